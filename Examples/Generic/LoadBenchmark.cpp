@@ -0,0 +1,206 @@
+// ==========================================================
+// Load benchmark
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at own risk!
+// ==========================================================
+
+//
+//  This example measures the decoding speed of the plugins.
+//  Each file given on the command line is loaded several times,
+//  either from the file itself (the first load warms up the system
+//  cache) or, with the -m option, from a memory stream filled once,
+//  so that neither disk access nor the file API hide the cost of the
+//  plugin itself.
+//  The throughput (file size divided by the load time) is reported
+//  per file and per format. Run it against two builds of the library
+//  to compare them.
+//
+//  Usage : LoadBenchmark [-m] [-n count] file1 [file2 ...]
+//
+//  Functions used in this sample : 
+//  FreeImage_OpenMemory, FreeImage_CloseMemory, FreeImage_GetFileTypeFromMemory, 
+//  FreeImage_GetFIFFromFilename, FreeImage_LoadFromMemory, FreeImage_Load, FreeImage_Unload, 
+//  FreeImage_GetFormatFromFIF, FreeImage_SetOutputMessage
+//
+// ==========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+
+/**
+FreeImage error handler
+@param fif Format / Plugin responsible for the error 
+@param message Error message
+*/
+void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message) {
+	printf("\n*** ");
+	if(fif != FIF_UNKNOWN) {
+		printf("%s Format\n", FreeImage_GetFormatFromFIF(fif));
+	}
+	printf("%s", message);
+	printf(" ***\n");
+}
+
+/**
+Read a whole file into memory
+@param lpszPathName File name
+@param size (return value) File size
+@return Returns a buffer allocated with malloc, or NULL
+*/
+static BYTE* LoadFileToMemory(const char *lpszPathName, long *size) {
+	FILE *file = fopen(lpszPathName, "rb");
+	if(!file) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	BYTE *buffer = (BYTE*)malloc(*size);
+	if(buffer && (fread(buffer, 1, *size, file) != (size_t)*size)) {
+		free(buffer);
+		buffer = NULL;
+	}
+	fclose(file);
+
+	return buffer;
+}
+
+/**
+Decode a file count times
+@param fif Format of the file
+@param lpszPathName File name, used when buffer is NULL
+@param buffer File content, or NULL to load from the file
+@param size File size
+@param count Number of loads
+@return Returns the total load time in seconds, or a negative value on error
+*/
+static double Benchmark(FREE_IMAGE_FORMAT fif, const char *lpszPathName, BYTE *buffer, long size, int count) {
+	clock_t start = clock();
+
+	for(int i = 0; i < count; i++) {
+		FIBITMAP *dib = NULL;
+		if(buffer) {
+			FIMEMORY *hmem = FreeImage_OpenMemory(buffer, (DWORD)size);
+			dib = FreeImage_LoadFromMemory(fif, hmem, 0);
+			FreeImage_CloseMemory(hmem);
+		} else {
+			dib = FreeImage_Load(fif, lpszPathName, 0);
+		}
+		if(!dib) {
+			return -1;
+		}
+		FreeImage_Unload(dib);
+	}
+
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// ----------------------------------------------------------
+
+int 
+main(int argc, char *argv[]) {
+	// total bytes and time per format
+	double format_bytes[FIF_JXR + 1];
+	double format_time[FIF_JXR + 1];
+	int count = 10;
+	BOOL from_memory = FALSE;
+	int first = 1;
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	FreeImage_Initialise();
+#endif // FREEIMAGE_LIB
+
+	FreeImage_SetOutputMessage(FreeImageErrorHandler);
+
+	while(first < argc) {
+		if(strcmp(argv[first], "-m") == 0) {
+			from_memory = TRUE;
+			first++;
+		} else if((strcmp(argv[first], "-n") == 0) && (first + 1 < argc)) {
+			count = atoi(argv[first + 1]);
+			first += 2;
+		} else {
+			break;
+		}
+	}
+	if((argc <= first) || (count <= 0)) {
+		printf("Usage : %s [-m] [-n count] file1 [file2 ...]\n", argv[0]);
+		return 0;
+	}
+
+	memset(format_bytes, 0, sizeof(format_bytes));
+	memset(format_time, 0, sizeof(format_time));
+
+	for(int i = first; i < argc; i++) {
+		long size = 0;
+		BYTE *buffer = LoadFileToMemory(argv[i], &size);
+		if(!buffer) {
+			printf("%s : cannot read the file\n", argv[i]);
+			continue;
+		}
+
+		// check the file signature, fall back to the file extension
+		FIMEMORY *hmem = FreeImage_OpenMemory(buffer, (DWORD)size);
+		FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(hmem, 0);
+		FreeImage_CloseMemory(hmem);
+		if(fif == FIF_UNKNOWN) {
+			fif = FreeImage_GetFIFFromFilename(argv[i]);
+		}
+
+		if((fif != FIF_UNKNOWN) && (fif <= FIF_JXR)) {
+			// warm up, then measure
+			BYTE *source = from_memory ? buffer : NULL;
+			double seconds = Benchmark(fif, argv[i], source, size, 1);
+			if(seconds >= 0) {
+				seconds = Benchmark(fif, argv[i], source, size, count);
+			}
+			if(seconds >= 0) {
+				double mb = (double)size * count / (1024 * 1024);
+				printf("%-8s %10ld bytes %8.3f ms/load %10.2f MB/s  %s\n", FreeImage_GetFormatFromFIF(fif), size, 1000 * seconds / count, (seconds > 0) ? mb / seconds : 0, argv[i]);
+				format_bytes[fif] += mb;
+				format_time[fif] += seconds;
+			} else {
+				printf("%s : load failed\n", argv[i]);
+			}
+		} else {
+			printf("%s : unknown format\n", argv[i]);
+		}
+
+		free(buffer);
+	}
+
+	// summary per format
+	printf("\n");
+	for(int fif = 0; fif <= FIF_JXR; fif++) {
+		if(format_bytes[fif] > 0) {
+			printf("%-8s %10.2f MB/s\n", FreeImage_GetFormatFromFIF((FREE_IMAGE_FORMAT)fif), (format_time[fif] > 0) ? format_bytes[fif] / format_time[fif] : 0);
+		}
+	}
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	FreeImage_DeInitialise();
+#endif // FREEIMAGE_LIB
+
+	return 0;
+}
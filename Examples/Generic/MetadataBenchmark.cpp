@@ -0,0 +1,203 @@
+// ==========================================================
+// Metadata benchmark
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at own risk!
+// ==========================================================
+
+//
+//  This example measures the speed of the metadata routines.
+//  Each file given on the command line is read into memory, then 
+//  - loaded several times without its pixels (FIF_LOAD_NOPIXELS), 
+//    which mostly measures the decoding of its Exif, IPTC, ... tags
+//  - the tags of all its metadata models are converted several times 
+//    to strings with FreeImage_TagToString.
+//  Both throughputs are reported in tags per second. Run it against 
+//  two builds of the library to compare them.
+//
+//  Usage : MetadataBenchmark [-n count] file1 [file2 ...]
+//
+//  Functions used in this sample : 
+//  FreeImage_OpenMemory, FreeImage_CloseMemory, FreeImage_GetFileTypeFromMemory, 
+//  FreeImage_LoadFromMemory, FreeImage_Unload, FreeImage_GetMetadataCount, 
+//  FreeImage_FindFirstMetadata, FreeImage_FindNextMetadata, FreeImage_FindCloseMetadata, 
+//  FreeImage_TagToString, FreeImage_SetOutputMessage
+//
+// ==========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+
+/**
+FreeImage error handler
+@param fif Format / Plugin responsible for the error 
+@param message Error message
+*/
+void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message) {
+	printf("\n*** ");
+	if(fif != FIF_UNKNOWN) {
+		printf("%s Format\n", FreeImage_GetFormatFromFIF(fif));
+	}
+	printf("%s", message);
+	printf(" ***\n");
+}
+
+/**
+Read a whole file into memory
+@param lpszPathName File name
+@param size (return value) File size
+@return Returns a buffer allocated with malloc, or NULL
+*/
+static BYTE* LoadFileToMemory(const char *lpszPathName, long *size) {
+	FILE *file = fopen(lpszPathName, "rb");
+	if(!file) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	BYTE *buffer = (BYTE*)malloc(*size);
+	if(buffer && (fread(buffer, 1, *size, file) != (size_t)*size)) {
+		free(buffer);
+		buffer = NULL;
+	}
+	fclose(file);
+
+	return buffer;
+}
+
+/**
+Load a file header only
+@return Returns the loaded bitmap, or NULL
+*/
+static FIBITMAP* LoadHeader(FREE_IMAGE_FORMAT fif, BYTE *buffer, long size) {
+	FIMEMORY *hmem = FreeImage_OpenMemory(buffer, (DWORD)size);
+	FIBITMAP *dib = FreeImage_LoadFromMemory(fif, hmem, FIF_LOAD_NOPIXELS);
+	FreeImage_CloseMemory(hmem);
+	return dib;
+}
+
+/**
+Count the tags of all the metadata models of a bitmap
+*/
+static unsigned CountTags(FIBITMAP *dib) {
+	unsigned count = 0;
+	for(int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		count += FreeImage_GetMetadataCount((FREE_IMAGE_MDMODEL)model, dib);
+	}
+	return count;
+}
+
+/**
+Convert the tags of all the metadata models of a bitmap to strings
+@return Returns the total length of the strings, so that the work cannot be optimized out
+*/
+static size_t ConvertTags(FIBITMAP *dib) {
+	size_t length = 0;
+	for(int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		FITAG *tag = NULL;
+		FIMETADATA *mdhandle = FreeImage_FindFirstMetadata((FREE_IMAGE_MDMODEL)model, dib, &tag);
+		if(mdhandle) {
+			do {
+				length += strlen(FreeImage_TagToString((FREE_IMAGE_MDMODEL)model, tag));
+			} while(FreeImage_FindNextMetadata(mdhandle, &tag));
+			FreeImage_FindCloseMetadata(mdhandle);
+		}
+	}
+	return length;
+}
+
+// ----------------------------------------------------------
+
+int 
+main(int argc, char *argv[]) {
+	int count = 1000;
+	int first = 1;
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	FreeImage_Initialise();
+#endif // FREEIMAGE_LIB
+
+	FreeImage_SetOutputMessage(FreeImageErrorHandler);
+
+	if((argc > 2) && (strcmp(argv[1], "-n") == 0)) {
+		count = atoi(argv[2]);
+		first = 3;
+	}
+	if((argc <= first) || (count <= 0)) {
+		printf("Usage : %s [-n count] file1 [file2 ...]\n", argv[0]);
+		return 0;
+	}
+
+	printf("%-32s %8s %16s %16s\n", "file", "tags", "decode (tags/s)", "string (tags/s)");
+
+	for(int i = first; i < argc; i++) {
+		long size = 0;
+		BYTE *buffer = LoadFileToMemory(argv[i], &size);
+		if(!buffer) {
+			printf("%-32s cannot be read\n", argv[i]);
+			continue;
+		}
+
+		FIMEMORY *hmem = FreeImage_OpenMemory(buffer, (DWORD)size);
+		FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(hmem, 0);
+		FreeImage_CloseMemory(hmem);
+
+		FIBITMAP *dib = (fif != FIF_UNKNOWN) ? LoadHeader(fif, buffer, size) : NULL;
+		const unsigned tags = dib ? CountTags(dib) : 0;
+		if(!tags) {
+			printf("%-32s has no metadata\n", argv[i]);
+			FreeImage_Unload(dib);
+			free(buffer);
+			continue;
+		}
+
+		// decode the tags
+		clock_t start = clock();
+		for(int j = 0; j < count; j++) {
+			FreeImage_Unload(LoadHeader(fif, buffer, size));
+		}
+		double decode_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		// convert the tags to strings
+		size_t length = 0;
+		start = clock();
+		for(int j = 0; j < count; j++) {
+			length += ConvertTags(dib);
+		}
+		double string_time = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		printf("%-32s %8u %16.0f %16.0f\n", argv[i], tags, 
+			(decode_time > 0) ? (double)tags * count / decode_time : 0, 
+			(string_time > 0) && length ? (double)tags * count / string_time : 0);
+
+		FreeImage_Unload(dib);
+		free(buffer);
+	}
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	FreeImage_DeInitialise();
+#endif // FREEIMAGE_LIB
+
+	return 0;
+}
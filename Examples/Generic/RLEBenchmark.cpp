@@ -0,0 +1,256 @@
+// ==========================================================
+// Run-length codec benchmark
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at own risk!
+// ==========================================================
+
+//
+//  This example measures the run-length codecs of the plugins that
+//  can write RLE data (TARGA, BMP RLE8 and PSD PackBits).
+//  Synthetic images are built in memory with three kinds of content :
+//  long runs, noise (literal packets only) and a mix of both, so that
+//  the run and the literal paths of the codecs are both measured.
+//  Each image is saved to a memory stream and loaded back several times,
+//  the encoding and decoding throughputs (uncompressed size divided by
+//  the time) are reported per format and per content.
+//  Run it against a build of the library made before the shared RLE
+//  codec module and against the current one to compare the old and the
+//  new codecs : the images are the same for both runs.
+//
+//  Usage : RLEBenchmark [-n count] [-s width height]
+//
+//  Functions used in this sample :
+//  FreeImage_Allocate, FreeImage_GetScanLine, FreeImage_GetPitch, FreeImage_Unload,
+//  FreeImage_OpenMemory, FreeImage_CloseMemory, FreeImage_SeekMemory, FreeImage_TellMemory,
+//  FreeImage_SaveToMemory, FreeImage_LoadFromMemory, FreeImage_GetFormatFromFIF,
+//  FreeImage_SetOutputMessage
+//
+// ==========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+
+/**
+FreeImage error handler
+@param fif Format / Plugin responsible for the error
+@param message Error message
+*/
+void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message) {
+	printf("\n*** ");
+	if(fif != FIF_UNKNOWN) {
+		printf("%s Format\n", FreeImage_GetFormatFromFIF(fif));
+	}
+	printf("%s", message);
+	printf(" ***\n");
+}
+
+/** Kind of synthetic image content */
+typedef enum {
+	CONTENT_RUNS = 0,	//! long runs of the same pixel
+	CONTENT_NOISE = 1,	//! no two consecutive equal pixels
+	CONTENT_MIXED = 2	//! runs and noise alternate
+} CONTENT;
+
+static const char *content_names[] = { "runs", "noise", "mixed" };
+
+/**
+Build a synthetic image
+@param width Image width
+@param height Image height
+@param bpp 8, 24 or 32
+@param content Kind of content
+@return Returns the image, or NULL
+*/
+static FIBITMAP* CreateImage(unsigned width, unsigned height, unsigned bpp, CONTENT content) {
+	FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+	if(!dib) {
+		return NULL;
+	}
+
+	if(bpp == 8) {
+		// greyscale palette
+		RGBQUAD *pal = FreeImage_GetPalette(dib);
+		for(int i = 0; i < 256; i++) {
+			pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
+		}
+	}
+
+	const unsigned bytespp = bpp / 8;
+	unsigned seed = 0x12345678;
+
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width * bytespp; x++) {
+			// xorshift noise
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+
+			BOOL noise = FALSE;
+			switch(content) {
+				case CONTENT_NOISE:
+					noise = TRUE;
+					break;
+				case CONTENT_MIXED:
+					noise = ((x / (64 * bytespp)) % 2) == 1;
+					break;
+				default:
+					break;
+			}
+			// runs of 200 pixels, noise made of distinct consecutive values
+			bits[x] = noise ? (BYTE)(((x % 2) ? 0x80 : 0) | (seed & 0x7F)) : (BYTE)(y + x / (200 * bytespp));
+		}
+	}
+
+	return dib;
+}
+
+/**
+Encode and decode an image count times
+@param fif Output format
+@param dib Image to encode
+@param flags Save flags selecting the RLE compression
+@param count Number of iterations
+@param encode_time (return value) Total encoding time in seconds
+@param decode_time (return value) Total decoding time in seconds
+@param packed_size (return value) Size of the encoded stream
+@return Returns TRUE if successful, FALSE otherwise
+*/
+static BOOL Benchmark(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags, int count, double *encode_time, double *decode_time, long *packed_size) {
+	*encode_time = 0;
+	*decode_time = 0;
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+
+	for(int i = 0; i < count; i++) {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+
+		clock_t start = clock();
+		if(!FreeImage_SaveToMemory(fif, dib, hmem, flags)) {
+			FreeImage_CloseMemory(hmem);
+			return FALSE;
+		}
+		*encode_time += (double)(clock() - start) / CLOCKS_PER_SEC;
+		*packed_size = FreeImage_TellMemory(hmem);
+
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+
+		start = clock();
+		FIBITMAP *check = FreeImage_LoadFromMemory(fif, hmem, 0);
+		if(!check) {
+			FreeImage_CloseMemory(hmem);
+			return FALSE;
+		}
+		*decode_time += (double)(clock() - start) / CLOCKS_PER_SEC;
+		FreeImage_Unload(check);
+	}
+
+	FreeImage_CloseMemory(hmem);
+
+	return TRUE;
+}
+
+// ----------------------------------------------------------
+
+/** Format, depth and flags of a benchmark case */
+typedef struct {
+	FREE_IMAGE_FORMAT fif;
+	unsigned bpp;
+	int flags;
+} RLECASE;
+
+int
+main(int argc, char *argv[]) {
+	const RLECASE cases[] = {
+		{ FIF_TARGA, 8, TARGA_SAVE_RLE },
+		{ FIF_TARGA, 24, TARGA_SAVE_RLE },
+		{ FIF_TARGA, 32, TARGA_SAVE_RLE },
+		{ FIF_BMP, 8, BMP_SAVE_RLE },
+		{ FIF_PSD, 24, PSD_RLE },
+		{ FIF_PSD, 32, PSD_RLE }
+	};
+	int count = 10;
+	unsigned width = 4096;
+	unsigned height = 4096;
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	FreeImage_Initialise();
+#endif // FREEIMAGE_LIB
+
+	FreeImage_SetOutputMessage(FreeImageErrorHandler);
+
+	for(int i = 1; i < argc; i++) {
+		if((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+			count = atoi(argv[++i]);
+		} else if((strcmp(argv[i], "-s") == 0) && (i + 2 < argc)) {
+			width = (unsigned)atoi(argv[i + 1]);
+			height = (unsigned)atoi(argv[i + 2]);
+			i += 2;
+		} else {
+			printf("Usage : %s [-n count] [-s width height]\n", argv[0]);
+			return 0;
+		}
+	}
+	if((count <= 0) || (width == 0) || (height == 0)) {
+		printf("Usage : %s [-n count] [-s width height]\n", argv[0]);
+		return 0;
+	}
+
+	printf("%-8s %3s %-6s %10s %10s %12s %12s\n", "format", "bpp", "data", "raw bytes", "rle bytes", "encode MB/s", "decode MB/s");
+
+	for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+		for(int content = CONTENT_RUNS; content <= CONTENT_MIXED; content++) {
+			FIBITMAP *dib = CreateImage(width, height, cases[c].bpp, (CONTENT)content);
+			if(!dib) {
+				printf("cannot allocate a %ux%u image\n", width, height);
+				continue;
+			}
+
+			double encode_time = 0, decode_time = 0;
+			long packed_size = 0;
+			// warm up, then measure
+			BOOL bSuccess = Benchmark(cases[c].fif, dib, cases[c].flags, 1, &encode_time, &decode_time, &packed_size);
+			if(bSuccess) {
+				bSuccess = Benchmark(cases[c].fif, dib, cases[c].flags, count, &encode_time, &decode_time, &packed_size);
+			}
+
+			const char *format = FreeImage_GetFormatFromFIF(cases[c].fif);
+			if(bSuccess) {
+				const double raw_size = (double)width * height * (cases[c].bpp / 8);
+				const double mb = raw_size * count / (1024 * 1024);
+				printf("%-8s %3u %-6s %10.0f %10ld %12.2f %12.2f\n", format, cases[c].bpp, content_names[content], raw_size, packed_size,
+					(encode_time > 0) ? mb / encode_time : 0, (decode_time > 0) ? mb / decode_time : 0);
+			} else {
+				printf("%-8s %3u %-6s : save or load failed\n", format, cases[c].bpp, content_names[content]);
+			}
+
+			FreeImage_Unload(dib);
+		}
+	}
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	FreeImage_DeInitialise();
+#endif // FREEIMAGE_LIB
+
+	return 0;
+}
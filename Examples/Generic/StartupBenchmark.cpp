@@ -0,0 +1,149 @@
+// ==========================================================
+// Startup benchmark
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at own risk!
+// ==========================================================
+
+//
+//  This example measures what a short-lived process pays to start using FreeImage :
+//  - the library initialization (static library builds only, the shared library
+//    is initialized when it is loaded, before main),
+//  - the first format lookup and the first load of a file without its pixels,
+//    which include the one-time setup done on first use,
+//  - a second load of the same file, for comparison,
+//  - count FreeImage_DeInitialise / FreeImage_Initialise cycles (static library builds only).
+//  Times are reported in microseconds. The first-use figures are only meaningful
+//  in a fresh process, run the example several times to average them.
+//
+//  Usage : StartupBenchmark [-n count] file
+//
+//  Functions used in this sample :
+//  FreeImage_Initialise, FreeImage_DeInitialise, FreeImage_GetFIFFromFilename,
+//  FreeImage_GetFileType, FreeImage_Load, FreeImage_Unload, FreeImage_GetMetadataCount,
+//  FreeImage_SetOutputMessage
+//
+// ==========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+
+/**
+FreeImage error handler
+@param fif Format / Plugin responsible for the error
+@param message Error message
+*/
+void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message) {
+	printf("\n*** ");
+	if(fif != FIF_UNKNOWN) {
+		printf("%s Format\n", FreeImage_GetFormatFromFIF(fif));
+	}
+	printf("%s", message);
+	printf(" ***\n");
+}
+
+/**
+Microseconds elapsed since start
+*/
+static double Elapsed(const std::chrono::steady_clock::time_point &start) {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+Load a file header only and count its tags
+@return Returns the number of tags, or -1 if the file cannot be loaded
+*/
+static int LoadHeader(const char *lpszPathName) {
+	FIBITMAP *dib = FreeImage_Load(FreeImage_GetFileType(lpszPathName), lpszPathName, FIF_LOAD_NOPIXELS);
+	if(!dib) {
+		return -1;
+	}
+	int count = 0;
+	for(int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		count += (int)FreeImage_GetMetadataCount((FREE_IMAGE_MDMODEL)model, dib);
+	}
+	FreeImage_Unload(dib);
+	return count;
+}
+
+// ----------------------------------------------------------
+
+int
+main(int argc, char *argv[]) {
+	int count = 100;
+	int first = 1;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	FreeImage_Initialise();
+	const double init_time = Elapsed(start);
+#endif // FREEIMAGE_LIB
+
+	FreeImage_SetOutputMessage(FreeImageErrorHandler);
+
+	if((argc > 2) && (strcmp(argv[1], "-n") == 0)) {
+		count = atoi(argv[2]);
+		first = 3;
+	}
+	if((argc <= first) || (count <= 0)) {
+		printf("Usage : %s [-n count] file\n", argv[0]);
+		return 0;
+	}
+	const char *lpszPathName = argv[first];
+
+#ifdef FREEIMAGE_LIB
+	printf("%-32s %10.1f us\n", "FreeImage_Initialise", init_time);
+#endif // FREEIMAGE_LIB
+
+	// first use
+	start = std::chrono::steady_clock::now();
+	const FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFilename(lpszPathName);
+	printf("%-32s %10.1f us (%s)\n", "first format lookup", Elapsed(start), (fif != FIF_UNKNOWN) ? FreeImage_GetFormatFromFIF(fif) : "unknown");
+
+	start = std::chrono::steady_clock::now();
+	const int tags = LoadHeader(lpszPathName);
+	const double first_load_time = Elapsed(start);
+	if(tags < 0) {
+		printf("%s cannot be loaded\n", lpszPathName);
+		return 0;
+	}
+	printf("%-32s %10.1f us (%d tags)\n", "first header load", first_load_time, tags);
+
+	start = std::chrono::steady_clock::now();
+	LoadHeader(lpszPathName);
+	printf("%-32s %10.1f us\n", "second header load", Elapsed(start));
+
+	// call this ONLY when linking with FreeImage as a static library
+#ifdef FREEIMAGE_LIB
+	// initialization cycles (the shared library stays initialized while it is loaded)
+	start = std::chrono::steady_clock::now();
+	for(int i = 0; i < count; i++) {
+		FreeImage_DeInitialise();
+		FreeImage_Initialise();
+	}
+	printf("%-32s %10.1f us\n", "DeInitialise + Initialise", Elapsed(start) / count);
+
+	FreeImage_DeInitialise();
+#endif // FREEIMAGE_LIB
+
+	return 0;
+}
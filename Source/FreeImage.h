@@ -526,6 +526,30 @@ FI_ENUM(FREE_IMAGE_COLOR_CHANNEL) {
 	FICC_PHASE	= 9		//! Complex images: use phase
 };
 
+/** Pixel layouts.
+Constants used in FreeImage_ReadRect / FreeImage_WriteRect to describe a caller buffer.
+Planar layouts store 4 consecutive planes (R, G, B, A), each plane being height rows of pitch bytes.
+*/
+FI_ENUM(FREE_IMAGE_PIXEL_LAYOUT) {
+	FIPL_BGRA8			= 0,	//! 4 x 8-bit, B G R A
+	FIPL_RGBA8			= 1,	//! 4 x 8-bit, R G B A
+	FIPL_RGB8			= 2,	//! 3 x 8-bit, R G B
+	FIPL_RGB16			= 3,	//! 3 x 16-bit unsigned, R G B
+	FIPL_RGBA16			= 4,	//! 4 x 16-bit unsigned, R G B A
+	FIPL_RGBAF			= 5,	//! 4 x 32-bit IEEE floating point, R G B A
+	FIPL_RGBA8_PLANAR	= 6,	//! 8-bit planes R, G, B, A
+	FIPL_RGBAF_PLANAR	= 7		//! 32-bit IEEE floating point planes R, G, B, A
+};
+
+/** Blend modes.
+Constants used in FreeImage_AlphaComposite.
+*/
+FI_ENUM(FREE_IMAGE_BLEND_MODE) {
+	FIBM_SRC_OVER	= 0,	//! Porter-Duff source over destination
+	FIBM_MULTIPLY	= 1,	//! Source over destination, colors multiplied
+	FIBM_SCREEN		= 2		//! Source over destination, colors screened
+};
+
 // Metadata support ---------------------------------------------------------
 
 /**
@@ -573,6 +597,16 @@ FI_ENUM(FREE_IMAGE_MDMODEL) {
 	FIMD_EXIF_RAW		= 11	//! Exif metadata as a raw buffer
 };
 
+/** Status of an asynchronous load or save
+*/
+FI_ENUM(FREE_IMAGE_JOB_STATUS) {
+	FIJS_PENDING	= 0,	//! waiting for a thread
+	FIJS_RUNNING	= 1,	//! being loaded or saved
+	FIJS_DONE		= 2,	//! loaded or saved successfully
+	FIJS_FAILED		= 3,	//! load or save failed
+	FIJS_CANCELLED	= 4		//! cancelled before completion
+};
+
 /**
   Handle to a metadata model
 */
@@ -583,6 +617,19 @@ FI_STRUCT (FIMETADATA) { void *data; };
 */
 FI_STRUCT (FITAG) { void *data; };
 
+/**
+  Handle to the result of a metadata scan (see FreeImage_ScanMetadata)
+*/
+FI_STRUCT (FIMETADATASCAN) { void *data; };
+
+/**
+  Tag requested from a metadata scan
+*/
+FI_STRUCT (FIMETADATAKEY) {
+	FREE_IMAGE_MDMODEL model;	//! metadata model of the tag
+	const char *key;			//! tag field name
+};
+
 // File IO routines ---------------------------------------------------------
 
 #ifndef FREEIMAGE_IO
@@ -620,6 +667,17 @@ FI_STRUCT (FIMEMORY) { void *data; };
 
 #endif // FREEIMAGE_IO
 
+/**
+Handle to an asynchronous load or save (see FreeImage_LoadAsync)
+*/
+FI_STRUCT (FIASYNCJOB) { void *data; };
+
+/**
+Completion callback of an asynchronous load or save, called once on the thread that ran it.
+The callback may change the thread count or the executor (see FreeImage_LoadAsync)
+*/
+typedef void (DLL_CALLCONV *FI_AsyncCallback)(FIASYNCJOB *job, void *user_data);
+
 // Plugin routines ----------------------------------------------------------
 
 #ifndef PLUGINS
@@ -669,6 +727,8 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 // Load / Save flag constants -----------------------------------------------
 
 #define FIF_LOAD_NOPIXELS 0x8000	//! loading: load the image header only (not supported by all plugins, default to full loading)
+#define FIF_LOAD_MAPPED   0x4000	//! loading: wrap the pixels of an uncompressed file instead of reading them, memory streams are copied (BMP and TARGA only, default to full loading)
+#define FIF_LOAD_RAWMETADATA 0x2000	//! loading: keep the Exif and IPTC profiles as read, decode them on first access to their tags (JPEG, WebP, PSD, TIFF and JXR IPTC), concurrent reads of the tags are safe, writes are not
 
 #define BMP_DEFAULT         0
 #define BMP_SAVE_RLE        1
@@ -782,6 +842,7 @@ typedef void (DLL_CALLCONV *FI_InitProc)(Plugin *plugin, int format_id);
 #define FI_RESCALE_DEFAULT			0x00    //! default options; none of the following other options apply
 #define FI_RESCALE_TRUE_COLOR		0x01	//! for non-transparent greyscale images, convert to 24-bit if src bitdepth <= 8 (default is a 8-bit greyscale image). 
 #define FI_RESCALE_OMIT_METADATA	0x02	//! do not copy metadata to the rescaled image
+#define FI_RESCALE_PREMULTIPLY_ALPHA	0x04	//! for 32-bit, RGBA16, RGBA16F and RGBAF images, filter the colors in premultiplied space (weighted by alpha); input and output colors stay straight
 
 
 #ifdef __cplusplus
@@ -807,6 +868,23 @@ DLL_API void DLL_CALLCONV FreeImage_SetOutputMessageStdCall(FreeImage_OutputMess
 DLL_API void DLL_CALLCONV FreeImage_SetOutputMessage(FreeImage_OutputMessageFunction omf);
 DLL_API void DLL_CALLCONV FreeImage_OutputMessageProc(int fif, const char *fmt, ...);
 
+// Multithreading routines --------------------------------------------------
+
+typedef void (DLL_CALLCONV *FI_TaskProc)(void *task);
+typedef void (DLL_CALLCONV *FI_ExecuteProc)(FI_TaskProc proc, void *task, void *user_data);
+
+DLL_API void DLL_CALLCONV FreeImage_SetThreadCount(int count);
+DLL_API int DLL_CALLCONV FreeImage_GetThreadCount(void);
+DLL_API void DLL_CALLCONV FreeImage_SetExecutor(FI_ExecuteProc execute, int concurrency, void *user_data);
+DLL_API void DLL_CALLCONV FreeImage_SetMaxParallelism(int count);
+DLL_API int DLL_CALLCONV FreeImage_GetMaxParallelism(void);
+
+// Progress routines --------------------------------------------------------
+
+typedef BOOL (DLL_CALLCONV *FI_ProgressProc)(double progress, void *user_data);
+
+DLL_API void DLL_CALLCONV FreeImage_SetProgressHandler(FI_ProgressProc proc, void *user_data FI_DEFAULT(NULL));
+
 // Allocate / Clone / Unload routines ---------------------------------------
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Allocate(int width, int height, int bpp, unsigned red_mask FI_DEFAULT(0), unsigned green_mask FI_DEFAULT(0), unsigned blue_mask FI_DEFAULT(0));
@@ -841,6 +919,21 @@ DLL_API unsigned DLL_CALLCONV FreeImage_WriteMemory(const void *buffer, unsigned
 DLL_API FIMULTIBITMAP *DLL_CALLCONV FreeImage_LoadMultiBitmapFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags FI_DEFAULT(0));
 DLL_API BOOL DLL_CALLCONV FreeImage_SaveMultiBitmapToMemory(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap, FIMEMORY *stream, int flags);
 
+// Asynchronous load / save routines ----------------------------------------
+
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_LoadAsync(FREE_IMAGE_FORMAT fif, const char *filename, int flags FI_DEFAULT(0), FI_AsyncCallback callback FI_DEFAULT(NULL), void *user_data FI_DEFAULT(NULL));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_LoadFromHandleAsync(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0), FI_AsyncCallback callback FI_DEFAULT(NULL), void *user_data FI_DEFAULT(NULL));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_LoadFromMemoryAsync(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags FI_DEFAULT(0), FI_AsyncCallback callback FI_DEFAULT(NULL), void *user_data FI_DEFAULT(NULL));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_SaveAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *filename, int flags FI_DEFAULT(0), FI_AsyncCallback callback FI_DEFAULT(NULL), void *user_data FI_DEFAULT(NULL));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_SaveToHandleAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0), FI_AsyncCallback callback FI_DEFAULT(NULL), void *user_data FI_DEFAULT(NULL));
+DLL_API FIASYNCJOB *DLL_CALLCONV FreeImage_SaveToMemoryAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, int flags FI_DEFAULT(0), FI_AsyncCallback callback FI_DEFAULT(NULL), void *user_data FI_DEFAULT(NULL));
+DLL_API FREE_IMAGE_JOB_STATUS DLL_CALLCONV FreeImage_GetAsyncStatus(FIASYNCJOB *job);
+DLL_API FREE_IMAGE_JOB_STATUS DLL_CALLCONV FreeImage_WaitAsync(FIASYNCJOB *job);
+DLL_API BOOL DLL_CALLCONV FreeImage_CancelAsync(FIASYNCJOB *job);
+DLL_API double DLL_CALLCONV FreeImage_GetAsyncProgress(FIASYNCJOB *job);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetAsyncBitmap(FIASYNCJOB *job);
+DLL_API void DLL_CALLCONV FreeImage_CloseAsync(FIASYNCJOB *job);
+
 // Plugin Interface ---------------------------------------------------------
 
 DLL_API FREE_IMAGE_FORMAT DLL_CALLCONV FreeImage_RegisterLocalPlugin(FI_InitProc proc_address, const char *format FI_DEFAULT(0), const char *description FI_DEFAULT(0), const char *extension FI_DEFAULT(0), const char *regexpr FI_DEFAULT(0));
@@ -912,6 +1005,9 @@ DLL_API BOOL DLL_CALLCONV FreeImage_GetPixelColor(FIBITMAP *dib, unsigned x, uns
 DLL_API BOOL DLL_CALLCONV FreeImage_SetPixelIndex(FIBITMAP *dib, unsigned x, unsigned y, BYTE *value);
 DLL_API BOOL DLL_CALLCONV FreeImage_SetPixelColor(FIBITMAP *dib, unsigned x, unsigned y, RGBQUAD *value);
 
+DLL_API BOOL DLL_CALLCONV FreeImage_ReadRect(FIBITMAP *dib, int left, int top, int width, int height, void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout);
+DLL_API BOOL DLL_CALLCONV FreeImage_WriteRect(FIBITMAP *dib, int left, int top, int width, int height, const void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout);
+
 // DIB info routines --------------------------------------------------------
 
 DLL_API unsigned DLL_CALLCONV FreeImage_GetColorsUsed(FIBITMAP *dib);
@@ -1021,11 +1117,15 @@ DLL_API void DLL_CALLCONV FreeImage_ConvertToRawBits(BYTE *bits, FIBITMAP *dib,
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToFloat(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBF(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBAF(FIBITMAP *dib);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGB16F(FIBITMAP *dib);
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBA16F(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToUINT16(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGB16(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToRGBA16(FIBITMAP *dib);
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToStandardType(FIBITMAP *src, BOOL scale_linear FI_DEFAULT(TRUE));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToStandardTypeRange(FIBITMAP *src, double min_value, double max_value);
+DLL_API BOOL DLL_CALLCONV FreeImage_GetMinMax(FIBITMAP *src, double *min_value, double *max_value, double clip_percent FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_linear FI_DEFAULT(TRUE));
 
 // Tone mapping operators ---------------------------------------------------
@@ -1088,6 +1188,18 @@ DLL_API BOOL DLL_CALLCONV FreeImage_CloneMetadata(FIBITMAP *dst, FIBITMAP *src);
 // tag to C string conversion
 DLL_API const char* DLL_CALLCONV FreeImage_TagToString(FREE_IMAGE_MDMODEL model, FITAG *tag, char *Make FI_DEFAULT(NULL));
 
+// batch scan of the header and of selected tags of many files
+DLL_API FIMETADATASCAN *DLL_CALLCONV FreeImage_ScanMetadata(const char **filenames, int count, const FIMETADATAKEY *keys, int key_count);
+DLL_API FIMETADATASCAN *DLL_CALLCONV FreeImage_ScanMetadataFromHandle(FreeImageIO *io, fi_handle *handles, int count, const FIMETADATAKEY *keys, int key_count);
+DLL_API void DLL_CALLCONV FreeImage_CloseMetadataScan(FIMETADATASCAN *scan);
+DLL_API int DLL_CALLCONV FreeImage_GetScanCount(FIMETADATASCAN *scan);
+DLL_API FREE_IMAGE_FORMAT DLL_CALLCONV FreeImage_GetScanFormat(FIMETADATASCAN *scan, int index);
+DLL_API FREE_IMAGE_TYPE DLL_CALLCONV FreeImage_GetScanImageType(FIMETADATASCAN *scan, int index);
+DLL_API unsigned DLL_CALLCONV FreeImage_GetScanWidth(FIMETADATASCAN *scan, int index);
+DLL_API unsigned DLL_CALLCONV FreeImage_GetScanHeight(FIMETADATASCAN *scan, int index);
+DLL_API unsigned DLL_CALLCONV FreeImage_GetScanBPP(FIMETADATASCAN *scan, int index);
+DLL_API FITAG *DLL_CALLCONV FreeImage_GetScanTag(FIMETADATASCAN *scan, int index, int key_index);
+
 // --------------------------------------------------------------------------
 // JPEG lossless transformation routines
 // --------------------------------------------------------------------------
@@ -1108,6 +1220,7 @@ DLL_API BOOL DLL_CALLCONV FreeImage_JPEGTransformCombinedFromMemory(FIMEMORY* sr
 
 // rotation and flipping
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor FI_DEFAULT(NULL));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RotateBilinear(FIBITMAP *dib, double angle, const void *bkcolor FI_DEFAULT(NULL));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask);
 DLL_API BOOL DLL_CALLCONV FreeImage_FlipHorizontal(FIBITMAP *dib);
 DLL_API BOOL DLL_CALLCONV FreeImage_FlipVertical(FIBITMAP *dib);
@@ -1124,6 +1237,7 @@ DLL_API BOOL DLL_CALLCONV FreeImage_AdjustBrightness(FIBITMAP *dib, double perce
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustContrast(FIBITMAP *dib, double percentage);
 DLL_API BOOL DLL_CALLCONV FreeImage_Invert(FIBITMAP *dib);
 DLL_API BOOL DLL_CALLCONV FreeImage_GetHistogram(FIBITMAP *dib, DWORD *histo, FREE_IMAGE_COLOR_CHANNEL channel FI_DEFAULT(FICC_BLACK));
+DLL_API BOOL DLL_CALLCONV FreeImage_GetHistogramEx(FIBITMAP *dib, DWORD *red, DWORD *green, DWORD *blue, DWORD *alpha FI_DEFAULT(NULL), DWORD *black FI_DEFAULT(NULL), unsigned bins FI_DEFAULT(256), double min_value FI_DEFAULT(0), double max_value FI_DEFAULT(255));
 DLL_API int DLL_CALLCONV FreeImage_GetAdjustColorsLookupTable(BYTE *LUT, double brightness, double contrast, double gamma, BOOL invert);
 DLL_API BOOL DLL_CALLCONV FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double gamma, BOOL invert FI_DEFAULT(FALSE));
 DLL_API unsigned DLL_CALLCONV FreeImage_ApplyColorMapping(FIBITMAP *dib, RGBQUAD *srccolors, RGBQUAD *dstcolors, unsigned count, BOOL ignore_alpha, BOOL swap);
@@ -1144,6 +1258,8 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CreateView(FIBITMAP *dib, unsigned left
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg FI_DEFAULT(FALSE), RGBQUAD *appBkColor FI_DEFAULT(NULL), FIBITMAP *bg FI_DEFAULT(NULL));
 DLL_API BOOL DLL_CALLCONV FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib);
+DLL_API BOOL DLL_CALLCONV FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib);
+DLL_API BOOL DLL_CALLCONV FreeImage_AlphaComposite(FIBITMAP *dst, FIBITMAP *src, int left, int top, FREE_IMAGE_BLEND_MODE mode FI_DEFAULT(FIBM_SRC_OVER), BOOL premultiplied FI_DEFAULT(FALSE), double opacity FI_DEFAULT(1.0));
 
 // background filling routines
 DLL_API BOOL DLL_CALLCONV FreeImage_FillBackground(FIBITMAP *dib, const void *color, int options FI_DEFAULT(0));
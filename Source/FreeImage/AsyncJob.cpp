@@ -0,0 +1,435 @@
+// ==========================================================
+// Asynchronous load / save
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImageIO.h"
+#include "ThreadPool.h"
+
+// ----------------------------------------------------------
+//   Asynchronous job
+// ----------------------------------------------------------
+
+/** Work done by a job */
+typedef enum {
+	ASYNC_LOAD_FILE,
+	ASYNC_LOAD_HANDLE,
+	ASYNC_LOAD_MEMORY,
+	ASYNC_SAVE_FILE,
+	ASYNC_SAVE_HANDLE,
+	ASYNC_SAVE_MEMORY
+} ASYNCWORK;
+
+/**
+A load or save run on the worker pool.<br>
+The job is referenced by the application handle and by the task running it,
+the last release frees it (and the loaded bitmap if the application did not take it).
+*/
+typedef struct tagASYNCJOB {
+	FIASYNCJOB handle;				//! handle given to the application
+	ASYNCWORK work;
+	FREE_IMAGE_FORMAT fif;
+	int flags;
+	std::string filename;			//! file to load or save
+	FreeImageIO io;					//! IO of the handle to load or save
+	fi_handle stream;				//! handle or FIMEMORY to load or save
+	FIBITMAP *dib;					//! loaded bitmap, or bitmap to save
+	FI_AsyncCallback callback;
+	void *user_data;
+	std::atomic<int> status;		//! FREE_IMAGE_JOB_STATUS
+	std::atomic<bool> cancelled;	//! TRUE once the application cancelled the job
+	std::atomic<double> progress;	//! fraction of the job done
+	std::atomic<int> references;	//! application handle and task
+	std::mutex mutex;
+	std::condition_variable finished;
+} ASYNCJOB;
+
+static inline BOOL
+IsLoad(const ASYNCJOB *job) {
+	return (job->work == ASYNC_LOAD_FILE) || (job->work == ASYNC_LOAD_HANDLE) || (job->work == ASYNC_LOAD_MEMORY);
+}
+
+static inline ASYNCJOB*
+GetJob(FIASYNCJOB *handle) {
+	return handle ? (ASYNCJOB*)handle->data : NULL;
+}
+
+static void
+ReleaseJob(ASYNCJOB *job) {
+	if(--job->references == 0) {
+		if(IsLoad(job) && job->dib) {
+			FreeImage_Unload(job->dib);
+		}
+		delete job;
+	}
+}
+
+/**
+Set the final status of a job and wake up the threads waiting for it
+*/
+static void
+FinishJob(ASYNCJOB *job, FREE_IMAGE_JOB_STATUS status) {
+	std::lock_guard<std::mutex> lock(job->mutex);
+	job->status = status;
+	job->finished.notify_all();
+}
+
+// ----------------------------------------------------------
+//   Load / save
+// ----------------------------------------------------------
+
+/**
+Load a file. The file is mapped and the system asked to read it ahead, so that
+the reads overlap with the decoding, which reads the mapping as a memory stream.
+Files that cannot be mapped, and mapped loads (FIF_LOAD_MAPPED keeps its own view
+of the file), are loaded through the default IO.
+*/
+static FIBITMAP*
+LoadFile(FREE_IMAGE_FORMAT fif, const char *filename, int flags) {
+	if((flags & FIF_LOAD_MAPPED) == 0) {
+		FILE *handle = fopen(filename, "rb");
+		if(!handle) {
+			FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadAsync: failed to open file %s", filename);
+			return NULL;
+		}
+
+		FreeImageIO io;
+		SetDefaultIO(&io);
+
+		void *mapping = NULL;
+		BYTE *data = NULL;
+		long size = 0;
+		if((fseek(handle, 0, SEEK_END) == 0) && ((size = ftell(handle)) > 0) && ((UINT64)size <= 0xFFFFFFFF) && (fseek(handle, 0, SEEK_SET) == 0)) {
+			data = MapIO(&io, (fi_handle)handle, 0, (size_t)size, &mapping);
+		}
+		fclose(handle);
+
+		if(data) {
+			PrefetchIO(mapping);
+
+			FIBITMAP *dib = NULL;
+			FIMEMORY *hmem = FreeImage_OpenMemory(data, (DWORD)size);
+			if(hmem) {
+				if(fif == FIF_UNKNOWN) {
+					fif = FreeImage_GetFileTypeFromMemory(hmem, 0);
+				}
+				if(FreeImage_FIFSupportsReading(fif)) {
+					dib = FreeImage_LoadFromMemory(fif, hmem, flags);
+				}
+				FreeImage_CloseMemory(hmem);
+			}
+			UnmapIO(mapping);
+			return dib;
+		}
+	}
+
+	if(fif == FIF_UNKNOWN) {
+		fif = FreeImage_GetFileType(filename, 0);
+	}
+	return FreeImage_FIFSupportsReading(fif) ? FreeImage_Load(fif, filename, flags) : NULL;
+}
+
+/**
+Progress handler of a running job
+@return Returns FALSE once the job is cancelled
+*/
+static BOOL DLL_CALLCONV
+JobProgress(double progress, void *user_data) {
+	ASYNCJOB *job = (ASYNCJOB*)user_data;
+	job->progress = progress;
+	return job->cancelled ? FALSE : TRUE;
+}
+
+/**
+Task running a job
+*/
+static void DLL_CALLCONV
+RunJob(void *task) {
+	ASYNCJOB *job = (ASYNCJOB*)task;
+
+	// a job cancelled before it started only calls back
+	int pending = FIJS_PENDING;
+	if(job->status.compare_exchange_strong(pending, FIJS_RUNNING)) {
+		BOOL bSuccess = FALSE;
+		FREE_IMAGE_FORMAT fif = job->fif;
+
+		// the codecs stop at their next progress report once the job is cancelled
+		ProgressHandler handler(JobProgress, job);
+
+		switch(job->work) {
+			case ASYNC_LOAD_FILE:
+				job->dib = LoadFile(fif, job->filename.c_str(), job->flags);
+				bSuccess = (job->dib != NULL);
+				break;
+
+			case ASYNC_LOAD_HANDLE:
+				if(fif == FIF_UNKNOWN) {
+					fif = FreeImage_GetFileTypeFromHandle(&job->io, job->stream, 0);
+				}
+				job->dib = FreeImage_FIFSupportsReading(fif) ? FreeImage_LoadFromHandle(fif, &job->io, job->stream, job->flags) : NULL;
+				bSuccess = (job->dib != NULL);
+				break;
+
+			case ASYNC_LOAD_MEMORY:
+				if(fif == FIF_UNKNOWN) {
+					fif = FreeImage_GetFileTypeFromMemory((FIMEMORY*)job->stream, 0);
+				}
+				job->dib = FreeImage_FIFSupportsReading(fif) ? FreeImage_LoadFromMemory(fif, (FIMEMORY*)job->stream, job->flags) : NULL;
+				bSuccess = (job->dib != NULL);
+				break;
+
+			case ASYNC_SAVE_FILE:
+				bSuccess = FreeImage_Save(fif, job->dib, job->filename.c_str(), job->flags);
+				break;
+
+			case ASYNC_SAVE_HANDLE:
+				bSuccess = FreeImage_SaveToHandle(fif, job->dib, &job->io, job->stream, job->flags);
+				break;
+
+			case ASYNC_SAVE_MEMORY:
+				bSuccess = FreeImage_SaveToMemory(fif, job->dib, (FIMEMORY*)job->stream, job->flags);
+				break;
+		}
+
+		if(bSuccess) {
+			job->progress = 1;
+		}
+		FinishJob(job, bSuccess ? FIJS_DONE : (job->cancelled ? FIJS_CANCELLED : FIJS_FAILED));
+	}
+
+	if(job->callback) {
+		job->callback(&job->handle, job->user_data);
+	}
+
+	ReleaseJob(job);
+}
+
+/**
+Create a job and submit it to the worker pool, or run it if it cannot be submitted
+*/
+static FIASYNCJOB*
+StartJob(ASYNCWORK work, FREE_IMAGE_FORMAT fif, int flags, const char *filename, FreeImageIO *io, fi_handle stream, FIBITMAP *dib, FI_AsyncCallback callback, void *user_data) {
+	ASYNCJOB *job = NULL;
+	try {
+		job = new ASYNCJOB;
+		if(filename) {
+			job->filename = filename;
+		}
+	} catch(std::bad_alloc &) {
+		delete job;
+		FreeImage_OutputMessageProc((int)fif, FI_MSG_ERROR_MEMORY);
+		return NULL;
+	}
+
+	job->handle.data = job;
+	job->work = work;
+	job->fif = fif;
+	job->flags = flags;
+	if(io) {
+		job->io = *io;
+	} else {
+		memset(&job->io, 0, sizeof(FreeImageIO));
+	}
+	job->stream = stream;
+	job->dib = dib;
+	job->callback = callback;
+	job->user_data = user_data;
+	job->status = FIJS_PENDING;
+	job->cancelled = false;
+	job->progress = 0;
+	job->references = 2;
+
+	if(!FreeImage_SubmitTask(RunJob, job)) {
+		RunJob(job);
+	}
+
+	return &job->handle;
+}
+
+// ----------------------------------------------------------
+//   Asynchronous load / save routines
+// ----------------------------------------------------------
+
+/**
+Load a file in the background. The function returns at once with a job handle, to be
+polled (FreeImage_GetAsyncStatus), waited for (FreeImage_WaitAsync) or cancelled
+(FreeImage_CancelAsync), and released with FreeImage_CloseAsync. The loaded bitmap is
+taken with FreeImage_GetAsyncBitmap.<br>
+When callback is not NULL, it is called once the job has ended (cancelled jobs included),
+on the thread that ran it. The callback may take the bitmap and close the job. It may
+also call FreeImage_SetThreadCount or FreeImage_SetExecutor : when this retires the
+pool running the callback, the worker ends once the callback returns.<br>
+Jobs run on the worker pool or on the executor set with FreeImage_SetExecutor.
+With a thread count of 1, they run before the function returns.
+@param fif Format of the file, FIF_UNKNOWN to identify it from its signature
+*/
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_LoadAsync(FREE_IMAGE_FORMAT fif, const char *filename, int flags, FI_AsyncCallback callback, void *user_data) {
+	if(!filename) {
+		return NULL;
+	}
+	return StartJob(ASYNC_LOAD_FILE, fif, flags, filename, NULL, NULL, NULL, callback, user_data);
+}
+
+/**
+Load from a handle in the background (see FreeImage_LoadAsync).
+The handle must stay valid until the job has ended.
+*/
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_LoadFromHandleAsync(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags, FI_AsyncCallback callback, void *user_data) {
+	if(!io || !handle) {
+		return NULL;
+	}
+	return StartJob(ASYNC_LOAD_HANDLE, fif, flags, NULL, io, handle, NULL, callback, user_data);
+}
+
+/**
+Load from a memory stream in the background (see FreeImage_LoadAsync).
+The stream must stay valid until the job has ended.
+*/
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_LoadFromMemoryAsync(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags, FI_AsyncCallback callback, void *user_data) {
+	if(!stream) {
+		return NULL;
+	}
+	return StartJob(ASYNC_LOAD_MEMORY, fif, flags, NULL, NULL, (fi_handle)stream, NULL, callback, user_data);
+}
+
+/**
+Save a bitmap to a file in the background (see FreeImage_LoadAsync).
+The bitmap must stay valid and unchanged until the job has ended.
+*/
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_SaveAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *filename, int flags, FI_AsyncCallback callback, void *user_data) {
+	if(!dib || !filename) {
+		return NULL;
+	}
+	return StartJob(ASYNC_SAVE_FILE, fif, flags, filename, NULL, NULL, dib, callback, user_data);
+}
+
+/**
+Save a bitmap to a handle in the background (see FreeImage_SaveAsync).
+The handle must stay valid until the job has ended.
+*/
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_SaveToHandleAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi_handle handle, int flags, FI_AsyncCallback callback, void *user_data) {
+	if(!dib || !io || !handle) {
+		return NULL;
+	}
+	return StartJob(ASYNC_SAVE_HANDLE, fif, flags, NULL, io, handle, dib, callback, user_data);
+}
+
+/**
+Save a bitmap to a memory stream in the background (see FreeImage_SaveAsync).
+The stream must stay valid until the job has ended.
+*/
+FIASYNCJOB * DLL_CALLCONV
+FreeImage_SaveToMemoryAsync(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, int flags, FI_AsyncCallback callback, void *user_data) {
+	if(!dib || !stream) {
+		return NULL;
+	}
+	return StartJob(ASYNC_SAVE_MEMORY, fif, flags, NULL, NULL, (fi_handle)stream, dib, callback, user_data);
+}
+
+FREE_IMAGE_JOB_STATUS DLL_CALLCONV
+FreeImage_GetAsyncStatus(FIASYNCJOB *handle) {
+	ASYNCJOB *job = GetJob(handle);
+	return job ? (FREE_IMAGE_JOB_STATUS)job->status.load() : FIJS_FAILED;
+}
+
+/**
+Wait until a job has ended
+@return Returns the final status of the job
+*/
+FREE_IMAGE_JOB_STATUS DLL_CALLCONV
+FreeImage_WaitAsync(FIASYNCJOB *handle) {
+	ASYNCJOB *job = GetJob(handle);
+	if(!job) {
+		return FIJS_FAILED;
+	}
+	std::unique_lock<std::mutex> lock(job->mutex);
+	while((job->status == FIJS_PENDING) || (job->status == FIJS_RUNNING)) {
+		job->finished.wait(lock);
+	}
+	return (FREE_IMAGE_JOB_STATUS)job->status.load();
+}
+
+/**
+Cancel a job. A job which has not started yet ends at once, a running job stops at
+its next progress report (see FreeImage_SetProgressHandler) and ends as cancelled,
+unless it completes first. The callback of the job is still called.
+@return Returns TRUE if the job was pending or running, FALSE if it has already ended
+*/
+BOOL DLL_CALLCONV
+FreeImage_CancelAsync(FIASYNCJOB *handle) {
+	ASYNCJOB *job = GetJob(handle);
+	if(!job) {
+		return FALSE;
+	}
+	std::lock_guard<std::mutex> lock(job->mutex);
+	job->cancelled = true;
+	int pending = FIJS_PENDING;
+	if(job->status.compare_exchange_strong(pending, FIJS_CANCELLED)) {
+		job->finished.notify_all();
+		return TRUE;
+	}
+	return (pending == FIJS_RUNNING) ? TRUE : FALSE;
+}
+
+/**
+@return Returns the fraction of a job done, from 0 to 1, as reported by the codec
+(operations which do not report their progress go from 0 to 1 when they end)
+*/
+double DLL_CALLCONV
+FreeImage_GetAsyncProgress(FIASYNCJOB *handle) {
+	ASYNCJOB *job = GetJob(handle);
+	return job ? job->progress.load() : 0;
+}
+
+/**
+Take the bitmap of a load that succeeded. The caller then owns it and unloads it.
+@return Returns the loaded bitmap on the first call, NULL otherwise
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_GetAsyncBitmap(FIASYNCJOB *handle) {
+	ASYNCJOB *job = GetJob(handle);
+	if(!job || !IsLoad(job) || (job->status != FIJS_DONE)) {
+		return NULL;
+	}
+	std::lock_guard<std::mutex> lock(job->mutex);
+	FIBITMAP *dib = job->dib;
+	job->dib = NULL;
+	return dib;
+}
+
+/**
+Release a job handle. A job still running ends in the background,
+a bitmap not taken with FreeImage_GetAsyncBitmap is unloaded.
+*/
+void DLL_CALLCONV
+FreeImage_CloseAsync(FIASYNCJOB *handle) {
+	ASYNCJOB *job = GetJob(handle);
+	if(job) {
+		ReleaseJob(job);
+	}
+}
@@ -29,6 +29,7 @@
 #endif 
 
 #include <stdlib.h>
+#include <mutex>
 #if defined(_WIN32) || defined(_WIN64) || defined(__MINGW32__)
 #include <malloc.h>
 #endif // _WIN32 || _WIN64 || __MINGW32__
@@ -69,6 +70,18 @@ FI_STRUCT (METADATAHEADER) {
 	TAGMAP *tagmap;	//! pointer to the tag map
 };
 
+/** serialized metadata model (see set_cached_profile) */
+FI_STRUCT (PROFILECACHE) { 
+	UINT64 fingerprint;			//! fingerprint of the tags the profile was built from
+	std::vector<BYTE> profile;	//! serialized profile
+};
+
+/** helper for map<FREE_IMAGE_MDMODEL, PROFILECACHE> */
+typedef std::map<int, PROFILECACHE> PROFILECACHEMAP;
+
+/** helper for map<FREE_IMAGE_MDMODEL, raw profile> (see set_raw_profile) */
+typedef std::map<int, std::vector<BYTE> > RAWPROFILEMAP;
+
 // ----------------------------------------------------------
 //  FIBITMAP definition
 // ----------------------------------------------------------
@@ -104,6 +117,18 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	/** contains a list of metadata models attached to the bitmap */
 	METADATAMAP *metadata;
 
+	/** serialized metadata models, reused by savers while the tags are unchanged, NULL if none */
+	PROFILECACHEMAP *profile_cache;
+
+	/** guards profile_cache : concurrent saves of the bitmap fill it (see set_cached_profile) */
+	std::mutex *cache_lock;
+
+	/** raw metadata profiles not parsed yet (see FIF_LOAD_RAWMETADATA), NULL if none */
+	RAWPROFILEMAP *raw_profiles;
+
+	/** guards raw_profiles and the tags they are parsed into : concurrent metadata reads parse them (see ParseRawProfile) */
+	std::recursive_mutex *metadata_lock;
+
 	/** FALSE if the FIBITMAP only contains the header and no pixel data */
 	BOOL has_pixels;
 
@@ -116,6 +141,8 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	BYTE *external_bits;
 	/** user provided pitch, 0 otherwise */
 	unsigned external_pitch;
+	/** file view holding the external pixels, released with the bitmap (see MapIO), NULL otherwise */
+	void *external_mapping;
 	//@}
 
 	//BYTE filler[1];			 // fill to 32-bit alignment
@@ -418,6 +445,19 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 			// initialize metadata models list
 
 			fih->metadata = new(std::nothrow) METADATAMAP;
+			fih->profile_cache = NULL;
+			fih->raw_profiles = NULL;
+
+			fih->cache_lock = new(std::nothrow) std::mutex;
+			fih->metadata_lock = new(std::nothrow) std::recursive_mutex;
+			if(!fih->cache_lock || !fih->metadata_lock) {
+				delete fih->cache_lock;
+				delete fih->metadata_lock;
+				delete fih->metadata;
+				FreeImage_Aligned_Free(bitmap->data);
+				free(bitmap);
+				return NULL;
+			}
 
 			// initialize attached thumbnail
 
@@ -427,6 +467,7 @@ FreeImage_AllocateBitmap(BOOL header_only, BYTE *ext_bits, unsigned ext_pitch, F
 
 			fih->external_bits = ext_bits;
 			fih->external_pitch = ext_pitch;
+			fih->external_mapping = NULL;
 
 			// write out the BITMAPINFOHEADER
 
@@ -474,6 +515,22 @@ FreeImage_AllocateHeaderForBits(BYTE *ext_bits, unsigned ext_pitch, FREE_IMAGE_T
 	return FreeImage_AllocateBitmap(FALSE, ext_bits, ext_pitch, type, width, height, bpp, red_mask, green_mask, blue_mask);
 }
 
+FIBITMAP *
+AllocateMappedBitmap(FreeImageIO *io, fi_handle handle, long offset, unsigned pitch, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
+	void *mapping = NULL;
+	BYTE *bits = MapIO(io, handle, offset, (size_t)pitch * abs(height), &mapping);
+	if(!bits) {
+		return NULL;
+	}
+	FIBITMAP *bitmap = FreeImage_AllocateBitmap(FALSE, bits, pitch, type, width, height, bpp, red_mask, green_mask, blue_mask);
+	if(!bitmap) {
+		UnmapIO(mapping);
+		return NULL;
+	}
+	((FREEIMAGEHEADER *)bitmap->data)->external_mapping = mapping;
+	return bitmap;
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_AllocateHeaderT(BOOL header_only, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask) {
 	return FreeImage_AllocateBitmap(header_only, NULL, 0, type, width, height, bpp, red_mask, green_mask, blue_mask);
@@ -521,9 +578,18 @@ FreeImage_Unload(FIBITMAP *dib) {
 
 			delete metadata;
 
+			// delete serialized metadata
+			delete ((FREEIMAGEHEADER *)dib->data)->profile_cache;
+			delete ((FREEIMAGEHEADER *)dib->data)->cache_lock;
+			delete ((FREEIMAGEHEADER *)dib->data)->raw_profiles;
+			delete ((FREEIMAGEHEADER *)dib->data)->metadata_lock;
+
 			// delete embedded thumbnail
 			FreeImage_Unload(FreeImage_GetThumbnail(dib));
 
+			// release mapped pixels
+			UnmapIO(((FREEIMAGEHEADER *)dib->data)->external_mapping);
+
 			// delete bitmap ...
 			FreeImage_Aligned_Free(dib->data);
 		}
@@ -534,6 +600,123 @@ FreeImage_Unload(FIBITMAP *dib) {
 
 // ----------------------------------------------------------
 
+/**
+Copy the serialized metadata models of src to dst (see set_cached_profile)
+*/
+static void
+CloneProfileCache(FIBITMAP *dst, FIBITMAP *src) {
+	std::lock_guard<std::mutex> lock(*((FREEIMAGEHEADER *)src->data)->cache_lock);
+
+	const PROFILECACHEMAP *src_cache = ((FREEIMAGEHEADER *)src->data)->profile_cache;
+	PROFILECACHEMAP *&dst_cache = ((FREEIMAGEHEADER *)dst->data)->profile_cache;
+
+	if(src_cache && !src_cache->empty()) {
+		if(!dst_cache) {
+			dst_cache = new(std::nothrow) PROFILECACHEMAP;
+		}
+		if(dst_cache) {
+			try {
+				for(PROFILECACHEMAP::const_iterator i = src_cache->begin(); i != src_cache->end(); i++) {
+					(*dst_cache)[i->first] = i->second;
+				}
+			} catch(std::bad_alloc &) {
+				// the cache is optional
+				dst_cache->clear();
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------
+
+/**
+Get the model a raw profile is stored under: one raw Exif profile holds all the Exif models
+@return Returns FIMD_NODATA if the model cannot be kept as a raw profile
+*/
+static FREE_IMAGE_MDMODEL
+GetRawProfileModel(FREE_IMAGE_MDMODEL model) {
+	switch(model) {
+		case FIMD_EXIF_MAIN:
+		case FIMD_EXIF_EXIF:
+		case FIMD_EXIF_GPS:
+		case FIMD_EXIF_MAKERNOTE:
+		case FIMD_EXIF_INTEROP:
+			return FIMD_EXIF_MAIN;
+		case FIMD_IPTC:
+			return FIMD_IPTC;
+		default:
+			return FIMD_NODATA;
+	}
+}
+
+/**
+Parse the raw profile holding a metadata model into tags, if not already done. 
+Called before any access to the tags of the model, with the bitmap metadata lock held : 
+a parse adds models to the metadata map, so the lookups of the models are made under 
+the same lock. The lock is recursive : the parsers call FreeImage_SetMetadata.<br>
+A model found by a reader is never changed by another reader, so its tags 
+(and FreeImage_FindNextMetadata) are read without the lock.
+*/
+static void
+ParseRawProfile(FIBITMAP *dib, FREE_IMAGE_MDMODEL model) {
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
+	RAWPROFILEMAP *&raw_profiles = ((FREEIMAGEHEADER *)dib->data)->raw_profiles;
+	if(!raw_profiles) {
+		return;
+	}
+	const FREE_IMAGE_MDMODEL raw_model = GetRawProfileModel(model);
+	RAWPROFILEMAP::iterator i = raw_profiles->find(raw_model);
+	if(i == raw_profiles->end()) {
+		return;
+	}
+
+	// detach the profile first, the parsers call FreeImage_SetMetadata
+	std::vector<BYTE> profile;
+	profile.swap(i->second);
+	raw_profiles->erase(i);
+	if(raw_profiles->empty()) {
+		delete raw_profiles;
+		raw_profiles = NULL;
+	}
+
+	if(raw_model == FIMD_EXIF_MAIN) {
+		jpeg_read_exif_profile(dib, &profile[0], (unsigned)profile.size());
+	} else {
+		read_iptc_profile(dib, &profile[0], (unsigned)profile.size());
+	}
+}
+
+/**
+Copy the raw metadata profiles of src to dst, replacing the models of dst they hold
+*/
+static void
+CloneRawProfiles(FIBITMAP *dst, FIBITMAP *src) {
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)src->data)->metadata_lock);
+
+	const RAWPROFILEMAP *src_profiles = ((FREEIMAGEHEADER *)src->data)->raw_profiles;
+	if(!src_profiles) {
+		return;
+	}
+
+	for(RAWPROFILEMAP::const_iterator i = src_profiles->begin(); i != src_profiles->end(); i++) {
+		const FREE_IMAGE_MDMODEL raw_model = (FREE_IMAGE_MDMODEL)i->first;
+
+		// drop the profile and the tags of dst
+		RAWPROFILEMAP *dst_profiles = ((FREEIMAGEHEADER *)dst->data)->raw_profiles;
+		if(dst_profiles) {
+			dst_profiles->erase(raw_model);
+		}
+		for(int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+			if(GetRawProfileModel((FREE_IMAGE_MDMODEL)model) == raw_model) {
+				FreeImage_SetMetadata((FREE_IMAGE_MDMODEL)model, dst, NULL, NULL);
+			}
+		}
+
+		set_raw_profile(dst, raw_model, &i->second[0], (unsigned)i->second.size());
+	}
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_Clone(FIBITMAP *dib) {
 	if(!dib) {
@@ -566,6 +749,8 @@ FreeImage_Clone(FIBITMAP *dib) {
 		// save metadata links
 		METADATAMAP *src_metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
 		METADATAMAP *dst_metadata = ((FREEIMAGEHEADER *)new_dib->data)->metadata;
+		std::mutex *dst_cache_lock = ((FREEIMAGEHEADER *)new_dib->data)->cache_lock;
+		std::recursive_mutex *dst_metadata_lock = ((FREEIMAGEHEADER *)new_dib->data)->metadata_lock;
 
 		// calculate the size of the dst image
 		// align the palette and the pixels on a FIBITMAP_ALIGNMENT bytes alignment boundary
@@ -584,6 +769,10 @@ FreeImage_Clone(FIBITMAP *dib) {
 
 		// restore metadata link for new_dib
 		((FREEIMAGEHEADER *)new_dib->data)->metadata = dst_metadata;
+		((FREEIMAGEHEADER *)new_dib->data)->profile_cache = NULL;
+		((FREEIMAGEHEADER *)new_dib->data)->cache_lock = dst_cache_lock;
+		((FREEIMAGEHEADER *)new_dib->data)->raw_profiles = NULL;
+		((FREEIMAGEHEADER *)new_dib->data)->metadata_lock = dst_metadata_lock;
 
 		// reset thumbnail link for new_dib
 		((FREEIMAGEHEADER *)new_dib->data)->thumbnail = NULL;
@@ -591,11 +780,15 @@ FreeImage_Clone(FIBITMAP *dib) {
 		// reset external wrapped buffer link for new_dib
 		((FREEIMAGEHEADER *)new_dib->data)->external_bits = NULL;
 		((FREEIMAGEHEADER *)new_dib->data)->external_pitch = 0;
+		((FREEIMAGEHEADER *)new_dib->data)->external_mapping = NULL;
 
 		// copy possible ICC profile
 		FreeImage_CreateICCProfile(new_dib, src_iccProfile->data, src_iccProfile->size);
 		dst_iccProfile->flags = src_iccProfile->flags;
 
+		// the tags and the raw profiles are copied together, a concurrent read could parse a profile in between
+		std::unique_lock<std::recursive_mutex> metadata_lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
 		// copy metadata models
 		for(METADATAMAP::iterator i = (*src_metadata).begin(); i != (*src_metadata).end(); i++) {
 			int model = (*i).first;
@@ -621,6 +814,14 @@ FreeImage_Clone(FIBITMAP *dib) {
 			}
 		}
 
+		// copy serialized metadata
+		CloneProfileCache(new_dib, dib);
+
+		// copy raw metadata profiles
+		CloneRawProfiles(new_dib, dib);
+
+		metadata_lock.unlock();
+
 		// copy the thumbnail
 		FreeImage_SetThumbnail(new_dib, FreeImage_GetThumbnail(dib));
 
@@ -1203,6 +1404,10 @@ FreeImage_FindFirstMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, FITAG **tag
 		return NULL;
 	}
 
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
+	ParseRawProfile(dib, model);
+
 	// get the metadata model
 	METADATAMAP *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
 	TAGMAP *tagmap = NULL;
@@ -1295,6 +1500,9 @@ FreeImage_CloneMetadata(FIBITMAP *dst, FIBITMAP *src) {
 	METADATAMAP *src_metadata = ((FREEIMAGEHEADER *)src->data)->metadata;
 	METADATAMAP *dst_metadata = ((FREEIMAGEHEADER *)dst->data)->metadata;
 
+	// the tags and the raw profiles are copied together, a concurrent read could parse a profile in between
+	std::unique_lock<std::recursive_mutex> metadata_lock(*((FREEIMAGEHEADER *)src->data)->metadata_lock);
+
 	// copy metadata models, *except* the FIMD_ANIMATION model
 	for(METADATAMAP::iterator i = (*src_metadata).begin(); i != (*src_metadata).end(); i++) {
 		int model = (*i).first;
@@ -1328,6 +1536,14 @@ FreeImage_CloneMetadata(FIBITMAP *dst, FIBITMAP *src) {
 		}
 	}
 
+	// copy serialized metadata, the cloned tags produce the same profiles
+	CloneProfileCache(dst, src);
+
+	// copy raw metadata profiles
+	CloneRawProfiles(dst, src);
+
+	metadata_lock.unlock();
+
 	// clone resolution 
 	FreeImage_SetDotsPerMeterX(dst, FreeImage_GetDotsPerMeterX(src)); 
 	FreeImage_SetDotsPerMeterY(dst, FreeImage_GetDotsPerMeterY(src)); 
@@ -1343,6 +1559,10 @@ FreeImage_SetMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key,
 		return FALSE;
 	}
 
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
+	ParseRawProfile(dib, model);
+
 	TAGMAP *tagmap = NULL;
 
 	// get the metadata model
@@ -1441,6 +1661,10 @@ FreeImage_GetMetadata(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key,
 	TAGMAP *tagmap = NULL;
 	*tag = NULL;
 
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
+	ParseRawProfile(dib, model);
+
 	// get the metadata model
 	METADATAMAP *metadata = ((FREEIMAGEHEADER *)dib->data)->metadata;
 	if(!(*metadata).empty()) {
@@ -1498,12 +1722,152 @@ FreeImage_SetMetadataKeyValue(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const cha
 
 // ----------------------------------------------------------
 
+BOOL 
+get_cached_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, UINT64 fingerprint, BYTE **ppbProfile, unsigned *uProfileLength) {
+	if(!dib) {
+		return FALSE;
+	}
+
+	std::lock_guard<std::mutex> lock(*((FREEIMAGEHEADER *)dib->data)->cache_lock);
+
+	const PROFILECACHEMAP *cache = ((FREEIMAGEHEADER *)dib->data)->profile_cache;
+	if(!cache) {
+		return FALSE;
+	}
+	PROFILECACHEMAP::const_iterator i = cache->find(md_model);
+	if((i == cache->end()) || (i->second.fingerprint != fingerprint)) {
+		return FALSE;
+	}
+
+	// (re-)allocate output buffer
+	const std::vector<BYTE> &profile = i->second.profile;
+	BYTE *pbProfile = (BYTE*)realloc(*ppbProfile, profile.size());
+	if(!pbProfile) {
+		return FALSE;
+	}
+	memcpy(pbProfile, &profile[0], profile.size());
+	*ppbProfile = pbProfile;
+	*uProfileLength = (unsigned)profile.size();
+
+	return TRUE;
+}
+
+BOOL 
+set_cached_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, UINT64 fingerprint, const BYTE *profile, unsigned length) {
+	if(!dib || !profile || !length) {
+		return FALSE;
+	}
+
+	// savers running on several threads may fill the cache of the same bitmap
+	std::lock_guard<std::mutex> lock(*((FREEIMAGEHEADER *)dib->data)->cache_lock);
+
+	PROFILECACHEMAP *&cache = ((FREEIMAGEHEADER *)dib->data)->profile_cache;
+	if(!cache) {
+		cache = new(std::nothrow) PROFILECACHEMAP;
+		if(!cache) {
+			return FALSE;
+		}
+	}
+
+	try {
+		PROFILECACHE &entry = (*cache)[md_model];
+		entry.fingerprint = fingerprint;
+		entry.profile.assign(profile, profile + length);
+	} catch(std::bad_alloc &) {
+		cache->erase(md_model);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL 
+set_raw_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, const BYTE *profile, unsigned length) {
+	// marker identifying string for Exif = "Exif\0\0"
+	static const BYTE exif_signature[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+
+	if(!dib || !profile || !length) {
+		return FALSE;
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
+	const FREE_IMAGE_MDMODEL raw_model = GetRawProfileModel(md_model);
+	if(raw_model == FIMD_EXIF_MAIN) {
+		if((length < sizeof(exif_signature)) || (memcmp(exif_signature, profile, sizeof(exif_signature)) != 0)) {
+			return FALSE;
+		}
+		// a second Exif profile is merged with the first one : parse both
+		ParseRawProfile(dib, raw_model);
+		if(FreeImage_GetMetadataCount(FIMD_EXIF_MAIN, dib)) {
+			return FALSE;
+		}
+	} else if(raw_model == FIMD_NODATA) {
+		return FALSE;
+	}
+
+	RAWPROFILEMAP *&raw_profiles = ((FREEIMAGEHEADER *)dib->data)->raw_profiles;
+	if(!raw_profiles) {
+		raw_profiles = new(std::nothrow) RAWPROFILEMAP;
+		if(!raw_profiles) {
+			return FALSE;
+		}
+	}
+
+	try {
+		// IPTC datasets are appended to the ones of a previous profile
+		std::vector<BYTE> &raw_profile = (*raw_profiles)[raw_model];
+		raw_profile.insert(raw_profile.end(), profile, profile + length);
+	} catch(std::bad_alloc &) {
+		raw_profiles->erase(raw_model);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL 
+get_raw_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, std::vector<BYTE> *profile) {
+	if(!dib) {
+		return FALSE;
+	}
+
+	// the profile is copied : a concurrent read of the tags may parse and release it
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
+	const RAWPROFILEMAP *raw_profiles = ((FREEIMAGEHEADER *)dib->data)->raw_profiles;
+	if(!raw_profiles) {
+		return FALSE;
+	}
+	RAWPROFILEMAP::const_iterator i = raw_profiles->find(GetRawProfileModel(md_model));
+	if(i == raw_profiles->end()) {
+		return FALSE;
+	}
+
+	// profile may be NULL to only check for a raw profile
+	if(profile) {
+		try {
+			*profile = i->second;
+		} catch(std::bad_alloc &) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+// ----------------------------------------------------------
+
 unsigned DLL_CALLCONV 
 FreeImage_GetMetadataCount(FREE_IMAGE_MDMODEL model, FIBITMAP *dib) {
 	if(!dib) {
 		return FALSE;
 	}
 
+	std::lock_guard<std::recursive_mutex> lock(*((FREEIMAGEHEADER *)dib->data)->metadata_lock);
+
+	ParseRawProfile(dib, model);
+
 	TAGMAP *tagmap = NULL;
 
 	// get the metadata model
@@ -1552,6 +1916,27 @@ FreeImage_GetMemorySize(FIBITMAP *dib) {
 		size += FreeImage_GetMemorySize(header->thumbnail);
 	}
 
+	// add serialized metadata size
+	std::unique_lock<std::mutex> cache_lock(*header->cache_lock);
+	size += sizeof(std::mutex);
+	if (header->profile_cache) {
+		for (PROFILECACHEMAP::iterator i = header->profile_cache->begin(); i != header->profile_cache->end(); i++) {
+			size += sizeof(PROFILECACHE) + i->second.profile.capacity();
+		}
+		size += MapIntrospector<PROFILECACHEMAP>::GetNodesMemorySize(header->profile_cache->size());
+	}
+	cache_lock.unlock();
+
+	// add raw metadata size
+	std::lock_guard<std::recursive_mutex> metadata_lock(*header->metadata_lock);
+	size += sizeof(std::recursive_mutex);
+	if (header->raw_profiles) {
+		for (RAWPROFILEMAP::iterator i = header->raw_profiles->begin(); i != header->raw_profiles->end(); i++) {
+			size += sizeof(std::vector<BYTE>) + i->second.capacity();
+		}
+		size += MapIntrospector<RAWPROFILEMAP>::GetNodesMemorySize(header->raw_profiles->size());
+	}
+
 	// add metadata size
 	METADATAMAP *md = header->metadata;
 	if (!md) {
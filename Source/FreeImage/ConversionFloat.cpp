@@ -53,6 +53,8 @@ FreeImage_ConvertToFloat(FIBITMAP *dib) {
 		case FIT_RGBA16:
 		case FIT_RGBF:
 		case FIT_RGBAF:
+		case FIT_RGB16F:
+		case FIT_RGBA16F:
 			src = dib;
 			break;
 		case FIT_FLOAT:
@@ -181,6 +183,31 @@ FreeImage_ConvertToFloat(FIBITMAP *dib) {
 			}
 		}
 		break;
+
+		case FIT_RGB16F:
+		case FIT_RGBA16F:
+		{
+			// widen each half line to RGBF, then compute the luminance
+			const unsigned src_channels = (src_type == FIT_RGBA16F) ? 4 : 3;
+			FIRGBF *line = (FIRGBF*)malloc(width * sizeof(FIRGBF));
+			if(!line) {
+				FreeImage_Unload(dst);
+				return NULL;
+			}
+			for(unsigned y = 0; y < height; y++) {
+				float *dst_pixel = (float*)dst_bits;
+
+				ConvertLineHalfToFloat((float*)line, 3, (const WORD*)src_bits, src_channels, width);
+				for(unsigned x = 0; x < width; x++) {
+					// convert (allowing grayscale values to range outside of [0..1])
+					dst_pixel[x] = LUMA_REC709(line[x].red, line[x].green, line[x].blue);
+				}
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+			free(line);
+		}
+		break;
 	}
 
 	if(src != dib) {
@@ -0,0 +1,437 @@
+// ==========================================================
+// Bitmap conversion routines
+// Half-float (FIT_RGB16F / FIT_RGBA16F) conversion helpers
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+#include "half.h"
+
+// x86 : the F16C kernels are always compiled, and selected at run time (see HasF16C)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#include <cpuid.h>
+#define FI_HALF_F16C
+#define FI_HALF_F16C_TARGET __attribute__((target("avx,f16c")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define FI_HALF_F16C
+#define FI_HALF_F16C_TARGET
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FI_HALF_NEON
+#endif
+
+/// Half-float value of 1.0, used to fill a missing alpha channel
+static const WORD FI_HALF_ONE = 0x3C00;
+
+// ----------------------------------------------------------
+//   F16C line conversion routines (x86)
+// ----------------------------------------------------------
+
+#if defined(FI_HALF_F16C)
+
+/**
+Check that the CPU supports the F16C instructions, and that the OS saves the AVX registers 
+(the F16C instructions are VEX encoded). The check is done once.
+*/
+static BOOL
+CheckF16C() {
+	unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	ecx = (unsigned)info[2];
+#else
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		return FALSE;
+	}
+#endif
+	// OSXSAVE (bit 27), AVX (bit 28) and F16C (bit 29)
+	const unsigned mask = (1U << 27) | (1U << 28) | (1U << 29);
+	if((ecx & mask) != mask) {
+		return FALSE;
+	}
+	// the XMM and YMM states must be enabled in XCR0
+#if defined(_MSC_VER)
+	const unsigned long long xcr0 = _xgetbv(0);
+#else
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	const unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+#endif
+	return ((xcr0 & 6) == 6) ? TRUE : FALSE;
+}
+
+static inline BOOL
+HasF16C() {
+	static const BOOL bF16C = CheckF16C();
+	return bF16C;
+}
+
+FI_HALF_F16C_TARGET static inline void
+Half4ToFloat4F16C(float *dst, const WORD *src) {
+	_mm_storeu_ps(dst, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)src)));
+}
+
+FI_HALF_F16C_TARGET static inline void
+Float4ToHalf4F16C(WORD *dst, const float *src) {
+	_mm_storel_epi64((__m128i*)dst, _mm_cvtps_ph(_mm_loadu_ps(src), _MM_FROUND_TO_NEAREST_INT));
+}
+
+/**
+F16C version of ConvertLineHalfToFloat (see below for the handling of the layouts)
+*/
+FI_HALF_F16C_TARGET static void
+ConvertLineHalfToFloatF16C(float *dst, unsigned dst_channels, const WORD *src, unsigned src_channels, unsigned width_in_pixels) {
+	if(dst_channels == src_channels) {
+		const unsigned count = width_in_pixels * src_channels;
+		unsigned i = 0;
+		for(; i + 8 <= count; i += 8) {
+			_mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+		}
+		for(; i + 4 <= count; i += 4) {
+			Half4ToFloat4F16C(dst + i, src + i);
+		}
+		for(; i < count; i++) {
+			dst[i] = imath_half_to_float(src[i]);
+		}
+	}
+	else if((src_channels == 4) && (dst_channels == 3)) {
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Half4ToFloat4F16C(dst, src);
+			src += 4;
+			dst += 3;
+		}
+		dst[0] = imath_half_to_float(src[0]);
+		dst[1] = imath_half_to_float(src[1]);
+		dst[2] = imath_half_to_float(src[2]);
+	}
+	else if((src_channels == 3) && (dst_channels == 4)) {
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Half4ToFloat4F16C(dst, src);
+			dst[3] = 1.0F;
+			src += 3;
+			dst += 4;
+		}
+		dst[0] = imath_half_to_float(src[0]);
+		dst[1] = imath_half_to_float(src[1]);
+		dst[2] = imath_half_to_float(src[2]);
+		dst[3] = 1.0F;
+	}
+	else {
+		assert(FALSE);
+	}
+}
+
+/**
+F16C version of ConvertLineFloatToHalf (see below for the handling of the layouts)
+*/
+FI_HALF_F16C_TARGET static void
+ConvertLineFloatToHalfF16C(WORD *dst, unsigned dst_channels, const float *src, unsigned src_channels, unsigned width_in_pixels) {
+	if(dst_channels == src_channels) {
+		const unsigned count = width_in_pixels * src_channels;
+		unsigned i = 0;
+		for(; i + 8 <= count; i += 8) {
+			_mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+		}
+		for(; i + 4 <= count; i += 4) {
+			Float4ToHalf4F16C(dst + i, src + i);
+		}
+		for(; i < count; i++) {
+			dst[i] = imath_float_to_half(src[i]);
+		}
+	}
+	else if((src_channels == 4) && (dst_channels == 3)) {
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Float4ToHalf4F16C(dst, src);
+			src += 4;
+			dst += 3;
+		}
+		dst[0] = imath_float_to_half(src[0]);
+		dst[1] = imath_float_to_half(src[1]);
+		dst[2] = imath_float_to_half(src[2]);
+	}
+	else if((src_channels == 3) && (dst_channels == 4)) {
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Float4ToHalf4F16C(dst, src);
+			dst[3] = FI_HALF_ONE;
+			src += 3;
+			dst += 4;
+		}
+		dst[0] = imath_float_to_half(src[0]);
+		dst[1] = imath_float_to_half(src[1]);
+		dst[2] = imath_float_to_half(src[2]);
+		dst[3] = FI_HALF_ONE;
+	}
+	else {
+		assert(FALSE);
+	}
+}
+
+#endif // FI_HALF_F16C
+
+// ----------------------------------------------------------
+//   4-lane conversion kernels
+// ----------------------------------------------------------
+
+/**
+Convert 4 consecutive half-float values to 4 float values
+*/
+static inline void
+Half4ToFloat4(float *dst, const WORD *src) {
+#if defined(FI_HALF_NEON)
+	vst1q_f32(dst, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src))));
+#else
+	dst[0] = imath_half_to_float(src[0]);
+	dst[1] = imath_half_to_float(src[1]);
+	dst[2] = imath_half_to_float(src[2]);
+	dst[3] = imath_half_to_float(src[3]);
+#endif
+}
+
+/**
+Convert 4 consecutive float values to 4 half-float values (round to nearest even)
+*/
+static inline void
+Float4ToHalf4(WORD *dst, const float *src) {
+#if defined(FI_HALF_NEON)
+	vst1_u16(dst, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src))));
+#else
+	dst[0] = imath_float_to_half(src[0]);
+	dst[1] = imath_float_to_half(src[1]);
+	dst[2] = imath_float_to_half(src[2]);
+	dst[3] = imath_float_to_half(src[3]);
+#endif
+}
+
+// ----------------------------------------------------------
+//   Line conversion routines
+// ----------------------------------------------------------
+
+void
+ConvertLineHalfToFloat(float *dst, unsigned dst_channels, const WORD *src, unsigned src_channels, unsigned width_in_pixels) {
+	if(width_in_pixels == 0) {
+		return;
+	}
+
+#if defined(FI_HALF_F16C)
+	if(HasF16C()) {
+		ConvertLineHalfToFloatF16C(dst, dst_channels, src, src_channels, width_in_pixels);
+		return;
+	}
+#endif
+
+	if(dst_channels == src_channels) {
+		// same layout : plain array conversion
+		const unsigned count = width_in_pixels * src_channels;
+		unsigned i = 0;
+		for(; i + 4 <= count; i += 4) {
+			Half4ToFloat4(dst + i, src + i);
+		}
+		for(; i < count; i++) {
+			dst[i] = imath_half_to_float(src[i]);
+		}
+	}
+	else if((src_channels == 4) && (dst_channels == 3)) {
+		// RGBA => RGB : each 4-lane store spills one float into the next pixel,
+		// which is then overwritten, so the last pixel is done separately
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Half4ToFloat4(dst, src);
+			src += 4;
+			dst += 3;
+		}
+		dst[0] = imath_half_to_float(src[0]);
+		dst[1] = imath_half_to_float(src[1]);
+		dst[2] = imath_half_to_float(src[2]);
+	}
+	else if((src_channels == 3) && (dst_channels == 4)) {
+		// RGB => RGBA : each 4-lane load reads the first channel of the next pixel,
+		// so the last pixel is done separately
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Half4ToFloat4(dst, src);
+			dst[3] = 1.0F;
+			src += 3;
+			dst += 4;
+		}
+		dst[0] = imath_half_to_float(src[0]);
+		dst[1] = imath_half_to_float(src[1]);
+		dst[2] = imath_half_to_float(src[2]);
+		dst[3] = 1.0F;
+	}
+	else {
+		assert(FALSE);
+	}
+}
+
+void
+ConvertLineFloatToHalf(WORD *dst, unsigned dst_channels, const float *src, unsigned src_channels, unsigned width_in_pixels) {
+	if(width_in_pixels == 0) {
+		return;
+	}
+
+#if defined(FI_HALF_F16C)
+	if(HasF16C()) {
+		ConvertLineFloatToHalfF16C(dst, dst_channels, src, src_channels, width_in_pixels);
+		return;
+	}
+#endif
+
+	if(dst_channels == src_channels) {
+		// same layout : plain array conversion
+		const unsigned count = width_in_pixels * src_channels;
+		unsigned i = 0;
+		for(; i + 4 <= count; i += 4) {
+			Float4ToHalf4(dst + i, src + i);
+		}
+		for(; i < count; i++) {
+			dst[i] = imath_float_to_half(src[i]);
+		}
+	}
+	else if((src_channels == 4) && (dst_channels == 3)) {
+		// RGBA => RGB : each 4-lane store spills one value into the next pixel (see above)
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Float4ToHalf4(dst, src);
+			src += 4;
+			dst += 3;
+		}
+		dst[0] = imath_float_to_half(src[0]);
+		dst[1] = imath_float_to_half(src[1]);
+		dst[2] = imath_float_to_half(src[2]);
+	}
+	else if((src_channels == 3) && (dst_channels == 4)) {
+		// RGB => RGBA : each 4-lane load reads one value from the next pixel (see above)
+		const unsigned last = width_in_pixels - 1;
+		for(unsigned x = 0; x < last; x++) {
+			Float4ToHalf4(dst, src);
+			dst[3] = FI_HALF_ONE;
+			src += 3;
+			dst += 4;
+		}
+		dst[0] = imath_float_to_half(src[0]);
+		dst[1] = imath_float_to_half(src[1]);
+		dst[2] = imath_float_to_half(src[2]);
+		dst[3] = FI_HALF_ONE;
+	}
+	else {
+		assert(FALSE);
+	}
+}
+
+// ----------------------------------------------------------
+//   smart convert X to RGB16F
+// ----------------------------------------------------------
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertToRGB16F(FIBITMAP *dib) {
+	FIBITMAP *src = NULL;
+	FIBITMAP *dst = NULL;
+
+	if(!FreeImage_HasPixels(dib)) return NULL;
+
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(dib);
+
+	// check for allowed conversions
+	switch(src_type) {
+		case FIT_RGBF:
+		case FIT_RGBAF:
+		case FIT_RGBA16F:
+			// direct conversion
+			src = dib;
+			break;
+		case FIT_RGB16F:
+			// RGB16F type : clone the src
+			return FreeImage_Clone(dib);
+		default:
+			// any other type is first converted to RGBF
+			src = FreeImage_ConvertToRGBF(dib);
+			if(!src) return NULL;
+			break;
+	}
+
+	// allocate dst image
+
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	dst = FreeImage_AllocateT(FIT_RGB16F, width, height);
+	if(!dst) {
+		if(src != dib) {
+			FreeImage_Unload(src);
+		}
+		return NULL;
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, src);
+
+	// convert from src type to RGB16F
+
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+
+	const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+	BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
+
+	switch(FreeImage_GetImageType(src)) {
+		case FIT_RGBF:
+		case FIT_RGBAF:
+		{
+			const unsigned src_channels = (FreeImage_GetImageType(src) == FIT_RGBAF) ? 4 : 3;
+			for(unsigned y = 0; y < height; y++) {
+				ConvertLineFloatToHalf((WORD*)dst_bits, 3, (const float*)src_bits, src_channels, width);
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
+
+		case FIT_RGBA16F:
+		{
+			for(unsigned y = 0; y < height; y++) {
+				const FIRGBA16 *src_pixel = (FIRGBA16*)src_bits;
+				FIRGB16 *dst_pixel = (FIRGB16*)dst_bits;
+				for(unsigned x = 0; x < width; x++) {
+					// copy the half bits and skip the alpha channel
+					dst_pixel[x].red   = src_pixel[x].red;
+					dst_pixel[x].green = src_pixel[x].green;
+					dst_pixel[x].blue  = src_pixel[x].blue;
+				}
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
+
+		default:
+			break;
+	}
+
+	if(src != dib) {
+		FreeImage_Unload(src);
+	}
+
+	return dst;
+}
@@ -0,0 +1,117 @@
+// ==========================================================
+// Bitmap conversion routines
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+// ----------------------------------------------------------
+//   smart convert X to RGBA16F
+// ----------------------------------------------------------
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_ConvertToRGBA16F(FIBITMAP *dib) {
+	FIBITMAP *src = NULL;
+	FIBITMAP *dst = NULL;
+
+	if(!FreeImage_HasPixels(dib)) return NULL;
+
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(dib);
+
+	// check for allowed conversions
+	switch(src_type) {
+		case FIT_RGBF:
+		case FIT_RGBAF:
+		case FIT_RGB16F:
+			// direct conversion
+			src = dib;
+			break;
+		case FIT_RGBA16F:
+			// RGBA16F type : clone the src
+			return FreeImage_Clone(dib);
+		default:
+			// any other type is first converted to RGBAF
+			src = FreeImage_ConvertToRGBAF(dib);
+			if(!src) return NULL;
+			break;
+	}
+
+	// allocate dst image
+
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	dst = FreeImage_AllocateT(FIT_RGBA16F, width, height);
+	if(!dst) {
+		if(src != dib) {
+			FreeImage_Unload(src);
+		}
+		return NULL;
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, src);
+
+	// convert from src type to RGBA16F
+
+	const unsigned src_pitch = FreeImage_GetPitch(src);
+	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+
+	const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+	BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
+
+	switch(FreeImage_GetImageType(src)) {
+		case FIT_RGBF:
+		case FIT_RGBAF:
+		{
+			const unsigned src_channels = (FreeImage_GetImageType(src) == FIT_RGBAF) ? 4 : 3;
+			for(unsigned y = 0; y < height; y++) {
+				ConvertLineFloatToHalf((WORD*)dst_bits, 4, (const float*)src_bits, src_channels, width);
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
+
+		case FIT_RGB16F:
+		{
+			for(unsigned y = 0; y < height; y++) {
+				const FIRGB16 *src_pixel = (FIRGB16*)src_bits;
+				FIRGBA16 *dst_pixel = (FIRGBA16*)dst_bits;
+				for(unsigned x = 0; x < width; x++) {
+					// copy the half bits and set alpha to 1.0
+					dst_pixel[x].red   = src_pixel[x].red;
+					dst_pixel[x].green = src_pixel[x].green;
+					dst_pixel[x].blue  = src_pixel[x].blue;
+					dst_pixel[x].alpha = 0x3C00;
+				}
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
+
+		default:
+			break;
+	}
+
+	if(src != dib) {
+		FreeImage_Unload(src);
+	}
+
+	return dst;
+}
@@ -70,6 +70,14 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 			// allow conversion from 96-bit RGBF
 			src = dib;
 			break;
+		case FIT_RGB16F:
+			// allow conversion from 48-bit RGB half
+			src = dib;
+			break;
+		case FIT_RGBA16F:
+			// allow conversion from 64-bit RGBA half
+			src = dib;
+			break;
 		case FIT_RGBAF:
 			// RGBAF type : clone the src
 			return FreeImage_Clone(dib);
@@ -238,6 +246,23 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 			}
 		}
 		break;
+
+		case FIT_RGB16F:
+		case FIT_RGBA16F:
+		{
+			// convert from half to float (adding a "dummy" alpha of 1.0 to RGB16F)
+			const unsigned src_channels = (src_type == FIT_RGBA16F) ? 4 : 3;
+
+			const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+			BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
+
+			for(unsigned y = 0; y < height; y++) {
+				ConvertLineHalfToFloat((float*)dst_bits, 4, (const WORD*)src_bits, src_channels, width);
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
 	}
 
 	if(src != dib) {
@@ -69,6 +69,14 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 			// allow conversion from 128-bit RGBAF
 			src = dib;
 			break;
+		case FIT_RGB16F:
+			// allow conversion from 48-bit RGB half
+			src = dib;
+			break;
+		case FIT_RGBA16F:
+			// allow conversion from 64-bit RGBA half (ignore the alpha channel)
+			src = dib;
+			break;
 		case FIT_RGBF:
 			// RGBF type : clone the src
 			return FreeImage_Clone(dib);
@@ -231,6 +239,23 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 			}
 		}
 		break;
+
+		case FIT_RGB16F:
+		case FIT_RGBA16F:
+		{
+			// convert from half to float (skip alpha channel)
+			const unsigned src_channels = (src_type == FIT_RGBA16F) ? 4 : 3;
+
+			const BYTE *src_bits = (BYTE*)FreeImage_GetBits(src);
+			BYTE *dst_bits = (BYTE*)FreeImage_GetBits(dst);
+
+			for(unsigned y = 0; y < height; y++) {
+				ConvertLineHalfToFloat((float*)dst_bits, 3, (const WORD*)src_bits, src_channels, width);
+				src_bits += src_pitch;
+				dst_bits += dst_pitch;
+			}
+		}
+		break;
 	}
 
 	if(src != dib) {
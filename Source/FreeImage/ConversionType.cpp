@@ -22,9 +22,25 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FI_CONVERT_SSE2
+#endif
 
 // ----------------------------------------------------------
 
+/** Arguments of a conversion run on bands of rows in parallel
+*/
+typedef struct tagCONVERTROWS {
+	FIBITMAP *src;
+	FIBITMAP *dst;
+	const BYTE *lut;	//! lookup table, indexed by the raw bits of a pixel
+	double scale;
+	double bias;
+} CONVERTROWS;
+
 /** Convert a greyscale image of type Tsrc to type Tdst.
 	Conversion is done using standard C language casting convention.
 */
@@ -33,8 +49,26 @@ class CONVERT_TYPE
 {
 public:
 	FIBITMAP* convert(FIBITMAP *src, FREE_IMAGE_TYPE dst_type);
+
+private:
+	static void convertRows(void *data, unsigned first, unsigned last);
 };
 
+template<class Tdst, class Tsrc> void 
+CONVERT_TYPE<Tdst, Tsrc>::convertRows(void *data, unsigned first, unsigned last) {
+	const CONVERTROWS *rows = (CONVERTROWS*)data;
+	const unsigned width = FreeImage_GetWidth(rows->src);
+
+	for(unsigned y = first; y < last; y++) {
+		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(rows->src, y));
+		Tdst *dst_bits = reinterpret_cast<Tdst*>(FreeImage_GetScanLine(rows->dst, y));
+
+		for(unsigned x = 0; x < width; x++) {
+			*dst_bits++ = static_cast<Tdst>(*src_bits++);
+		}
+	}
+}
+
 template<class Tdst, class Tsrc> FIBITMAP* 
 CONVERT_TYPE<Tdst, Tsrc>::convert(FIBITMAP *src, FREE_IMAGE_TYPE dst_type) {
 
@@ -52,41 +86,348 @@ CONVERT_TYPE<Tdst, Tsrc>::convert(FIBITMAP *src, FREE_IMAGE_TYPE dst_type) {
 
 	// convert from src_type to dst_type
 	
-	for(unsigned y = 0; y < height; y++) {
-		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-		Tdst *dst_bits = reinterpret_cast<Tdst*>(FreeImage_GetScanLine(dst, y));
+	CONVERTROWS rows = { src, dst, NULL, 0, 0 };
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), convertRows, &rows)) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
+
+/** Test a value for NaN on its bits : the library may be built with -ffast-math,
+	which lets the compiler assume that no comparison ever sees a NaN.
+*/
+template<class T> static inline bool
+IsNaN(T value) {
+	return false;
+}
+
+static inline bool
+IsNaN(float value) {
+	DWORD bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x7FFFFFFF) > 0x7F800000;
+}
+
+static inline bool
+IsNaN(double value) {
+	UINT64 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x7FFFFFFFFFFFFFFFULL) > 0x7FF0000000000000ULL;
+}
+
+/** Arguments of a min / max search run on bands of rows in parallel
+*/
+template<class T> struct MINMAXPASS {
+	FIBITMAP *src;
+	unsigned chunk;		//! number of rows of a band
+	T *min_value;		//! min value of each band
+	T *max_value;		//! max value of each band
+};
+
+/** Find the min and max value of the rows [first, last[ of a greyscale image, into their band entries. 
+	Each scanline is scanned using several independent accumulators, 
+	so that the loop carries no dependency between consecutive pixels and can be vectorized.
+	NaN values are ignored.
+*/
+template<class T> static void
+MinMaxRows(void *data, unsigned first, unsigned last) {
+	const MINMAXPASS<T> *pass = (MINMAXPASS<T>*)data;
+	const unsigned width = FreeImage_GetWidth(pass->src);
+
+	// start from an empty range
+	T l_min[8], l_max[8];
+	for(unsigned k = 0; k < 8; k++) {
+		l_min[k] = std::numeric_limits<T>::max();
+		l_max[k] = std::numeric_limits<T>::lowest();
+	}
+
+	for(unsigned y = first; y < last; y++) {
+		const T *bits = reinterpret_cast<T*>(FreeImage_GetScanLine(pass->src, y));
+		unsigned x = 0;
+		for(; x + 8 <= width; x += 8) {
+			for(unsigned k = 0; k < 8; k++) {
+				const T value = bits[x + k];
+				if(IsNaN(value)) continue;
+				l_min[k] = (value < l_min[k]) ? value : l_min[k];
+				l_max[k] = (value > l_max[k]) ? value : l_max[k];
+			}
+		}
+		for(; x < width; x++) {
+			const T value = bits[x];
+			if(IsNaN(value)) continue;
+			l_min[0] = (value < l_min[0]) ? value : l_min[0];
+			l_max[0] = (value > l_max[0]) ? value : l_max[0];
+		}
+	}
+
+	// (a call may cover several bands, the entries of the following bands then stay empty)
+	const unsigned band = first / pass->chunk;
+	for(unsigned k = 0; k < 8; k++) {
+		pass->min_value[band] = MIN(pass->min_value[band], l_min[k]);
+		pass->max_value[band] = MAX(pass->max_value[band], l_max[k]);
+	}
+}
+
+/** Find the min and max value of a greyscale image of type T, in a single pass. 
+	The bands of rows are scanned in parallel, then their min and max values are merged.
+	NaN values are ignored.
+	@return Returns FALSE if the image only holds NaN values or if the search was cancelled (min and max are then set to 0)
+*/
+template<class T> static BOOL
+FindMinMax(FIBITMAP *src, T& min_value, T& max_value) {
+	const unsigned height = FreeImage_GetHeight(src);
+
+	unsigned chunk = FreeImage_GetRowChunk(FreeImage_GetWidth(src));
+	unsigned bands = (height + chunk - 1) / chunk;
 
+	T local[2];
+	T *partial = (T*)malloc(2 * bands * sizeof(T));
+	if(!partial) {
+		// a single band, run on the calling thread
+		chunk = height;
+		bands = 1;
+		partial = local;
+	}
+
+	MINMAXPASS<T> pass = { src, chunk, partial, partial + bands };
+	for(unsigned band = 0; band < bands; band++) {
+		pass.min_value[band] = std::numeric_limits<T>::max();
+		pass.max_value[band] = std::numeric_limits<T>::lowest();
+	}
+	const BOOL bSuccess = FreeImage_ParallelFor(height, chunk, MinMaxRows<T>, &pass);
+
+	min_value = std::numeric_limits<T>::max();
+	max_value = std::numeric_limits<T>::lowest();
+	if(bSuccess) {
+		for(unsigned band = 0; band < bands; band++) {
+			min_value = MIN(min_value, pass.min_value[band]);
+			max_value = MAX(max_value, pass.max_value[band]);
+		}
+	}
+
+	if(partial != local) {
+		free(partial);
+	}
+
+	if(max_value < min_value) {
+		min_value = max_value = 0;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/** Find the range [min, max] of a greyscale image of type T, ignoring the 
+	clip_percent % darkest and the clip_percent % brightest pixels.
+	Percentiles are exact for 8- and 16-bit images. For other types, they are 
+	computed from a 65536 bins histogram over the [min, max] range of the image.
+	@return Returns FALSE if the image only holds NaN values
+*/
+template<class T> static BOOL
+FindRange(FIBITMAP *src, double clip_percent, double& min_value, double& max_value) {
+	T t_min, t_max;
+	const BOOL bFound = FindMinMax(src, t_min, t_max);
+
+	min_value = (double)t_min;
+	max_value = (double)t_max;
+
+	if(!bFound || (clip_percent <= 0) || (t_min == t_max)) {
+		return bFound;
+	}
+
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	// use one bin per value when possible
+	const double range = max_value - min_value;
+	const unsigned nbins = (std::numeric_limits<T>::is_integer && (range < 65536)) ? (unsigned)range + 1 : 65536;
+	const double bin_scale = (nbins - 1) / range;
+
+	DWORD *hist = (DWORD*)calloc(nbins, sizeof(DWORD));
+	if(!hist) {
+		// keep the full range
+		return TRUE;
+	}
+
+	for(unsigned y = 0; y < height; y++) {
+		const T *bits = reinterpret_cast<T*>(FreeImage_GetScanLine(src, y));
 		for(unsigned x = 0; x < width; x++) {
-			*dst_bits++ = static_cast<Tdst>(*src_bits++);
+			// (NaN values are ignored)
+			const double bin = (bits[x] - min_value) * bin_scale;
+			if(!IsNaN(bits[x]) && (bin >= 0) && (bin < nbins)) {
+				hist[(unsigned)bin]++;
+			}
 		}
 	}
 
-	return dst;
+	// number of pixels to ignore at each end of the histogram
+	const double clip_count = MIN(clip_percent, 50.0) * width * height / 100;
+
+	unsigned low = 0;
+	double count = hist[0];
+	while((count <= clip_count) && (low < nbins - 1)) {
+		count += hist[++low];
+	}
+	unsigned high = nbins - 1;
+	count = hist[high];
+	while((count <= clip_count) && (high > low)) {
+		count += hist[--high];
+	}
+
+	free(hist);
+
+	max_value = min_value + high / bin_scale;
+	min_value = min_value + low / bin_scale;
+
+	return TRUE;
 }
 
+#if defined(FI_CONVERT_SSE2)
+/** Load 4 consecutive values as 2 x 2 doubles
+*/
+template<class T> static inline void
+Load4AsDouble(const T *src, __m128d& lo, __m128d& hi) {
+	lo = _mm_set_pd((double)src[1], (double)src[0]);
+	hi = _mm_set_pd((double)src[3], (double)src[2]);
+}
+
+template<> inline void
+Load4AsDouble<float>(const float *src, __m128d& lo, __m128d& hi) {
+	const __m128 v = _mm_loadu_ps(src);
+	lo = _mm_cvtps_pd(v);
+	hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+}
+
+template<> inline void
+Load4AsDouble<double>(const double *src, __m128d& lo, __m128d& hi) {
+	lo = _mm_loadu_pd(src);
+	hi = _mm_loadu_pd(src + 2);
+}
+
+template<> inline void
+Load4AsDouble<LONG>(const LONG *src, __m128d& lo, __m128d& hi) {
+	const __m128i v = _mm_loadu_si128((const __m128i*)src);
+	lo = _mm_cvtepi32_pd(v);
+	hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+template<> inline void
+Load4AsDouble<DWORD>(const DWORD *src, __m128d& lo, __m128d& hi) {
+	// no unsigned conversion : offset the values into the signed range, then back
+	const __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)src), _mm_set1_epi32((int)0x80000000));
+	const __m128d offset = _mm_set1_pd(2147483648.0);
+	lo = _mm_add_pd(_mm_cvtepi32_pd(v), offset);
+	hi = _mm_add_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))), offset);
+}
+#endif // FI_CONVERT_SSE2
 
 /** Convert a greyscale image of type Tsrc to a 8-bit grayscale dib.
 	Conversion is done using either a linear scaling from [min, max] to [0, 255]
 	or a rounding from src_pixel to (BYTE) MIN(255, MAX(0, q)) where int q = int(src_pixel + 0.5); 
+	8- and 16-bit types are converted through a lookup table, other types use a 
+	fused multiply-add scaling (dst = src * scale + bias) with saturation.
 */
 template<class Tsrc>
 class CONVERT_TO_BYTE
 {
 public:
 	FIBITMAP* convert(FIBITMAP *src, BOOL scale_linear);
+	FIBITMAP* convert(FIBITMAP *src, double min_value, double max_value);
+	BOOL findRange(FIBITMAP *src, double clip_percent, double& min_value, double& max_value);
+
+private:
+	FIBITMAP* allocate(FIBITMAP *src);
+	FIBITMAP* convertLUT(FIBITMAP *src, double scale, double bias);
+	static void lookupRows(void *data, unsigned first, unsigned last);
+	static void scaleRows(void *data, unsigned first, unsigned last);
+	static void roundRows(void *data, unsigned first, unsigned last);
 };
 
-template<class Tsrc> FIBITMAP* 
-CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, BOOL scale_linear) {
-	FIBITMAP *dst = NULL;
-	unsigned x, y;
+template<class Tsrc> void 
+CONVERT_TO_BYTE<Tsrc>::lookupRows(void *data, unsigned first, unsigned last) {
+	const CONVERTROWS *rows = (CONVERTROWS*)data;
+	const unsigned width = FreeImage_GetWidth(rows->src);
+	const BYTE *lut = rows->lut;
 
-	unsigned width	= FreeImage_GetWidth(src);
-	unsigned height = FreeImage_GetHeight(src);
+	for(unsigned y = first; y < last; y++) {
+		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(rows->src, y));
+		BYTE *dst_bits = FreeImage_GetScanLine(rows->dst, y);
+		if(sizeof(Tsrc) == sizeof(WORD)) {
+			const WORD *index = reinterpret_cast<const WORD*>(src_bits);
+			for(unsigned x = 0; x < width; x++) {
+				dst_bits[x] = lut[index[x]];
+			}
+		} else {
+			const BYTE *index = reinterpret_cast<const BYTE*>(src_bits);
+			for(unsigned x = 0; x < width; x++) {
+				dst_bits[x] = lut[index[x]];
+			}
+		}
+	}
+}
+
+template<class Tsrc> void 
+CONVERT_TO_BYTE<Tsrc>::scaleRows(void *data, unsigned first, unsigned last) {
+	const CONVERTROWS *rows = (CONVERTROWS*)data;
+	const unsigned width = FreeImage_GetWidth(rows->src);
+	const double scale = rows->scale;
+	const double bias = rows->bias;
+
+	for(unsigned y = first; y < last; y++) {
+		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(rows->src, y));
+		BYTE *dst_bits = FreeImage_GetScanLine(rows->dst, y);
+		unsigned x = 0;
+#if defined(FI_CONVERT_SSE2)
+		// 4 pixels per iteration, computed in double as below : 
+		// max(q, 0) returns 0 when q is NaN, so NaN values are also mapped to 0
+		const __m128d v_scale = _mm_set1_pd(scale);
+		const __m128d v_bias = _mm_set1_pd(bias);
+		const __m128d v_min = _mm_setzero_pd();
+		const __m128d v_max = _mm_set1_pd(255);
+		for(; x + 4 <= width; x += 4) {
+			__m128d lo, hi;
+			Load4AsDouble(src_bits + x, lo, hi);
+			lo = _mm_min_pd(_mm_max_pd(_mm_add_pd(_mm_mul_pd(lo, v_scale), v_bias), v_min), v_max);
+			hi = _mm_min_pd(_mm_max_pd(_mm_add_pd(_mm_mul_pd(hi, v_scale), v_bias), v_min), v_max);
+			__m128i q = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+			q = _mm_packs_epi32(q, q);
+			const int packed = _mm_cvtsi128_si32(_mm_packus_epi16(q, q));
+			memcpy(dst_bits + x, &packed, sizeof(packed));
+		}
+#endif // FI_CONVERT_SSE2
+		for(; x < width; x++) {
+			// (NaN values are mapped to 0)
+			double q = IsNaN(src_bits[x]) ? 0 : scale * src_bits[x] + bias;
+			q = (q < 0) ? 0 : q;
+			q = (q > 255) ? 255 : q;
+			dst_bits[x] = (BYTE)q;
+		}
+	}
+}
+
+template<class Tsrc> void 
+CONVERT_TO_BYTE<Tsrc>::roundRows(void *data, unsigned first, unsigned last) {
+	const CONVERTROWS *rows = (CONVERTROWS*)data;
+	const unsigned width = FreeImage_GetWidth(rows->src);
 
+	for(unsigned y = first; y < last; y++) {
+		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(rows->src, y));
+		BYTE *dst_bits = FreeImage_GetScanLine(rows->dst, y);
+		for(unsigned x = 0; x < width; x++) {
+			// rounding
+			int q = int(src_bits[x] + 0.5);
+			dst_bits[x] = (BYTE) MIN(255, MAX(0, q));
+		}
+	}
+}
+
+template<class Tsrc> FIBITMAP* 
+CONVERT_TO_BYTE<Tsrc>::allocate(FIBITMAP *src) {
 	// allocate a 8-bit dib
 
-	dst = FreeImage_AllocateT(FIT_BITMAP, width, height, 8, 0, 0, 0);
+	FIBITMAP *dst = FreeImage_AllocateT(FIT_BITMAP, FreeImage_GetWidth(src), FreeImage_GetHeight(src), 8, 0, 0, 0);
 	if(!dst) return NULL;
 
 	// build a greyscale palette
@@ -97,51 +438,119 @@ CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, BOOL scale_linear) {
 		pal[i].rgbBlue = (BYTE)i;
 	}
 
+	return dst;
+}
+
+template<class Tsrc> FIBITMAP* 
+CONVERT_TO_BYTE<Tsrc>::convertLUT(FIBITMAP *src, double scale, double bias) {
+	// 8- and 16-bit types : every possible value is mapped once, 
+	// indexing the table with the raw (unsigned) bits of the pixel
+	assert(sizeof(Tsrc) <= sizeof(WORD));
+
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	FIBITMAP *dst = allocate(src);
+	if(!dst) return NULL;
+
+	const unsigned lut_size = (sizeof(Tsrc) == sizeof(WORD)) ? 65536 : 256;
+	BYTE *lut = (BYTE*)malloc(lut_size * sizeof(BYTE));
+	if(!lut) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+	for(unsigned i = 0; i < lut_size; i++) {
+		const Tsrc value = (sizeof(Tsrc) == sizeof(WORD)) ? (Tsrc)(WORD)i : (Tsrc)(BYTE)i;
+		const double q = scale * value + bias;
+		lut[i] = (BYTE)CLAMP<double>(q, 0, 255);
+	}
+
+	CONVERTROWS rows = { src, dst, lut, scale, bias };
+	const BOOL bSuccess = FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), lookupRows, &rows);
+
+	free(lut);
+
+	if(!bSuccess) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
+template<class Tsrc> FIBITMAP* 
+CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, double min_value, double max_value) {
+	// linear scaling from [min, max] to [0, 255], with saturation
+	const double scale = 255 / (max_value - min_value);
+	const double bias = 0.5 - min_value * scale;
+
+	if(sizeof(Tsrc) <= sizeof(WORD)) {
+		return convertLUT(src, scale, bias);
+	}
+
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	FIBITMAP *dst = allocate(src);
+	if(!dst) return NULL;
+
+	CONVERTROWS rows = { src, dst, NULL, scale, bias };
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), scaleRows, &rows)) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
+template<class Tsrc> FIBITMAP* 
+CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, BOOL scale_linear) {
 	// convert the src image to dst
 	// (FIBITMAP are stored upside down)
 	if(scale_linear) {
 		Tsrc max, min;
-		double scale;
 
 		// find the min and max value of the image
-		Tsrc l_min, l_max;
-		min = 255, max = 0;
-		for(y = 0; y < height; y++) {
-			Tsrc *bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			MAXMIN(bits, width, l_max, l_min);
-			if(l_max > max) max = l_max;
-			if(l_min < min) min = l_min;
+		// (the range always includes some part of [0..255])
+		CancelWatch watch;
+		if(!FindMinMax(src, min, max) && watch.isCancelled()) {
+			return NULL;
 		}
+		min = MIN<Tsrc>(min, 255);
+		max = MAX<Tsrc>(max, 0);
 		if(max == min) {
 			max = 255; min = 0;
 		}
 
-		// compute the scaling factor
-		scale = 255 / (double)(max - min);
-
 		// scale to 8-bit
-		for(y = 0; y < height; y++) {
-			Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
-			for(x = 0; x < width; x++) {
-				dst_bits[x] = (BYTE)( scale * (src_bits[x] - min) + 0.5);
-			}
-		}
-	} else {
-		for(y = 0; y < height; y++) {
-			Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
-			for(x = 0; x < width; x++) {
-				// rounding
-				int q = int(src_bits[x] + 0.5);
-				dst_bits[x] = (BYTE) MIN(255, MAX(0, q));
-			}
-		}
+		return convert(src, (double)min, (double)max);
+	}
+
+	// rounding
+	if(sizeof(Tsrc) <= sizeof(WORD)) {
+		return convertLUT(src, 1, 0.5);
+	}
+
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	FIBITMAP *dst = allocate(src);
+	if(!dst) return NULL;
+
+	CONVERTROWS rows = { src, dst, NULL, 0, 0 };
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), roundRows, &rows)) {
+		FreeImage_Unload(dst);
+		return NULL;
 	}
 
 	return dst;
 }
 
+template<class Tsrc> BOOL
+CONVERT_TO_BYTE<Tsrc>::findRange(FIBITMAP *src, double clip_percent, double& min_value, double& max_value) {
+	return FindRange<Tsrc>(src, clip_percent, min_value, max_value);
+}
+
 /** Convert a greyscale image of type Tsrc to a FICOMPLEX dib.
 */
 template<class Tsrc>
@@ -220,22 +629,105 @@ CONVERT_TO_COMPLEX<double>			convertDoubleToComplex;
 
 // ----------------------------------------------------------
 
+/** Convert a half-float value to a 8-bit value, clamping [0..1] to [0..255]
+	(NaN values are mapped to 0)
+*/
+static inline BYTE
+HalfValueToByte(float value) {
+	if(IsNaN(value) || (value <= 0)) {
+		return 0;
+	}
+	return (value >= 1) ? 255 : (BYTE)(value * 255 + 0.5F);
+}
+
+/** Convert bands of rows of a RGB16F / RGBA16F image to a 24- / 32-bit image.
+	Each row is converted to float by blocks of pixels held on the stack.
+*/
+static void
+ConvertHalfRowsToBitmap(void *data, unsigned first, unsigned last) {
+	const CONVERTROWS *rows = (CONVERTROWS*)data;
+	const unsigned width = FreeImage_GetWidth(rows->src);
+	const unsigned channels = (FreeImage_GetImageType(rows->src) == FIT_RGBA16F) ? 4 : 3;
+	const unsigned bytespp = FreeImage_GetLine(rows->dst) / width;
+
+	const unsigned block = 256;
+	float line[block * 4];
+
+	for(unsigned y = first; y < last; y++) {
+		const WORD *src_bits = (WORD*)FreeImage_GetScanLine(rows->src, y);
+		BYTE *dst_bits = FreeImage_GetScanLine(rows->dst, y);
+		for(unsigned x = 0; x < width; x += block) {
+			const unsigned count = MIN(block, width - x);
+			ConvertLineHalfToFloat(line, channels, src_bits + x * channels, channels, count);
+			const float *value = line;
+			for(unsigned k = 0; k < count; k++) {
+				dst_bits[FI_RGBA_RED]	= HalfValueToByte(value[0]);
+				dst_bits[FI_RGBA_GREEN]	= HalfValueToByte(value[1]);
+				dst_bits[FI_RGBA_BLUE]	= HalfValueToByte(value[2]);
+				if(channels == 4) {
+					dst_bits[FI_RGBA_ALPHA] = HalfValueToByte(value[3]);
+				}
+				value += channels;
+				dst_bits += bytespp;
+			}
+		}
+	}
+}
+
+/** Convert a RGB16F image to a 24-bit image, or a RGBA16F image to a 32-bit image.
+	Values are clamped to [0..1], then scaled to [0..255]: high dynamic range images 
+	should rather go through a tone mapping operator.
+*/
+static FIBITMAP*
+ConvertHalfToBitmap(FIBITMAP *src) {
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bpp = (FreeImage_GetImageType(src) == FIT_RGBA16F) ? 32 : 24;
+
+	FIBITMAP *dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if(!dst) return NULL;
+
+	CONVERTROWS rows = { src, dst, NULL, 0, 0 };
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), ConvertHalfRowsToBitmap, &rows)) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
+// ----------------------------------------------------------
+
 // ----------------------------------------------------------
 //   smart convert X to standard FIBITMAP
 // ----------------------------------------------------------
 
+/** Report a failed conversion : either cancelled by the progress handler, or not supported
+*/
+static void
+ReportConversionFailure(const CancelWatch& watch, FREE_IMAGE_TYPE src_type, FREE_IMAGE_TYPE dst_type) {
+	if(watch.isCancelled()) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FREE_IMAGE_TYPE: Conversion from type %d to type %d cancelled.", src_type, dst_type);
+	} else {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FREE_IMAGE_TYPE: Unable to convert from type %d to type %d.\n No such conversion exists.", src_type, dst_type);
+	}
+}
+
 /** Convert image of any type to a standard 8-bit greyscale image.
 For standard images, a clone of the input image is returned.
 When the scale_linear parameter is TRUE, conversion is done by scaling linearly 
 each pixel to an integer value between [0..255]. When it is FALSE, conversion is done 
 by rounding each float pixel to an integer between [0..255]. 
 For complex images, the magnitude is extracted as a double image, then converted according to the scale parameter. 
+Half-float RGB16F and RGBA16F images are converted to 24- and 32-bit images, by clamping each channel to [0..1] 
+(the scale parameter is then ignored). 
 @param image Image to convert
 @param scale_linear Linear scaling / rounding switch
 */
 FIBITMAP* DLL_CALLCONV
 FreeImage_ConvertToStandardType(FIBITMAP *src, BOOL scale_linear) {
 	FIBITMAP *dst = NULL;
+	CancelWatch watch;
 
 	if(!src) return NULL;
 
@@ -285,10 +777,14 @@ FreeImage_ConvertToStandardType(FIBITMAP *src, BOOL scale_linear) {
 			break;
 		case FIT_RGBAF:		// 128-bit RGBA float image: 4 x 32-bit IEEE floating point
 			break;
+		case FIT_RGB16F:	// 48-bit RGB float image: 3 x 16-bit IEEE floating point
+		case FIT_RGBA16F:	// 64-bit RGBA float image: 4 x 16-bit IEEE floating point
+			dst = ConvertHalfToBitmap(src);
+			break;
 	}
 
 	if(NULL == dst) {
-		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FREE_IMAGE_TYPE: Unable to convert from type %d to type %d.\n No such conversion exists.", src_type, FIT_BITMAP);
+		ReportConversionFailure(watch, src_type, FIT_BITMAP);
 	} else {
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(dst, src);
@@ -299,6 +795,129 @@ FreeImage_ConvertToStandardType(FIBITMAP *src, BOOL scale_linear) {
 
 
 
+/** Convert a greyscale image to a standard 8-bit greyscale image, by scaling linearly 
+the [min_value, max_value] range to [0..255]. Pixels outside this range are saturated, NaN pixels are set to 0. 
+Using a range previously computed with FreeImage_GetMinMax, callers converting many images 
+sharing the same dynamic range can skip the min / max search made by FreeImage_ConvertToStandardType. 
+For standard images, a clone of the input image is returned.
+For complex images, the magnitude is extracted as a double image, then converted. 
+@param src Image to convert
+@param min_value Value mapped to 0
+@param max_value Value mapped to 255
+@return Returns the converted image if successful, returns NULL otherwise
+@see FreeImage_GetMinMax
+*/
+FIBITMAP* DLL_CALLCONV
+FreeImage_ConvertToStandardTypeRange(FIBITMAP *src, double min_value, double max_value) {
+	FIBITMAP *dst = NULL;
+	CancelWatch watch;
+
+	if(!FreeImage_HasPixels(src)) return NULL;
+
+	if(!(min_value < max_value)) {
+		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FREE_IMAGE_TYPE: Invalid conversion range, the minimum value must be lower than the maximum value");
+		return NULL;
+	}
+
+	// convert from src_type to FIT_BITMAP
+
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(src);
+
+	switch(src_type) {
+		case FIT_BITMAP:	// standard image: 1-, 4-, 8-, 16-, 24-, 32-bit
+			dst = FreeImage_Clone(src);
+			break;
+		case FIT_UINT16:	// array of unsigned short: unsigned 16-bit
+			dst = convertUShortToByte.convert(src, min_value, max_value);
+			break;
+		case FIT_INT16:		// array of short: signed 16-bit
+			dst = convertShortToByte.convert(src, min_value, max_value);
+			break;
+		case FIT_UINT32:	// array of unsigned long: unsigned 32-bit
+			dst = convertULongToByte.convert(src, min_value, max_value);
+			break;
+		case FIT_INT32:		// array of long: signed 32-bit
+			dst = convertLongToByte.convert(src, min_value, max_value);
+			break;
+		case FIT_FLOAT:		// array of float: 32-bit
+			dst = convertFloatToByte.convert(src, min_value, max_value);
+			break;
+		case FIT_DOUBLE:	// array of double: 64-bit
+			dst = convertDoubleToByte.convert(src, min_value, max_value);
+			break;
+		case FIT_COMPLEX:	// array of FICOMPLEX: 2 x 64-bit
+			{
+				// Convert to type FIT_DOUBLE
+				FIBITMAP *dib_double = FreeImage_GetComplexChannel(src, FICC_MAG);
+				if(dib_double) {
+					dst = convertDoubleToByte.convert(dib_double, min_value, max_value);
+					// Free image of type FIT_DOUBLE
+					FreeImage_Unload(dib_double);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+
+	if(NULL == dst) {
+		ReportConversionFailure(watch, src_type, FIT_BITMAP);
+	} else {
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, src);
+	}
+	
+	return dst;
+}
+
+/** Compute the range of pixel values of a greyscale image (FIT_UINT16, FIT_INT16, FIT_UINT32, 
+FIT_INT32, FIT_FLOAT or FIT_DOUBLE), optionally ignoring outliers at both ends of the histogram. 
+The result may be used with FreeImage_ConvertToStandardTypeRange. 
+@param src Input image
+@param min_value Output minimum value
+@param max_value Output maximum value
+@param clip_percent Percentage of pixels [0..50] ignored at each end of the histogram (0 returns the true min and max). 
+Percentiles are exact for 16-bit images, and approximated to 1/65536 of the image range otherwise.
+NaN values are ignored.
+@return Returns TRUE if successful, returns FALSE otherwise (e.g. when every pixel is NaN)
+@see FreeImage_ConvertToStandardTypeRange
+*/
+BOOL DLL_CALLCONV
+FreeImage_GetMinMax(FIBITMAP *src, double *min_value, double *max_value, double clip_percent) {
+	if(!FreeImage_HasPixels(src) || !min_value || !max_value) return FALSE;
+
+	double l_min = 0, l_max = 0;
+	BOOL bFound = FALSE;
+
+	switch(FreeImage_GetImageType(src)) {
+		case FIT_UINT16:
+			bFound = convertUShortToByte.findRange(src, clip_percent, l_min, l_max);
+			break;
+		case FIT_INT16:
+			bFound = convertShortToByte.findRange(src, clip_percent, l_min, l_max);
+			break;
+		case FIT_UINT32:
+			bFound = convertULongToByte.findRange(src, clip_percent, l_min, l_max);
+			break;
+		case FIT_INT32:
+			bFound = convertLongToByte.findRange(src, clip_percent, l_min, l_max);
+			break;
+		case FIT_FLOAT:
+			bFound = convertFloatToByte.findRange(src, clip_percent, l_min, l_max);
+			break;
+		case FIT_DOUBLE:
+			bFound = convertDoubleToByte.findRange(src, clip_percent, l_min, l_max);
+			break;
+		default:
+			return FALSE;
+	}
+
+	*min_value = l_min;
+	*max_value = l_max;
+
+	return bFound;
+}
+
 // ----------------------------------------------------------
 //   smart convert X to Y
 // ----------------------------------------------------------
@@ -306,6 +925,7 @@ FreeImage_ConvertToStandardType(FIBITMAP *src, BOOL scale_linear) {
 FIBITMAP* DLL_CALLCONV
 FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_linear) {
 	FIBITMAP *dst = NULL;
+	CancelWatch watch;
 
 	if(!FreeImage_HasPixels(src)) return NULL;
 
@@ -355,6 +975,12 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
 			}
 			break;
 		case FIT_UINT16:
@@ -389,6 +1015,12 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
 			}
 			break;
 		case FIT_INT16:
@@ -419,6 +1051,10 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGB16F:
+					break;
+				case FIT_RGBA16F:
+					break;
 			}
 			break;
 		case FIT_UINT32:
@@ -449,6 +1085,10 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGB16F:
+					break;
+				case FIT_RGBA16F:
+					break;
 			}
 			break;
 		case FIT_INT32:
@@ -479,6 +1119,10 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGB16F:
+					break;
+				case FIT_RGBA16F:
+					break;
 			}
 			break;
 		case FIT_FLOAT:
@@ -510,6 +1154,12 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
 			}
 			break;
 		case FIT_DOUBLE:
@@ -538,6 +1188,10 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGB16F:
+					break;
+				case FIT_RGBA16F:
+					break;
 			}
 			break;
 		case FIT_COMPLEX:
@@ -564,6 +1218,10 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 					break;
 				case FIT_RGBAF:
 					break;
+				case FIT_RGB16F:
+					break;
+				case FIT_RGBA16F:
+					break;
 			}
 			break;
 		case FIT_RGB16:
@@ -596,6 +1254,12 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
 			}
 			break;
 		case FIT_RGBA16:
@@ -628,6 +1292,12 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
 			}
 			break;
 		case FIT_RGBF:
@@ -656,6 +1326,12 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 				case FIT_RGBAF:
 					dst = FreeImage_ConvertToRGBAF(src);
 					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
 			}
 			break;
 		case FIT_RGBAF:
@@ -684,12 +1360,88 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, BOOL scale_line
 				case FIT_RGBF:
 					dst = FreeImage_ConvertToRGBF(src);
 					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
+			}
+			break;
+		case FIT_RGB16F:
+			switch(dst_type) {
+				case FIT_BITMAP:
+					dst = FreeImage_ConvertToStandardType(src, scale_linear);
+					break;
+				case FIT_UINT16:
+					break;
+				case FIT_INT16:
+					break;
+				case FIT_UINT32:
+					break;
+				case FIT_INT32:
+					break;
+				case FIT_FLOAT:
+					dst = FreeImage_ConvertToFloat(src);
+					break;
+				case FIT_DOUBLE:
+					break;
+				case FIT_COMPLEX:
+					break;
+				case FIT_RGB16:
+					break;
+				case FIT_RGBA16:
+					break;
+				case FIT_RGBF:
+					dst = FreeImage_ConvertToRGBF(src);
+					break;
+				case FIT_RGBAF:
+					dst = FreeImage_ConvertToRGBAF(src);
+					break;
+				case FIT_RGBA16F:
+					dst = FreeImage_ConvertToRGBA16F(src);
+					break;
+			}
+			break;
+		case FIT_RGBA16F:
+			switch(dst_type) {
+				case FIT_BITMAP:
+					dst = FreeImage_ConvertToStandardType(src, scale_linear);
+					break;
+				case FIT_UINT16:
+					break;
+				case FIT_INT16:
+					break;
+				case FIT_UINT32:
+					break;
+				case FIT_INT32:
+					break;
+				case FIT_FLOAT:
+					dst = FreeImage_ConvertToFloat(src);
+					break;
+				case FIT_DOUBLE:
+					break;
+				case FIT_COMPLEX:
+					break;
+				case FIT_RGB16:
+					break;
+				case FIT_RGBA16:
+					break;
+				case FIT_RGBF:
+					dst = FreeImage_ConvertToRGBF(src);
+					break;
+				case FIT_RGBAF:
+					dst = FreeImage_ConvertToRGBAF(src);
+					break;
+				case FIT_RGB16F:
+					dst = FreeImage_ConvertToRGB16F(src);
+					break;
 			}
 			break;
 	}
 
 	if(NULL == dst) {
-		FreeImage_OutputMessageProc(FIF_UNKNOWN, "FREE_IMAGE_TYPE: Unable to convert from type %d to type %d.\n No such conversion exists.", src_type, dst_type);
+		ReportConversionFailure(watch, src_type, dst_type);
 	} else {
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(dst, src);
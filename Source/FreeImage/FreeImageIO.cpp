@@ -19,6 +19,16 @@
 // Use at your own risk!
 // ==========================================================
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FI_MAPIO_POSIX
+#endif
+
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "FreeImageIO.h"
@@ -223,3 +233,294 @@ SetMemoryIO(FreeImageIO *io) {
 	io->tell_proc  = _MemoryTellProc;
 	io->write_proc = _MemoryWriteProc;
 }
+
+// ----------------------------------------------------------
+//   Buffered input
+// ----------------------------------------------------------
+
+BufferedReader::BufferedReader(FreeImageIO *io, fi_handle handle, unsigned size) :
+	_begin(NULL), _ptr(NULL), _end(NULL), _size(size), _io(io), _handle(handle) {
+	assert(size);
+	_begin = (BYTE*)malloc(_size);
+	_ptr = _end = _begin;
+}
+
+BufferedReader::~BufferedReader() {
+	if(_begin != NULL) {
+		free(_begin);
+	}
+}
+
+BOOL
+BufferedReader::fill(unsigned count) {
+	if((_begin == NULL) || (count > _size)) {
+		return FALSE;
+	}
+
+	// keep the unread bytes, they may be part of the requested block
+	const unsigned remaining = (unsigned)(_end - _ptr);
+	if(remaining && (_ptr != _begin)) {
+		memmove(_begin, _ptr, remaining);
+	}
+	_ptr = _begin;
+	_end = _begin + remaining;
+	_end += _io->read_proc(_end, 1, _size - remaining, _handle);
+
+	return ((unsigned)(_end - _ptr) >= count) ? TRUE : FALSE;
+}
+
+unsigned
+BufferedReader::readBlock(void *dst, unsigned size) {
+	BYTE *out = (BYTE*)dst;
+	unsigned done = 0;
+
+	while(done < size) {
+		unsigned available = (unsigned)(_end - _ptr);
+		if(available == 0) {
+			if(size - done >= _size) {
+				// large blocks bypass the buffer
+				return done + _io->read_proc(out + done, 1, size - done, _handle);
+			}
+			if(!fill(1)) {
+				break;
+			}
+			available = (unsigned)(_end - _ptr);
+		}
+		const unsigned n = MIN(available, size - done);
+		memcpy(out + done, _ptr, n);
+		_ptr += n;
+		done += n;
+	}
+
+	return done;
+}
+
+BOOL
+BufferedReader::skip(unsigned size) {
+	const unsigned available = (unsigned)(_end - _ptr);
+	if(size <= available) {
+		_ptr += size;
+		return TRUE;
+	}
+	_ptr = _end = _begin;
+	return (_io->seek_proc(_handle, (long)(size - available), SEEK_CUR) == 0) ? TRUE : FALSE;
+}
+
+long
+BufferedReader::tell() const {
+	// the stream is positioned at the end of the buffered bytes
+	return _io->tell_proc(_handle) - (long)(_end - _ptr);
+}
+
+BOOL
+BufferedReader::seek(long offset, int origin) {
+	if((origin == SEEK_SET) || (origin == SEEK_CUR)) {
+		// buffered bytes cover [end_pos - (_end - _begin), end_pos)
+		const long end_pos = _io->tell_proc(_handle);
+		const long position = (origin == SEEK_SET) ? offset : end_pos - (long)(_end - _ptr) + offset;
+		if((position >= end_pos - (long)(_end - _begin)) && (position <= end_pos)) {
+			_ptr = _end - (end_pos - position);
+			return TRUE;
+		}
+		_ptr = _end = _begin;
+		return (_io->seek_proc(_handle, position, SEEK_SET) == 0) ? TRUE : FALSE;
+	}
+
+	_ptr = _end = _begin;
+	return (_io->seek_proc(_handle, offset, origin) == 0) ? TRUE : FALSE;
+}
+
+void
+BufferedReader::release() {
+	if(_end > _ptr) {
+		_io->seek_proc(_handle, -(long)(_end - _ptr), SEEK_CUR);
+	}
+	_ptr = _end = _begin;
+}
+
+// ----------------------------------------------------------
+
+unsigned DLL_CALLCONV 
+_BufferedReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	if(size == 0) {
+		return 0;
+	}
+	// return the number of complete items, like fread
+	return ((BufferedReader*)handle)->read(buffer, size * count) / size;
+}
+
+unsigned DLL_CALLCONV 
+_BufferedWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	// read-only stream
+	return 0;
+}
+
+int DLL_CALLCONV
+_BufferedSeekProc(fi_handle handle, long offset, int origin) {
+	return ((BufferedReader*)handle)->seek(offset, origin) ? 0 : -1;
+}
+
+long DLL_CALLCONV
+_BufferedTellProc(fi_handle handle) {
+	return ((BufferedReader*)handle)->tell();
+}
+
+void
+SetBufferedIO(FreeImageIO *io) {
+	io->read_proc  = _BufferedReadProc;
+	io->seek_proc  = _BufferedSeekProc;
+	io->tell_proc  = _BufferedTellProc;
+	io->write_proc = _BufferedWriteProc;
+}
+
+// ----------------------------------------------------------
+//   Mapped views
+// ----------------------------------------------------------
+
+/**
+File view created by MapIO
+*/
+typedef struct tagFIMAPPING {
+	void *base;		//! start of the view
+	size_t length;	//! length of the view
+	bool copy;		//! true if the view is a private copy of a memory stream, allocated with malloc
+} FIMAPPING;
+
+static void
+UnmapView(void *base, size_t length) {
+#if defined(_WIN32)
+	UnmapViewOfFile(base);
+#elif defined(FI_MAPIO_POSIX)
+	munmap(base, length);
+#endif
+}
+
+/**
+Maps a copy-on-write view of a file, the view stays valid after the file is closed
+*/
+static BYTE*
+MapFile(FILE *stream, long offset, size_t size, void **mapping) {
+	void *base = NULL;
+	size_t length = 0;
+	size_t delta = 0;
+
+#if defined(_WIN32)
+	HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(stream));
+	LARGE_INTEGER file_size;
+	if((hFile == INVALID_HANDLE_VALUE) || !GetFileSizeEx(hFile, &file_size) || ((UINT64)offset + size > (UINT64)file_size.QuadPart)) {
+		return NULL;
+	}
+
+	// views start on a multiple of the allocation granularity
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	delta = (size_t)(offset % si.dwAllocationGranularity);
+	const UINT64 start = (UINT64)offset - delta;
+	length = delta + size;
+
+	HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(!hMapping) {
+		return NULL;
+	}
+	base = MapViewOfFile(hMapping, FILE_MAP_COPY, (DWORD)(start >> 32), (DWORD)(start & 0xFFFFFFFF), length);
+	// the view keeps a reference to the mapping object
+	CloseHandle(hMapping);
+	if(!base) {
+		return NULL;
+	}
+
+#elif defined(FI_MAPIO_POSIX)
+	const int fd = fileno(stream);
+	struct stat st;
+	if((fd < 0) || (fstat(fd, &st) != 0) || !S_ISREG(st.st_mode) || ((UINT64)offset + size > (UINT64)st.st_size)) {
+		return NULL;
+	}
+
+	// views start on a page boundary
+	const long page_size = sysconf(_SC_PAGESIZE);
+	delta = (size_t)(offset % page_size);
+	length = delta + size;
+
+	base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)(offset - delta));
+	if(base == MAP_FAILED) {
+		return NULL;
+	}
+
+#else
+	return NULL;
+#endif
+
+	FIMAPPING *view = (FIMAPPING*)malloc(sizeof(FIMAPPING));
+	if(!view) {
+		UnmapView(base, length);
+		return NULL;
+	}
+	view->base = base;
+	view->length = length;
+	view->copy = false;
+	*mapping = view;
+
+	return (BYTE*)base + delta;
+}
+
+BYTE*
+MapIO(FreeImageIO *io, fi_handle handle, long offset, size_t size, void **mapping) {
+	*mapping = NULL;
+
+	if(!io || !handle || (offset < 0) || (size == 0)) {
+		return NULL;
+	}
+
+	if(io->read_proc == _MemoryReadProc) {
+		// a memory stream buffer can be written, reallocated or freed while the bitmap lives, 
+		// and the bitmap must not write to it : the bytes are copied into a private view
+		FIMEMORYHEADER *mem_header = (FIMEMORYHEADER*)(((FIMEMORY*)handle)->data);
+		if((UINT64)offset + size > (UINT64)mem_header->file_length) {
+			return NULL;
+		}
+		FIMAPPING *view = (FIMAPPING*)malloc(sizeof(FIMAPPING));
+		void *base = malloc(size);
+		if(!view || !base) {
+			free(view);
+			free(base);
+			return NULL;
+		}
+		memcpy(base, (BYTE*)mem_header->data + offset, size);
+		view->base = base;
+		view->length = size;
+		view->copy = true;
+		*mapping = view;
+
+		return (BYTE*)base;
+	}
+
+	if(io->read_proc == _ReadProc) {
+		return MapFile((FILE*)handle, offset, size, mapping);
+	}
+
+	return NULL;
+}
+
+void
+UnmapIO(void *mapping) {
+	if(mapping) {
+		FIMAPPING *view = (FIMAPPING*)mapping;
+		if(view->copy) {
+			free(view->base);
+		} else {
+			UnmapView(view->base, view->length);
+		}
+		free(view);
+	}
+}
+
+void
+PrefetchIO(void *mapping) {
+#if defined(FI_MAPIO_POSIX)
+	if(mapping && !((FIMAPPING*)mapping)->copy) {
+		FIMAPPING *view = (FIMAPPING*)mapping;
+		madvise(view->base, view->length, MADV_SEQUENTIAL);
+		madvise(view->base, view->length, MADV_WILLNEED);
+	}
+#endif
+}
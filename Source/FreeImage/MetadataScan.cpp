@@ -0,0 +1,345 @@
+// ==========================================================
+// Batch metadata scan
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImageIO.h"
+#include "ThreadPool.h"
+#include "../Metadata/FreeImageTag.h"
+
+// ----------------------------------------------------------
+//   Scan result
+// ----------------------------------------------------------
+
+/**
+Result of a metadata scan, stored one column per field
+*/
+typedef struct tagMETADATASCAN {
+	int count;							//! number of scanned files
+	int key_count;						//! number of requested tags
+	std::vector<FREE_IMAGE_FORMAT> format;
+	std::vector<FREE_IMAGE_TYPE> type;
+	std::vector<unsigned> width;
+	std::vector<unsigned> height;
+	std::vector<unsigned> bpp;
+	std::vector<FITAG*> tags;			//! tags[key_index * count + index], NULL when missing
+} METADATASCAN;
+
+/**
+Work shared by the scan threads
+*/
+typedef struct tagSCANCONTEXT {
+	METADATASCAN *scan;
+	const char **filenames;				//! files to scan, NULL when scanning handles
+	FreeImageIO *io;					//! IO of the handles
+	fi_handle *handles;					//! handles to scan
+	const FIMETADATAKEY *keys;			//! requested tags
+} SCANCONTEXT;
+
+/** Flags of the header only load done for each file */
+static const int SCAN_LOAD_FLAGS = FIF_LOAD_NOPIXELS | FIF_LOAD_RAWMETADATA;
+
+// ----------------------------------------------------------
+//   Internal functions
+// ----------------------------------------------------------
+
+static BOOL
+IsExifModel(FREE_IMAGE_MDMODEL model) {
+	switch(model) {
+		case FIMD_EXIF_MAIN:
+		case FIMD_EXIF_EXIF:
+		case FIMD_EXIF_GPS:
+		case FIMD_EXIF_MAKERNOTE:
+		case FIMD_EXIF_INTEROP:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/**
+Store the header and the requested tags of a loaded file.
+A raw Exif profile is parsed without its thumbnail into a scratch header,
+the other models are parsed by FreeImage_GetMetadata on first access.
+*/
+static void
+StoreScanResult(SCANCONTEXT *ctx, int index, FREE_IMAGE_FORMAT fif, FIBITMAP *dib) {
+	METADATASCAN *scan = ctx->scan;
+
+	scan->format[index] = fif;
+	scan->type[index] = FreeImage_GetImageType(dib);
+	scan->width[index] = FreeImage_GetWidth(dib);
+	scan->height[index] = FreeImage_GetHeight(dib);
+	scan->bpp[index] = FreeImage_GetBPP(dib);
+
+	FIBITMAP *exif = NULL;
+	BOOL exif_parsed = FALSE;
+
+	for(int k = 0; k < scan->key_count; k++) {
+		const FIMETADATAKEY *key = &ctx->keys[k];
+		FIBITMAP *src = dib;
+
+		if(IsExifModel(key->model)) {
+			if(!exif_parsed) {
+				std::vector<BYTE> profile;
+				if(get_raw_profile(dib, FIMD_EXIF_MAIN, &profile)) {
+					exif = FreeImage_AllocateHeader(FALSE, 1, 1, 8);
+					if(exif) {
+						jpeg_read_exif_tags(exif, &profile[0], (unsigned)profile.size());
+					}
+				}
+				exif_parsed = TRUE;
+			}
+			if(exif) {
+				src = exif;
+			}
+		}
+
+		FITAG *tag = NULL;
+		if(key->key && FreeImage_GetMetadata(key->model, src, key->key, &tag)) {
+			scan->tags[(size_t)k * scan->count + index] = FreeImage_CloneTag(tag);
+		}
+	}
+
+	FreeImage_Unload(exif);
+}
+
+/**
+Scan a file. The whole file is mapped and read as a memory stream,
+files that cannot be mapped are read through the default IO.
+*/
+static void
+ScanFile(SCANCONTEXT *ctx, int index) {
+	const char *filename = ctx->filenames[index];
+	if(!filename) {
+		return;
+	}
+	FILE *handle = fopen(filename, "rb");
+	if(!handle) {
+		return;
+	}
+
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	void *mapping = NULL;
+	BYTE *data = NULL;
+	long size = 0;
+	if((fseek(handle, 0, SEEK_END) == 0) && ((size = ftell(handle)) > 0) && ((UINT64)size <= 0xFFFFFFFF) && (fseek(handle, 0, SEEK_SET) == 0)) {
+		data = MapIO(&io, (fi_handle)handle, 0, (size_t)size, &mapping);
+	}
+
+	if(data) {
+		FIMEMORY *hmem = FreeImage_OpenMemory(data, (DWORD)size);
+		if(hmem) {
+			const FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromMemory(hmem, 0);
+			if(FreeImage_FIFSupportsReading(fif)) {
+				FIBITMAP *dib = FreeImage_LoadFromMemory(fif, hmem, SCAN_LOAD_FLAGS);
+				if(dib) {
+					StoreScanResult(ctx, index, fif, dib);
+					FreeImage_Unload(dib);
+				}
+			}
+			FreeImage_CloseMemory(hmem);
+		}
+		UnmapIO(mapping);
+	} else {
+		const FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromHandle(&io, (fi_handle)handle, 0);
+		if(FreeImage_FIFSupportsReading(fif)) {
+			FIBITMAP *dib = FreeImage_LoadFromHandle(fif, &io, (fi_handle)handle, SCAN_LOAD_FLAGS);
+			if(dib) {
+				StoreScanResult(ctx, index, fif, dib);
+				FreeImage_Unload(dib);
+			}
+		}
+	}
+
+	fclose(handle);
+}
+
+/**
+Scan a user provided handle
+*/
+static void
+ScanHandle(SCANCONTEXT *ctx, int index) {
+	fi_handle handle = ctx->handles[index];
+	if(!handle) {
+		return;
+	}
+
+	const FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeFromHandle(ctx->io, handle, 0);
+	if(FreeImage_FIFSupportsReading(fif)) {
+		FIBITMAP *dib = FreeImage_LoadFromHandle(fif, ctx->io, handle, SCAN_LOAD_FLAGS);
+		if(dib) {
+			StoreScanResult(ctx, index, fif, dib);
+			FreeImage_Unload(dib);
+		}
+	}
+}
+
+/**
+Body of the parallel scan loop
+*/
+static void
+ScanFiles(void *data, unsigned first, unsigned last) {
+	SCANCONTEXT *ctx = (SCANCONTEXT*)data;
+	for(unsigned index = first; index < last; index++) {
+		if(ctx->filenames) {
+			ScanFile(ctx, (int)index);
+		} else {
+			ScanHandle(ctx, (int)index);
+		}
+	}
+}
+
+/**
+Allocate the result and scan the files on the worker pool, the calling thread included
+*/
+static FIMETADATASCAN*
+RunScan(const char **filenames, FreeImageIO *io, fi_handle *handles, int count, const FIMETADATAKEY *keys, int key_count) {
+	if((count < 0) || (key_count < 0) || ((key_count > 0) && !keys)) {
+		return NULL;
+	}
+
+	FIMETADATASCAN *handle = NULL;
+	METADATASCAN *scan = NULL;
+
+	try {
+		handle = new FIMETADATASCAN;
+		handle->data = NULL;
+		scan = new METADATASCAN;
+		scan->count = count;
+		scan->key_count = key_count;
+		scan->format.assign(count, FIF_UNKNOWN);
+		scan->type.assign(count, FIT_UNKNOWN);
+		scan->width.assign(count, 0);
+		scan->height.assign(count, 0);
+		scan->bpp.assign(count, 0);
+		scan->tags.assign((size_t)key_count * count, NULL);
+		handle->data = scan;
+	} catch(std::bad_alloc &) {
+		delete scan;
+		delete handle;
+		return NULL;
+	}
+
+	SCANCONTEXT ctx;
+	ctx.scan = scan;
+	ctx.filenames = filenames;
+	ctx.io = io;
+	ctx.handles = handles;
+	ctx.keys = keys;
+
+	// files take very different times, so that each one is a chunk
+	if(!FreeImage_ParallelFor((unsigned)count, 1, ScanFiles, &ctx)) {
+		// cancelled
+		FreeImage_CloseMetadataScan(handle);
+		return NULL;
+	}
+
+	return handle;
+}
+
+static inline METADATASCAN*
+GetScan(FIMETADATASCAN *scan, int index) {
+	if(scan && scan->data) {
+		METADATASCAN *data = (METADATASCAN*)scan->data;
+		if((index >= 0) && (index < data->count)) {
+			return data;
+		}
+	}
+	return NULL;
+}
+
+// ----------------------------------------------------------
+//   Metadata scan
+// ----------------------------------------------------------
+
+FIMETADATASCAN * DLL_CALLCONV
+FreeImage_ScanMetadata(const char **filenames, int count, const FIMETADATAKEY *keys, int key_count) {
+	if(!filenames && (count > 0)) {
+		return NULL;
+	}
+	return RunScan(filenames, NULL, NULL, count, keys, key_count);
+}
+
+FIMETADATASCAN * DLL_CALLCONV
+FreeImage_ScanMetadataFromHandle(FreeImageIO *io, fi_handle *handles, int count, const FIMETADATAKEY *keys, int key_count) {
+	if((!io || !handles) && (count > 0)) {
+		return NULL;
+	}
+	return RunScan(NULL, io, handles, count, keys, key_count);
+}
+
+void DLL_CALLCONV
+FreeImage_CloseMetadataScan(FIMETADATASCAN *scan) {
+	if(scan) {
+		METADATASCAN *data = (METADATASCAN*)scan->data;
+		if(data) {
+			for(size_t i = 0; i < data->tags.size(); i++) {
+				FreeImage_DeleteTag(data->tags[i]);
+			}
+			delete data;
+		}
+		delete scan;
+	}
+}
+
+int DLL_CALLCONV
+FreeImage_GetScanCount(FIMETADATASCAN *scan) {
+	return (scan && scan->data) ? ((METADATASCAN*)scan->data)->count : 0;
+}
+
+FREE_IMAGE_FORMAT DLL_CALLCONV
+FreeImage_GetScanFormat(FIMETADATASCAN *scan, int index) {
+	METADATASCAN *data = GetScan(scan, index);
+	return data ? data->format[index] : FIF_UNKNOWN;
+}
+
+FREE_IMAGE_TYPE DLL_CALLCONV
+FreeImage_GetScanImageType(FIMETADATASCAN *scan, int index) {
+	METADATASCAN *data = GetScan(scan, index);
+	return data ? data->type[index] : FIT_UNKNOWN;
+}
+
+unsigned DLL_CALLCONV
+FreeImage_GetScanWidth(FIMETADATASCAN *scan, int index) {
+	METADATASCAN *data = GetScan(scan, index);
+	return data ? data->width[index] : 0;
+}
+
+unsigned DLL_CALLCONV
+FreeImage_GetScanHeight(FIMETADATASCAN *scan, int index) {
+	METADATASCAN *data = GetScan(scan, index);
+	return data ? data->height[index] : 0;
+}
+
+unsigned DLL_CALLCONV
+FreeImage_GetScanBPP(FIMETADATASCAN *scan, int index) {
+	METADATASCAN *data = GetScan(scan, index);
+	return data ? data->bpp[index] : 0;
+}
+
+FITAG * DLL_CALLCONV
+FreeImage_GetScanTag(FIMETADATASCAN *scan, int index, int key_index) {
+	METADATASCAN *data = GetScan(scan, index);
+	if(data && (key_index >= 0) && (key_index < data->key_count)) {
+		return data->tags[(size_t)key_index * data->count + index];
+	}
+	return NULL;
+}
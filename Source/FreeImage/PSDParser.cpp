@@ -25,9 +25,12 @@
 // Use at your own risk!
 // ==========================================================
 
+#include <atomic>
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "PSDParser.h"
+#include "RLECodec.h"
+#include "ThreadPool.h"
 
 #include "../Metadata/FreeImageTag.h"
 
@@ -54,6 +57,9 @@
 #define PSDP_COMPRESSION_ZIP			2	//! ZIP compression without prediction
 #define PSDP_COMPRESSION_ZIP_PREDICTION	3	//! ZIP compression with prediction
 
+// Largest block moved by a single read_proc or write_proc call (PSB planes may exceed 4 GB)
+#define PSD_IO_BLOCK	0x40000000
+
 /**
 PSD image resources
 */
@@ -160,6 +166,89 @@ psdReadSize(FreeImageIO *io, fi_handle handle, const psdHeaderInfo& header) {
 	}
 }
 
+/**
+Skips nBytes from the current position. 
+Large PSB blocks are skipped in several steps when a long cannot hold their size (no fseeko).
+*/
+static bool
+psdSkip(FreeImageIO *io, fi_handle handle, UINT64 nBytes) {
+	if (sizeof(long) < sizeof(UINT64)) {
+		const long offset = 0x10000000;
+		while (nBytes > (UINT64)offset) {
+			if (io->seek_proc(handle, offset, SEEK_CUR) != 0) {
+				return false;
+			}
+			nBytes -= offset;
+		}
+	}
+	if (nBytes > 0) {
+		return (io->seek_proc(handle, (long)nBytes, SEEK_CUR) == 0);
+	}
+	return true;
+}
+
+/**
+Moves to an absolute position of the stream
+@see psdSkip
+*/
+static bool
+psdSeek(FreeImageIO *io, fi_handle handle, UINT64 nPosition) {
+	if (io->seek_proc(handle, 0, SEEK_SET) != 0) {
+		return false;
+	}
+	return psdSkip(io, handle, nPosition);
+}
+
+/**
+Returns the number of bytes from the current position to the end of the stream, 
+or UINT64 max when the stream cannot tell it
+*/
+static UINT64
+psdRemainingSize(FreeImageIO *io, fi_handle handle) {
+	const long nPosition = io->tell_proc(handle);
+	if ((nPosition < 0) || (io->seek_proc(handle, 0, SEEK_END) != 0)) {
+		return (UINT64)-1;
+	}
+	const long nEnd = io->tell_proc(handle);
+	if (io->seek_proc(handle, nPosition, SEEK_SET) != 0) {
+		return (UINT64)-1;
+	}
+	return (nEnd >= nPosition) ? (UINT64)(nEnd - nPosition) : (UINT64)-1;
+}
+
+/**
+Reads nBytes with as many read_proc calls as needed
+@return Returns the number of bytes read
+*/
+static size_t
+psdReadBlock(FreeImageIO *io, fi_handle handle, BYTE *data, size_t nBytes) {
+	size_t nDone = 0;
+	while (nDone < nBytes) {
+		const unsigned nCount = (unsigned)MIN(nBytes - nDone, (size_t)PSD_IO_BLOCK);
+		const unsigned nRead = io->read_proc(data + nDone, 1, nCount, handle);
+		nDone += nRead;
+		if (nRead < nCount) {
+			break;
+		}
+	}
+	return nDone;
+}
+
+/**
+Writes nBytes with as many write_proc calls as needed
+*/
+static bool
+psdWriteBlock(FreeImageIO *io, fi_handle handle, const BYTE *data, size_t nBytes) {
+	for (size_t nDone = 0; nDone < nBytes; ) {
+		const unsigned nCount = (unsigned)MIN(nBytes - nDone, (size_t)PSD_IO_BLOCK);
+		if (io->write_proc((void*)(data + nDone), nCount, 1, handle) != 1) {
+			return false;
+		}
+		nDone += nCount;
+	}
+	return true;
+}
+
 // --------------------------------------------------------------------------
 
 template <int N>
@@ -993,6 +1082,161 @@ bool psdData::Write(FreeImageIO *io, fi_handle handle, int ID) {
 
 //---------------------------------------------------------------------------
 
+psdLayerRecord::psdLayerRecord() : _Top(0), _Left(0), _Bottom(0), _Right(0), _Opacity(255), _Flags(0) {
+	memset(_BlendMode, 0, sizeof(_BlendMode));
+	memset(&_UserMask, 0, sizeof(_UserMask));
+	memset(&_RealUserMask, 0, sizeof(_RealUserMask));
+}
+
+psdLayerRecord::~psdLayerRecord() {
+}
+
+/**
+Reads the flags, default color and rectangle of a layer mask
+*/
+static void
+psdReadLayerMask(const BYTE *data, BYTE flags, BYTE defaultColor, psdLayerMask& mask) {
+	mask._bValid = true;
+	mask._Top = (int)psdGetValue(&data[0], 4);
+	mask._Left = (int)psdGetValue(&data[4], 4);
+	mask._Bottom = (int)psdGetValue(&data[8], 4);
+	mask._Right = (int)psdGetValue(&data[12], 4);
+	mask._DefaultColor = defaultColor;
+	mask._Flags = flags;
+}
+
+bool psdLayerRecord::Read(FreeImageIO *io, fi_handle handle, const psdHeaderInfo& header, UINT64& nSize) {
+	BYTE Rectangle[16];
+	BYTE ShortValue[2];
+	BYTE IntValue[4];
+	BYTE LongValue[8];
+	BYTE BlendInfo[12];
+
+	// rectangle containing the contents of the layer
+	if(io->read_proc(Rectangle, sizeof(Rectangle), 1, handle) != 1) {
+		return false;
+	}
+	_Top = (int)psdGetValue(&Rectangle[0], sizeof(IntValue));
+	_Left = (int)psdGetValue(&Rectangle[4], sizeof(IntValue));
+	_Bottom = (int)psdGetValue(&Rectangle[8], sizeof(IntValue));
+	_Right = (int)psdGetValue(&Rectangle[12], sizeof(IntValue));
+
+	// channel information
+	if(io->read_proc(ShortValue, sizeof(ShortValue), 1, handle) != 1) {
+		return false;
+	}
+	const unsigned nChannels = psdGetValue(ShortValue, sizeof(ShortValue));
+	if(nChannels > 56) {
+		// Photoshop supports at most 56 channels
+		return false;
+	}
+	_Channels.resize(nChannels);
+	for(unsigned c = 0; c < nChannels; c++) {
+		psdLayerChannel& channel = _Channels[c];
+		if(io->read_proc(ShortValue, sizeof(ShortValue), 1, handle) != 1) {
+			return false;
+		}
+		channel._ID = (short)psdGetValue(ShortValue, sizeof(ShortValue));
+		if(header._Version == 1) {
+			if(io->read_proc(IntValue, sizeof(IntValue), 1, handle) != 1) {
+				return false;
+			}
+			channel._Length = psdGetLongValue(IntValue, sizeof(IntValue));
+		} else {
+			if(io->read_proc(LongValue, sizeof(LongValue), 1, handle) != 1) {
+				return false;
+			}
+			channel._Length = psdGetLongValue(LongValue, sizeof(LongValue));
+		}
+		channel._Offset = 0;
+	}
+
+	// blend mode signature and key, opacity, clipping, flags, filler
+	if(io->read_proc(BlendInfo, sizeof(BlendInfo), 1, handle) != 1) {
+		return false;
+	}
+	if(memcmp(BlendInfo, "8BIM", 4) != 0) {
+		return false;
+	}
+	memcpy(_BlendMode, &BlendInfo[4], 4);
+	_BlendMode[4] = '\0';
+	_Opacity = BlendInfo[8];
+	_Flags = BlendInfo[10];
+
+	// extra data field
+	if(io->read_proc(IntValue, sizeof(IntValue), 1, handle) != 1) {
+		return false;
+	}
+	const DWORD nExtraLength = psdGetValue(IntValue, sizeof(IntValue));
+
+	// size of the record, the caller locates the channel data from it
+	nSize = sizeof(Rectangle) + sizeof(ShortValue) + 
+		(UINT64)nChannels * (sizeof(ShortValue) + ((header._Version == 1) ? sizeof(IntValue) : sizeof(LongValue))) + 
+		sizeof(BlendInfo) + sizeof(IntValue) + nExtraLength;
+
+	// layer mask data : 0, 20 or at least 36 bytes
+	UINT64 nExtraRead = 0;
+	if(io->read_proc(IntValue, sizeof(IntValue), 1, handle) != 1) {
+		return false;
+	}
+	const DWORD nMaskLength = psdGetValue(IntValue, sizeof(IntValue));
+	nExtraRead += sizeof(IntValue) + (UINT64)nMaskLength;
+	if(nExtraRead > nExtraLength) {
+		return false;
+	}
+	if((nMaskLength >= 18) && (nMaskLength <= 256)) {
+		BYTE MaskData[256];
+		if(io->read_proc(MaskData, nMaskLength, 1, handle) != 1) {
+			return false;
+		}
+		// rectangle, default color, flags
+		psdReadLayerMask(&MaskData[0], MaskData[17], MaskData[16], _UserMask);
+		if(nMaskLength >= 36) {
+			// optional mask parameters, then real flags, real user mask background and rectangle
+			unsigned nPosition = 18;
+			if(_UserMask._Flags & 0x10) {
+				const BYTE nParameters = MaskData[nPosition++];
+				nPosition += ((nParameters & 0x01) ? 1 : 0) + ((nParameters & 0x02) ? 8 : 0) + ((nParameters & 0x04) ? 1 : 0) + ((nParameters & 0x08) ? 8 : 0);
+			}
+			if(nPosition + 18 <= nMaskLength) {
+				psdReadLayerMask(&MaskData[nPosition + 2], MaskData[nPosition], MaskData[nPosition + 1], _RealUserMask);
+			}
+		}
+	} else if(!psdSkip(io, handle, nMaskLength)) {
+		return false;
+	}
+
+	// layer blending ranges are skipped
+	if(io->read_proc(IntValue, sizeof(IntValue), 1, handle) != 1) {
+		return false;
+	}
+	const DWORD nRangesLength = psdGetValue(IntValue, sizeof(IntValue));
+	nExtraRead += sizeof(IntValue) + (UINT64)nRangesLength;
+	if((nExtraRead > nExtraLength) || !psdSkip(io, handle, nRangesLength)) {
+		return false;
+	}
+
+	// layer name : Pascal string, padded to a multiple of 4 bytes
+	BYTE nNameLength = 0;
+	char Name[256];
+	if(io->read_proc(&nNameLength, 1, 1, handle) != 1) {
+		return false;
+	}
+	if((nNameLength > 0) && (io->read_proc(Name, nNameLength, 1, handle) != 1)) {
+		return false;
+	}
+	_Name.assign(Name, nNameLength);
+	nExtraRead += 1 + nNameLength;
+	if(nExtraRead > nExtraLength) {
+		return false;
+	}
+
+	// skip the additional layer information
+	return psdSkip(io, handle, nExtraLength - nExtraRead);
+}
+
+//---------------------------------------------------------------------------
+
 /**
 Invert only color components, skipping Alpha/Black
 (Can be useful as public/utility function)
@@ -1042,6 +1286,7 @@ psdParser::psdParser() {
 	_TransparentIndex = -1;
 	_fi_flags = 0;
 	_fi_format_id = FIF_UNKNOWN;
+	_bLayersIndexed = false;
 }
 
 psdParser::~psdParser() {
@@ -1060,28 +1305,138 @@ unsigned psdParser::GetChannelOffset(FIBITMAP* bitmap, unsigned c) const {
 	return channelOffset;
 }
 
-bool psdParser::ReadLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle)	{
-	bool bSuccess = true;
+bool psdParser::ReadLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle, UINT64 nPosition)	{
+	const UINT64 nTotalBytes = psdReadSize(io, handle, _headerInfo);
 
-	UINT64 nTotalBytes = psdReadSize(io, handle, _headerInfo);
+	if ((nPosition == 0) || (nTotalBytes == 0)) {
+		return psdSkip(io, handle, nTotalBytes);
+	}
 
-	// Hack to handle large PSB files without using fseeko().
-	if (sizeof(long) < sizeof(UINT64)) {
-		const long offset = 0x10000000;
-		while (nTotalBytes > offset) {
-			if (io->seek_proc(handle, offset, SEEK_CUR) != 0) {
-				bSuccess = false;
+	// build the layer index : layer records are read, channel data are only located
+
+	const unsigned nSizeLength = (_headerInfo._Version == 1) ? 4 : 8;
+	const UINT64 nSectionStart = nPosition + nSizeLength;
+	const UINT64 nSectionEnd = nSectionStart + nTotalBytes;
+
+	_layers.clear();
+
+	// layer info
+	const UINT64 nLayerInfoBytes = psdReadSize(io, handle, _headerInfo);
+	if (nSectionStart + nSizeLength + nLayerInfoBytes > nSectionEnd) {
+		return false;
+	}
+	if (!ReadLayerInfo(io, handle, nSectionStart + nSizeLength, nLayerInfoBytes)) {
+		return false;
+	}
+
+	if (_layers.empty() && (_headerInfo._BitsPerChannel > 8)) {
+		// 16- and 32-bit layers are stored in a 'Lr16' or 'Lr32' block of the additional layer information
+		nPosition = nSectionStart + nSizeLength + nLayerInfoBytes;
+		BYTE IntValue[4];
+		BYTE LongValue[8];
+
+		// skip the global layer mask info
+		if (!psdSeek(io, handle, nPosition) || (io->read_proc(IntValue, sizeof(IntValue), 1, handle) != 1)) {
+			return false;
+		}
+		nPosition += sizeof(IntValue) + psdGetValue(IntValue, sizeof(IntValue));
+
+		while (nPosition + 12 <= nSectionEnd) {
+			BYTE Signature[4];
+			BYTE Key[4];
+
+			if (!psdSeek(io, handle, nPosition) ||
+				(io->read_proc(Signature, sizeof(Signature), 1, handle) != 1) ||
+				(io->read_proc(Key, sizeof(Key), 1, handle) != 1)) {
+				break;
+			}
+			if ((memcmp(Signature, "8BIM", 4) != 0) && (memcmp(Signature, "8B64", 4) != 0)) {
+				break;
+			}
+			nPosition += sizeof(Signature) + sizeof(Key);
+
+			// some PSB blocks use a 8-byte length
+			const bool bLongLength = (_headerInfo._Version == 2) && (
+				(memcmp(Key, "LMsk", 4) == 0) || (memcmp(Key, "Lr16", 4) == 0) || (memcmp(Key, "Lr32", 4) == 0) ||
+				(memcmp(Key, "Layr", 4) == 0) || (memcmp(Key, "Mt16", 4) == 0) || (memcmp(Key, "Mt32", 4) == 0) ||
+				(memcmp(Key, "Mtrn", 4) == 0) || (memcmp(Key, "Alph", 4) == 0) || (memcmp(Key, "FMsk", 4) == 0) ||
+				(memcmp(Key, "lnk2", 4) == 0) || (memcmp(Key, "FEid", 4) == 0) || (memcmp(Key, "FXid", 4) == 0) ||
+				(memcmp(Key, "PxSD", 4) == 0));
+
+			UINT64 nLength = 0;
+			if (bLongLength) {
+				if (io->read_proc(LongValue, sizeof(LongValue), 1, handle) != 1) {
+					break;
+				}
+				nLength = psdGetLongValue(LongValue, sizeof(LongValue));
+				nPosition += sizeof(LongValue);
+			} else {
+				if (io->read_proc(IntValue, sizeof(IntValue), 1, handle) != 1) {
+					break;
+				}
+				nLength = psdGetValue(IntValue, sizeof(IntValue));
+				nPosition += sizeof(IntValue);
+			}
+			if (nPosition + nLength > nSectionEnd) {
 				break;
 			}
-			nTotalBytes -= offset;
+
+			if ((memcmp(Key, "Lr16", 4) == 0) || (memcmp(Key, "Lr32", 4) == 0)) {
+				if (!ReadLayerInfo(io, handle, nPosition, nLength)) {
+					return false;
+				}
+				break;
+			}
+			nPosition += nLength;
+		}
+	}
+
+	return psdSeek(io, handle, nSectionEnd);
+}
+
+bool psdParser::ReadLayerInfo(FreeImageIO *io, fi_handle handle, UINT64 nStart, UINT64 length) {
+	if (length == 0) {
+		// no layers
+		return true;
+	}
+
+	BYTE ShortValue[2];
+	if (io->read_proc(ShortValue, sizeof(ShortValue), 1, handle) != 1) {
+		return false;
+	}
+	// a negative count means that the first alpha channel contains the transparency data for the merged result 
+	// (computed as an int, -32768 has no short opposite)
+	int nLayers = (short)psdGetValue(ShortValue, sizeof(ShortValue));
+	if (nLayers < 0) {
+		nLayers = -nLayers;
+	}
+
+	// channel image data follow the layer records, in the same order
+	UINT64 nOffset = nStart + sizeof(ShortValue);
+
+	std::vector<psdLayerRecord> layers(nLayers);
+	for (int i = 0; i < nLayers; i++) {
+		UINT64 nRecordSize = 0;
+		if (!layers[i].Read(io, handle, _headerInfo, nRecordSize)) {
+			return false;
 		}
+		nOffset += nRecordSize;
 	}
-	if (bSuccess && nTotalBytes > 0) {
-		if (io->seek_proc(handle, (long)nTotalBytes, SEEK_CUR) != 0)
-			bSuccess = false;
+
+	for (int i = 0; i < nLayers; i++) {
+		std::vector<psdLayerChannel>& channels = layers[i]._Channels;
+		for (size_t c = 0; c < channels.size(); c++) {
+			channels[c]._Offset = nOffset;
+			nOffset += channels[c]._Length;
+		}
+	}
+	if (nOffset > nStart + length) {
+		return false;
 	}
 
-	return bSuccess;
+	_layers.swap(layers);
+
+	return true;
 }
 
 bool psdParser::ReadImageResources(FreeImageIO *io, fi_handle handle, LONG length) {
@@ -1307,43 +1662,85 @@ void psdParser::ReadImageLine(BYTE* dst, const BYTE* src, unsigned lineSize, uns
 	}
 }
 
-void psdParser::UnpackRLE(BYTE* line, const BYTE* rle_line, BYTE* line_end, unsigned srcSize) {
-	while (srcSize > 0) {
+/**
+Arguments of the RLE decoding or encoding of a channel plane, run on bands of rows in parallel
+*/
+typedef struct tagPSDRLEROWS {
+	BYTE* line_start;				//! first (bottom-up : last) bitmap line of the channel
+	unsigned lineSize;				//! bitmap pitch
+	BYTE* plane;					//! packed plane (decoding) or row slots (encoding)
+	DWORD* rleLineSizeList;			//! packed size of each row
+	const size_t* rowOffset;		//! offset of each packed row in the plane (decoding)
+	size_t maxPackedSize;			//! size of a row slot (encoding)
+	unsigned planeLineSize;			//! channel line size
+	unsigned bpp;					//! bytes per bitmap pixel
+	unsigned bytes;					//! bytes per sample
+	std::atomic<bool> failed;		//! true if a band could not allocate its line cache
+} PSDRLEROWS;
+
+void psdParser::UnpackRLEBand(void *data, unsigned first, unsigned last) {
+	PSDRLEROWS* rows = (PSDRLEROWS*)data;
+	const unsigned lineSize = rows->planeLineSize;
+
+	// samples wider than a byte need to be byte swapped, they go through a line cache
+	BYTE* line_start = NULL;
+	if (rows->bytes != 1) {
+		line_start = new (std::nothrow) BYTE[lineSize];
+		if (!line_start) {
+			rows->failed = true;
+			return;
+		}
+	}
 
-		int len = *rle_line++;
-		srcSize--;
+	// rows only depend on the line size table : they are unpacked directly into the bitmap 
+	// whenever the sample size allows it
+	BYTE* dst_line_start = rows->line_start - (size_t)first * rows->lineSize;//<*** flipped
+	for (unsigned h = first; h < last; ++h, dst_line_start -= rows->lineSize) {
+		const BYTE* src = rows->plane + rows->rowOffset[h];
+		const DWORD rleLineSize = rows->rleLineSizeList[h];
 
-		// NOTE len is signed byte in PackBits RLE
+		if (line_start) {
+			const unsigned nDecoded = PackBits_Decode(line_start, lineSize, src, rleLineSize);
+			// a short row is completed with zeros
+			memset(line_start + nDecoded, 0, lineSize - nDecoded);
+			ReadImageLine(dst_line_start, line_start, lineSize, rows->bpp, rows->bytes);
+		} else {
+			PackBits_DecodeStrided(dst_line_start, rows->bpp, lineSize, src, rleLineSize);
+		}
+	}
 
-		if ( len < 128 ) { //<- MSB is not set
-			// uncompressed packet
+	SAFE_DELETE_ARRAY(line_start);
+}
 
-			// (len + 1) bytes of data are copied
-			++len;
+bool psdParser::UnpackRLEPlane(BYTE* dst_line_start, unsigned dstLineSize, const BYTE* plane, const DWORD* rleLineSizeList, unsigned nHeight, unsigned lineSize, unsigned dstBpp, unsigned bytes) {
+	// offsets of the packed rows, so that bands can start anywhere in the plane
+	size_t* rowOffset = new (std::nothrow) size_t[nHeight];
+	if (!rowOffset) {
+		return false;
+	}
+	size_t nOffset = 0;
+	for (unsigned h = 0; h < nHeight; ++h) {
+		rowOffset[h] = nOffset;
+		nOffset += rleLineSizeList[h];
+	}
 
-			// assert we don't write beyound eol
-			memcpy(line, rle_line, line + len > line_end ? line_end - line : len);
-			line += len;
-			rle_line += len;
-			srcSize -= len;
-		}
-		else if ( len > 128 ) { //< MSB is set
-			// RLE compressed packet
+	PSDRLEROWS rows;
+	rows.line_start = dst_line_start;
+	rows.lineSize = dstLineSize;
+	rows.plane = (BYTE*)plane;
+	rows.rleLineSizeList = (DWORD*)rleLineSizeList;
+	rows.rowOffset = rowOffset;
+	rows.maxPackedSize = 0;
+	rows.planeLineSize = lineSize;
+	rows.bpp = dstBpp;
+	rows.bytes = bytes;
+	rows.failed = false;
 
-			// One byte of data is repeated (–len + 1) times
+	const BOOL bDone = FreeImage_ParallelFor(nHeight, FreeImage_GetRowChunk(lineSize), UnpackRLEBand, &rows);
 
-			len ^= 0xFF; // same as (-len + 1) & 0xFF
-			len += 2;    //
+	SAFE_DELETE_ARRAY(rowOffset);
 
-			// assert we don't write beyound eol
-			memset(line, *rle_line++, line + len > line_end ? line_end - line : len);
-			line += len;
-			srcSize--;
-		}
-		else if ( 128 == len ) {
-			// Do nothing
-		}
-	}//< rle_line
+	return bDone && !rows.failed;
 }
 
 FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
@@ -1465,6 +1862,9 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 
 	BYTE* line_start = new BYTE[lineSize]; //< fileline cache
 
+	// progress is reported for each row of each channel read
+	const double progressRows = (double)MIN(nChannels, dstChannels) * nHeight;
+
 	switch ( nCompression ) {
 		case PSDP_COMPRESSION_NONE: // raw data
 		{
@@ -1478,6 +1878,11 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 
 				BYTE* dst_line_start = dst_first_line + channelOffset;
 				for(unsigned h = 0; h < nHeight; ++h, dst_line_start -= dstLineSize) {//<*** flipped
+					if(!FreeImage_ReportProgress((c * nHeight + h) / progressRows)) {
+						FreeImage_Unload(bitmap);
+						SAFE_DELETE_ARRAY(line_start);
+						throw (const char*)NULL;
+					}
 					io->read_proc(line_start, lineSize, 1, handle);
 					ReadImageLine(dst_line_start, line_start, lineSize, dstBpp, bytes);
 				} //< h
@@ -1527,19 +1932,25 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 #endif
 			}
 
-			DWORD largestRLELine = 0;
+			// each channel plane is read with a single I/O, rows offsets are given by the line size table. 
+			// The table is checked against the rest of the file : lines past its end (corrupted table 
+			// or truncated file) are cut, and decoded as zeros, so that a plane is never larger than the file
+
+			UINT64 nAvailable = psdRemainingSize(io, handle);
+			size_t largestPlane = 0;
 			for(unsigned ch = 0; ch < nChannels; ++ch) {
+				size_t planeSize = 0;
 				for(unsigned h = 0; h < nHeight; ++h) {
-					const unsigned index = ch * nHeight + h;
-
-					if(largestRLELine < rleLineSizeList[index]) {
-						largestRLELine = rleLineSizeList[index];
-					}
+					DWORD& rleLineSize = rleLineSizeList[ch * nHeight + h];
+					rleLineSize = (DWORD)MIN<UINT64>(rleLineSize, nAvailable);
+					nAvailable -= rleLineSize;
+					planeSize += rleLineSize;
 				}
+				largestPlane = MAX(largestPlane, planeSize);
 			}
 
-			BYTE* rle_line_start = new (std::nothrow) BYTE[largestRLELine];
-			if(!rle_line_start) {
+			BYTE* plane = new (std::nothrow) BYTE[largestPlane];
+			if(!plane) {
 				FreeImage_Unload(bitmap);
 				SAFE_DELETE_ARRAY(line_start);
 				SAFE_DELETE_ARRAY(rleLineSizeList);
@@ -1552,30 +1963,39 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 					// @todo write to extra channels
 					break;
 				}
-				const BYTE* const line_end = line_start + lineSize;
-
-				const unsigned channelOffset = GetChannelOffset(bitmap, ch) * bytes;
-
-				BYTE* dst_line_start = dst_first_line + channelOffset;
-				for(unsigned h = 0; h < nHeight; ++h, dst_line_start -= dstLineSize) {//<*** flipped
-					const unsigned index = ch * nHeight + h;
-
-					// - read and uncompress line -
-
-					const DWORD rleLineSize = rleLineSizeList[index];
+				const DWORD* channelLineSizeList = rleLineSizeList + ch * nHeight;
 
-					io->read_proc(rle_line_start, rleLineSize, 1, handle);
+				size_t planeSize = 0;
+				for(unsigned h = 0; h < nHeight; ++h) {
+					planeSize += channelLineSizeList[h];
+				}
+				const size_t bytesRead = psdReadBlock(io, handle, plane, planeSize);
+				if(bytesRead < planeSize) {
+					// truncated file : missing data is decoded as zero
+					memset(plane + bytesRead, 0, planeSize - bytesRead);
+				}
 
-					// - write line to destination -
+				const unsigned channelOffset = GetChannelOffset(bitmap, ch) * bytes;
 
-					UnpackRLE(line_start, rle_line_start, line_start + lineSize, rleLineSize);
-					ReadImageLine(dst_line_start, line_start, lineSize, dstBpp, bytes);
-				}//< h
+				// unpack the plane in bands of rows, on the worker pool : the load is cancelled between two bands
+				bool bUnpacked = false;
+				{
+					ProgressStep step(ch * nHeight / progressRows, (ch + 1) * nHeight / progressRows);
+					bUnpacked = UnpackRLEPlane(dst_first_line + channelOffset, dstLineSize, plane, channelLineSizeList, nHeight, lineSize, dstBpp, bytes);
+				}
+				if(!bUnpacked) {
+					// cancelled (or out of memory)
+					FreeImage_Unload(bitmap);
+					SAFE_DELETE_ARRAY(line_start);
+					SAFE_DELETE_ARRAY(rleLineSizeList);
+					SAFE_DELETE_ARRAY(plane);
+					throw (const char*)NULL;
+				}
 			}//< ch
 
 			SAFE_DELETE_ARRAY(line_start);
 			SAFE_DELETE_ARRAY(rleLineSizeList);
-			SAFE_DELETE_ARRAY(rle_line_start);
+			SAFE_DELETE_ARRAY(plane);
 		}
 		break;
 
@@ -1668,6 +2088,390 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 	return bitmap;
 }
 
+/**
+Undo the horizontal prediction of a ZIP compressed line. 
+8- and 16-bit samples are stored as deltas, 32-bit samples are split into byte planes (most significant first) before computing byte deltas. 
+@param line Uncompressed line, decoded in place for 8- and 16-bit samples
+@param dst Output line for 32-bit samples
+@param nWidth Number of samples
+@param bytes Bytes per sample
+@return Returns the decoded line
+*/
+static BYTE*
+psdUndoPrediction(BYTE *line, BYTE *dst, unsigned nWidth, unsigned bytes) {
+	switch (bytes) {
+		case 1:
+			for (unsigned x = 1; x < nWidth; x++) {
+				line[x] = (BYTE)(line[x] + line[x - 1]);
+			}
+			return line;
+
+		case 2:
+		{
+			// big endian samples
+			WORD prev = (WORD)((line[0] << 8) | line[1]);
+			for (unsigned x = 1; x < nWidth; x++) {
+				BYTE *p = line + 2 * x;
+				const WORD v = (WORD)(((p[0] << 8) | p[1]) + prev);
+				p[0] = (BYTE)(v >> 8);
+				p[1] = (BYTE)(v & 0xFF);
+				prev = v;
+			}
+			return line;
+		}
+
+		case 4:
+		{
+			const unsigned lineSize = 4 * nWidth;
+			for (unsigned x = 1; x < lineSize; x++) {
+				line[x] = (BYTE)(line[x] + line[x - 1]);
+			}
+			// interleave the byte planes back into big endian samples
+			for (unsigned x = 0; x < nWidth; x++) {
+				dst[4 * x + 0] = line[x];
+				dst[4 * x + 1] = line[nWidth + x];
+				dst[4 * x + 2] = line[2 * nWidth + x];
+				dst[4 * x + 3] = line[3 * nWidth + x];
+			}
+			return dst;
+		}
+	}
+	return line;
+}
+
+void psdParser::ReadLayerChannel(FreeImageIO *io, fi_handle handle, const psdLayerChannel& channel, BYTE* dst_line_start, unsigned dstLineSize, unsigned nHeight, unsigned lineSize, unsigned dstBpp, unsigned bytes) {
+	if (channel._Length < 2) {
+		// no data
+		return;
+	}
+
+	if (!psdSeek(io, handle, channel._Offset)) {
+		throw "Error in layer channel data";
+	}
+
+	BYTE ShortValue[2];
+	if (io->read_proc(ShortValue, sizeof(ShortValue), 1, handle) != 1) {
+		throw "Error in layer channel data";
+	}
+	const WORD nCompression = (WORD)psdGetValue(ShortValue, sizeof(ShortValue));
+
+	// reject lengths that cannot be produced by any compression method
+	const unsigned nSizeLength = (_headerInfo._Version == 1) ? 2 : 4;
+	const UINT64 nDataSize = channel._Length - 2;
+	const UINT64 nMaxSize = (UINT64)nHeight * (lineSize + (lineSize + 126) / 127 + nSizeLength) + 65536;
+	if ((nDataSize > nMaxSize) || (nDataSize > UINT_MAX)) {
+		throw "Invalid layer channel length";
+	}
+
+	// the whole channel is read with a single I/O
+
+	BYTE* data = new (std::nothrow) BYTE[(size_t)nDataSize + 1];
+	BYTE* line_start = new (std::nothrow) BYTE[lineSize];
+	if (!data || !line_start) {
+		SAFE_DELETE_ARRAY(data);
+		SAFE_DELETE_ARRAY(line_start);
+		throw std::bad_alloc();
+	}
+	const size_t nBytesRead = psdReadBlock(io, handle, data, (size_t)nDataSize);
+	if (nBytesRead < nDataSize) {
+		// truncated file : missing data is decoded as zero
+		memset(data + nBytesRead, 0, (size_t)(nDataSize - nBytesRead));
+	}
+
+	switch (nCompression) {
+		case PSDP_COMPRESSION_NONE:
+		{
+			const BYTE* src = data;
+			for (unsigned h = 0; (h < nHeight) && (src + lineSize <= data + nDataSize); ++h, dst_line_start -= dstLineSize) {//<*** flipped
+				ReadImageLine(dst_line_start, src, lineSize, dstBpp, bytes);
+				src += lineSize;
+			}
+		}
+		break;
+
+		case PSDP_COMPRESSION_RLE:
+		{
+			// line size table followed by the packed lines
+			const UINT64 nTableSize = (UINT64)nHeight * nSizeLength;
+			DWORD *rleLineSizeList = new (std::nothrow) DWORD[nHeight];
+			if (!rleLineSizeList) {
+				SAFE_DELETE_ARRAY(data);
+				SAFE_DELETE_ARRAY(line_start);
+				throw std::bad_alloc();
+			}
+			if (nTableSize <= nDataSize) {
+				UINT64 nPackedSize = nTableSize;
+				for (unsigned h = 0; h < nHeight; ++h) {
+					const BYTE* p = data + h * nSizeLength;
+					DWORD nSize = (nSizeLength == 2) ? psdGetValue(p, 2) : psdGetValue(p, 4);
+					// clip the lines of a corrupted table to the channel data
+					nSize = (DWORD)MIN<UINT64>(nSize, nDataSize - nPackedSize);
+					rleLineSizeList[h] = nSize;
+					nPackedSize += nSize;
+				}
+				if (!UnpackRLEPlane(dst_line_start, dstLineSize, data + nTableSize, rleLineSizeList, nHeight, lineSize, dstBpp, bytes)) {
+					// cancelled (or out of memory)
+					SAFE_DELETE_ARRAY(data);
+					SAFE_DELETE_ARRAY(line_start);
+					SAFE_DELETE_ARRAY(rleLineSizeList);
+					throw (const char*)NULL;
+				}
+			}
+			SAFE_DELETE_ARRAY(rleLineSizeList);
+		}
+		break;
+
+		case PSDP_COMPRESSION_ZIP:
+		case PSDP_COMPRESSION_ZIP_PREDICTION:
+		{
+			const UINT64 nUncompressedSize = (UINT64)nHeight * lineSize;
+			BYTE *uncompressed = (nUncompressedSize <= UINT_MAX) ? new (std::nothrow) BYTE[(size_t)nUncompressedSize] : NULL;
+			if (!uncompressed) {
+				SAFE_DELETE_ARRAY(data);
+				SAFE_DELETE_ARRAY(line_start);
+				throw std::bad_alloc();
+			}
+			memset(uncompressed, 0, (size_t)nUncompressedSize);
+			FreeImage_ZLibUncompress(uncompressed, (DWORD)nUncompressedSize, data, (DWORD)nDataSize);
+
+			BYTE* src = uncompressed;
+			for (unsigned h = 0; h < nHeight; ++h, dst_line_start -= dstLineSize, src += lineSize) {//<*** flipped
+				const BYTE* line = src;
+				if (nCompression == PSDP_COMPRESSION_ZIP_PREDICTION) {
+					line = psdUndoPrediction(src, line_start, lineSize / bytes, bytes);
+				}
+				ReadImageLine(dst_line_start, line, lineSize, dstBpp, bytes);
+			}
+			SAFE_DELETE_ARRAY(uncompressed);
+		}
+		break;
+
+		default:
+			FreeImage_OutputMessageProc(_fi_format_id, "Unsupported layer compression %d", nCompression);
+			break;
+	}
+
+	SAFE_DELETE_ARRAY(data);
+	SAFE_DELETE_ARRAY(line_start);
+}
+
+/**
+Multiplies the alpha channel of a layer by a layer mask. 
+Pixels outside of the mask rectangle use the mask default color.
+@param bitmap RGBA layer
+@param nLeft Layer position
+@param nTop Layer position
+@param mask Decoded mask, or NULL when the mask rectangle is empty
+@param info Mask rectangle and default color
+*/
+template <class T> static void 
+psdApplyLayerMask(FIBITMAP *bitmap, int nLeft, int nTop, FIBITMAP *mask, const psdLayerMask& info, T maxValue, double rounding) {
+	const unsigned nWidth = FreeImage_GetWidth(bitmap);
+	const unsigned nHeight = FreeImage_GetHeight(bitmap);
+	const unsigned nMaskWidth = mask ? FreeImage_GetWidth(mask) : 0;
+	const unsigned nMaskHeight = mask ? FreeImage_GetHeight(mask) : 0;
+	const T defaultValue = info._DefaultColor ? maxValue : 0;
+
+	for (unsigned y = 0; y < nHeight; y++) {
+		// rows are stored bottom-up
+		const int nMaskRow = nTop + (int)(nHeight - 1 - y) - info._Top;
+		const T *mask_line = ((nMaskRow >= 0) && ((unsigned)nMaskRow < nMaskHeight)) ? (T*)FreeImage_GetScanLine(mask, nMaskHeight - 1 - nMaskRow) : NULL;
+
+		T *pixel = (T*)FreeImage_GetScanLine(bitmap, y);
+		for (unsigned x = 0; x < nWidth; x++, pixel += 4) {
+			const int nMaskColumn = nLeft + (int)x - info._Left;
+			const T value = (mask_line && (nMaskColumn >= 0) && ((unsigned)nMaskColumn < nMaskWidth)) ? mask_line[nMaskColumn] : defaultValue;
+			pixel[3] = (T)((double)pixel[3] * value / maxValue + rounding);
+		}
+	}
+}
+
+FIBITMAP* psdParser::ReadLayerData(FreeImageIO *io, fi_handle handle, const psdLayerRecord& layer) {
+	bool header_only = (_fi_flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
+	const int nLayerWidth = layer._Right - layer._Left;
+	const int nLayerHeight = layer._Bottom - layer._Top;
+	if ((nLayerWidth <= 0) || (nLayerHeight <= 0)) {
+		// e.g. group markers
+		throw "Empty layer";
+	}
+	if ((nLayerWidth > 300000) || (nLayerHeight > 300000)) {
+		throw "Invalid layer size";
+	}
+
+	const unsigned nWidth = (unsigned)nLayerWidth;
+	const unsigned nHeight = (unsigned)nLayerHeight;
+	const unsigned depth = _headerInfo._BitsPerChannel;
+	const unsigned bytes = depth / 8;
+
+	// color channels of the layer and transparency mask
+	unsigned nColorChannels = 0;
+	switch (_headerInfo._ColourMode) {
+		case PSDP_RGB:
+			nColorChannels = 3;
+			break;
+		case PSDP_GRAYSCALE:
+		case PSDP_DUOTONE:
+			nColorChannels = 1;
+			break;
+		default:
+			throw "Unsupported color mode for layers";
+	}
+	if ((depth != 8) && (depth != 16) && (depth != 32)) {
+		throw "Unsupported layer depth";
+	}
+
+	// user supplied layer masks are applied to the transparency of the layer, unless they are disabled
+	bool bHasTransparency = false;
+	bool bHasMask = false;
+	for (size_t c = 0; c < layer._Channels.size(); c++) {
+		const short nID = layer._Channels[c]._ID;
+		if (nID == -1) {
+			bHasTransparency = true;
+		} else if (((nID == -2) && layer._UserMask._bValid && !(layer._UserMask._Flags & 0x02)) || 
+			((nID == -3) && layer._RealUserMask._bValid && !(layer._RealUserMask._Flags & 0x02))) {
+			bHasMask = true;
+		}
+	}
+	const bool bHasAlpha = bHasTransparency || bHasMask;
+
+	// greyscale layers with a transparency mask are loaded as RGBA
+	const unsigned dstCh = bHasAlpha ? 4 : nColorChannels;
+
+	FIBITMAP* bitmap = NULL;
+	switch (depth) {
+		case 16:
+			bitmap = FreeImage_AllocateHeaderT(header_only, (dstCh == 1) ? FIT_UINT16 : ((dstCh == 3) ? FIT_RGB16 : FIT_RGBA16), nWidth, nHeight, depth*dstCh);
+			break;
+		case 32:
+			bitmap = FreeImage_AllocateHeaderT(header_only, (dstCh == 1) ? FIT_FLOAT : ((dstCh == 3) ? FIT_RGBF : FIT_RGBAF), nWidth, nHeight, depth*dstCh);
+			break;
+		default:
+			bitmap = FreeImage_AllocateHeader(header_only, nWidth, nHeight, depth*dstCh);
+			break;
+	}
+	if (!bitmap) {
+		throw FI_MSG_ERROR_DIB_MEMORY;
+	}
+
+	// layer properties
+	char buffer[32];
+	FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, bitmap, "LayerName", layer._Name.c_str());
+	sprintf(buffer, "%d", layer._Left);
+	FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, bitmap, "LayerLeft", buffer);
+	sprintf(buffer, "%d", layer._Top);
+	FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, bitmap, "LayerTop", buffer);
+	sprintf(buffer, "%d", (int)layer._Opacity);
+	FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, bitmap, "LayerOpacity", buffer);
+	FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, bitmap, "LayerBlendMode", layer._BlendMode);
+	// flags bit 1 is set for hidden layers
+	FreeImage_SetMetadataKeyValue(FIMD_CUSTOM, bitmap, "LayerVisible", (layer._Flags & 0x02) ? "0" : "1");
+
+	if (header_only) {
+		return bitmap;
+	}
+
+	// Load pixels data, only the channels of this layer are read
+
+	const unsigned lineSize = nWidth * bytes;
+	const unsigned dstBpp = FreeImage_GetBPP(bitmap) / 8;
+	const unsigned dstLineSize = FreeImage_GetPitch(bitmap);
+	BYTE* const dst_first_line = FreeImage_GetScanLine(bitmap, nHeight - 1);//<*** flipped
+
+	if (bHasAlpha && !bHasTransparency) {
+		// the layer is opaque, its masks give the transparency
+		for (unsigned y = 0; y < nHeight; y++) {
+			BYTE *pixel = FreeImage_GetScanLine(bitmap, y) + 3 * bytes;
+			for (unsigned x = 0; x < nWidth; x++, pixel += dstBpp) {
+				switch (depth) {
+					case 16:
+						*(WORD*)pixel = 0xFFFF;
+						break;
+					case 32:
+						*(float*)pixel = 1.0F;
+						break;
+					default:
+						*pixel = 0xFF;
+						break;
+				}
+			}
+		}
+	}
+
+	FIBITMAP* mask = NULL;
+	try {
+		// color channels and transparency first, masks are applied once the alpha channel is complete
+		for (size_t c = 0; c < layer._Channels.size(); c++) {
+			const psdLayerChannel& channel = layer._Channels[c];
+
+			unsigned channelOffset = 0;
+			if (channel._ID == -1) {
+				channelOffset = 3 * bytes;
+			} else if ((channel._ID >= 0) && ((unsigned)channel._ID < nColorChannels)) {
+				channelOffset = GetChannelOffset(bitmap, channel._ID) * bytes;
+			} else {
+				continue;
+			}
+
+			ReadLayerChannel(io, handle, channel, dst_first_line + channelOffset, dstLineSize, nHeight, lineSize, dstBpp, bytes);
+		}
+
+		for (size_t c = 0; bHasMask && (c < layer._Channels.size()); c++) {
+			const psdLayerChannel& channel = layer._Channels[c];
+			const psdLayerMask& info = (channel._ID == -2) ? layer._UserMask : layer._RealUserMask;
+			if (((channel._ID != -2) && (channel._ID != -3)) || !info._bValid || (info._Flags & 0x02)) {
+				continue;
+			}
+
+			const int nMaskWidth = info._Right - info._Left;
+			const int nMaskHeight = info._Bottom - info._Top;
+			if ((nMaskWidth > 300000) || (nMaskHeight > 300000)) {
+				throw "Invalid layer mask size";
+			}
+			if ((nMaskWidth > 0) && (nMaskHeight > 0)) {
+				// the mask has its own rectangle : it is decoded on its own, then applied
+				const FREE_IMAGE_TYPE mask_type = (depth == 16) ? FIT_UINT16 : ((depth == 32) ? FIT_FLOAT : FIT_BITMAP);
+				mask = FreeImage_AllocateT(mask_type, nMaskWidth, nMaskHeight, depth);
+				if (!mask) {
+					throw FI_MSG_ERROR_DIB_MEMORY;
+				}
+				ReadLayerChannel(io, handle, channel, FreeImage_GetScanLine(mask, nMaskHeight - 1), FreeImage_GetPitch(mask), nMaskHeight, nMaskWidth * bytes, bytes, bytes);
+			}
+
+			switch (depth) {
+				case 16:
+					psdApplyLayerMask<WORD>(bitmap, layer._Left, layer._Top, mask, info, 0xFFFF, 0.5);
+					break;
+				case 32:
+					psdApplyLayerMask<float>(bitmap, layer._Left, layer._Top, mask, info, 1.0F, 0);
+					break;
+				default:
+					psdApplyLayerMask<BYTE>(bitmap, layer._Left, layer._Top, mask, info, 0xFF, 0.5);
+					break;
+			}
+			FreeImage_Unload(mask);
+			mask = NULL;
+		}
+	} catch(...) {
+		FreeImage_Unload(mask);
+		FreeImage_Unload(bitmap);
+		throw;
+	}
+
+	if ((nColorChannels == 1) && bHasAlpha) {
+		// copy the grey channel to the green and blue channels
+		for (unsigned y = 0; y < nHeight; y++) {
+			BYTE *pixel = FreeImage_GetScanLine(bitmap, y);
+			for (unsigned x = 0; x < nWidth; x++, pixel += dstBpp) {
+				memcpy(pixel + bytes, pixel, bytes);
+				memcpy(pixel + 2 * bytes, pixel, bytes);
+			}
+		}
+	}
+
+	return bitmap;
+}
+
 bool psdParser::WriteLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle)	{
 	// Short section with no layers.
 	BYTE IntValue[4];
@@ -1743,35 +2547,55 @@ void psdParser::WriteImageLine(BYTE* dst, const BYTE* src, unsigned lineSize, un
 	}
 }
 
-unsigned psdParser::PackRLE(BYTE* line_start, const BYTE* src_line, unsigned srcSize) {
-	BYTE* line = line_start;
-	while (srcSize > 0) {
-		if(srcSize >= 2 && src_line[0] == src_line[1]) {
-			int len = 2;
-			while(len < 127 && len < (int)srcSize && src_line[0] == src_line[len])
-				len++;
-			*line++ = (BYTE)((-len + 1) & 0xFF);
-			*line++ = src_line[0];
-			src_line += len;
-			srcSize -= len;
-		} else {
-			// uncompressed packet
-			// (len + 1) bytes of data are copied
-			int len = 1;
-			while(len < 127 && len < (int)srcSize &&
-				  (len+2 >= (int)srcSize || // check to switch to a run instead
-				   src_line[len] != src_line[len+1] ||
-				   src_line[len] != src_line[len+2]))
-				len++;
-			*line++ = (BYTE)(len - 1);
-			for(int i=0; i < len; i++) {
-				*line++ = *src_line;
-				src_line++;
-			}
-			srcSize -= len;
+void psdParser::PackRLEBand(void *data, unsigned first, unsigned last) {
+	PSDRLEROWS* rows = (PSDRLEROWS*)data;
+	const unsigned lineSize = rows->planeLineSize;
+
+	BYTE* line_start = new (std::nothrow) BYTE[lineSize]; //< fileline cache
+	if (!line_start) {
+		rows->failed = true;
+		return;
+	}
+
+	const BYTE* src_line_start = rows->line_start - (size_t)first * rows->lineSize;//<*** flipped
+	for (unsigned h = first; h < last; ++h, src_line_start -= rows->lineSize) {
+		BYTE* slot = rows->plane + h * rows->maxPackedSize;
+		WriteImageLine(line_start, src_line_start, lineSize, rows->bpp, rows->bytes);
+		rows->rleLineSizeList[h] = PackBits_Encode(slot, line_start, lineSize);
+	}
+
+	SAFE_DELETE_ARRAY(line_start);
+}
+
+bool psdParser::PackRLEPlane(BYTE* plane, size_t& planeSize, DWORD* rleLineSizeList, const BYTE* src_line_start, unsigned srcLineSize, unsigned nHeight, unsigned lineSize, unsigned srcBpp, unsigned bytes) {
+	// each row is packed into its own slot so that rows do not depend on each other : 
+	// bands of rows are packed on the worker pool, the slots are then compacted in file order
+
+	PSDRLEROWS rows;
+	rows.line_start = (BYTE*)src_line_start;
+	rows.lineSize = srcLineSize;
+	rows.plane = plane;
+	rows.rleLineSizeList = rleLineSizeList;
+	rows.rowOffset = NULL;
+	rows.maxPackedSize = PACKBITS_MAX_ENCODED_SIZE(lineSize);
+	rows.planeLineSize = lineSize;
+	rows.bpp = srcBpp;
+	rows.bytes = bytes;
+	rows.failed = false;
+
+	if (!FreeImage_ParallelFor(nHeight, FreeImage_GetRowChunk(lineSize), PackRLEBand, &rows) || rows.failed) {
+		return false;
+	}
+
+	planeSize = 0;
+	for(unsigned h = 0; h < nHeight; ++h) {
+		if(planeSize != h * rows.maxPackedSize) {
+			memmove(plane + planeSize, plane + h * rows.maxPackedSize, rleLineSizeList[h]);
 		}
+		planeSize += rleLineSizeList[h];
 	}
-	return (unsigned)(line - line_start);
+
+	return true;
 }
 
 bool psdParser::WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib) {
@@ -1853,10 +2677,12 @@ bool psdParser::WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib)
 
 			// later use this array as WORD rleLineSizeList[nChannels][nHeight];
 			// Every 127 bytes needs a length byte.
-			BYTE* rle_line_start = new BYTE[lineSize + ((nWidth + 126) / 127)]; //< RLE buffer
+			BYTE* plane = new (std::nothrow) BYTE[(size_t)nHeight * PACKBITS_MAX_ENCODED_SIZE(lineSize)]; //< RLE channel plane
 			DWORD *rleLineSizeList = new (std::nothrow) DWORD[nChannels*nHeight];
 
-			if(!rleLineSizeList) {
+			if(!plane || !rleLineSizeList) {
+				SAFE_DELETE_ARRAY(plane);
+				SAFE_DELETE_ARRAY(rleLineSizeList);
 				SAFE_DELETE_ARRAY(line_start);
 				throw std::bad_alloc();
 			}
@@ -1874,17 +2700,16 @@ bool psdParser::WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib)
 			for(unsigned c = 0; c < nChannels; c++) {
 				const unsigned channelOffset = GetChannelOffset(dib, c) * bytes;
 
-				BYTE* src_line_start = src_first_line + channelOffset;
-				for(unsigned h = 0; h < nHeight; ++h, src_line_start -= srcLineSize) {//<*** flipped
-					WriteImageLine(line_start, src_line_start, lineSize, srcBpp, bytes);
-					unsigned len = PackRLE(rle_line_start, line_start, lineSize);
-					rleLineSizeList[c * nHeight + h] = len;
-					if(io->write_proc(rle_line_start, len, 1, handle) != 1) {
-						return false;
-					}
+				size_t planeSize = 0;
+				if(!PackRLEPlane(plane, planeSize, rleLineSizeList + c * nHeight, src_first_line + channelOffset, srcLineSize, nHeight, lineSize, srcBpp, bytes)
+					|| !psdWriteBlock(io, handle, plane, planeSize)) {
+					SAFE_DELETE_ARRAY(plane);
+					SAFE_DELETE_ARRAY(rleLineSizeList);
+					SAFE_DELETE_ARRAY(line_start);
+					return false;
 				}
 			}
-			SAFE_DELETE_ARRAY(rle_line_start);
+			SAFE_DELETE_ARRAY(plane);
 			// Fix length of resource
 			io->seek_proc(handle, offsets_pos, SEEK_SET);
 			if(_headerInfo._Version == 1) {
@@ -1936,6 +2761,28 @@ bool psdParser::WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib)
 	return true;
 }
 
+void psdParser::SetResolutionAndProfile(FIBITMAP *bitmap) {
+	// set resolution info
+	unsigned res_x = 2835;	// 72 dpi
+	unsigned res_y = 2835;	// 72 dpi
+	if (_bResolutionInfoFilled) {
+		_resolutionInfo.GetResolutionInfo(res_x, res_y);
+	}
+	FreeImage_SetDotsPerMeterX(bitmap, res_x);
+	FreeImage_SetDotsPerMeterY(bitmap, res_y);
+
+	// set ICC profile
+	if(NULL != _iccProfile._ProfileData) {
+		FreeImage_CreateICCProfile(bitmap, _iccProfile._ProfileData, _iccProfile._ProfileSize);
+		if ((_fi_flags & PSD_CMYK) == PSD_CMYK) {
+			short mode = _headerInfo._ColourMode;
+			if((mode == PSDP_CMYK) || (mode == PSDP_MULTICHANNEL)) {
+				FreeImage_GetICCProfile(bitmap)->flags |= FIICC_COLOR_IS_CMYK;
+			}
+		}
+	}
+}
+
 FIBITMAP* psdParser::Load(FreeImageIO *io, fi_handle handle, int s_format_id, int flags) {
 	FIBITMAP *Bitmap = NULL;
 
@@ -1968,31 +2815,14 @@ FIBITMAP* psdParser::Load(FreeImageIO *io, fi_handle handle, int s_format_id, in
 			throw("Error in Image Data");
 		}
 
-		// set resolution info
-		if(NULL != Bitmap) {
-			unsigned res_x = 2835;	// 72 dpi
-			unsigned res_y = 2835;	// 72 dpi
-			if (_bResolutionInfoFilled) {
-				_resolutionInfo.GetResolutionInfo(res_x, res_y);
-			}
-			FreeImage_SetDotsPerMeterX(Bitmap, res_x);
-			FreeImage_SetDotsPerMeterY(Bitmap, res_y);
-		}
-
-		// set ICC profile
-		if(NULL != _iccProfile._ProfileData) {
-			FreeImage_CreateICCProfile(Bitmap, _iccProfile._ProfileData, _iccProfile._ProfileSize);
-			if ((flags & PSD_CMYK) == PSD_CMYK) {
-				short mode = _headerInfo._ColourMode;
-				if((mode == PSDP_CMYK) || (mode == PSDP_MULTICHANNEL)) {
-					FreeImage_GetICCProfile(Bitmap)->flags |= FIICC_COLOR_IS_CMYK;
-				}
-			}
-		}
+		// set resolution info and ICC profile
+		SetResolutionAndProfile(Bitmap);
 
 		// Metadata
 		if(NULL != _iptc._Data) {
-			read_iptc_profile(Bitmap, _iptc._Data, _iptc._Size);
+			if(!(_fi_flags & FIF_LOAD_RAWMETADATA) || !read_iptc_profile_raw(Bitmap, _iptc._Data, _iptc._Size)) {
+				read_iptc_profile(Bitmap, _iptc._Data, _iptc._Size);
+			}
 		}
 		if(NULL != _exif1._Data) {
 			psd_read_exif_profile(Bitmap, _exif1._Data, _exif1._Size);
@@ -2010,8 +2840,99 @@ FIBITMAP* psdParser::Load(FreeImageIO *io, fi_handle handle, int s_format_id, in
 			psd_set_xmp_profile(Bitmap, _xmp._Data, _xmp._Size);
 		}
 
+	} catch(const char *text) {
+		// no message when the load was cancelled
+		if(text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+	}
+	catch(const std::exception& e) {
+		FreeImage_OutputMessageProc(s_format_id, "%s", e.what());
+	}
+
+	return Bitmap;
+}
+
+void psdParser::IndexLayers(FreeImageIO *io, fi_handle handle) {
+	if (_bLayersIndexed) {
+		return;
+	}
+
+	if (!_headerInfo.Read(io, handle)) {
+		throw("Error in header");
+	}
+
+	if (!_colourModeData.Read(io, handle) || (_colourModeData._Length < 0)) {
+		throw("Error in ColourMode Data");
+	}
+
+	// image resources are kept for the resolution and the ICC profile of the layers
+	BYTE Length[4];
+	if (io->read_proc(Length, sizeof(Length), 1, handle) != 1) {
+		throw("Error in Image Resource");
+	}
+	const DWORD nResourcesLength = psdGetValue(Length, sizeof(Length));
+	if ((nResourcesLength > 0x7FFFFFFF) || ((nResourcesLength > 0) && !ReadImageResources(io, handle, (LONG)nResourcesLength))) {
+		throw("Error in Image Resource");
+	}
+
+	// the section follows the header and the color mode data and image resources sections, each preceded by its length
+	const UINT64 nPosition = 26 + 4 + (UINT64)_colourModeData._Length + 4 + nResourcesLength;
+	if (!psdSeek(io, handle, nPosition) || !ReadLayerAndMaskInfoSection(io, handle, nPosition)) {
+		throw("Error in Layer Info");
+	}
+
+	_bLayersIndexed = true;
+}
+
+int psdParser::GetLayerCount(FreeImageIO *io, fi_handle handle, int s_format_id) {
+	_fi_format_id = s_format_id;
+
+	try {
+		if (NULL == handle) {
+			return 0;
+		}
+		IndexLayers(io, handle);
 	} catch(const char *text) {
 		FreeImage_OutputMessageProc(s_format_id, text);
+		return 0;
+	}
+	catch(const std::exception& e) {
+		FreeImage_OutputMessageProc(s_format_id, "%s", e.what());
+		return 0;
+	}
+
+	return (int)_layers.size();
+}
+
+FIBITMAP* psdParser::LoadLayer(FreeImageIO *io, fi_handle handle, int s_format_id, int layer, int flags) {
+	FIBITMAP *Bitmap = NULL;
+
+	_fi_flags = flags;
+	_fi_format_id = s_format_id;
+
+	try {
+		if (NULL == handle) {
+			throw("Cannot open file");
+		}
+
+		// the layer index is built by the first page request, then reused
+		IndexLayers(io, handle);
+
+		if ((layer < 0) || (layer >= (int)_layers.size())) {
+			throw("Invalid layer index");
+		}
+
+		Bitmap = ReadLayerData(io, handle, _layers[layer]);
+
+		// set resolution info and ICC profile
+		SetResolutionAndProfile(Bitmap);
+
+	} catch(const char *text) {
+		// no message when the load was cancelled
+		if(text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
 	}
 	catch(const std::exception& e) {
 		FreeImage_OutputMessageProc(s_format_id, "%s", e.what());
@@ -282,6 +282,58 @@ public:
 	bool Write(FreeImageIO *io, fi_handle handle, int ID);
 };
 
+/**
+Channel information of a layer record
+*/
+typedef struct psdLayerChannel {
+	short  _ID;			//! Channel ID : 0 = red, 1 = green, etc; -1 = transparency mask; -2 = user supplied layer mask; -3 = real user supplied layer mask
+	UINT64 _Length;		//! Length of the channel data, including the 2 bytes of the compression method
+	UINT64 _Offset;		//! Position of the channel data in the stream
+} psdLayerChannel;
+
+/**
+Layer mask data of a layer record (user supplied layer mask or real user supplied layer mask)
+*/
+typedef struct psdLayerMask {
+	bool _bValid;		//! true if the layer record describes this mask
+	int _Top;			//! Rectangle enclosing the mask, in document coordinates
+	int _Left;
+	int _Bottom;
+	int _Right;
+	BYTE _DefaultColor;	//! 0 or 255, value of the mask outside of its rectangle
+	BYTE _Flags;		//! bit 1 = mask disabled
+} psdLayerMask;
+
+/**
+Table 11: Layer records. 
+Only the properties needed to decode a layer are kept, the channel data 
+are located when the layer index is built and read on demand. 
+*/
+class psdLayerRecord {
+public:
+	int _Top;				//! Rectangle containing the contents of the layer
+	int _Left;
+	int _Bottom;
+	int _Right;
+	BYTE _Opacity;			//! 0 = transparent ... 255 = opaque
+	BYTE _Flags;			//! bit 1 = visible
+	char _BlendMode[5];		//! Blend mode key
+	std::string _Name;		//! Pascal layer name
+	std::vector<psdLayerChannel> _Channels;
+	psdLayerMask _UserMask;		//! mask of channel -2
+	psdLayerMask _RealUserMask;	//! mask of channel -3
+
+public:
+	psdLayerRecord();
+	~psdLayerRecord();
+	/**
+	Read a layer record (channel offsets are left to the caller)
+	@param nSize Receives the size of the record in the stream
+	@return Returns true if successful, false otherwise
+	*/
+	bool Read(FreeImageIO *io, fi_handle handle, const psdHeaderInfo& header, UINT64& nSize);
+};
+
 /**
 PSD loader
 */
@@ -298,6 +350,8 @@ private:
 	psdData					_exif1;
 	psdData					_exif3;
 	psdData					_xmp;
+	std::vector<psdLayerRecord>	_layers;
+	bool _bLayersIndexed;
 
 	short _ColourCount;
 	short _TransparentIndex;
@@ -313,20 +367,40 @@ private:
 	
 private:
 	unsigned GetChannelOffset(FIBITMAP* bitmap, unsigned c) const;
-	/**	Actually ignore it */
-	bool ReadLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle);
-	void ReadImageLine(BYTE* dst, const BYTE* src, unsigned lineSize, unsigned dstBpp, unsigned bytes);
-	void UnpackRLE(BYTE* dst, const BYTE* src, BYTE* dst_end, unsigned srcSize);
+	/**	Skips the section, or builds the layer index when the stream position nPosition of the section is given. 
+	Positions are tracked from the section sizes, as tell_proc cannot report PSB positions over 2 GB */
+	bool ReadLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle, UINT64 nPosition = 0);
+	/**	Reads the layer records of a layer info block starting at nStart and locates their channel data */
+	bool ReadLayerInfo(FreeImageIO *io, fi_handle handle, UINT64 nStart, UINT64 length);
+	/**	Reads the header, the resources and the layer index once, they are kept for the next layers */
+	void IndexLayers(FreeImageIO *io, fi_handle handle);
+	FIBITMAP* ReadLayerData(FreeImageIO *io, fi_handle handle, const psdLayerRecord& layer);
+	void ReadLayerChannel(FreeImageIO *io, fi_handle handle, const psdLayerChannel& channel, BYTE* dst_line_start, unsigned dstLineSize, unsigned nHeight, unsigned lineSize, unsigned dstBpp, unsigned bytes);
+	void SetResolutionAndProfile(FIBITMAP *bitmap);
+	static void ReadImageLine(BYTE* dst, const BYTE* src, unsigned lineSize, unsigned dstBpp, unsigned bytes);
+	/** Unpacks a band of rows of a channel plane (parallel loop body) */
+	static void UnpackRLEBand(void *data, unsigned first, unsigned last);
+	/** Unpacks the rows of a channel plane, whose packed sizes are given by rleLineSizeList, on the worker pool. 
+	Returns false if the load was cancelled or memory is missing */
+	static bool UnpackRLEPlane(BYTE* dst_line_start, unsigned dstLineSize, const BYTE* plane, const DWORD* rleLineSizeList, unsigned nHeight, unsigned lineSize, unsigned dstBpp, unsigned bytes);
 	FIBITMAP* ReadImageData(FreeImageIO *io, fi_handle handle);
 	bool WriteLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle);
-	void WriteImageLine(BYTE* dst, const BYTE* src, unsigned lineSize, unsigned srcBpp, unsigned bytes);
-	unsigned PackRLE(BYTE* line_start, const BYTE* src_line, unsigned srcSize);
+	static void WriteImageLine(BYTE* dst, const BYTE* src, unsigned lineSize, unsigned srcBpp, unsigned bytes);
+	/** Packs a band of rows of a channel plane into their slots (parallel loop body) */
+	static void PackRLEBand(void *data, unsigned first, unsigned last);
+	/**	Packs the rows of a channel plane on the worker pool, fills rleLineSizeList and planeSize. 
+	Returns false if the save was cancelled or memory is missing */
+	static bool PackRLEPlane(BYTE* plane, size_t& planeSize, DWORD* rleLineSizeList, const BYTE* src_line_start, unsigned srcLineSize, unsigned nHeight, unsigned lineSize, unsigned srcBpp, unsigned bytes);
 	bool WriteImageData(FreeImageIO *io, fi_handle handle, FIBITMAP* dib);
 
 public:
 	psdParser();
 	~psdParser();
 	FIBITMAP* Load(FreeImageIO *io, fi_handle handle, int s_format_id, int flags=0);
+	/** Returns the number of layers, reading only the layer records */
+	int GetLayerCount(FreeImageIO *io, fi_handle handle, int s_format_id);
+	/** Loads a single layer (0-based index), decoding only its channels */
+	FIBITMAP* LoadLayer(FreeImageIO *io, fi_handle handle, int s_format_id, int layer, int flags=0);
 	bool Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data);
 	/** Also used by the TIFF plugin */
 	bool ReadImageResources(FreeImageIO *io, fi_handle handle, LONG length=0);
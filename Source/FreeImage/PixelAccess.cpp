@@ -25,6 +25,11 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FI_PIXEL_SSE2
+#endif
+
 // ----------------------------------------------------------
 
 BYTE * DLL_CALLCONV
@@ -195,3 +200,773 @@ FreeImage_SetPixelColor(FIBITMAP *dib, unsigned x, unsigned y, RGBQUAD *value) {
 	return FALSE;
 }
 
+
+// ----------------------------------------------------------
+//   Bulk rectangle access
+// ----------------------------------------------------------
+
+/**
+Get the size in bytes of a pixel (or of a plane sample for planar layouts)
+@param layout Caller buffer layout
+@param planar Returns TRUE if the layout is planar
+@return Returns the pixel size in bytes, 0 if the layout is unknown
+*/
+static unsigned
+GetLayoutPixelSize(FREE_IMAGE_PIXEL_LAYOUT layout, BOOL *planar) {
+	*planar = FALSE;
+	switch(layout) {
+		case FIPL_BGRA8:
+		case FIPL_RGBA8:
+			return 4;
+		case FIPL_RGB8:
+			return 3;
+		case FIPL_RGB16:
+			return 6;
+		case FIPL_RGBA16:
+			return 8;
+		case FIPL_RGBAF:
+			return 16;
+		case FIPL_RGBA8_PLANAR:
+			*planar = TRUE;
+			return 1;
+		case FIPL_RGBAF_PLANAR:
+			*planar = TRUE;
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+/**
+Check the parameters of FreeImage_ReadRect / FreeImage_WriteRect
+*/
+static BOOL
+CheckRectParameters(FIBITMAP *dib, int left, int top, int width, int height, const void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout) {
+	if(!FreeImage_HasPixels(dib) || !buffer) {
+		return FALSE;
+	}
+	BOOL planar = FALSE;
+	const unsigned pixel_size = GetLayoutPixelSize(layout, &planar);
+	if(pixel_size == 0) {
+		return FALSE;
+	}
+	if((left < 0) || (top < 0) || (width <= 0) || (height <= 0)) {
+		return FALSE;
+	}
+	// (left + width may overflow, compare with the room left after left instead)
+	const unsigned dib_width = FreeImage_GetWidth(dib);
+	const unsigned dib_height = FreeImage_GetHeight(dib);
+	if(((unsigned)left > dib_width) || ((unsigned)width > dib_width - (unsigned)left)) {
+		return FALSE;
+	}
+	if(((unsigned)top > dib_height) || ((unsigned)height > dib_height - (unsigned)top)) {
+		return FALSE;
+	}
+	if((unsigned)width > pitch / pixel_size) {
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+Get a pointer to row y (top-down) of plane 'channel' inside a caller buffer.
+For interleaved layouts, channel is ignored.
+*/
+static inline BYTE*
+GetLayoutRow(BYTE *buffer, unsigned pitch, int height, int y, BOOL planar, unsigned channel) {
+	if(planar) {
+		buffer += (size_t)channel * pitch * height;
+	}
+	return buffer + (size_t)y * pitch;
+}
+
+/**
+Pack a BGRA8 pivot line into a 8-bit caller layout
+@return Returns FALSE if the layout is not a 8-bit layout
+*/
+static BOOL
+PackLineBGRA8(BYTE *buffer, unsigned pitch, int height, int y, FREE_IMAGE_PIXEL_LAYOUT layout, const BYTE *src, int width) {
+	switch(layout) {
+		case FIPL_BGRA8:
+		{
+			BYTE *dst = GetLayoutRow(buffer, pitch, height, y, FALSE, 0);
+			for(int x = 0; x < width; x++) {
+				dst[0] = src[FI_RGBA_BLUE];
+				dst[1] = src[FI_RGBA_GREEN];
+				dst[2] = src[FI_RGBA_RED];
+				dst[3] = src[FI_RGBA_ALPHA];
+				src += 4;
+				dst += 4;
+			}
+		}
+		return TRUE;
+
+		case FIPL_RGBA8:
+		{
+			BYTE *dst = GetLayoutRow(buffer, pitch, height, y, FALSE, 0);
+			for(int x = 0; x < width; x++) {
+				dst[0] = src[FI_RGBA_RED];
+				dst[1] = src[FI_RGBA_GREEN];
+				dst[2] = src[FI_RGBA_BLUE];
+				dst[3] = src[FI_RGBA_ALPHA];
+				src += 4;
+				dst += 4;
+			}
+		}
+		return TRUE;
+
+		case FIPL_RGB8:
+		{
+			BYTE *dst = GetLayoutRow(buffer, pitch, height, y, FALSE, 0);
+			for(int x = 0; x < width; x++) {
+				dst[0] = src[FI_RGBA_RED];
+				dst[1] = src[FI_RGBA_GREEN];
+				dst[2] = src[FI_RGBA_BLUE];
+				src += 4;
+				dst += 3;
+			}
+		}
+		return TRUE;
+
+		case FIPL_RGBA8_PLANAR:
+		{
+			BYTE *r = GetLayoutRow(buffer, pitch, height, y, TRUE, 0);
+			BYTE *g = GetLayoutRow(buffer, pitch, height, y, TRUE, 1);
+			BYTE *b = GetLayoutRow(buffer, pitch, height, y, TRUE, 2);
+			BYTE *a = GetLayoutRow(buffer, pitch, height, y, TRUE, 3);
+			for(int x = 0; x < width; x++) {
+				r[x] = src[FI_RGBA_RED];
+				g[x] = src[FI_RGBA_GREEN];
+				b[x] = src[FI_RGBA_BLUE];
+				a[x] = src[FI_RGBA_ALPHA];
+				src += 4;
+			}
+		}
+		return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/**
+Unpack a 8-bit caller layout into a BGRA8 pivot line
+@return Returns FALSE if the layout is not a 8-bit layout
+*/
+static BOOL
+UnpackLineBGRA8(BYTE *dst, const BYTE *buffer, unsigned pitch, int height, int y, FREE_IMAGE_PIXEL_LAYOUT layout, int width) {
+	switch(layout) {
+		case FIPL_BGRA8:
+		{
+			const BYTE *src = GetLayoutRow((BYTE*)buffer, pitch, height, y, FALSE, 0);
+			for(int x = 0; x < width; x++) {
+				dst[FI_RGBA_BLUE]  = src[0];
+				dst[FI_RGBA_GREEN] = src[1];
+				dst[FI_RGBA_RED]   = src[2];
+				dst[FI_RGBA_ALPHA] = src[3];
+				src += 4;
+				dst += 4;
+			}
+		}
+		return TRUE;
+
+		case FIPL_RGBA8:
+		{
+			const BYTE *src = GetLayoutRow((BYTE*)buffer, pitch, height, y, FALSE, 0);
+			for(int x = 0; x < width; x++) {
+				dst[FI_RGBA_RED]   = src[0];
+				dst[FI_RGBA_GREEN] = src[1];
+				dst[FI_RGBA_BLUE]  = src[2];
+				dst[FI_RGBA_ALPHA] = src[3];
+				src += 4;
+				dst += 4;
+			}
+		}
+		return TRUE;
+
+		case FIPL_RGB8:
+		{
+			const BYTE *src = GetLayoutRow((BYTE*)buffer, pitch, height, y, FALSE, 0);
+			for(int x = 0; x < width; x++) {
+				dst[FI_RGBA_RED]   = src[0];
+				dst[FI_RGBA_GREEN] = src[1];
+				dst[FI_RGBA_BLUE]  = src[2];
+				dst[FI_RGBA_ALPHA] = 0xFF;
+				src += 3;
+				dst += 4;
+			}
+		}
+		return TRUE;
+
+		case FIPL_RGBA8_PLANAR:
+		{
+			const BYTE *r = GetLayoutRow((BYTE*)buffer, pitch, height, y, TRUE, 0);
+			const BYTE *g = GetLayoutRow((BYTE*)buffer, pitch, height, y, TRUE, 1);
+			const BYTE *b = GetLayoutRow((BYTE*)buffer, pitch, height, y, TRUE, 2);
+			const BYTE *a = GetLayoutRow((BYTE*)buffer, pitch, height, y, TRUE, 3);
+			for(int x = 0; x < width; x++) {
+				dst[FI_RGBA_RED]   = r[x];
+				dst[FI_RGBA_GREEN] = g[x];
+				dst[FI_RGBA_BLUE]  = b[x];
+				dst[FI_RGBA_ALPHA] = a[x];
+				dst += 4;
+			}
+		}
+		return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+static inline BYTE
+FloatToByte(float value) {
+	return (BYTE)(CLAMP(value, 0.0F, 1.0F) * 255.0F + 0.5F);
+}
+
+static inline WORD
+FloatToWord(float value) {
+	return (WORD)(CLAMP(value, 0.0F, 1.0F) * 65535.0F + 0.5F);
+}
+
+/**
+Pack a RGBAF pivot line into any caller layout
+*/
+static void
+PackLineRGBAF(BYTE *buffer, unsigned pitch, int height, int y, FREE_IMAGE_PIXEL_LAYOUT layout, const float *src, int width) {
+	switch(layout) {
+		case FIPL_BGRA8:
+		case FIPL_RGBA8:
+		case FIPL_RGB8:
+		{
+			BYTE *dst = GetLayoutRow(buffer, pitch, height, y, FALSE, 0);
+			const unsigned bytespp = (layout == FIPL_RGB8) ? 3 : 4;
+			const unsigned r = (layout == FIPL_BGRA8) ? 2 : 0;
+			const unsigned b = (layout == FIPL_BGRA8) ? 0 : 2;
+			for(int x = 0; x < width; x++) {
+				dst[r] = FloatToByte(src[0]);
+				dst[1] = FloatToByte(src[1]);
+				dst[b] = FloatToByte(src[2]);
+				if(bytespp == 4) {
+					dst[3] = FloatToByte(src[3]);
+				}
+				src += 4;
+				dst += bytespp;
+			}
+		}
+		break;
+
+		case FIPL_RGB16:
+		case FIPL_RGBA16:
+		{
+			WORD *dst = (WORD*)GetLayoutRow(buffer, pitch, height, y, FALSE, 0);
+			const unsigned channels = (layout == FIPL_RGB16) ? 3 : 4;
+			for(int x = 0; x < width; x++) {
+				for(unsigned c = 0; c < channels; c++) {
+					dst[c] = FloatToWord(src[c]);
+				}
+				src += 4;
+				dst += channels;
+			}
+		}
+		break;
+
+		case FIPL_RGBAF:
+			memcpy(GetLayoutRow(buffer, pitch, height, y, FALSE, 0), src, width * 4 * sizeof(float));
+			break;
+
+		case FIPL_RGBA8_PLANAR:
+		{
+			for(unsigned c = 0; c < 4; c++) {
+				BYTE *dst = GetLayoutRow(buffer, pitch, height, y, TRUE, c);
+				for(int x = 0; x < width; x++) {
+					dst[x] = FloatToByte(src[4 * x + c]);
+				}
+			}
+		}
+		break;
+
+		case FIPL_RGBAF_PLANAR:
+		{
+			for(unsigned c = 0; c < 4; c++) {
+				float *dst = (float*)GetLayoutRow(buffer, pitch, height, y, TRUE, c);
+				for(int x = 0; x < width; x++) {
+					dst[x] = src[4 * x + c];
+				}
+			}
+		}
+		break;
+	}
+}
+
+/**
+Unpack any caller layout into a RGBAF pivot line
+*/
+static void
+UnpackLineRGBAF(float *dst, const BYTE *buffer, unsigned pitch, int height, int y, FREE_IMAGE_PIXEL_LAYOUT layout, int width) {
+	switch(layout) {
+		case FIPL_BGRA8:
+		case FIPL_RGBA8:
+		case FIPL_RGB8:
+		{
+			const BYTE *src = GetLayoutRow((BYTE*)buffer, pitch, height, y, FALSE, 0);
+			const unsigned bytespp = (layout == FIPL_RGB8) ? 3 : 4;
+			const unsigned r = (layout == FIPL_BGRA8) ? 2 : 0;
+			const unsigned b = (layout == FIPL_BGRA8) ? 0 : 2;
+			for(int x = 0; x < width; x++) {
+				dst[0] = src[r] / 255.0F;
+				dst[1] = src[1] / 255.0F;
+				dst[2] = src[b] / 255.0F;
+				dst[3] = (bytespp == 4) ? src[3] / 255.0F : 1.0F;
+				src += bytespp;
+				dst += 4;
+			}
+		}
+		break;
+
+		case FIPL_RGB16:
+		case FIPL_RGBA16:
+		{
+			const WORD *src = (const WORD*)GetLayoutRow((BYTE*)buffer, pitch, height, y, FALSE, 0);
+			const unsigned channels = (layout == FIPL_RGB16) ? 3 : 4;
+			for(int x = 0; x < width; x++) {
+				dst[0] = src[0] / 65535.0F;
+				dst[1] = src[1] / 65535.0F;
+				dst[2] = src[2] / 65535.0F;
+				dst[3] = (channels == 4) ? src[3] / 65535.0F : 1.0F;
+				src += channels;
+				dst += 4;
+			}
+		}
+		break;
+
+		case FIPL_RGBAF:
+			memcpy(dst, GetLayoutRow((BYTE*)buffer, pitch, height, y, FALSE, 0), width * 4 * sizeof(float));
+			break;
+
+		case FIPL_RGBA8_PLANAR:
+		{
+			for(unsigned c = 0; c < 4; c++) {
+				const BYTE *src = GetLayoutRow((BYTE*)buffer, pitch, height, y, TRUE, c);
+				for(int x = 0; x < width; x++) {
+					dst[4 * x + c] = src[x] / 255.0F;
+				}
+			}
+		}
+		break;
+
+		case FIPL_RGBAF_PLANAR:
+		{
+			for(unsigned c = 0; c < 4; c++) {
+				const float *src = (const float*)GetLayoutRow((BYTE*)buffer, pitch, height, y, TRUE, c);
+				for(int x = 0; x < width; x++) {
+					dst[4 * x + c] = src[x];
+				}
+			}
+		}
+		break;
+	}
+}
+
+/**
+Read pixels [left, left + width[ of a FIT_BITMAP scanline into a BGRA8 pivot line
+@param pivot Pivot line, large enough to hold left + width pixels
+@return Returns a pointer to the first pixel of the requested span, NULL if the bitdepth is not supported
+*/
+static BYTE*
+ReadLineBGRA8(FIBITMAP *dib, BYTE *bits, int left, int width, BYTE *pivot) {
+	RGBQUAD *palette = FreeImage_GetPalette(dib);
+	BYTE *table = FreeImage_GetTransparencyTable(dib);
+	const int transparent_pixels = FreeImage_IsTransparent(dib) ? (int)FreeImage_GetTransparencyCount(dib) : 0;
+
+	switch(FreeImage_GetBPP(dib)) {
+		case 1:
+			// sub-byte pixels : convert from the start of the scanline
+			if(transparent_pixels) {
+				FreeImage_ConvertLine1To32MapTransparency(pivot, bits, left + width, palette, table, transparent_pixels);
+			} else {
+				FreeImage_ConvertLine1To32(pivot, bits, left + width, palette);
+			}
+			return pivot + 4 * left;
+		case 4:
+			if(transparent_pixels) {
+				FreeImage_ConvertLine4To32MapTransparency(pivot, bits, left + width, palette, table, transparent_pixels);
+			} else {
+				FreeImage_ConvertLine4To32(pivot, bits, left + width, palette);
+			}
+			return pivot + 4 * left;
+		case 8:
+			if(transparent_pixels) {
+				FreeImage_ConvertLine8To32MapTransparency(pivot, bits + left, width, palette, table, transparent_pixels);
+			} else {
+				FreeImage_ConvertLine8To32(pivot, bits + left, width, palette);
+			}
+			return pivot;
+		case 16:
+			if((FreeImage_GetRedMask(dib) == FI16_565_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_565_BLUE_MASK)) {
+				FreeImage_ConvertLine16To32_565(pivot, bits + 2 * left, width);
+			} else {
+				FreeImage_ConvertLine16To32_555(pivot, bits + 2 * left, width);
+			}
+			return pivot;
+		case 24:
+			FreeImage_ConvertLine24To32(pivot, bits + 3 * left, width);
+			return pivot;
+		case 32:
+			// no conversion needed
+			return bits + 4 * left;
+		default:
+			return NULL;
+	}
+}
+
+/**
+Store a BGRA8 pivot line into pixels [left, left + width[ of a FIT_BITMAP scanline
+@return Returns FALSE if the bitdepth is not supported
+*/
+static BOOL
+WriteLineBGRA8(FIBITMAP *dib, BYTE *bits, int left, int width, BYTE *pivot) {
+	switch(FreeImage_GetBPP(dib)) {
+		case 16:
+			if((FreeImage_GetRedMask(dib) == FI16_565_RED_MASK) && (FreeImage_GetGreenMask(dib) == FI16_565_GREEN_MASK) && (FreeImage_GetBlueMask(dib) == FI16_565_BLUE_MASK)) {
+				FreeImage_ConvertLine32To16_565(bits + 2 * left, pivot, width);
+			} else {
+				FreeImage_ConvertLine32To16_555(bits + 2 * left, pivot, width);
+			}
+			return TRUE;
+		case 24:
+			FreeImage_ConvertLine32To24(bits + 3 * left, pivot, width);
+			return TRUE;
+		case 32:
+			memcpy(bits + 4 * left, pivot, width * 4);
+			return TRUE;
+		default:
+			// palettized images cannot be written as color data
+			return FALSE;
+	}
+}
+
+/**
+Read pixels [left, left + width[ of a non FIT_BITMAP scanline into a RGBAF pivot line
+@return Returns FALSE if the image type is not supported
+*/
+static BOOL
+ReadLineRGBAF(FREE_IMAGE_TYPE image_type, const BYTE *bits, int left, int width, float *pivot) {
+	switch(image_type) {
+		case FIT_UINT16:
+		{
+			const WORD *src = (const WORD*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				pivot[0] = pivot[1] = pivot[2] = src[x] / 65535.0F;
+				pivot[3] = 1.0F;
+			}
+		}
+		return TRUE;
+
+		case FIT_FLOAT:
+		{
+			const float *src = (const float*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				pivot[0] = pivot[1] = pivot[2] = src[x];
+				pivot[3] = 1.0F;
+			}
+		}
+		return TRUE;
+
+		case FIT_RGB16:
+		{
+			const FIRGB16 *src = (const FIRGB16*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				pivot[0] = src[x].red / 65535.0F;
+				pivot[1] = src[x].green / 65535.0F;
+				pivot[2] = src[x].blue / 65535.0F;
+				pivot[3] = 1.0F;
+			}
+		}
+		return TRUE;
+
+		case FIT_RGBA16:
+		{
+			const FIRGBA16 *src = (const FIRGBA16*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				pivot[0] = src[x].red / 65535.0F;
+				pivot[1] = src[x].green / 65535.0F;
+				pivot[2] = src[x].blue / 65535.0F;
+				pivot[3] = src[x].alpha / 65535.0F;
+			}
+		}
+		return TRUE;
+
+		case FIT_RGBF:
+		{
+			const FIRGBF *src = (const FIRGBF*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				pivot[0] = src[x].red;
+				pivot[1] = src[x].green;
+				pivot[2] = src[x].blue;
+				pivot[3] = 1.0F;
+			}
+		}
+		return TRUE;
+
+		case FIT_RGBAF:
+			memcpy(pivot, (const FIRGBAF*)bits + left, width * sizeof(FIRGBAF));
+			return TRUE;
+
+		case FIT_RGB16F:
+			ConvertLineHalfToFloat(pivot, 4, (const WORD*)((const FIRGB16*)bits + left), 3, width);
+			return TRUE;
+
+		case FIT_RGBA16F:
+			ConvertLineHalfToFloat(pivot, 4, (const WORD*)((const FIRGBA16*)bits + left), 4, width);
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/**
+Store a RGBAF pivot line into pixels [left, left + width[ of a non FIT_BITMAP scanline.
+Greyscale types receive the luminance of the pivot line.
+@return Returns FALSE if the image type is not supported
+*/
+static BOOL
+WriteLineRGBAF(FREE_IMAGE_TYPE image_type, BYTE *bits, int left, int width, const float *pivot) {
+	switch(image_type) {
+		case FIT_UINT16:
+		{
+			WORD *dst = (WORD*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				dst[x] = FloatToWord(LUMA_REC709(pivot[0], pivot[1], pivot[2]));
+			}
+		}
+		return TRUE;
+
+		case FIT_FLOAT:
+		{
+			float *dst = (float*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				dst[x] = LUMA_REC709(pivot[0], pivot[1], pivot[2]);
+			}
+		}
+		return TRUE;
+
+		case FIT_RGB16:
+		{
+			FIRGB16 *dst = (FIRGB16*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				dst[x].red   = FloatToWord(pivot[0]);
+				dst[x].green = FloatToWord(pivot[1]);
+				dst[x].blue  = FloatToWord(pivot[2]);
+			}
+		}
+		return TRUE;
+
+		case FIT_RGBA16:
+		{
+			FIRGBA16 *dst = (FIRGBA16*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				dst[x].red   = FloatToWord(pivot[0]);
+				dst[x].green = FloatToWord(pivot[1]);
+				dst[x].blue  = FloatToWord(pivot[2]);
+				dst[x].alpha = FloatToWord(pivot[3]);
+			}
+		}
+		return TRUE;
+
+		case FIT_RGBF:
+		{
+			FIRGBF *dst = (FIRGBF*)bits + left;
+			for(int x = 0; x < width; x++, pivot += 4) {
+				dst[x].red   = pivot[0];
+				dst[x].green = pivot[1];
+				dst[x].blue  = pivot[2];
+			}
+		}
+		return TRUE;
+
+		case FIT_RGBAF:
+			memcpy((FIRGBAF*)bits + left, pivot, width * sizeof(FIRGBAF));
+			return TRUE;
+
+		case FIT_RGB16F:
+			ConvertLineFloatToHalf((WORD*)((FIRGB16*)bits + left), 3, pivot, 4, width);
+			return TRUE;
+
+		case FIT_RGBA16F:
+			ConvertLineFloatToHalf((WORD*)((FIRGBA16*)bits + left), 4, pivot, 4, width);
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/**
+Convert a BGRA8 line to a RGBAF line
+*/
+static void
+ConvertLineBGRA8ToRGBAF(float *dst, const BYTE *src, int width) {
+	int x = 0;
+#if defined(FI_PIXEL_SSE2)
+	// 4 pixels per iteration : widen the bytes to 32-bit, then reorder the channels to RGBA
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(255.0F);
+	for(; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)src);
+		const __m128i lo = _mm_unpacklo_epi8(v, zero);
+		const __m128i hi = _mm_unpackhi_epi8(v, zero);
+		const __m128i p[4] = {
+			_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+			_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)
+		};
+		for(int k = 0; k < 4; k++) {
+			const __m128i rgba = _mm_shuffle_epi32(p[k], _MM_SHUFFLE(FI_RGBA_ALPHA, FI_RGBA_BLUE, FI_RGBA_GREEN, FI_RGBA_RED));
+			_mm_storeu_ps(dst + 4 * k, _mm_div_ps(_mm_cvtepi32_ps(rgba), scale));
+		}
+		src += 16;
+		dst += 16;
+	}
+#endif
+	for(; x < width; x++) {
+		dst[0] = src[FI_RGBA_RED] / 255.0F;
+		dst[1] = src[FI_RGBA_GREEN] / 255.0F;
+		dst[2] = src[FI_RGBA_BLUE] / 255.0F;
+		dst[3] = src[FI_RGBA_ALPHA] / 255.0F;
+		src += 4;
+		dst += 4;
+	}
+}
+
+/**
+Convert a RGBAF line to a BGRA8 line
+*/
+static void
+ConvertLineRGBAFToBGRA8(BYTE *dst, const float *src, int width) {
+	int x = 0;
+#if defined(FI_PIXEL_SSE2)
+	// 4 pixels per iteration : clamp and round as FloatToByte (NaN values give 0), 
+	// reorder the channels (the RGBA <=> BGRA permutation is its own inverse), then narrow to bytes
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0F);
+	const __m128 scale = _mm_set1_ps(255.0F);
+	const __m128 half = _mm_set1_ps(0.5F);
+	for(; x + 4 <= width; x += 4) {
+		__m128i p[4];
+		for(int k = 0; k < 4; k++) {
+			const __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + 4 * k), zero), one);
+			const __m128i q = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+			p[k] = _mm_shuffle_epi32(q, _MM_SHUFFLE(FI_RGBA_ALPHA, FI_RGBA_BLUE, FI_RGBA_GREEN, FI_RGBA_RED));
+		}
+		const __m128i words = _mm_packs_epi32(p[0], p[1]);
+		_mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(words, _mm_packs_epi32(p[2], p[3])));
+		src += 16;
+		dst += 16;
+	}
+#endif
+	for(; x < width; x++) {
+		dst[FI_RGBA_RED]   = FloatToByte(src[0]);
+		dst[FI_RGBA_GREEN] = FloatToByte(src[1]);
+		dst[FI_RGBA_BLUE]  = FloatToByte(src[2]);
+		dst[FI_RGBA_ALPHA] = FloatToByte(src[3]);
+		src += 4;
+		dst += 4;
+	}
+}
+
+BOOL DLL_CALLCONV
+FreeImage_ReadRect(FIBITMAP *dib, int left, int top, int width, int height, void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout) {
+	if(!CheckRectParameters(dib, left, top, width, height, buffer, pitch, layout)) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned dib_height = FreeImage_GetHeight(dib);
+
+	if((image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) != 1) && (FreeImage_GetBPP(dib) != 4) && (FreeImage_GetBPP(dib) != 8) &&
+		(FreeImage_GetBPP(dib) != 16) && (FreeImage_GetBPP(dib) != 24) && (FreeImage_GetBPP(dib) != 32)) {
+		return FALSE;
+	}
+
+	// pivot lines : BGRA8 for standard bitmaps, RGBAF for other types
+	// (the BGRA8 line holds left + width pixels, see ReadLineBGRA8)
+	BYTE *line8 = (BYTE*)malloc((left + width) * 4 * sizeof(BYTE));
+	float *linef = (float*)malloc(width * 4 * sizeof(float));
+	if(!line8 || !linef) {
+		free(line8);
+		free(linef);
+		return FALSE;
+	}
+
+	BOOL bResult = TRUE;
+
+	for(int y = 0; (y < height) && bResult; y++) {
+		// the caller buffer is top-down, the dib is bottom-up
+		BYTE *bits = FreeImage_GetScanLine(dib, dib_height - 1 - (top + y));
+
+		if(image_type == FIT_BITMAP) {
+			const BYTE *pivot = ReadLineBGRA8(dib, bits, left, width, line8);
+			if(!PackLineBGRA8((BYTE*)buffer, pitch, height, y, layout, pivot, width)) {
+				ConvertLineBGRA8ToRGBAF(linef, pivot, width);
+				PackLineRGBAF((BYTE*)buffer, pitch, height, y, layout, linef, width);
+			}
+		} else {
+			bResult = ReadLineRGBAF(image_type, bits, left, width, linef);
+			if(bResult) {
+				PackLineRGBAF((BYTE*)buffer, pitch, height, y, layout, linef, width);
+			}
+		}
+	}
+
+	free(line8);
+	free(linef);
+
+	return bResult;
+}
+
+BOOL DLL_CALLCONV
+FreeImage_WriteRect(FIBITMAP *dib, int left, int top, int width, int height, const void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout) {
+	if(!CheckRectParameters(dib, left, top, width, height, buffer, pitch, layout)) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned dib_height = FreeImage_GetHeight(dib);
+
+	if((image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) != 16) && (FreeImage_GetBPP(dib) != 24) && (FreeImage_GetBPP(dib) != 32)) {
+		// palettized images cannot be written as color data
+		return FALSE;
+	}
+
+	BYTE *line8 = (BYTE*)malloc(width * 4 * sizeof(BYTE));
+	float *linef = (float*)malloc(width * 4 * sizeof(float));
+	if(!line8 || !linef) {
+		free(line8);
+		free(linef);
+		return FALSE;
+	}
+
+	BOOL bResult = TRUE;
+
+	for(int y = 0; (y < height) && bResult; y++) {
+		// the caller buffer is top-down, the dib is bottom-up
+		BYTE *bits = FreeImage_GetScanLine(dib, dib_height - 1 - (top + y));
+
+		if(image_type == FIT_BITMAP) {
+			if(!UnpackLineBGRA8(line8, (const BYTE*)buffer, pitch, height, y, layout, width)) {
+				UnpackLineRGBAF(linef, (const BYTE*)buffer, pitch, height, y, layout, width);
+				ConvertLineRGBAFToBGRA8(line8, linef, width);
+			}
+			bResult = WriteLineBGRA8(dib, bits, left, width, line8);
+		} else {
+			UnpackLineRGBAF(linef, (const BYTE*)buffer, pitch, height, y, layout, width);
+			bResult = WriteLineRGBAF(image_type, bits, left, width, linef);
+		}
+	}
+
+	free(line8);
+	free(linef);
+
+	return bResult;
+}
@@ -76,13 +76,129 @@ FreeImage_stricmp(const char *s1, const char *s2) {
 	return c1 - c2;
 }
 
+// =====================================================================
+//  Implementation of PluginIndex
+// =====================================================================
+
+/**
+Case insensitive FNV-1a hash of the first length characters of a name
+*/
+static inline size_t
+HashName(const char *name, size_t length) {
+	DWORD hash = 2166136261U;
+	for(size_t i = 0; i < length; i++) {
+		hash ^= (BYTE)tolower((BYTE)name[i]);
+		hash *= 16777619U;
+	}
+	return (size_t)hash;
+}
+
+/**
+Case insensitive comparison of two names of the same length
+*/
+static inline BOOL
+SameName(const char *name1, const char *name2, size_t length) {
+	for(size_t i = 0; i < length; i++) {
+		if(tolower((BYTE)name1[i]) != tolower((BYTE)name2[i])) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+PluginIndex::PluginIndex() :
+m_entries(),
+m_slots(64, -1) {
+}
+
+void
+PluginIndex::Insert(int entry) {
+	// entries of the same name stay in insertion order along the probe sequence
+	const size_t mask = m_slots.size() - 1;
+	size_t slot = HashName(m_entries[entry].m_name, m_entries[entry].m_length) & mask;
+	while(m_slots[slot] != -1) {
+		slot = (slot + 1) & mask;
+	}
+	m_slots[slot] = entry;
+}
+
+void
+PluginIndex::Rehash(size_t size) {
+	m_slots.assign(size, -1);
+	for(size_t i = 0; i < m_entries.size(); i++) {
+		Insert((int)i);
+	}
+}
+
+void
+PluginIndex::Add(const char *name, size_t length, PluginNode *node) {
+	if(!name || (length == 0)) {
+		return;
+	}
+
+	// a node may list a name twice
+	const size_t mask = m_slots.size() - 1;
+	for(size_t slot = HashName(name, length) & mask; m_slots[slot] != -1; slot = (slot + 1) & mask) {
+		const Entry &entry = m_entries[m_slots[slot]];
+		if((entry.m_node == node) && (entry.m_length == length) && SameName(entry.m_name, name, length)) {
+			return;
+		}
+	}
+
+	Entry entry = { name, length, node };
+	m_entries.push_back(entry);
+
+	// keep the table at most half full
+	if(2 * m_entries.size() > m_slots.size()) {
+		Rehash(2 * m_slots.size());
+	} else {
+		Insert((int)m_entries.size() - 1);
+	}
+}
+
+void
+PluginIndex::AddList(const char *list, PluginNode *node) {
+	if(list) {
+		const char *name = list;
+		for(const char *c = list; ; c++) {
+			if((*c == ',') || (*c == '\0')) {
+				Add(name, (size_t)(c - name), node);
+				if(*c == '\0') {
+					break;
+				}
+				name = c + 1;
+			}
+		}
+	}
+}
+
+PluginNode *
+PluginIndex::Find(const char *name) const {
+	if(name) {
+		const size_t length = strlen(name);
+		const size_t mask = m_slots.size() - 1;
+
+		// the lowest enabled FIF comes first
+		for(size_t slot = HashName(name, length) & mask; m_slots[slot] != -1; slot = (slot + 1) & mask) {
+			const Entry &entry = m_entries[m_slots[slot]];
+			if((entry.m_length == length) && entry.m_node->m_enabled && SameName(entry.m_name, name, length)) {
+				return entry.m_node;
+			}
+		}
+	}
+	return NULL;
+}
+
 // =====================================================================
 //  Implementation of PluginList
 // =====================================================================
 
 PluginList::PluginList() :
 m_plugin_map(),
-m_node_count(0) {
+m_node_count(0),
+m_format_index(),
+m_mime_index(),
+m_extension_index() {
 }
 
 FREE_IMAGE_FORMAT
@@ -128,6 +244,21 @@ PluginList::AddNode(FI_InitProc init_proc, void *instance, const char *format, c
 
 			m_plugin_map[(const int)m_plugin_map.size()] = node;
 
+			// index the names designating the plugin
+			const char *the_extension = (extension != NULL) ? extension : (plugin->extension_proc != NULL) ? plugin->extension_proc() : NULL;
+			const char *the_mime = (plugin->mime_proc != NULL) ? plugin->mime_proc() : NULL;
+
+			try {
+				m_format_index.Add(the_format, strlen(the_format), node);
+				m_extension_index.Add(the_format, strlen(the_format), node);
+				m_extension_index.AddList(the_extension, node);
+				if(the_mime != NULL) {
+					m_mime_index.Add(the_mime, strlen(the_mime), node);
+				}
+			} catch(std::bad_alloc &) {
+				FreeImage_OutputMessageProc(node->m_id, FI_MSG_ERROR_MEMORY);
+			}
+
 			return (FREE_IMAGE_FORMAT)node->m_id;
 		}
 
@@ -142,32 +273,17 @@ PluginList::AddNode(FI_InitProc init_proc, void *instance, const char *format, c
 
 PluginNode *
 PluginList::FindNodeFromFormat(const char *format) {
-	for (map<int, PluginNode *>::iterator i = m_plugin_map.begin(); i != m_plugin_map.end(); ++i) {
-		const char *the_format = ((*i).second->m_format != NULL) ? (*i).second->m_format : (*i).second->m_plugin->format_proc();
-
-		if ((*i).second->m_enabled) {
-			if (FreeImage_stricmp(the_format, format) == 0) {
-				return (*i).second;
-			}
-		}
-	}
-
-	return NULL;
+	return m_format_index.Find(format);
 }
 
 PluginNode *
 PluginList::FindNodeFromMime(const char *mime) {
-	for (map<int, PluginNode *>::iterator i = m_plugin_map.begin(); i != m_plugin_map.end(); ++i) {
-		const char *the_mime = ((*i).second->m_plugin->mime_proc != NULL) ? (*i).second->m_plugin->mime_proc() : "";
-
-		if ((*i).second->m_enabled) {
-			if ((the_mime != NULL) && (strcmp(the_mime, mime) == 0)) {
-				return (*i).second;
-			}
-		}
-	}
+	return m_mime_index.Find(mime);
+}
 
-	return NULL;
+PluginNode *
+PluginList::FindNodeFromExtension(const char *extension) {
+	return m_extension_index.Find(extension);
 }
 
 PluginNode *
@@ -724,51 +840,17 @@ FreeImage_FIFSupportsNoPixels(FREE_IMAGE_FORMAT fif) {
 
 FREE_IMAGE_FORMAT DLL_CALLCONV
 FreeImage_GetFIFFromFilename(const char *filename) {
-	if (filename != NULL) {
-		const char *extension;
-
+	if ((filename != NULL) && (s_plugins != NULL)) {
 		// get the proper extension if we received a filename
 
-		char *place = strrchr((char *)filename, '.');	
-		extension = (place != NULL) ? ++place : filename;
-
-		// look for the extension in the plugin table
-
-		for (int i = 0; i < FreeImage_GetFIFCount(); ++i) {
-
-			if (s_plugins->FindNodeFromFIF(i)->m_enabled) {
-
-				// compare the format id with the extension
-
-				if (FreeImage_stricmp(FreeImage_GetFormatFromFIF((FREE_IMAGE_FORMAT)i), extension) == 0) {
-					return (FREE_IMAGE_FORMAT)i;
-				} else {
-					// make a copy of the extension list and split it
-
-					char *copy = (char *)malloc(strlen(FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i)) + 1);
-					memset(copy, 0, strlen(FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i)) + 1);
-					memcpy(copy, FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i), strlen(FreeImage_GetFIFExtensionList((FREE_IMAGE_FORMAT)i)));
+		const char *place = strrchr(filename, '.');
+		const char *extension = (place != NULL) ? place + 1 : filename;
 
-					// get the first token
+		// look for the extension among the format ids and extension lists
 
-					char *token = strtok(copy, ",");
+		PluginNode *node = s_plugins->FindNodeFromExtension(extension);
 
-					while (token != NULL) {
-						if (FreeImage_stricmp(token, extension) == 0) {
-							free(copy);
-
-								return (FREE_IMAGE_FORMAT)i;
-						}
-
-						token = strtok(NULL, ",");
-					}
-
-					// free the copy of the extension list
-
-					free(copy);
-				}	
-			}
-		}
+		return (node != NULL) ? (FREE_IMAGE_FORMAT)node->m_id : FIF_UNKNOWN;
 	}
 
 	return FIF_UNKNOWN;
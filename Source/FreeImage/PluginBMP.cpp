@@ -26,15 +26,15 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
+#include "RLECodec.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
 // ----------------------------------------------------------
 
 static const BYTE RLE_COMMAND     = 0;
-static const BYTE RLE_ENDOFLINE   = 0;
 static const BYTE RLE_ENDOFBITMAP = 1;
-static const BYTE RLE_DELTA       = 2;
 
 static const BYTE BI_RGB            = 0;	// compression: none
 static const BYTE BI_RLE8           = 1;	// compression: RLE 8-bit/pixel
@@ -267,244 +267,70 @@ LoadPixelData(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int height, unsi
 }
 
 /**
-Load image pixels for 4-bit RLE compressed dib
+Load image pixels for 4-bit or 8-bit RLE compressed dib
 @param io FreeImage IO
 @param handle FreeImage IO handle
 @param width Image width
 @param height Image height
-@param dib 4-bit image to be loaded 
+@param dib 4-bit or 8-bit image to be loaded 
 @return Returns TRUE if successful, returns FALSE otherwise
 */
 static BOOL 
-LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBITMAP *dib) {
-	int status_byte = 0;
-	BYTE second_byte = 0;
-	int bits = 0;
-
-	BYTE *pixels = NULL;	// temporary 8-bit buffer
-
-	try {
-		height = abs(height);
-
-		pixels = (BYTE*)malloc(width * height * sizeof(BYTE));
-		if (!pixels) {
-			throw(1);
-		}
-		memset(pixels, 0, width * height * sizeof(BYTE));
-
-		BYTE *q = pixels;
-		BYTE *end = pixels + height * width;
-
-		for (int scanline = 0; scanline < height; ) {
-			if (q < pixels || q  >= end) {
-				break;
-			}
-			if(io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
-				throw(1);
-			}
-			if (status_byte != 0)	{
-				status_byte = (int)MIN((size_t)status_byte, (size_t)(end - q));
-				// Encoded mode
-				if(io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
-					throw(1);
-				}
-				for (int i = 0; i < status_byte; i++)	{
-					*q++ = (BYTE)((i & 0x01) ? (second_byte & 0x0f) : ((second_byte >> 4) & 0x0f));
-				}
-				bits += status_byte;
-			}
-			else {
-				// Escape mode
-				if(io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
-					throw(1);
-				}
-				switch (status_byte) {
-					case RLE_ENDOFLINE:
-					{
-						// End of line
-						bits = 0;
-						scanline++;
-						q = pixels + scanline * width;
-					}
-					break;
-
-					case RLE_ENDOFBITMAP:
-						// End of bitmap
-						q = end;
-						break;
-
-					case RLE_DELTA:
-					{
-						// read the delta values
-						BYTE delta_x = 0;
-						BYTE delta_y = 0;
-
-						if(io->read_proc(&delta_x, sizeof(BYTE), 1, handle) != 1) {
-							throw(1);
-						}
-						if(io->read_proc(&delta_y, sizeof(BYTE), 1, handle) != 1) {
-							throw(1);
-						}
-
-						// apply them
-						bits += delta_x;
-						scanline += delta_y;
-						q = pixels + scanline*width+bits;
-					}
-					break;
-
-					default:
-					{
-						// Absolute mode
-						status_byte = (int)MIN((size_t)status_byte, (size_t)(end - q));
-						for (int i = 0; i < status_byte; i++) {
-							if ((i & 0x01) == 0) {
-								if(io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
-									throw(1);
-								}
-							}
-							*q++ = (BYTE)((i & 0x01) ? (second_byte & 0x0f) : ((second_byte >> 4) & 0x0f));
-						}
-						bits += status_byte;
-						// Read pad byte
-						if (((status_byte & 0x03) == 1) || ((status_byte & 0x03) == 2)) {
-							BYTE padding = 0;
-							if(io->read_proc(&padding, sizeof(BYTE), 1, handle) != 1) {
-								throw(1);
-							}
-						}
-					}
-					break;
-				}
-			}
-		}
-		
-		{
-			// Convert to 4-bit
-			for(int y = 0; y < height; y++) {
-				const BYTE *src = (BYTE*)pixels + y * width;
-				BYTE *dst = FreeImage_GetScanLine(dib, y);
-
-				BOOL hinibble = TRUE;
-
-				for (int cols = 0; cols < width; cols++){
-					if (hinibble) {
-						dst[cols >> 1] = (src[cols] << 4);
-					} else {
-						dst[cols >> 1] |= src[cols];
-					}
-
-					hinibble = !hinibble;
-				}
-			}
-		}
+LoadPixelDataRLE(FreeImageIO *io, fi_handle handle, int width, int height, FIBITMAP *dib) {
+	BufferedReader reader(io, handle);
+	if (reader.isNull()) {
+		return FALSE;
+	}
 
-		free(pixels);
+	const BOOL bSuccess = BMPRLE_Decode(reader, FreeImage_GetBits(dib), FreeImage_GetPitch(dib), width, abs(height), FreeImage_GetBPP(dib));
 
-		return TRUE;
+	// give back the bytes read ahead
+	reader.release();
 
-	} catch(int) {
-		if (pixels) {
-			free(pixels);
-		}
-		return FALSE;
-	}
+	return bSuccess;
 }
 
 /**
-Load image pixels for 8-bit RLE compressed dib
+Wrap the pixels of an uncompressed bottom-up dib instead of loading them (see FIF_LOAD_MAPPED)
 @param io FreeImage IO
 @param handle FreeImage IO handle
-@param width Image width
-@param height Image height
-@param dib 8-bit image to be loaded 
-@return Returns TRUE if successful, returns FALSE otherwise
+@param flags Load flags
+@param bitmap_bits_offset Offset of the pixel data
+@param bih Info header
+@param pitch Image pitch
+@return Returns the mapped dib, returns NULL if the pixels have to be loaded
 */
-static BOOL 
-LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBITMAP *dib) {
-	BYTE status_byte = 0;
-	BYTE second_byte = 0;
-	int scanline = 0;
-	int bits = 0;
-	int count = 0;
-	BYTE delta_x = 0;
-	BYTE delta_y = 0;
-
-	height = abs(height);
-	
-	while(scanline < height) {
-
-		if (io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
-			return FALSE;
-		}
-
-		if (status_byte == RLE_COMMAND) {
-			if (io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
-				return FALSE;
-			}
-
-			switch (status_byte) {
-				case RLE_ENDOFLINE:
-					bits = 0;
-					scanline++;
-					break;
-
-				case RLE_ENDOFBITMAP:
-					return TRUE;
-
-				case RLE_DELTA:
-					// read the delta values
-					delta_x = 0;
-					delta_y = 0;
-					if (io->read_proc(&delta_x, sizeof(BYTE), 1, handle) != 1) {
-						return FALSE;
-					}
-					if (io->read_proc(&delta_y, sizeof(BYTE), 1, handle) != 1) {
-						return FALSE;
-					}
-					// apply them
-					bits += delta_x;
-					scanline += delta_y;
-					break;
-
-				default:
-					// absolute mode
-					count = MIN((int)status_byte, width - bits);
-					if (count < 0) {
-						return FALSE;
-					}
-					BYTE *sline = FreeImage_GetScanLine(dib, scanline);
-					if (io->read_proc((void *)(sline + bits), sizeof(BYTE) * count, 1, handle) != 1) {
-						return FALSE;
-					}
-					// align run length to even number of bytes
-					if ((status_byte & 1) == 1) {
-						if (io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
-							return FALSE;
-						}
-					}
-					bits += status_byte;				
-					break;
+static FIBITMAP *
+AllocateMappedDIB(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bits_offset, const BITMAPINFOHEADER *bih, unsigned pitch, unsigned red_mask = 0, unsigned green_mask = 0, unsigned blue_mask = 0) {
+	if(((flags & FIF_LOAD_MAPPED) != FIF_LOAD_MAPPED) || ((flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS)) {
+		return NULL;
+	}
 
-			} // switch (status_byte)
-		}
-		else {
-			count = MIN((int)status_byte, width - bits);
-			if (count < 0) {
-				return FALSE;
-			}
-			BYTE *sline = FreeImage_GetScanLine(dib, scanline);
-			if (io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
-				return FALSE;
-			}
-			for (int i = 0; i < count; i++) {
-				*(sline + bits) = second_byte;
-				bits++;
-			}
+	// top-down and compressed pixels need to be loaded
+	if(bih->biHeight <= 0) {
+		return NULL;
+	}
+	if(bih->biBitCount <= 8) {
+		if(bih->biCompression != BI_RGB) {
+			return NULL;
 		}
+	} else if((bih->biCompression != BI_RGB) && (bih->biCompression != BI_BITFIELDS) && (bih->biCompression != BI_ALPHABITFIELDS)) {
+		return NULL;
 	}
-	
-	return FALSE;
+
+	// so do pixels that need to be swapped
+#ifdef FREEIMAGE_BIGENDIAN
+	if(bih->biBitCount == 16) {
+		return NULL;
+	}
+#endif
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
+	if(bih->biBitCount >= 24) {
+		return NULL;
+	}
+#endif
+
+	return AllocateMappedBitmap(io, handle, (long)bitmap_bits_offset, pitch, FIT_BITMAP, bih->biWidth, bih->biHeight, bih->biBitCount, red_mask, green_mask, blue_mask);
 }
 
 // --------------------------------------------------------------------------
@@ -551,7 +377,11 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 				
 				// allocate enough memory to hold the bitmap (header, palette, pixels) and read the palette
 
-				dib = FreeImage_AllocateHeader(header_only, width, height, bit_count);
+				dib = AllocateMappedDIB(io, handle, flags, bitmap_bits_offset, &bih, pitch);
+				const BOOL mapped = (dib != NULL);
+				if (!mapped) {
+					dib = FreeImage_AllocateHeader(header_only, width, height, bit_count);
+				}
 				if (dib == NULL) {
 					throw FI_MSG_ERROR_DIB_MEMORY;
 				}
@@ -583,8 +413,8 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 				}
 #endif
 
-				if(header_only) {
-					// header only mode
+				if(header_only || mapped) {
+					// header only mode, or pixels wrapped by the dib
 					return dib;
 				}
 
@@ -604,7 +434,7 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 						break;
 
 					case BI_RLE4 :
-						if( (bit_count == 4) && LoadPixelDataRLE4(io, handle, width, height, dib) ) {
+						if( (bit_count == 4) && LoadPixelDataRLE(io, handle, width, height, dib) ) {
 							return dib;
 						} else {
 							throw "Error encountered while decoding RLE4 BMP data";
@@ -612,7 +442,7 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 						break;
 
 					case BI_RLE8 :
-						if( (bit_count == 8) && LoadPixelDataRLE8(io, handle, width, height, dib) ) {
+						if( (bit_count == 8) && LoadPixelDataRLE(io, handle, width, height, dib) ) {
 							return dib;
 						} else {
 							throw "Error encountered while decoding RLE8 BMP data";
@@ -641,12 +471,15 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 					use_bitfields = 4;
 				}
 				
+				DWORD bitfields[4] = { FI16_555_RED_MASK, FI16_555_GREEN_MASK, FI16_555_BLUE_MASK, 0 };
 				if (use_bitfields > 0) {
- 					DWORD bitfields[4];
 					io->read_proc(bitfields, use_bitfields * sizeof(DWORD), 1, handle);
+				}
+
+				dib = AllocateMappedDIB(io, handle, flags, bitmap_bits_offset, &bih, pitch, bitfields[0], bitfields[1], bitfields[2]);
+				const BOOL mapped = (dib != NULL);
+				if (!mapped) {
 					dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, bitfields[0], bitfields[1], bitfields[2]);
-				} else {
-					dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI16_555_RED_MASK, FI16_555_GREEN_MASK, FI16_555_BLUE_MASK);
 				}
 
 				if (dib == NULL) {
@@ -657,8 +490,8 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 				FreeImage_SetDotsPerMeterX(dib, bih.biXPelsPerMeter);
 				FreeImage_SetDotsPerMeterY(dib, bih.biYPelsPerMeter);
 
-				if(header_only) {
-					// header only mode
+				if(header_only || mapped) {
+					// header only mode, or pixels wrapped by the dib
 					return dib;
 				}
 				
@@ -689,16 +522,15 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 					use_bitfields = 4;
 				}
 
+				DWORD bitfields[4] = { FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, 0 };
  				if (use_bitfields > 0) {
-					DWORD bitfields[4];
 					io->read_proc(bitfields, use_bitfields * sizeof(DWORD), 1, handle);
+				}
+
+				dib = AllocateMappedDIB(io, handle, flags, bitmap_bits_offset, &bih, pitch, bitfields[0], bitfields[1], bitfields[2]);
+				const BOOL mapped = (dib != NULL);
+				if (!mapped) {
 					dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, bitfields[0], bitfields[1], bitfields[2]);
-				} else {
-					if( bit_count == 32 ) {
-						dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					} else {
-						dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					}
 				}
 
 				if (dib == NULL) {
@@ -714,6 +546,12 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 					return dib;
 				}
 
+				if(mapped) {
+					// pixels wrapped by the dib
+					FreeImage_SetTransparent(dib, (FreeImage_GetColorType(dib) == FIC_RGBALPHA));
+					return dib;
+				}
+
 				// Skip over the optional palette 
 				// A 24 or 32 bit DIB may contain a palette for faster color reduction
 				// i.e. you can have (FreeImage_GetColorsUsed(dib) > 0)
@@ -849,7 +687,7 @@ LoadOS22XBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bits_
 						return dib;
 
 					case BI_RLE4 :
-						if ((bit_count == 4) && LoadPixelDataRLE4(io, handle, width, height, dib)) {
+						if ((bit_count == 4) && LoadPixelDataRLE(io, handle, width, height, dib)) {
 							return dib;
 						}
 						else {
@@ -858,7 +696,7 @@ LoadOS22XBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bits_
 						break;
 
 					case BI_RLE8 :
-						if ((bit_count == 8) && LoadPixelDataRLE8(io, handle, width, height, dib)) {
+						if ((bit_count == 8) && LoadPixelDataRLE(io, handle, width, height, dib)) {
 							return dib;
 						}
 						else {
@@ -1235,155 +1073,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 // ----------------------------------------------------------
 
-/**
-Encode a 8-bit source buffer into a 8-bit target buffer using a RLE compression algorithm. 
-The size of the target buffer must be equal to the size of the source buffer. 
-On return, the function will return the real size of the target buffer, which should be less that or equal to the source buffer size. 
-@param target 8-bit Target buffer
-@param source 8-bit Source buffer
-@param size Source/Target input buffer size
-@return Returns the target buffer size
-*/
-static int
-RLEEncodeLine(BYTE *target, BYTE *source, int size) {
-	BYTE buffer[256];
-	int buffer_size = 0;
-	int target_pos = 0;
-
-	for (int i = 0; i < size; ++i) {
-		if ((i < size - 1) && (source[i] == source[i + 1])) {
-			// find a solid block of same bytes
-
-			int j = i + 1;
-			int jmax = 254 + i;
-
-			while ((j < size - 1) && (j < jmax) && (source[j] == source[j + 1]))
-				++j;
-
-			// if the block is larger than 3 bytes, use it
-			// else put the data into the larger pool
-
-			if (((j - i) + 1) > 3) {
-				// don't forget to write what we already have in the buffer
-
-				switch(buffer_size) {
-					case 0 :
-						break;
-
-					case RLE_DELTA :
-						target[target_pos++] = 1;
-						target[target_pos++] = buffer[0];
-						target[target_pos++] = 1;
-						target[target_pos++] = buffer[1];
-						break;
-
-					case RLE_ENDOFBITMAP :
-						target[target_pos++] = (BYTE)buffer_size;
-						target[target_pos++] = buffer[0];
-						break;
-
-					default :
-						target[target_pos++] = RLE_COMMAND;
-						target[target_pos++] = (BYTE)buffer_size;
-						memcpy(target + target_pos, buffer, buffer_size);
-
-						// prepare for next run
-						
-						target_pos += buffer_size;
-
-						if ((buffer_size & 1) == 1)
-							target_pos++;
-
-						break;
-				}
-
-				// write the continuous data
-
-				target[target_pos++] = (BYTE)((j - i) + 1);
-				target[target_pos++] = source[i];
-
-				buffer_size = 0;
-			} else {
-				for (int k = 0; k < (j - i) + 1; ++k) {
-					buffer[buffer_size++] = source[i + k];
-
-					if (buffer_size == 254) {
-						// write what we have
-
-						target[target_pos++] = RLE_COMMAND;
-						target[target_pos++] = (BYTE)buffer_size;
-						memcpy(target + target_pos, buffer, buffer_size);
-
-						// prepare for next run
-
-						target_pos += buffer_size;
-						buffer_size = 0;
-					}
-				}
-			}
-
-			i = j;
-		} else {
-			buffer[buffer_size++] = source[i];
-		}
-
-		// write the buffer if it's full
-
-		if (buffer_size == 254) {
-			target[target_pos++] = RLE_COMMAND;
-			target[target_pos++] = (BYTE)buffer_size;
-			memcpy(target + target_pos, buffer, buffer_size);
-
-			// prepare for next run
-
-			target_pos += buffer_size;
-			buffer_size = 0;
-		}
-	}
-
-	// write the last bytes
-
-	switch(buffer_size) {
-		case 0 :
-			break;
-
-		case RLE_DELTA :
-			target[target_pos++] = 1;
-			target[target_pos++] = buffer[0];
-			target[target_pos++] = 1;
-			target[target_pos++] = buffer[1];
-			break;
-
-		case RLE_ENDOFBITMAP :
-			target[target_pos++] = (BYTE)buffer_size;
-			target[target_pos++] = buffer[0];
-			break;
-
-		default :
-			target[target_pos++] = RLE_COMMAND;
-			target[target_pos++] = (BYTE)buffer_size;
-			memcpy(target + target_pos, buffer, buffer_size);
-
-			// prepare for next run
-			
-			target_pos += buffer_size;
-
-			if ((buffer_size & 1) == 1)
-				target_pos++;
-
-			break;			
-	}
-
-	// write the END_OF_LINE marker
-
-	target[target_pos++] = RLE_COMMAND;
-	target[target_pos++] = RLE_ENDOFLINE;
-
-	// return the written size
-
-	return target_pos;
-}
-
 static BOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
 	if ((dib != NULL) && (handle != NULL)) {
@@ -1487,10 +1176,10 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		// write the bitmap data... if RLE compression is enable, use it
 
 		if ((dst_bpp == 8) && ((flags & BMP_SAVE_RLE) == BMP_SAVE_RLE)) {
-			BYTE *buffer = (BYTE*)malloc(dst_pitch * 2 * sizeof(BYTE));
+			BYTE *buffer = (BYTE*)malloc(BMPRLE_MAX_ENCODED_SIZE(dst_width) * sizeof(BYTE));
 
 			for (unsigned i = 0; i < dst_height; ++i) {
-				int size = RLEEncodeLine(buffer, FreeImage_GetScanLine(dib, i), FreeImage_GetLine(dib));
+				unsigned size = BMPRLE_EncodeLine8(buffer, FreeImage_GetScanLine(dib, i), dst_width);
 
 				if (io->write_proc(buffer, size, 1, handle) != 1) {
 					free(buffer);
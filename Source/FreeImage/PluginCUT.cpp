@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -157,10 +158,15 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		unsigned i = 0, k = 0;
 		unsigned pitch = FreeImage_GetPitch(dib);
 		unsigned size = header.width * header.height;
-		BYTE count = 0, run = 0;
+		int count = 0, run = 0;
+
+		BufferedReader reader(io, handle);
+		if(reader.isNull()) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
 
 		while (i < size) {
-			if(io->read_proc(&count, 1, sizeof(BYTE), handle) != 1) {
+			if((count = reader.getByte()) == EOF) {
 				throw FI_MSG_ERROR_PARSING;
 			}
 
@@ -170,8 +176,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 				// paint shop pro adds two useless bytes here...
 
-				io->read_proc(&count, 1, sizeof(BYTE), handle);
-				io->read_proc(&count, 1, sizeof(BYTE), handle);
+				reader.skip(2);
 
 				continue;
 			}
@@ -179,7 +184,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			if (count & 0x80) {
 				count &= ~(0x80);
 
-				if(io->read_proc(&run, 1, sizeof(BYTE), handle) != 1) {
+				if((run = reader.getByte()) == EOF) {
 					throw FI_MSG_ERROR_PARSING;
 				}
 
@@ -190,7 +195,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				}
 			} else {
 				if(k + count <= header.width) {
-					if(io->read_proc(&bits[k], count, sizeof(BYTE), handle) != 1) {
+					if(reader.read(&bits[k], count) != (unsigned)count) {
 						throw FI_MSG_ERROR_PARSING;
 					}
 				} else {
@@ -202,6 +207,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			i += count;
 		}
 
+		// give back the bytes read ahead
+		reader.release();
+
 		return dib;
 
 	} catch(const char* text) {
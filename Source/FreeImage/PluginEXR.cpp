@@ -22,6 +22,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
 #ifdef _MSC_VER
 // OpenEXR has many problems with MSVC warnings (why not just correct them ?), just ignore one of them
@@ -47,6 +48,9 @@
 
 static int s_format_id;
 
+/** Number of scanlines read between two progress reports (a multiple of the lines of a compressed block) */
+static const int EXR_PROGRESS_LINES = 256;
+
 // ----------------------------------------------------------
 
 /**
@@ -161,7 +165,9 @@ SupportsExportType(FREE_IMAGE_TYPE type) {
 	return (
 		(type == FIT_FLOAT) ||
 		(type == FIT_RGBF)  ||
-		(type == FIT_RGBAF)
+		(type == FIT_RGBAF) ||
+		(type == FIT_RGB16F) ||
+		(type == FIT_RGBA16F)
 	);
 }
 
@@ -182,6 +188,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	}
 
 	try {
+		// initialize the OpenEXR library (once, thread safe)
+		// note that this OpenEXR function produce so called "false memory leaks"
+		// see http://lists.nongnu.org/archive/html/openexr-devel/2013-11/msg00000.html
+		Imf::staticInitialize();
+
 		BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
 		BOOL support_fp16 = (flags & EXR_ALLOW_FOR_FP16) == EXR_ALLOW_FOR_FP16;
@@ -373,6 +384,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			Imath::Box2i dw = dataWindow;
 			Imf::Array2D<Imf::Rgba> chunk(chunk_size, width);
 			while (dw.min.y <= dw.max.y) {
+				if(!FreeImage_ReportProgress((double)(dw.min.y - dataWindow.min.y) / height)) {
+					// cancelled
+					FreeImage_Unload(dib);
+					return NULL;
+				}
 				// read a chunk
 				rgbaFile.setFrameBuffer (&chunk[0][0] - dw.min.x - dw.min.y * width, 1, width);
 				rgbaFile.readPixels (dw.min.y, MIN(dw.min.y + chunk_size - 1, dw.max.y));
@@ -438,9 +454,16 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				}
 			}
 
-			// read the file
+			// read the file in bands of scanlines, the load may be cancelled between two bands
 			file.setFrameBuffer(frameBuffer);
-			file.readPixels(dataWindow.min.y, dataWindow.max.y);
+			for(int y = dataWindow.min.y; y <= dataWindow.max.y; y += EXR_PROGRESS_LINES) {
+				if(!FreeImage_ReportProgress((double)(y - dataWindow.min.y) / height)) {
+					// cancelled
+					FreeImage_Unload(dib);
+					return NULL;
+				}
+				file.readPixels(y, MIN(y + EXR_PROGRESS_LINES - 1, dataWindow.max.y));
+			}
 		}
 
 		// lastly, flip dib lines
@@ -575,6 +598,24 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 	if(!dib || !handle) return FALSE;
 
+	// initialize the OpenEXR library (once, thread safe)
+	Imf::staticInitialize();
+
+	// half-float images are saved as is, unless float data or EXR_LC compression is requested
+	{
+		const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+		if(((image_type == FIT_RGB16F) || (image_type == FIT_RGBA16F)) && (((flags & EXR_FLOAT) == EXR_FLOAT) || ((flags & EXR_LC) == EXR_LC))) {
+			FIBITMAP *float_dib = (image_type == FIT_RGB16F) ? FreeImage_ConvertToRGBF(dib) : FreeImage_ConvertToRGBAF(dib);
+			if(!float_dib) {
+				FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+				return FALSE;
+			}
+			const BOOL bResult = Save(io, float_dib, handle, page, flags, data);
+			FreeImage_Unload(float_dib);
+			return bResult;
+		}
+	}
+
 	try {
 		// check for EXR_LC compression and verify that the format is RGB
 		if((flags & EXR_LC) == EXR_LC) {
@@ -651,6 +692,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				header.channels().insert ("Y", Imf::Channel(pixelType));
 				break;
 			case FIT_RGBF:
+			case FIT_RGB16F:
 				components = 3;
 				for(int c = 0; c < components; c++) {
 					// insert R, G and B channels
@@ -658,6 +700,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				}
 				break;
 			case FIT_RGBAF:
+			case FIT_RGBA16F:
 				components = 4;
 				for(int c = 0; c < components; c++) {
 					// insert R, G, B and A channels
@@ -677,7 +720,16 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		unsigned pitch = 0;	// size of our yStride in bytes
 
 
-		if(pixelType == Imf::HALF) {
+		if((image_type == FIT_RGB16F) || (image_type == FIT_RGBA16F)) {
+			// half data are saved without conversion
+			// invert dib scanlines
+			bIsFlipped = FreeImage_FlipVertical(dib);
+
+			bits = FreeImage_GetBits(dib);
+			bytespc = sizeof(half);
+			bytespp = sizeof(half) * components;
+			pitch = FreeImage_GetPitch(dib);
+		} else if(pixelType == Imf::HALF) {
 			// convert from float to half
 			halfData = new(std::nothrow) half[width * height * components];
 			if(!halfData) {
@@ -715,7 +767,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				(char*)(bits),			// base
 				bytespp,				// xStride
 				pitch));				// yStride
-		} else if((image_type == FIT_RGBF) || (image_type == FIT_RGBAF)) {			
+		} else {
 			for(int c = 0; c < components; c++) {
 				char *channel_base = (char*)(bits) + c*bytespc;
 				frameBuffer.insert (channel_name[c],// name
@@ -764,10 +816,7 @@ void DLL_CALLCONV
 InitEXR(Plugin *plugin, int format_id) {
 	s_format_id = format_id;
 
-	// initialize the OpenEXR library
-	// note that this OpenEXR function produce so called "false memory leaks"
-	// see http://lists.nongnu.org/archive/html/openexr-devel/2013-11/msg00000.html
-	Imf::staticInitialize();
+	// the OpenEXR library is initialized on first use of Load or Save
 
 	plugin->format_proc = Format;
 	plugin->description_proc = Description;
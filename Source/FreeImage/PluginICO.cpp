@@ -366,17 +366,20 @@ LoadStandardIcon(FreeImageIO *io, fi_handle handle, int flags, BOOL header_only)
 		}
 
 		int width_and	= WidthBytes(width);
-		BYTE *line_and	= (BYTE *)malloc(width_and);
+		BYTE *mask_and	= (BYTE *)malloc(width_and * height);
 
-		if( line_and == NULL ) {
+		if( mask_and == NULL ) {
 			FreeImage_Unload(dib32);
 			return NULL;
 		}
 
+		// read the whole AND-mask at once
+		io->read_proc(mask_and, width_and, height, handle);
+
 		//loop through each line of the AND-mask generating the alpha channel, invert XOR-mask
 		for(int y = 0; y < height; y++) {
 			RGBQUAD *quad = (RGBQUAD *)FreeImage_GetScanLine(dib32, y);
-			io->read_proc(line_and, width_and, 1, handle);
+			const BYTE *line_and = mask_and + y * width_and;
 			for(int x = 0; x < width; x++) {
 				quad->rgbReserved = (line_and[x>>3] & (0x80 >> (x & 0x07))) != 0 ? 0 : 0xFF;
 				if( quad->rgbReserved == 0 ) {
@@ -387,7 +390,7 @@ LoadStandardIcon(FreeImageIO *io, fi_handle handle, int flags, BOOL header_only)
 				quad++;
 			}
 		}
-		free(line_and);
+		free(mask_and);
 
 		return dib32;
 	}
@@ -24,6 +24,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 // ----------------------------------------------------------
 //  Internal typedefs and structures
@@ -202,7 +203,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 		DWORD type, size;
 
-		io->read_proc(&type, 4, 1, handle);
+		BufferedReader reader(io, handle);
+		if (reader.isNull())
+			return NULL;
+
+		reader.read(&type, 4);
 #ifndef FREEIMAGE_BIGENDIAN
 		SwapLong(&type);
 #endif
@@ -210,12 +215,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		if(type != ID_FORM)
 			return NULL;
 
-		io->read_proc(&size, 4, 1, handle);
+		reader.read(&size, 4);
 #ifndef FREEIMAGE_BIGENDIAN
 		SwapLong(&size);
 #endif
 
-		io->read_proc(&type, 4, 1, handle);
+		reader.read(&type, 4);
 #ifndef FREEIMAGE_BIGENDIAN
 		SwapLong(&type);
 #endif
@@ -230,17 +235,17 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		while (size) {
 			DWORD ch_type,ch_size;
 
-			io->read_proc(&ch_type, 4, 1, handle);
+			reader.read(&ch_type, 4);
 #ifndef FREEIMAGE_BIGENDIAN
 			SwapLong(&ch_type);
 #endif
 
-			io->read_proc(&ch_size,4,1,handle );
+			reader.read(&ch_size, 4);
 #ifndef FREEIMAGE_BIGENDIAN
 			SwapLong(&ch_size);
 #endif
 
-			unsigned ch_end = io->tell_proc(handle) + ch_size;
+			unsigned ch_end = reader.tell() + ch_size;
 
 			if (ch_type == ID_BMHD) {			// Bitmap Header
 				if (dib)
@@ -248,7 +253,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 				BMHD bmhd;
 
-				io->read_proc(&bmhd, sizeof(bmhd), 1, handle);
+				reader.read(&bmhd, sizeof(bmhd));
 #ifndef FREEIMAGE_BIGENDIAN
 				SwapHeader(&bmhd);
 #endif
@@ -278,10 +283,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				RGBQUAD *pal = FreeImage_GetPalette(dib);
 				if(pal != NULL) {
 					unsigned palette_entries = MIN((unsigned)ch_size / 3, FreeImage_GetColorsUsed(dib));
-					for (unsigned k = 0; k < palette_entries; k++) {					
-						io->read_proc(&pal[k].rgbRed, 1, 1, handle );
-						io->read_proc(&pal[k].rgbGreen, 1, 1, handle );
-						io->read_proc(&pal[k].rgbBlue, 1, 1, handle );
+					const BYTE *rgb = reader.getBytes(3 * palette_entries);
+					for (unsigned k = 0; (rgb != NULL) && (k < palette_entries); k++, rgb += 3) {
+						pal[k].rgbRed = rgb[0];
+						pal[k].rgbGreen = rgb[1];
+						pal[k].rgbBlue = rgb[2];
 					}
 				}
 			} else if (ch_type == ID_BODY) {
@@ -299,31 +305,35 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						if (comp == 1) {
 							// use RLE compression
 
-							DWORD number_of_bytes_written = 0;
-							BYTE rle_count;
-							BYTE byte;
+							unsigned number_of_bytes_written = 0;
+							int rle_count;
+							int byte;
 
 							while (number_of_bytes_written < line) {
-								io->read_proc(&rle_count, 1, 1, handle);
+								if ((rle_count = reader.getByte()) == EOF)
+									break;
 
 								if (rle_count < 128) {
-									for (int k = 0; k < rle_count + 1; k++) {
-										io->read_proc(&byte, 1, 1, handle);
+									const BYTE *run = reader.getBytes(rle_count + 1);
+									if (run == NULL)
+										break;
 
-										bits[number_of_bytes_written++] += byte;
-									}
+									unsigned count = MIN((unsigned)rle_count + 1, line - number_of_bytes_written);
+									memcpy(bits + number_of_bytes_written, run, count);
+									number_of_bytes_written += count;
 								} else if (rle_count > 128) {
-									io->read_proc(&byte, 1, 1, handle);
+									if ((byte = reader.getByte()) == EOF)
+										break;
 
-									for (int k = 0; k < 257 - rle_count; k++) {
-										bits[number_of_bytes_written++] += byte;
-									}
+									unsigned count = MIN((unsigned)(257 - rle_count), line - number_of_bytes_written);
+									memset(bits + number_of_bytes_written, byte, count);
+									number_of_bytes_written += count;
 								}
 							}
 						} else {
 							// don't use compression
 
-							io->read_proc(bits, line, 1, handle);
+							reader.read(bits, line);
 						}
 					}
 
@@ -351,8 +361,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 							for(unsigned x = 0; x < src_size;) {
 								// read the next source byte into t
-								signed char t = 0;
-								io->read_proc(&t, 1, 1, handle);
+								int c = reader.getByte();
+								if (c == EOF)
+									break;
+								signed char t = (signed char)c;
 								
 								if (t >= 0) {
 									// t = [0..127] => copy the next t+1 bytes literally
@@ -361,16 +373,15 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 									if((size_to_read + x) > src_size) {
 										// sanity check for buffer overruns 
 										size_to_read = src_size - x;
-										io->read_proc(src + x, size_to_read, 1, handle);
+										reader.read(src + x, size_to_read);
 										x += (t + 1);
 									} else {
-										io->read_proc(src + x, size_to_read, 1, handle);
+										reader.read(src + x, size_to_read);
 										x += size_to_read;
 									}
 								} else if (t != -128) {
 									// t = [-1..-127]  => replicate the next byte -t+1 times
-									BYTE b = 0;
-									io->read_proc(&b, 1, 1, handle);
+									BYTE b = (BYTE)reader.getByte();
 									unsigned size_to_copy = (unsigned)(-(int)t + 1);
 
 									if((size_to_copy + x) > src_size) {
@@ -386,7 +397,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 								// t = -128 => noop
 							}
 						} else {
-							io->read_proc(src, src_size, 1, handle);
+							reader.read(src, src_size);
 						}
 
 						// lazy planar->chunky...
@@ -421,7 +432,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				ch_end++;
 			}
 
-			io->seek_proc(handle, ch_end - io->tell_proc(handle), SEEK_CUR);
+			reader.seek(ch_end, SEEK_SET);
 
 			size -= ch_size + 8;
 		}
@@ -704,9 +704,10 @@ jpeg_read_jfxx(FIBITMAP *dib, const BYTE *dataptr, unsigned int datalen) {
 
 /**
 	Read JPEG special markers
+	@param raw_metadata If TRUE, keep the Exif and IPTC profiles as is (see FIF_LOAD_RAWMETADATA)
 */
 static BOOL 
-read_markers(j_decompress_ptr cinfo, FIBITMAP *dib) {
+read_markers(j_decompress_ptr cinfo, FIBITMAP *dib, BOOL raw_metadata) {
 	jpeg_saved_marker_ptr marker;
 
 	for(marker = cinfo->marker_list; marker != NULL; marker = marker->next) {
@@ -730,13 +731,17 @@ read_markers(j_decompress_ptr cinfo, FIBITMAP *dib) {
 				break;
 			case EXIF_MARKER:
 				// Exif or Adobe XMP profile
-				jpeg_read_exif_profile(dib, marker->data, marker->data_length);
+				if(!raw_metadata || !set_raw_profile(dib, FIMD_EXIF_MAIN, marker->data, marker->data_length)) {
+					jpeg_read_exif_profile(dib, marker->data, marker->data_length);
+				}
 				jpeg_read_xmp_profile(dib, marker->data, marker->data_length);
 				jpeg_read_exif_profile_raw(dib, marker->data, marker->data_length);
 				break;
 			case IPTC_MARKER:
 				// IPTC/NAA or Adobe Photoshop profile
-				jpeg_read_iptc_profile(dib, marker->data, marker->data_length);
+				if(!raw_metadata || !read_iptc_profile_raw(dib, marker->data, marker->data_length)) {
+					jpeg_read_iptc_profile(dib, marker->data, marker->data_length);
+				}
 				break;
 		}
 	}
@@ -825,8 +830,8 @@ static BOOL
 jpeg_write_iptc_profile(j_compress_ptr cinfo, FIBITMAP *dib) {
 	//const char *ps_header = "Photoshop 3.0\x08BIM\x04\x04\x0\x0\x0\x0";
 	const unsigned tag_length = 26;
-
-	if(FreeImage_GetMetadataCount(FIMD_IPTC, dib)) {
+	// a profile loaded with FIF_LOAD_RAWMETADATA is written as is, without decoding its tags
+	if(get_raw_profile(dib, FIMD_IPTC, NULL) || FreeImage_GetMetadataCount(FIMD_IPTC, dib)) {
 		BYTE *profile = NULL;
 		unsigned profile_size = 0;
 
@@ -1278,7 +1283,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			
 			// step 6: read special markers
 			
-			read_markers(&cinfo, dib);
+			read_markers(&cinfo, dib, (flags & FIF_LOAD_RAWMETADATA) == FIF_LOAD_RAWMETADATA);
 
 			// --- header only mode => clean-up and return
 
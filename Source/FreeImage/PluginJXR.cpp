@@ -533,10 +533,11 @@ ReadDescriptiveMetadata(PKImageDecode *pID, FIBITMAP *dib) {
 
 /**
 Read ICC, XMP, Exif, Exif-GPS, IPTC, descriptive (i.e. Exif-TIFF) metadata
+@param flags FreeImage load flags, the IPTC profile is kept as is with FIF_LOAD_RAWMETADATA
 @see ReadProfile, ReadDescriptiveMetadata
 */
 static ERR
-ReadMetadata(PKImageDecode *pID, FIBITMAP *dib) {
+ReadMetadata(PKImageDecode *pID, FIBITMAP *dib, int flags) {
 	ERR error_code = 0;		// error code as returned by the interface
 	size_t currentPos = 0;	// current stream position
 	
@@ -584,7 +585,9 @@ ReadMetadata(PKImageDecode *pID, FIBITMAP *dib) {
 			error_code = ReadProfile(pStream, cbByteCount, uOffset, &pbProfile);
 			JXR_CHECK(error_code);
 			// decode the IPTC profile
-			read_iptc_profile(dib, pbProfile, cbByteCount);
+			if(!(flags & FIF_LOAD_RAWMETADATA) || !read_iptc_profile_raw(dib, pbProfile, cbByteCount)) {
+				read_iptc_profile(dib, pbProfile, cbByteCount);
+			}
 		}
 
 		// Exif metadata
@@ -741,8 +744,8 @@ WriteMetadata(PKImageEncode *pIE, FIBITMAP *dib) {
 			JXR_CHECK(error_code);
 		}
 
-		// write IPTC metadata
-		if(FreeImage_GetMetadataCount(FIMD_IPTC, dib)) {
+		// write IPTC metadata, as is if loaded with FIF_LOAD_RAWMETADATA
+		if(get_raw_profile(dib, FIMD_IPTC, NULL) || FreeImage_GetMetadataCount(FIMD_IPTC, dib)) {
 			// create a binary profile
 			if(write_iptc_profile(dib, &profile, &profile_size)) {
 				// write the profile
@@ -1197,7 +1200,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 
 		// get metadata & ICC profile
-		error_code = ReadMetadata(pDecoder, dib);
+		error_code = ReadMetadata(pDecoder, dib, flags);
 		JXR_CHECK(error_code);
 
 		if(header_only) {
@@ -25,13 +25,12 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "RLECodec.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
 // ----------------------------------------------------------
 
-#define PCX_IO_BUF_SIZE	2048
-
 // ----------------------------------------------------------
 
 #ifdef _WIN32
@@ -114,61 +113,21 @@ THIS IS HOW RUNTIME LENGTH ENCODING WORKS IN PCX:
 
 Note that a scanline always has an even number of bytes
 
-@param io FreeImage IO
-@param handle FreeImage handle
-@param buffer
-@param length
-@param bIsRLE
-@param ReadBuf
-@param ReadPos
-@return
+@param reader Buffered input stream
+@param buffer Output scanline
+@param length Scanline length in bytes
+@param bIsRLE TRUE if the scanline is run-length encoded
+@return Returns the number of bytes written to buffer
 */
 static unsigned
-readLine(FreeImageIO *io, fi_handle handle, BYTE *buffer, unsigned length, BOOL bIsRLE, BYTE * ReadBuf, int * ReadPos) {
-	BYTE count = 0;
-	BYTE value = 0;
-	unsigned written = 0;
-
+readLine(BufferedReader &reader, BYTE *buffer, unsigned length, BOOL bIsRLE) {
 	if (bIsRLE) {
 		// run-length encoded read
-
-		while (length--) {
-			if (count == 0) {
-				if (*ReadPos >= PCX_IO_BUF_SIZE - 1 ) {
-					if (*ReadPos == PCX_IO_BUF_SIZE - 1) {
-						// we still have one BYTE, copy it to the start pos
-						*ReadBuf = ReadBuf[PCX_IO_BUF_SIZE - 1];
-						io->read_proc(ReadBuf + 1, 1, PCX_IO_BUF_SIZE - 1, handle);
-					} else {
-						// read the complete buffer
-						io->read_proc(ReadBuf, 1, PCX_IO_BUF_SIZE, handle);
-					}
-
-					*ReadPos = 0;
-				}
-
-				value = *(ReadBuf + (*ReadPos)++);
-
-				if ((value & 0xC0) == 0xC0) {
-					count = value & 0x3F;
-					value = *(ReadBuf + (*ReadPos)++);
-				} else {
-					count = 1;
-				}
-			}
-
-			count--;
-
-			*(buffer + written++) = value;
-		}
-
-	} else {
-		// normal read
-
-		written = io->read_proc(buffer, length, 1, handle);
+		return PCXRLE_DecodeLine(reader, buffer, length);
 	}
 
-	return written;
+	// normal read
+	return reader.read(buffer, length);
 }
 
 #ifdef FREEIMAGE_BIGENDIAN
@@ -347,7 +306,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	BYTE *bits;			  // Pointer to dib data
 	RGBQUAD *pal;		  // Pointer to dib palette
 	BYTE *line = NULL;	  // PCX raster line
-	BYTE *ReadBuf = NULL; // buffer;
 	BOOL bIsRLE;		  // True if the file is run-length encoded
 
 	if(!handle) {
@@ -516,39 +474,24 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			throw FI_MSG_ERROR_MEMORY;
 		}
 		
-		ReadBuf = (BYTE*)malloc(PCX_IO_BUF_SIZE * sizeof(BYTE));
-		if(!ReadBuf) {
+		BufferedReader reader(io, handle);
+		if(reader.isNull()) {
 			throw FI_MSG_ERROR_MEMORY;
 		}
 		
 		bits = FreeImage_GetScanLine(dib, height - 1);
 
-		int ReadPos = PCX_IO_BUF_SIZE;
-
 		if ((header.planes == 1) && ((header.bpp == 1) || (header.bpp == 8))) {
-			BYTE skip;
-			unsigned written;
-
 			for (unsigned y = 0; y < height; y++) {
 				// do a safe copy of the scanline into 'line'
-				written = readLine(io, handle, line, lineLength, bIsRLE, ReadBuf, &ReadPos);
+				readLine(reader, line, lineLength, bIsRLE);
 				// sometimes (already encountered), PCX images can have a lineLength > pitch
 				memcpy(bits, line, MIN(pitch, lineLength));
 
-				// skip trailing garbage at the end of the scanline
-
-				for (unsigned count = written; count < lineLength; count++) {
-					if (ReadPos < PCX_IO_BUF_SIZE) {
-						ReadPos++;
-					} else {
-						io->read_proc(&skip, sizeof(BYTE), 1, handle);
-					}
-				}
-
 				bits -= pitch;
 			}
 		} else if ((header.planes == 4) && (header.bpp == 1)) {
-			BYTE bit,  mask, skip;
+			BYTE bit,  mask;
 			unsigned index;
 			BYTE *buffer;
 
@@ -558,7 +501,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}
 
 			for (unsigned y = 0; y < height; y++) {
-				unsigned written = readLine(io, handle, line, lineLength, bIsRLE, ReadBuf, &ReadPos);
+				readLine(reader, line, lineLength, bIsRLE);
 
 				// build a nibble using the 4 planes
 
@@ -580,16 +523,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					bits[x] = (buffer[2*x] << 4) | buffer[2*x+1];
 				}
 
-				// skip trailing garbage at the end of the scanline
-
-				for (unsigned count = written; count < lineLength; count++) {
-					if (ReadPos < PCX_IO_BUF_SIZE) {
-						ReadPos++;
-					} else {
-						io->read_proc(&skip, sizeof(BYTE), 1, handle);
-					}
-				}
-
 				bits -= pitch;
 			}
 
@@ -599,7 +532,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			BYTE *pLine;
 
 			for (unsigned y = 0; y < height; y++) {
-				readLine(io, handle, line, lineLength, bIsRLE, ReadBuf, &ReadPos);
+				readLine(reader, line, lineLength, bIsRLE);
 
 				// convert the plane stream to BGR (RRRRGGGGBBBB -> BGRBGRBGRBGR)
 				// well, now with the FI_RGBA_x macros, on BIGENDIAN we convert to RGB
@@ -629,7 +562,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 
 		free(line);
-		free(ReadBuf);
 
 		return dib;
 
@@ -642,9 +574,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		if (line != NULL) {
 			free(line);
 		}
-		if (ReadBuf != NULL) {
-			free(ReadBuf);
-		}
 
 		FreeImage_OutputMessageProc(s_format_id, text);
 	}
@@ -70,6 +70,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 // ==========================================================
 // Plugin Interface
@@ -956,10 +957,23 @@ static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	char outputMessage[ outputMessageSize ] = "";
 	FIBITMAP* dib = NULL;
+
+	// the opcode parser reads a few bytes at a time, route it through a read-ahead buffer
+	BufferedReader reader(io, handle);
+	if ( reader.isNull() ) {
+		return NULL;
+	}
+	FreeImageIO buffered_io;
+	SetBufferedIO(&buffered_io);
+	io = &buffered_io;
+	handle = (fi_handle)&reader;
+
 	try {		
 		// Skip empty 512 byte header.
-		if ( !io->seek_proc(handle, 512, SEEK_CUR) == 0 )
+		if ( !io->seek_proc(handle, 512, SEEK_CUR) == 0 ) {
+			reader.release();
 			return NULL;
+		}
 		
 		// Read PICT header
 		Read16( io, handle ); // Skip version 1 picture size
@@ -1307,9 +1321,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}			
 		}
 		
+		reader.release();
 		return dib;
 	} 
 	catch(const char *message) {
+		// leave the stream where the parser stopped
+		reader.release();
 		FreeImage_Unload( dib );
 		FreeImage_OutputMessageProc(s_format_id, message);
 	}
@@ -22,101 +22,348 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "RLECodec.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FI_PNM_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 // ==========================================================
 // Internal functions
 // ==========================================================
 
 /**
-Get an integer value from the actual position pointed by handle
+Skip whitespace and comments up to the next digit
+@return Returns the digit character
 */
-static int
-GetInt(FreeImageIO *io, fi_handle handle) {
-    char c = 0;
-	BOOL bFirstChar;
+static inline int
+SkipToDigit(BufferedReader &reader) {
+	int c = reader.getByte();
+
+	while ((unsigned)(c - '0') > 9) {
+		if (c == '#') {
+			// if we're at a comment, read to end of line
+			do {
+				c = reader.getByte();
+			} while ((c != '\n') && (c != EOF));
+		}
+		if (c == EOF) {
+			throw FI_MSG_ERROR_PARSING;
+		}
+		c = reader.getByte();
+	}
+
+	return c;
+}
+
+/**
+Get an integer value from the actual position of the stream.
+The character following the number is consumed.
+Values are saturated to INT_MAX while the digits are read, so that long numbers never wrap.
+*/
+static inline unsigned
+GetInt(BufferedReader &reader) {
+	int c = SkipToDigit(reader);
+
+	// we're at the start of a number, continue until we hit a non-number
+
+	unsigned i = 0;
+
+	do {
+		const unsigned digit = (unsigned)(c - '0');
+		i = (i <= (INT_MAX - digit) / 10) ? (i * 10) + digit : INT_MAX;
+		c = reader.getByte();
+	} while ((unsigned)(c - '0') <= 9);
+
+	return i;
+}
 
-    // skip forward to start of next number
+/** Size of the blocks parsed by ParseIntBlock */
+#define PNM_BLOCK_SIZE 64
 
-	if(!io->read_proc(&c, 1, 1, handle)) {
-		throw FI_MSG_ERROR_PARSING;
+#if defined(FI_PNM_SSE2) && !defined(FREEIMAGE_BIGENDIAN)
+/**
+Index of the lowest set bit of a non-zero mask
+*/
+static inline unsigned
+CountTrailingZeros(UINT64 mask) {
+#if defined(__GNUC__)
+	return (unsigned)__builtin_ctzll(mask);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, mask);
+	return (unsigned)index;
+#else
+	unsigned index = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		index++;
 	}
+	return index;
+#endif
+}
 
-    while (1) {
-        // eat comments
+/**
+Returns a mask of the digits of a 16-byte block, and a mask of its comment starts
+*/
+static inline unsigned
+ClassifyBlock(const BYTE *p, unsigned *comments) {
+	const __m128i block = _mm_loadu_si128((const __m128i*)p);
 
-        if (c == '#') {
-			// if we're at a comment, read to end of line
+	// signed compares : bytes above 0x7F are not digits
+	const __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+	*comments = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('#')));
 
-            bFirstChar = TRUE;
+	return (unsigned)_mm_movemask_epi8(is_digit);
+}
 
-            while (1) {
-				if(!io->read_proc(&c, 1, 1, handle)) {
-					throw FI_MSG_ERROR_PARSING;
-				}
+/**
+Converts 1 to 8 ASCII digits at once (SWAR)
+@param p Digits, followed by at least 8 - length readable bytes
+@param length Number of digits
+*/
+static inline unsigned
+ConvertDigits(const BYTE *p, unsigned length) {
+	// left align the digits on 8 bytes, leading bytes become zeros
+	UINT64 chunk;
+	memcpy(&chunk, p, sizeof(chunk));
+	chunk = (chunk & 0x0F0F0F0F0F0F0F0FULL) << (8 * (8 - length));
+
+	// combine pairs of digits, then pairs of pairs, ...
+	chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+	chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+	chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFULL;
+
+	return (unsigned)chunk;
+}
 
-				if (bFirstChar && c == ' ') {
-					// loop off 1 sp after #
-					bFirstChar = FALSE;
-				} else if (c == '\n') {
-					break;
-				}
-			}
-		}
+/**
+Parse the integers of a 64-byte block. Digits and separators are located with SSE2, 
+token boundaries are then read from the masks, so that integers do not depend on each other.
+Parsing stops before a comment, a number longer than 8 digits or a number that is not terminated within the block.
+@param p Block start, at least PNM_BLOCK_SIZE + 8 readable bytes
+@param values Receives the integers
+@param max_count Maximum number of integers to parse
+@param count Receives the number of integers parsed
+@return Returns the number of bytes used (terminator of the last integer included)
+*/
+static unsigned
+ParseIntBlock(const BYTE *p, unsigned *values, unsigned max_count, unsigned *count) {
+	unsigned c0, c1, c2, c3;
+	const UINT64 digits = 
+		  (UINT64)ClassifyBlock(p, &c0) 
+		| ((UINT64)ClassifyBlock(p + 16, &c1) << 16) 
+		| ((UINT64)ClassifyBlock(p + 32, &c2) << 32) 
+		| ((UINT64)ClassifyBlock(p + 48, &c3) << 48);
+	const UINT64 comments = (UINT64)c0 | ((UINT64)c1 << 16) | ((UINT64)c2 << 32) | ((UINT64)c3 << 48);
+
+	// first digit and first terminator of each number
+	UINT64 starts = digits & ~(digits << 1);
+	UINT64 ends = ~digits & (digits << 1);
+
+	if (comments) {
+		// let the scalar parser skip the comment
+		const UINT64 before = (comments & (~comments + 1)) - 1;
+		starts &= before;
+		ends &= before;
+	}
 
-        if (c >= '0' && c <='9') {
-			// we've found what we were looking for
-            break;
-		}
+	unsigned n = 0;
+	unsigned used = 0;
 
-		if(!io->read_proc(&c, 1, 1, handle)) {
-			throw FI_MSG_ERROR_PARSING;
+	while (starts && ends && (n < max_count)) {
+		const unsigned start = CountTrailingZeros(starts);
+		const unsigned end = CountTrailingZeros(ends);
+		if (end - start > 8) {
+			break;
 		}
-    }
+		values[n++] = ConvertDigits(p + start, end - start);
+		used = end + 1;
 
-    // we're at the start of a number, continue until we hit a non-number
+		// clear the lowest bits
+		starts &= starts - 1;
+		ends &= ends - 1;
+	}
 
-    int i = 0;
+	*count = n;
 
-    while (1) {
-        i = (i * 10) + (c - '0');
+	return used;
+}
+#endif // FI_PNM_SSE2
 
-		if(!io->read_proc(&c, 1, 1, handle)) {
-			throw FI_MSG_ERROR_PARSING;
+/**
+Plain PNM sample input : integers are parsed by blocks and clamped to [0..maxval]
+*/
+class AsciiReader {
+public:
+	/**
+	@param reader Input stream, positioned after the header
+	@param maxval Maximum sample value
+	@param count Number of samples of the image
+	*/
+	AsciiReader(BufferedReader &reader, unsigned maxval, UINT64 count) :
+		_reader(reader), _maxval(maxval), _remaining(count), _pos(0), _count(0) {
+	}
+
+	/** Returns the next sample */
+	inline unsigned getSample() {
+		if (_pos == _count) {
+			refill();
 		}
+		return _samples[_pos++];
+	}
 
-		if (c < '0' || c > '9') {
-			break;
+private:
+	void refill() {
+		_pos = 0;
+		_count = 0;
+
+#if defined(FI_PNM_SSE2) && !defined(FREEIMAGE_BIGENDIAN)
+		// do not read beyond the image samples
+		const unsigned max_count = (unsigned)MIN(_remaining, (UINT64)(PNM_BLOCK_SIZE / 2));
+		const BYTE *block = _reader.peek(PNM_BLOCK_SIZE + 8);
+		if (block && max_count) {
+			const unsigned used = ParseIntBlock(block, _samples, max_count, &_count);
+			_reader.getBytes(used);
 		}
-    }
+#endif
+
+		if (_count == 0) {
+			// comments, long numbers and the end of the stream
+			_samples[0] = GetInt(_reader);
+			_count = 1;
+		}
+
+		for (unsigned i = 0; i < _count; i++) {
+			_samples[i] = MIN(_samples[i], _maxval);
+		}
+		_remaining -= MIN((UINT64)_count, _remaining);
+	}
 
-    return i;
+private:
+	BufferedReader &_reader;
+	const unsigned _maxval;
+	UINT64 _remaining;
+	unsigned _pos;
+	unsigned _count;
+	unsigned _samples[PNM_BLOCK_SIZE / 2];	// at most one number every 2 bytes
+};
+
+/**
+Get a PBM bit from the actual position of the stream.
+Bits are single digits, they need not be separated by whitespace.
+*/
+static inline BOOL
+GetBit(BufferedReader &reader) {
+	return (SkipToDigit(reader) != '0');
 }
 
 /**
-Read a WORD value taking into account the endianess issue
+Read a row of big endian WORD values
 */
-static inline WORD 
-ReadWord(FreeImageIO *io, fi_handle handle) {
-	WORD level = 0;
-	io->read_proc(&level, 2, 1, handle); 
+static inline void 
+ReadWords(BufferedReader &reader, WORD *values, unsigned count) {
+	reader.read(values, count * sizeof(WORD));
 #ifndef FREEIMAGE_BIGENDIAN
-	SwapShort(&level);	// PNM uses the big endian convention
+	for (unsigned i = 0; i < count; i++) {
+		SwapShort(&values[i]);	// PNM uses the big endian convention
+	}
 #endif
-	return level;
 }
 
 /**
-Write a WORD value taking into account the endianess issue
+Write a row of WORD values taking into account the endianess issue
 */
 static inline void 
-WriteWord(FreeImageIO *io, fi_handle handle, const WORD value) {
-	WORD level = value;
+WriteWords(FreeImageIO *io, fi_handle handle, const WORD *values, unsigned count, WORD *buffer) {
+	for (unsigned i = 0; i < count; i++) {
+		buffer[i] = values[i];
 #ifndef FREEIMAGE_BIGENDIAN
-	SwapShort(&level);	// PNM uses the big endian convention
+		SwapShort(&buffer[i]);	// PNM uses the big endian convention
 #endif
-	io->write_proc(&level, 2, 1, handle);
+	}
+	io->write_proc(buffer, count * sizeof(WORD), 1, handle);
 }
 
+/**
+Buffered output of plain PNM values.
+Each value is right aligned on a fixed number of digits and followed by a space, 
+lines are wrapped so that no line is longer than 70 characters.
+*/
+class AsciiWriter {
+public:
+	/**
+	@param digits Number of digits per value (values must fit)
+	@param wrap Line length above which a new line is started
+	*/
+	AsciiWriter(FreeImageIO *io, fi_handle handle, unsigned digits, unsigned wrap) :
+		_io(io), _handle(handle), _digits(digits), _wrap(wrap), _length(0), _ptr(_buffer) {
+		// 8-bit values are formatted once
+		for (unsigned value = 0; value < 256; value++) {
+			format(_formatted[value], value);
+		}
+	}
+
+	~AsciiWriter() {
+		flush();
+	}
+
+	inline void putValue(unsigned value) {
+		if (_ptr + sizeof(_formatted[0]) + 1 > _buffer + sizeof(_buffer)) {
+			flush();
+		}
+
+		if (value < 256) {
+			memcpy(_ptr, _formatted[value], sizeof(_formatted[0]));
+		} else {
+			format(_ptr, value);
+		}
+		_ptr += _digits + 1;
+
+		_length += _digits + 1;
+		if (_length > _wrap) {
+			*_ptr++ = '\n';
+			_length = 0;
+		}
+	}
+
+	void flush() {
+		if (_ptr > _buffer) {
+			_io->write_proc(_buffer, (unsigned)(_ptr - _buffer), 1, _handle);
+			_ptr = _buffer;
+		}
+	}
+
+private:
+	/** Writes the digits backward, then pads with spaces */
+	inline void format(BYTE *dst, unsigned value) const {
+		BYTE *p = dst + _digits;
+		*p = ' ';
+		do {
+			*--p = (BYTE)('0' + value % 10);
+			value /= 10;
+		} while (value && (p > dst));
+		while (p > dst) {
+			*--p = ' ';
+		}
+	}
+
+private:
+	FreeImageIO *_io;
+	fi_handle _handle;
+	const unsigned _digits;
+	const unsigned _wrap;
+	unsigned _length;
+	BYTE *_ptr;
+	BYTE _formatted[256][8];
+	BYTE _buffer[8192];
+};
+
 
 // ==========================================================
 // Plugin Interface
@@ -225,6 +472,13 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 	BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
+	// the header and the pixels are read through a buffer, ASCII files are parsed byte by byte
+	BufferedReader reader(io, handle);
+	if (reader.isNull()) {
+		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+		return NULL;
+	}
+
 	try {
 		FREE_IMAGE_TYPE image_type = FIT_BITMAP;	// standard image: 1-, 8-, 24-bit
 
@@ -242,8 +496,8 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 		// Read the header information: width, height and the 'max' value if any
 
-		const int width  = GetInt(io, handle);
-		const int height = GetInt(io, handle);
+		const int width  = (int)GetInt(reader);
+		const int height = (int)GetInt(reader);
 		int maxval = 1;
 
 		if (width < 0 || height < 0) {
@@ -251,7 +505,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 
 		if((id_two == '2') || (id_two == '5') || (id_two == '3') || (id_two == '6')) {
-			maxval = GetInt(io, handle);
+			maxval = (int)GetInt(reader);
 			if((maxval <= 0) || (maxval > 65535)) {
 				FreeImage_OutputMessageProc(s_format_id, "Invalid max value : %d", maxval);
 				throw (const char*)NULL;
@@ -327,6 +581,15 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			return dib;
 		}
 
+		// 8-bit sample scaling, values above maxval are clamped
+
+		BYTE scale[256];
+		if(image_type == FIT_BITMAP) {
+			for (i = 0; i < 256; i++) {
+				scale[i] = (BYTE)((255 * MIN(i, maxval)) / maxval);
+			}
+		}
+
 		// Read the image...
 
 		switch(id_two)  {
@@ -339,7 +602,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
 						for (x = 0; x < width; x++) {
-							if (GetInt(io, handle) == 0)
+							if (!GetBit(reader))
 								bits[x >> 3] |= (0x80 >> (x & 0x7));
 							else
 								bits[x >> 3] &= (0xFF7F >> (x & 0x7));
@@ -351,15 +614,14 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					for (y = 0; y < height; y++) {	
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
-						for (x = 0; x < line; x++) {
-							io->read_proc(&bits[x], 1, 1, handle);
+						reader.read(bits, line);
 
+						for (x = 0; x < line; x++) {
 							bits[x] = ~bits[x];
 						}
 					}
 				}
-
-				return dib;
+				break;
 
 			case '2':
 			case '5':
@@ -367,25 +629,25 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					// write the bitmap data
 
 					if(id_two == '2') {		// ASCII greymap
-						int level = 0;
+						AsciiReader ascii(reader, maxval, (UINT64)width * height);
 
 						for (y = 0; y < height; y++) {	
 							BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
 							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[x] = (BYTE)((255 * level) / maxval);
+								bits[x] = scale[ascii.getSample()];
 							}
 						}
 					} else {		// Raw greymap
-						BYTE level = 0;
-
 						for (y = 0; y < height; y++) {		
 							BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
-							for (x = 0; x < width; x++) {
-								io->read_proc(&level, 1, 1, handle);
-								bits[x] = (BYTE)((255 * (int)level) / maxval);
+							reader.read(bits, width);
+
+							if (maxval != 255) {
+								for (x = 0; x < width; x++) {
+									bits[x] = scale[bits[x]];
+								}
 							}
 						}
 					}
@@ -394,31 +656,30 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					// write the bitmap data
 
 					if(id_two == '2') {		// ASCII greymap
-						int level = 0;
+						AsciiReader ascii(reader, maxval, (UINT64)width * height);
 
 						for (y = 0; y < height; y++) {	
 							WORD *bits = (WORD*)FreeImage_GetScanLine(dib, height - 1 - y);
 
 							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[x] = (WORD)((65535 * (double)level) / maxval);
+								bits[x] = (WORD)((65535 * (double)ascii.getSample()) / maxval);
 							}
 						}
 					} else {		// Raw greymap
-						WORD level = 0;
-
 						for (y = 0; y < height; y++) {		
 							WORD *bits = (WORD*)FreeImage_GetScanLine(dib, height - 1 - y);
 
-							for (x = 0; x < width; x++) {
-								level = ReadWord(io, handle);
-								bits[x] = (WORD)((65535 * (double)level) / maxval);
+							ReadWords(reader, bits, width);
+
+							if (maxval != 65535) {
+								for (x = 0; x < width; x++) {
+									bits[x] = (WORD)((65535 * (double)MIN((int)bits[x], maxval)) / maxval);
+								}
 							}
 						}
 					}
 				}
-
-				return dib;
+				break;
 
 			case '3':
 			case '6':
@@ -426,37 +687,34 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					// write the bitmap data
 
 					if (id_two == '3') {		// ASCII pixmap
-						int level = 0;
+						AsciiReader ascii(reader, maxval, (UINT64)width * height * 3);
 
 						for (y = 0; y < height; y++) {	
 							BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
 							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[FI_RGBA_RED] = (BYTE)((255 * level) / maxval);		// R
-								level = GetInt(io, handle);
-								bits[FI_RGBA_GREEN] = (BYTE)((255 * level) / maxval);	// G
-								level = GetInt(io, handle);
-								bits[FI_RGBA_BLUE] = (BYTE)((255 * level) / maxval);	// B
+								bits[FI_RGBA_RED] = scale[ascii.getSample()];		// R
+								bits[FI_RGBA_GREEN] = scale[ascii.getSample()];	// G
+								bits[FI_RGBA_BLUE] = scale[ascii.getSample()];	// B
 
 								bits += 3;
 							}
 						}
 					}  else {			// Raw pixmap
-						BYTE level = 0;
-
 						for (y = 0; y < height; y++) {	
 							BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
-							for (x = 0; x < width; x++) {
-								io->read_proc(&level, 1, 1, handle); 
-								bits[FI_RGBA_RED] = (BYTE)((255 * (int)level) / maxval);	// R
+							// read the RGB scanline, then convert it in place
+							reader.read(bits, width * 3);
 
-								io->read_proc(&level, 1, 1, handle);
-								bits[FI_RGBA_GREEN] = (BYTE)((255 * (int)level) / maxval);	// G
+							for (x = 0; x < width; x++) {
+								const BYTE r = scale[bits[0]];
+								const BYTE g = scale[bits[1]];
+								const BYTE b = scale[bits[2]];
 
-								io->read_proc(&level, 1, 1, handle);
-								bits[FI_RGBA_BLUE] = (BYTE)((255 * (int)level) / maxval);	// B
+								bits[FI_RGBA_RED] = r;		// R
+								bits[FI_RGBA_GREEN] = g;	// G
+								bits[FI_RGBA_BLUE] = b;		// B
 
 								bits += 3;
 							}
@@ -467,41 +725,42 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					// write the bitmap data
 
 					if (id_two == '3') {		// ASCII pixmap
-						int level = 0;
+						AsciiReader ascii(reader, maxval, (UINT64)width * height * 3);
 
 						for (y = 0; y < height; y++) {	
 							FIRGB16 *bits = (FIRGB16*)FreeImage_GetScanLine(dib, height - 1 - y);
 
 							for (x = 0; x < width; x++) {
-								level = GetInt(io, handle);
-								bits[x].red = (WORD)((65535 * (double)level) / maxval);		// R
-								level = GetInt(io, handle);
-								bits[x].green = (WORD)((65535 * (double)level) / maxval);	// G
-								level = GetInt(io, handle);
-								bits[x].blue = (WORD)((65535 * (double)level) / maxval);	// B
+								bits[x].red = (WORD)((65535 * (double)ascii.getSample()) / maxval);		// R
+								bits[x].green = (WORD)((65535 * (double)ascii.getSample()) / maxval);	// G
+								bits[x].blue = (WORD)((65535 * (double)ascii.getSample()) / maxval);	// B
 							}
 						}
 					}  else {			// Raw pixmap
-						WORD level = 0;
-
 						for (y = 0; y < height; y++) {	
 							FIRGB16 *bits = (FIRGB16*)FreeImage_GetScanLine(dib, height - 1 - y);
 
-							for (x = 0; x < width; x++) {
-								level = ReadWord(io, handle);
-								bits[x].red = (WORD)((65535 * (double)level) / maxval);		// R
-								level = ReadWord(io, handle);
-								bits[x].green = (WORD)((65535 * (double)level) / maxval);	// G
-								level = ReadWord(io, handle);
-								bits[x].blue = (WORD)((65535 * (double)level) / maxval);	// B
+							// FIRGB16 has the file channel order
+							ReadWords(reader, (WORD*)bits, width * 3);
+
+							if (maxval != 65535) {
+								for (x = 0; x < width; x++) {
+									bits[x].red = (WORD)((65535 * (double)MIN((int)bits[x].red, maxval)) / maxval);		// R
+									bits[x].green = (WORD)((65535 * (double)MIN((int)bits[x].green, maxval)) / maxval);	// G
+									bits[x].blue = (WORD)((65535 * (double)MIN((int)bits[x].blue, maxval)) / maxval);	// B
+								}
 							}
 						}
 					}
 				}
-
-				return dib;
+				break;
 		}
 
+		// give back the bytes read ahead
+		reader.release();
+
+		return dib;
+
 	} catch (const char *text)  {
 		if(dib) FreeImage_Unload(dib);
 
@@ -613,6 +872,15 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	// Write the image data
 	///////////////////////
 
+	// raw scanlines that need conversion are written through a line buffer
+	WORD *line = NULL;
+	if ((flags == PNM_SAVE_RAW) && ((bpp == 24) || (image_type != FIT_BITMAP))) {
+		line = (WORD*)malloc(width * sizeof(FIRGB16));
+		if (!line) {
+			return FALSE;
+		}
+	}
+
 	if(image_type == FIT_BITMAP) {
 		switch(bpp)  {
 			case 24 :            // 24-bit RGB, 3 bytes per pixel
@@ -621,40 +889,35 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 					for (y = 0; y < height; y++) {
 						// write the scanline to disc
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
+						BYTE *rgb = (BYTE*)line;
 
 						for (x = 0; x < width; x++) {
-							io->write_proc(&bits[FI_RGBA_RED], 1, 1, handle);	// R
-							io->write_proc(&bits[FI_RGBA_GREEN], 1, 1, handle);	// G
-							io->write_proc(&bits[FI_RGBA_BLUE], 1, 1, handle);	// B
+							rgb[0] = bits[FI_RGBA_RED];		// R
+							rgb[1] = bits[FI_RGBA_GREEN];	// G
+							rgb[2] = bits[FI_RGBA_BLUE];	// B
 
+							rgb += 3;
 							bits += 3;
 						}
+
+						io->write_proc(line, width * 3, 1, handle);
 					}
 				} else {
-					int length = 0;
+					// No line should be longer than 70 characters
+					AsciiWriter writer(io, handle, 3, 58);
 
 					for (y = 0; y < height; y++) {
 						// write the scanline to disc
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 						
 						for (x = 0; x < width; x++) {
-							sprintf(buffer, "%3d %3d %3d ", bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE]);
-
-							io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-
-							length += 12;
-
-							if(length > 58) {
-								// No line should be longer than 70 characters
-								sprintf(buffer, "\n");
-								io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-								length = 0;
-							}
+							writer.putValue(bits[FI_RGBA_RED]);
+							writer.putValue(bits[FI_RGBA_GREEN]);
+							writer.putValue(bits[FI_RGBA_BLUE]);
 
 							bits += 3;
 						}					
 					}
-
 				}
 			}
 			break;
@@ -666,30 +929,18 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 						// write the scanline to disc
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
-						for (x = 0; x < width; x++) {
-							io->write_proc(&bits[x], 1, 1, handle);
-						}
+						io->write_proc(bits, width, 1, handle);
 					}
 				} else {
-					int length = 0;
+					// No line should be longer than 70 characters
+					AsciiWriter writer(io, handle, 3, 66);
 
 					for (y = 0; y < height; y++) {
 						// write the scanline to disc
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
 						for (x = 0; x < width; x++) {
-							sprintf(buffer, "%3d ", bits[x]);
-
-							io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-
-							length += 4;
-
-							if (length > 66) {
-								// No line should be longer than 70 characters
-								sprintf(buffer, "\n");
-								io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-								length = 0;
-							}
+							writer.putValue(bits[x]);
 						}
 					}
 				}
@@ -698,38 +949,23 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 
 			case 1:		// 1-bit B & W
 			{
-				int color;
-
 				if (flags == PNM_SAVE_RAW)  {
 					for(y = 0; y < height; y++) {
 						// write the scanline to disc
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
-						for(x = 0; x < (int)FreeImage_GetLine(dib); x++)
-							io->write_proc(&bits[x], 1, 1, handle);
+						io->write_proc(bits, FreeImage_GetLine(dib), 1, handle);
 					}
 				} else  {
-					int length = 0;
+					// No line should be longer than 70 characters
+					AsciiWriter writer(io, handle, 1, 68);
 
 					for (y = 0; y < height; y++) {
 						// write the scanline to disc
 						BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
 
-						for (x = 0; x < (int)FreeImage_GetLine(dib) * 8; x++)	{
-							color = (bits[x>>3] & (0x80 >> (x & 0x07))) != 0;
-
-							sprintf(buffer, "%c ", color ? '1':'0');
-
-							io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-
-							length += 2;
-
-							if (length > 68) {
-								// No line should be longer than 70 characters
-								sprintf(buffer, "\n");
-								io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-								length = 0;
-							}
+						for (x = 0; x < width; x++)	{
+							writer.putValue((bits[x>>3] & (0x80 >> (x & 0x07))) != 0);
 						}
 					}
 				}
@@ -745,30 +981,18 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 				// write the scanline to disc
 				WORD *bits = (WORD*)FreeImage_GetScanLine(dib, height - 1 - y);
 
-				for (x = 0; x < width; x++) {
-					WriteWord(io, handle, bits[x]);
-				}
+				WriteWords(io, handle, bits, width, line);
 			}
 		} else {
-			int length = 0;
+			// No line should be longer than 70 characters
+			AsciiWriter writer(io, handle, 5, 64);
 
 			for (y = 0; y < height; y++) {
 				// write the scanline to disc
 				WORD *bits = (WORD*)FreeImage_GetScanLine(dib, height - 1 - y);
 
 				for (x = 0; x < width; x++) {
-					sprintf(buffer, "%5d ", bits[x]);
-
-					io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-
-					length += 6;
-
-					if (length > 64) {
-						// No line should be longer than 70 characters
-						sprintf(buffer, "\n");
-						io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-						length = 0;
-					}
+					writer.putValue(bits[x]);
 				}
 			}
 		}
@@ -777,41 +1001,30 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	else if(image_type == FIT_RGB16) {		// 48-bit RGB
 		if (flags == PNM_SAVE_RAW)  {
 			for (y = 0; y < height; y++) {
-				// write the scanline to disc
+				// write the scanline to disc, FIRGB16 has the file channel order
 				FIRGB16 *bits = (FIRGB16*)FreeImage_GetScanLine(dib, height - 1 - y);
 
-				for (x = 0; x < width; x++) {
-					WriteWord(io, handle, bits[x].red);		// R
-					WriteWord(io, handle, bits[x].green);	// G
-					WriteWord(io, handle, bits[x].blue);	// B
-				}
+				WriteWords(io, handle, (WORD*)bits, width * 3, line);
 			}
 		} else {
-			int length = 0;
+			// No line should be longer than 70 characters
+			AsciiWriter writer(io, handle, 5, 52);
 
 			for (y = 0; y < height; y++) {
 				// write the scanline to disc
 				FIRGB16 *bits = (FIRGB16*)FreeImage_GetScanLine(dib, height - 1 - y);
 				
 				for (x = 0; x < width; x++) {
-					sprintf(buffer, "%5d %5d %5d ", bits[x].red, bits[x].green, bits[x].blue);
-
-					io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-
-					length += 18;
-
-					if(length > 52) {
-						// No line should be longer than 70 characters
-						sprintf(buffer, "\n");
-						io->write_proc(&buffer, (unsigned int)strlen(buffer), 1, handle);
-						length = 0;
-					}
+					writer.putValue(bits[x].red);
+					writer.putValue(bits[x].green);
+					writer.putValue(bits[x].blue);
 				}					
 			}
-
 		}
 	}
 
+	free(line);
+
 	return TRUE;
 }
 
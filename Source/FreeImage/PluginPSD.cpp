@@ -106,15 +106,50 @@ SupportsNoPixels() {
 
 // ----------------------------------------------------------
 
+static void * DLL_CALLCONV
+Open(FreeImageIO *io, fi_handle handle, BOOL read) {
+	// layers are only indexed when the page count is requested or when a layer is loaded, 
+	// so that loading the merged image does not parse the layer records. 
+	// The parser keeps the index for the next pages.
+	return read ? new(std::nothrow) psdParser() : NULL;
+}
+
+static void DLL_CALLCONV
+Close(FreeImageIO *io, fi_handle handle, void *data) {
+	delete (psdParser*)data;
+}
+
+/**
+Page 0 is the merged image, pages 1 .. N are the layers
+*/
+static int DLL_CALLCONV
+PageCount(FreeImageIO *io, fi_handle handle, void *data) {
+	if(!handle || !data) {
+		return 1;
+	}
+	psdParser *parser = (psdParser*)data;
+
+	return 1 + parser->GetLayerCount(io, handle, s_format_id);
+}
+
+// ----------------------------------------------------------
+
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	if(!handle) {
 		return NULL;
 	}
 	try {
-		psdParser parser;
-
-		FIBITMAP *dib = parser.Load(io, handle, s_format_id, flags);
+		psdParser local_parser;
+		psdParser *parser = data ? (psdParser*)data : &local_parser;
+
+		FIBITMAP *dib = NULL;
+		if(page > 0) {
+			// load a single layer
+			dib = parser->LoadLayer(io, handle, s_format_id, page - 1, flags);
+		} else {
+			dib = parser->Load(io, handle, s_format_id, flags);
+		}
 		
 		return dib;
 
@@ -154,9 +189,9 @@ InitPSD(Plugin *plugin, int format_id) {
 	plugin->description_proc = Description;
 	plugin->extension_proc = Extension;
 	plugin->regexpr_proc = NULL;
-	plugin->open_proc = NULL;
-	plugin->close_proc = NULL;
-	plugin->pagecount_proc = NULL;
+	plugin->open_proc = Open;
+	plugin->close_proc = Close;
+	plugin->pagecount_proc = PageCount;
 	plugin->pagecapability_proc = NULL;
 	plugin->load_proc = Load;
 	plugin->save_proc = Save;
@@ -30,6 +30,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "RLECodec.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -86,11 +87,6 @@ typedef struct tagSGIHeader {
 	char reserved[404];
 } SGIHeader;
 
-typedef struct tagRLEStatus {
-  int cnt;
-  int val;
-} RLEStatus;
-
 #ifdef _WIN32
 #pragma pack(pop)
 #else
@@ -128,44 +124,6 @@ SwapHeader(SGIHeader *header) {
 }
 #endif
 
-static int 
-get_rlechar(FreeImageIO *io, fi_handle handle, RLEStatus *pstatus) {
-	if (!pstatus->cnt) {
-		int cnt = 0;
-		while (0 == cnt) {
-			BYTE packed = 0;
-			if(io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1) {
-				return EOF;
-			}
-			cnt = packed;
-		}
-		if (cnt == EOF) {
-			return EOF;
-		}
-		pstatus->cnt = cnt & 0x7F;
-		if (cnt & 0x80) {
-			pstatus->val = -1;
-		} else {
-			BYTE packed = 0;
-			if(io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1) {
-				return EOF;
-			}
-			pstatus->val = packed;
-		}
-	}
-	pstatus->cnt--;
-	if (pstatus->val == -1) {
-		BYTE packed = 0;
-		if(io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1) {
-			return EOF;
-		}
-		return packed;
-	}
-	else {
-		return pstatus->val;
-	}
-}
-
 static const char * DLL_CALLCONV
 Format() {
   return "SGI";
@@ -217,9 +175,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	int i, dim;
 	int bitcount;
 	SGIHeader sgiHeader;
-	RLEStatus my_rle_status;
 	FIBITMAP *dib = NULL;
 	LONG *pRowIndex = NULL;
+	LONG *pRowSize = NULL;
+	BYTE *pRowData = NULL;
 
 	try {
 		// read the header
@@ -279,13 +238,19 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				SwapLong((DWORD*)&pRowIndex[i]);
 			}
 #endif
-			// Discard row size index
-			for (i = 0; i < (int)(index_len * sizeof(LONG)); i++) {
-				BYTE packed = 0;
-				if( io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1 ) {
-					throw SGI_EOF_IN_RLE_INDEX;
-				}
+			// read the row size index
+			pRowSize = (LONG*)malloc(index_len * sizeof(LONG));
+			if(!pRowSize) {
+				throw FI_MSG_ERROR_MEMORY;
 			}
+			if ((unsigned)index_len != io->read_proc(pRowSize, sizeof(LONG), index_len, handle)) {
+				throw SGI_EOF_IN_RLE_INDEX;
+			}
+#ifndef FREEIMAGE_BIGENDIAN
+			for (i = 0; i < index_len; i++) {
+				SwapLong((DWORD*)&pRowSize[i]);
+			}
+#endif
 		}
 		
 		switch(zsize) {
@@ -325,7 +290,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 		// decode the image
 
-		memset(&my_rle_status, 0, sizeof(RLEStatus));
 		
 		int ns = FreeImage_GetPitch(dib);                                                    
 		BYTE *pStartRow = FreeImage_GetScanLine(dib, 0);
@@ -344,29 +308,47 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			numChannels = 4;
 		}
 		
+		// each row is read with a single call, then unpacked (or copied) into its channel
+
+		// a valid RLE row never needs more than 2 bytes per pixel (plus the end of row marker)
+		const unsigned max_rle_size = 2 * width + 1;
+		unsigned max_row_size = width;
+		if (bIsRLE) {
+			for (i = 0; i < height * zsize; i++) {
+				pRowSize[i] = MIN((unsigned)pRowSize[i], max_rle_size);
+				max_row_size = MAX(max_row_size, (unsigned)pRowSize[i]);
+			}
+		}
+		pRowData = (BYTE*)malloc(max_row_size);
+		if(!pRowData) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
+		// RLE rows are usually stored in order, seeking to the next one stays inside the buffer
+		BufferedReader reader(io, handle);
+		if(reader.isNull()) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
 		LONG *pri = pRowIndex;
+		LONG *prs = pRowSize;
 		for (i = 0; i < zsize; i++) {
 			BYTE *pRow = pStartRow + offset_table[i];
-			for (int j = 0; j < height; j++, pRow += ns, pri++) {
-				BYTE *p = pRow;
+			for (int j = 0; j < height; j++, pRow += ns) {
 				if (bIsRLE) {
-					my_rle_status.cnt = 0;
-					io->seek_proc(handle, *pri, SEEK_SET);
-				}
-				for (int k = 0; k < width; k++, p += numChannels) {
-					int ch;
-					BYTE packed = 0;
-					if (bIsRLE) {
-						ch = get_rlechar(io, handle, &my_rle_status);
-						packed = (BYTE)ch;
-					}
-					else {
-						ch = io->read_proc(&packed, sizeof(BYTE), 1, handle);
+					reader.seek(*pri++, SEEK_SET);
+					const unsigned row_size = reader.read(pRowData, (unsigned)*prs++);
+					if (SGIRLE_DecodeStrided(pRow, numChannels, width, pRowData, row_size) < (unsigned)width) {
+						throw SGI_EOF_IN_IMAGE_DATA;
 					}
-					if (ch == EOF) {
+				} else {
+					if (reader.read(pRowData, width) != (unsigned)width) {
 						throw SGI_EOF_IN_IMAGE_DATA;
 					}
-					*p = packed;
+					BYTE *p = pRow;
+					for (int k = 0; k < width; k++, p += numChannels) {
+						*p = pRowData[k];
+					}
 				}
 			}
 		}
@@ -387,11 +369,16 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 		if(pRowIndex)
 			free(pRowIndex);
+		if(pRowSize)
+			free(pRowSize);
+		free(pRowData);
 
 		return dib;
 
 	} catch(const char *text) {
 		if(pRowIndex) free(pRowIndex);
+		if(pRowSize) free(pRowSize);
+		if(pRowData) free(pRowData);
 		if(dib) FreeImage_Unload(dib);
 		FreeImage_OutputMessageProc(s_format_id, text);
 		return NULL;
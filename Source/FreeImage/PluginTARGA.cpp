@@ -27,6 +27,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
+#include "RLECodec.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -201,85 +203,6 @@ FIBITMAP* TargaThumbnail::toFIBITMAP() {
 // Internal functions
 // ==========================================================
 
-/** This class is used when loading RLE compressed images, it implements io cache of fixed size.
-	In general RLE compressed images *should* be compressed line by line with line sizes stored in Scan Line Table section.
-	In reality, however there are images not obeying the specification, compressing image data continuously across lines,
-	making it impossible to load the file cached at every line.
-*/
-class IOCache
-{
-public:
-	IOCache(FreeImageIO *io, fi_handle handle, size_t size) :
-		_ptr(NULL), _begin(NULL), _end(NULL), _size(size), _io(io), _handle(handle)	{
-		  assert(size);
-			_begin = (BYTE*)malloc(size);
-			if (_begin) {
-			_end = _begin + _size;
-			_ptr = _end;	// will force refill on first access
-		}
-	}
-	
-	~IOCache() {
-		if (_begin != NULL) {
-			free(_begin);
-		}	
-	}
-		
-	BOOL isNull() { return _begin == NULL;}
-	
-	inline
-	BYTE getByte() {
-		if (_ptr >= _end) {
-			// need refill
-			_ptr = _begin;
-			_io->read_proc(_ptr, sizeof(BYTE), (unsigned)_size, _handle);	//### EOF - no problem?
-		}
-
-		BYTE result = *_ptr;
-
-		_ptr++;
-
-		return result;
-	}
-	
-	inline
-	BYTE* getBytes(size_t count /*must be < _size!*/) {
-		if (_ptr + count >= _end) {
-			
-			// need refill
-
-			// 'count' bytes might span two cache bounds,
-			// SEEK back to add the remains of the current cache again into the new one
-
-			long read = long(_ptr - _begin);
-			long remaining = long(_size - read);
-
-			_io->seek_proc(_handle, -remaining, SEEK_CUR);
-
-			_ptr = _begin;
-			_io->read_proc(_ptr, sizeof(BYTE), (unsigned)_size, _handle);	//### EOF - no problem?
-		}
-
-		BYTE *result = _ptr;
-
-		_ptr += count;
-
-		return result;
-	}
-
-private:
-	IOCache& operator=(const IOCache& src); // deleted
-	IOCache(const IOCache& other); // deleted
-
-private:
-	BYTE *_ptr;
-	BYTE *_begin;
-	BYTE *_end;
-	const size_t _size;
-	const FreeImageIO *_io;	
-	const fi_handle _handle;	
-};
-
 #ifdef FREEIMAGE_BIGENDIAN
 static void
 SwapHeader(TGAHEADER *header) {
@@ -575,95 +498,91 @@ loadRLE(FIBITMAP*& dib, int width, int height, FreeImageIO* io, fi_handle handle
 	const int file_pixel_size = bPP/8;
 	const int pixel_size = as24bit ? 3 : file_pixel_size;
 
-	const BYTE bpp = as24bit ? 24 : bPP;
-	const int line_size = CalculateLine(width, bpp);
-
 	// Note, many of the params can be computed inside the function.
 	// However, because this is a template function, it will lead to redundant code duplication.
 
-	BYTE rle;
-	BYTE *line_bits;
-
-	// this is used to guard against writing beyond the end of the image (on corrupted rle block)
-	const BYTE* dib_end = FreeImage_GetScanLine(dib, height);//< one-past-end row
-
-	// Compute the rough size of a line...
 	const long pixels_offset = io->tell_proc(handle);
 	const long remaining_size = (eof - pixels_offset);
 	if (remaining_size < height) {
 		throw FI_MSG_ERROR_CORRUPTED;
 	}
-	const long sz = (remaining_size / height);
 
-	// ...and allocate cache of this size (yields good results)
-	IOCache cache(io, handle, sz);
-	if(cache.isNull()) {
+	// In general RLE compressed images *should* be compressed line by line with line sizes stored in Scan Line Table section.
+	// In reality, however there are images not obeying the specification, compressing image data continuously across lines,
+	// the decoder state is kept from one line to the next for this reason.
+
+	BufferedReader reader(io, handle);
+	BYTE *file_line = (BYTE*)malloc(width * file_pixel_size);
+	if(reader.isNull() || !file_line) {
+		free(file_line);
 		FreeImage_Unload(dib);
 		dib = NULL;
 		return;
 	}
-		
-	int x = 0, y = 0;
 
-	line_bits = FreeImage_GetScanLine(dib, y);
+	TGARLEState state;
+	memset(&state, 0, sizeof(TGARLEState));
 
-	while (y < height) {
-
-		rle = cache.getByte();
-
-		BOOL has_rle = rle & 0x80;
-		rle &= ~0x80; // remove type-bit
-
-		BYTE packet_count = rle + 1;
+	for (int y = 0; y < height; y++) {
+		const unsigned decoded = TGARLE_DecodeLine(reader, file_line, width, file_pixel_size, &state);
 
-		//packet_count might be corrupt, test if we are not about to write beyond the last image bit
+		BYTE *line_bits = FreeImage_GetScanLine(dib, y);
+		BYTE *val = file_line;
+		for (unsigned x = 0; x < decoded; x++, line_bits += pixel_size, val += file_pixel_size) {
+			_assignPixel<bPP>(line_bits, val, as24bit);
+		}
 
-		if ((line_bits+x) + packet_count*pixel_size > dib_end) {
+		if (decoded < (unsigned)width) {
 			FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_CORRUPTED);
 			// return what is left from the bitmap
-			return;
+			break;
 		}
+	}
 
-		if (has_rle) {
+	free(file_line);
+}
 
-			// read a pixel value from file...
-			BYTE *val = cache.getBytes(file_pixel_size);
+// --------------------------------------------------------------------------
 
-			//...and fill packet_count pixels with it
+/**
+Wraps the pixels of an uncompressed bottom-left image instead of loading them (see FIF_LOAD_MAPPED)
+@return Returns the mapped dib, returns NULL if the pixels have to be loaded
+*/
+static FIBITMAP* 
+allocateMapped(FreeImageIO *io, fi_handle handle, int flags, long start_offset, const TGAHEADER& header) {
+	if (((flags & FIF_LOAD_MAPPED) != FIF_LOAD_MAPPED) || (flags & (FIF_LOAD_NOPIXELS | TARGA_LOAD_RGB888))) {
+		return NULL;
+	}
 
-			for (int ix = 0; ix < packet_count; ix++) {
-				_assignPixel<bPP>((line_bits+x), val, as24bit);
-				x += pixel_size;
+	// flipped images need to be loaded
+	if (header.is_image_descriptor & 0x30) {
+		return NULL;
+	}
 
-				if (x >= line_size) {
-					x = 0;
-					y++;
-					line_bits = FreeImage_GetScanLine(dib, y);
-				}
+	switch (header.is_pixel_depth) {
+		case 8:
+			if ((header.image_type != TGA_CMAP) && (header.image_type != TGA_MONO)) {
+				return NULL;
 			}
+			break;
 
-		} else {
-			// no rle commpresion
-
-			// copy packet_count pixels from file to dib
-			for (int ix = 0; ix < packet_count; ix++) {
-				BYTE *val = cache.getBytes(file_pixel_size);
-				_assignPixel<bPP>((line_bits+x), val, as24bit);
-				x += pixel_size;
-
-				if (x >= line_size) {
-					x = 0;
-					y++;
-					line_bits = FreeImage_GetScanLine(dib, y);
-				}
-			} //< packet_count
-		} //< has_rle
+		case 24:
+		case 32:
+			// file pixels are BGR(A)
+			if ((FREEIMAGE_COLORORDER != FREEIMAGE_COLORORDER_BGR) || (header.image_type != TGA_RGB) || (header.color_map_type != 0)) {
+				return NULL;
+			}
+			break;
 
-	} //< while height
+		default:
+			return NULL;
+	}
 
-}
+	const long offset = start_offset + (long)sizeof(TGAHEADER) + header.id_length + ((header.color_map_type != 0) ? header.cm_length * header.cm_size / 8 : 0);
+	const unsigned line = CalculateLine(header.is_width, header.is_pixel_depth);
 
-// --------------------------------------------------------------------------
+	return AllocateMappedBitmap(io, handle, offset, line, FIT_BITMAP, header.is_width, header.is_height, header.is_pixel_depth, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+}
 
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
@@ -740,9 +659,15 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// skip comment
 		io->seek_proc(handle, header.id_length, SEEK_CUR);
 
+		// wrap the pixels when possible
+		dib = allocateMapped(io, handle, flags, start_offset, header);
+		const BOOL mapped = (dib != NULL);
+
 		switch (header.is_pixel_depth) {
 			case 8 : {
-				dib = FreeImage_AllocateHeader(header_only, header.is_width, header.is_height, 8);
+				if (!mapped) {
+					dib = FreeImage_AllocateHeader(header_only, header.is_width, header.is_height, 8);
+				}
 				
 				if (dib == NULL) {
 					throw FI_MSG_ERROR_DIB_MEMORY;
@@ -843,7 +768,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					FreeImage_Unload(th);				
 				}
 
-				if(header_only) {
+				if(header_only || mapped) {
 					return dib;
 				}
 					
@@ -975,7 +900,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			case 24 : {
 
-				dib = FreeImage_AllocateHeader(header_only, header.is_width, header.is_height, pixel_bits, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+				if (!mapped) {
+					dib = FreeImage_AllocateHeader(header_only, header.is_width, header.is_height, pixel_bits, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+				}
 
 				if (dib == NULL) {
 					throw FI_MSG_ERROR_DIB_MEMORY;
@@ -987,7 +914,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					FreeImage_Unload(th);
 				}
 				
-				if(header_only) {
+				if(header_only || mapped) {
 					return dib;
 				}
 					
@@ -1019,7 +946,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					pixel_bits = 24;
 				}
 
-				dib = FreeImage_AllocateHeader(header_only, header.is_width, header.is_height, pixel_bits, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+				if (!mapped) {
+					dib = FreeImage_AllocateHeader(header_only, header.is_width, header.is_height, pixel_bits, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+				}
 
 				if (dib == NULL) {
 					throw FI_MSG_ERROR_DIB_MEMORY;
@@ -1038,7 +967,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					FreeImage_Unload(th);
 				}
 
-				if(header_only) {
+				if(header_only || mapped) {
 					return dib;
 				}
 					
@@ -1102,36 +1031,6 @@ hasValidThumbnail(FIBITMAP* dib) {
 		&& FreeImage_GetHeight(thumbnail) <= 255;
 }
 
-/**
-Writes the ready RLE packet to buffer
-*/
-static inline void 
-flushPacket(BYTE*& dest, unsigned pixel_size, BYTE* packet_begin, BYTE*& packet, BYTE& packet_count, BOOL& has_rle) {
-	if (packet_count) {
-		const BYTE type_bit = has_rle ? 0x80 : 0x0;
-		const BYTE write_count = has_rle ? 1 : packet_count;
-
-		// build packet header: zero-based count + type bit
-		assert(packet_count >= 1);
-		BYTE rle = packet_count - 1;
-		rle |= type_bit;
-
-		// write packet header
-		*dest = rle;
-		++dest;
-
-		// write packet data
-		memcpy(dest, packet_begin, write_count * pixel_size);
-		dest += write_count * pixel_size;
-
-		// reset state
-		packet_count = 0;
-		packet = packet_begin;
-		has_rle = FALSE;
-	}
-}
-
-
 static inline void 
 writeToPacket(BYTE* packet, BYTE* pixel, unsigned pixel_size) {
 	// Take care of channel and byte order here, because packet will be flushed straight to the file
@@ -1173,27 +1072,6 @@ writeToPacket(BYTE* packet, BYTE* pixel, unsigned pixel_size) {
 	}
 }
 
-static inline BOOL 
-isEqualPixel(BYTE* lhs, BYTE* rhs, unsigned pixel_size) {
-	switch (pixel_size) {
-		case 1:
-			return *lhs == *rhs;
-
-		case 2:
-			return *(WORD*)lhs == *(WORD*)rhs;
-
-		case 3:
-			return *(WORD*)lhs == *(WORD*)rhs && lhs[2] == rhs[2];
-
-		case 4:
-			return *(unsigned*)lhs == *(unsigned*)rhs;
-
-		default:
-			assert(FALSE);
-			return FALSE;
-	}
-}
-
 static void 
 saveRLE(FIBITMAP* dib, FreeImageIO* io, fi_handle handle) {
 	// Image is compressed line by line, packets don't span multiple lines (TGA2.0 recommendation)
@@ -1201,130 +1079,33 @@ saveRLE(FIBITMAP* dib, FreeImageIO* io, fi_handle handle) {
 	const unsigned width = FreeImage_GetWidth(dib);
 	const unsigned height = FreeImage_GetHeight(dib);
 	const unsigned pixel_size = FreeImage_GetBPP(dib)/8;
-	const unsigned line_size = FreeImage_GetLine(dib);
-
-	const BYTE max_packet_size = 128;
-	BYTE packet_count = 0;
-	BOOL has_rle = FALSE;
-
-	// packet (compressed or not) to be written to line
-
-	BYTE* const packet_begin = (BYTE*)malloc(max_packet_size * pixel_size);
-	BYTE* packet = packet_begin;
-
-	// line to be written to disk
-	// Note: we need some extra bytes for anti-commpressed lines. The worst case is:
-	// 8 bit images were every 3th pixel is different.
-	// Rle packet becomes two pixels, but nothing is compressed: two byte pixels are transformed into byte header and byte pixel value
-	// After every rle packet there is a non-rle packet of one pixel: an extra byte for the header will be added for it
-	// In the end we gain no bytes from compression, but also must insert a byte at every 3th pixel
-
-	// add extra space for anti-commpressed lines
-	size_t extra_space = (size_t)ceil(width / 3.0);
-	BYTE* const line_begin = (BYTE*)malloc(width * pixel_size + extra_space);
-	BYTE* line = line_begin;
-
-	BYTE *current = (BYTE*)malloc(pixel_size);
-	BYTE *next    = (BYTE*)malloc(pixel_size);
-
-	for(unsigned y = 0; y < height; y++) {
-		BYTE *bits = FreeImage_GetScanLine(dib, y);
-
-		// rewind line pointer
-		line = line_begin;
-
-		for(unsigned x = 0; x < line_size; x += pixel_size) {
-
-			AssignPixel(current, (bits + x), pixel_size);
-
-			// read next pixel from dib
-
-			if( x + 1*pixel_size < line_size) {
-				AssignPixel(next, (bits + x + 1*pixel_size), pixel_size);
-
-			} else {
-				// last pixel in line
 
-				// include current pixel and flush
-				if(!has_rle) {
+	// line converted to the file pixel format...
+	BYTE* const file_line = (BYTE*)malloc(width * pixel_size);
+	// ...and packed line to be written to disk
+	BYTE* const packed_line = (BYTE*)malloc(TGARLE_MAX_ENCODED_SIZE(width, pixel_size));
 
-					writeToPacket(packet, current, pixel_size);
-					packet += pixel_size;
-
-				}
-
-				assert(packet_count < max_packet_size);
-
-				++packet_count;
-
-				flushPacket(line, pixel_size, packet_begin, packet, packet_count, has_rle);
-
-				// start anew on next line
-				break;
-			}
-
-			if(isEqualPixel(current, next, pixel_size)) {
-
-				// has rle
-
-				if(!has_rle) {
-					// flush non rle packet
-
-					flushPacket(line, pixel_size, packet_begin, packet, packet_count, has_rle);
-
-					// start a rle packet
-
-					has_rle = TRUE;
-
-					writeToPacket(packet, current, pixel_size);
-					packet += pixel_size;
-				}
-
-				// otherwise do nothing. We will just increase the count at the end
+	if (file_line && packed_line) {
+		for(unsigned y = 0; y < height; y++) {
+			BYTE *bits = FreeImage_GetScanLine(dib, y);
 
+			if (pixel_size == 1) {
+				memcpy(file_line, bits, width);
 			} else {
-
-				// no rle
-
-				if(has_rle) {
-					// flush rle packet
-
-					// include current pixel first
-					assert(packet_count < max_packet_size);
-					++packet_count;
-
-					flushPacket(line, pixel_size, packet_begin, packet, packet_count, has_rle);
-
-					// start anew on the next pixel
-					continue;
-
-				} else {
-
-					writeToPacket(packet, current, pixel_size);
-					packet += pixel_size;
+				for(unsigned x = 0; x < width; x++) {
+					writeToPacket(file_line + x * pixel_size, bits + x * pixel_size, pixel_size);
 				}
-
 			}
 
-			// increase counter on every pixel
-
-			++packet_count;
+			const unsigned packed_size = TGARLE_EncodeLine(packed_line, file_line, width, pixel_size);
 
-			if(packet_count == max_packet_size) {
-				flushPacket(line, pixel_size, packet_begin, packet, packet_count, has_rle);
-			}
-
-		}//for width
-
-		// write line to disk
-		io->write_proc(line_begin, 1, (unsigned)(line - line_begin), handle);
-
-	}//for height
+			// write line to disk
+			io->write_proc(packed_line, 1, packed_size, handle);
+		}
+	}
 
-	free(line_begin);
-	free(packet_begin);
-	free(current);
-	free(next);
+	free(file_line);
+	free(packed_line);
 }
 
 static BOOL DLL_CALLCONV
@@ -43,6 +43,7 @@
 
 #include "FreeImageIO.h"
 #include "PSDParser.h"
+#include "ThreadPool.h"
 
 // --------------------------------------------------------------------------
 // GeoTIFF profile (see XTIFF.cpp)
@@ -101,10 +102,10 @@ static void WriteImageType(TIFF *tiff, FREE_IMAGE_TYPE fit);
 
 static void WriteCompression(TIFF *tiff, uint16_t bitspersample, uint16_t samplesperpixel, uint16_t photometric, int flags);
 
-static BOOL tiff_read_iptc_profile(TIFF *tiff, FIBITMAP *dib);
+static BOOL tiff_read_iptc_profile(TIFF *tiff, FIBITMAP *dib, BOOL raw_metadata);
 static BOOL tiff_read_xmp_profile(TIFF *tiff, FIBITMAP *dib);
 static BOOL tiff_read_exif_profile(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *dib);
-static void ReadMetadata(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *dib);
+static void ReadMetadata(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *dib, int flags);
 
 static BOOL tiff_write_iptc_profile(TIFF *tiff, FIBITMAP *dib);
 static BOOL tiff_write_xmp_profile(TIFF *tiff, FIBITMAP *dib);
@@ -778,9 +779,10 @@ WriteCompression(TIFF *tiff, uint16_t bitspersample, uint16_t samplesperpixel, u
 
 /**
 	Read the TIFFTAG_RICHTIFFIPTC tag (IPTC/NAA or Adobe Photoshop profile)
+	@param raw_metadata If TRUE, keep the profile as is (see FIF_LOAD_RAWMETADATA)
 */
 static BOOL 
-tiff_read_iptc_profile(TIFF *tiff, FIBITMAP *dib) {
+tiff_read_iptc_profile(TIFF *tiff, FIBITMAP *dib, BOOL raw_metadata) {
 	BYTE *profile = NULL;
 	uint32_t profile_size = 0;
 
@@ -789,6 +791,9 @@ tiff_read_iptc_profile(TIFF *tiff, FIBITMAP *dib) {
 			TIFFSwabArrayOfLong((uint32_t *) profile, (unsigned long)profile_size);
 		}
 
+		if(raw_metadata && read_iptc_profile_raw(dib, profile, 4 * profile_size)) {
+			return TRUE;
+		}
 		return read_iptc_profile(dib, profile, 4 * profile_size);
 	}
 
@@ -867,10 +872,10 @@ tiff_read_exif_profile(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *
 Read TIFF special profiles
 */
 static void 
-ReadMetadata(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *dib) {
+ReadMetadata(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *dib, int flags) {
 
 	// IPTC/NAA
-	tiff_read_iptc_profile(tiff, dib);
+	tiff_read_iptc_profile(tiff, dib, (flags & FIF_LOAD_RAWMETADATA) == FIF_LOAD_RAWMETADATA);
 
 	// Adobe XMP
 	tiff_read_xmp_profile(tiff, dib);
@@ -889,7 +894,8 @@ ReadMetadata(FreeImageIO *io, fi_handle handle, TIFF *tiff, FIBITMAP *dib) {
 */
 static BOOL 
 tiff_write_iptc_profile(TIFF *tiff, FIBITMAP *dib) {
-	if(FreeImage_GetMetadataCount(FIMD_IPTC, dib)) {
+	// a profile loaded with FIF_LOAD_RAWMETADATA is written as is, without decoding its tags
+	if(get_raw_profile(dib, FIMD_IPTC, NULL) || FreeImage_GetMetadataCount(FIMD_IPTC, dib)) {
 		BYTE *profile = NULL;
 		uint32_t profile_size = 0;
 		// create a binary profile
@@ -1403,6 +1409,55 @@ ReadThumbnail(FreeImageIO *io, fi_handle handle, void *data, TIFF *tiff, FIBITMA
 	FreeImage_Unload(thumbnail);
 }
 
+/**
+Read a whole image into a bottom-up RGBA raster, like TIFFReadRGBAImage does.
+Top-down images are read in bands of whole strips (or tiles), so that the load
+reports its progress and can be cancelled between two bands.
+@param cancelled Set to TRUE when the load was cancelled
+@return Returns FALSE if the image cannot be read or the load was cancelled
+*/
+static BOOL
+ReadRGBAImage(TIFF *tif, uint32_t width, uint32_t height, uint32_t *raster, BOOL *cancelled) {
+	char emsg[1024];
+	TIFFRGBAImage img;
+
+	*cancelled = FALSE;
+	if (!TIFFRGBAImageOK(tif, emsg) || !TIFFRGBAImageBegin(&img, tif, 1, emsg)) {
+		return FALSE;
+	}
+	img.req_orientation = ORIENTATION_BOTLEFT;
+
+	// bands follow the order of the rows in the file, other orientations are read at once
+	uint32_t band = height;
+	if (img.orientation == ORIENTATION_TOPLEFT) {
+		uint32_t rows = 0;
+		if (TIFFIsTiled(tif)) {
+			TIFFGetField(tif, TIFFTAG_TILELENGTH, &rows);
+		} else {
+			TIFFGetFieldDefaulted(tif, TIFFTAG_ROWSPERSTRIP, &rows);
+		}
+		rows = CLAMP<uint32_t>(rows, 1, height);
+		// about 256K pixels per band
+		const uint64_t blocks = (1 << 18) / ((uint64_t)rows * width + 1);
+		band = (uint32_t)MIN<uint64_t>(height, rows * MAX<uint64_t>(blocks, 1));
+	}
+
+	int ok = 1;
+	for (uint32_t y = 0; ok && (y < height); y += band) {
+		const uint32_t nrow = MIN(band, height - y);
+		img.row_offset = y;
+		ok = TIFFRGBAImageGet(&img, raster + (size_t)(height - y - nrow) * width, width, nrow);
+		if (ok && !FreeImage_ReportProgress((double)(y + nrow) / height)) {
+			*cancelled = TRUE;
+			ok = 0;
+		}
+	}
+
+	TIFFRGBAImageEnd(&img);
+
+	return ok ? TRUE : FALSE;
+}
+
 // --------------------------------------------------------------------------
 
 static FIBITMAP * DLL_CALLCONV
@@ -1509,11 +1564,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					throw FI_MSG_ERROR_MEMORY;
 				}
 
-				// read the image in one chunk into an RGBA array
+				// read the image in bands into an RGBA array
 
-				if (!TIFFReadRGBAImage(tif, width, height, raster, 1)) {
+				BOOL bCancelled = FALSE;
+				if (!ReadRGBAImage(tif, width, height, raster, &bCancelled)) {
 					_TIFFfree(raster);
-					throw FI_MSG_ERROR_UNSUPPORTED_FORMAT;
+					throw bCancelled ? (char*)NULL : FI_MSG_ERROR_UNSUPPORTED_FORMAT;
 				}
 			}
 			// TIFFReadRGBAImage always deliveres 3 or 4 samples per pixel images
@@ -1645,6 +1701,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (uint32_t y = 0; y < height; y += rowsperstrip) {
 					const int32_t nrow = (y + rowsperstrip > height ? height - y : rowsperstrip);
 
+					if (!FreeImage_ReportProgress((double)y / height)) {
+						free(buf);
+						throw (char*)NULL;
+					}
+
 					if (nrow * src_width * dst_spp * sizeof(BYTE) > static_cast<size_t>(bufsz)) {
 						free(buf);
 						throw FI_MSG_ERROR_CORRUPTED_IMAGE;
@@ -1685,6 +1746,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (uint32_t y = 0; y < height; y += rowsperstrip) {
 					int32_t nrow = (y + rowsperstrip > height ? height - y : rowsperstrip);
 
+					if (!FreeImage_ReportProgress((double)y / height)) {
+						free(buf);
+						throw (char*)NULL;
+					}
+
 					if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), grey, nrow * src_line) == -1) {
 						free(buf);
 						throw FI_MSG_ERROR_PARSING;
@@ -1802,6 +1868,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					for (uint32_t y = 0; y < height; y += rowsperstrip) {
 						const int32_t strips = (y + rowsperstrip > height ? height - y : rowsperstrip);
 
+						if (!FreeImage_ReportProgress((double)y / height)) {
+							free(buf);
+							FreeImage_Unload(alpha);
+							throw (char*)NULL;
+						}
+
 						if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf, strips * src_line) == -1) {
 							free(buf);
 							FreeImage_Unload(alpha);
@@ -1864,6 +1936,12 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					
 					for (uint32_t y = 0; y < height; y += rowsperstrip) {
 						const int32_t strips = (y + rowsperstrip > height ? height - y : rowsperstrip);
+
+						if (!FreeImage_ReportProgress((double)y / height)) {
+							free(buf);
+							FreeImage_Unload(alpha);
+							throw (char*)NULL;
+						}
 						
 						// - loop for channels (planes) -
 						
@@ -2002,6 +2080,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					for (uint32_t y = 0; y < height; y += rowsperstrip) {
 						int32_t strips = (y + rowsperstrip > height ? height - y : rowsperstrip);
 
+						if (!FreeImage_ReportProgress((double)y / height)) {
+							free(buf);
+							throw (char*)NULL;
+						}
+
 						if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf, strips * src_line) == -1) {
 							// ignore errors as they can be frequent and not really valid errors, especially with fax images
 							bThrowMessage = TRUE;							
@@ -2035,6 +2118,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					
 					for (uint32_t y = 0; y < height; y += rowsperstrip) {
 						const int32_t strips = (y + rowsperstrip > height ? height - y : rowsperstrip);
+
+						if (!FreeImage_ReportProgress((double)y / height)) {
+							free(buf);
+							throw (char*)NULL;
+						}
 						
 						// - loop for channels (planes) -
 						
@@ -2143,6 +2231,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (uint32_t y = 0; y < height; y += tileHeight) {						
 					int32_t nrows = (y + tileHeight > height ? height - y : tileHeight);					
 
+					if (!FreeImage_ReportProgress((double)y / height)) {
+						free(tileBuffer);
+						throw (char*)NULL;
+					}
+
 					for (uint32_t x = 0, rowSize = 0; x < width; x += tileWidth, rowSize += tileRowSize) {
 						memset(tileBuffer, 0, tileSize);
 
@@ -2220,6 +2313,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				for (uint32_t y = 0; y < height; y += rowsperstrip) {
 					int32_t nrow = (y + rowsperstrip > height ? height - y : rowsperstrip);
 
+					if (!FreeImage_ReportProgress((double)y / height)) {
+						free(buf);
+						throw (char*)NULL;
+					}
+
 					if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf, nrow * src_line) == -1) {
 						free(buf);
 						throw FI_MSG_ERROR_PARSING;
@@ -2277,6 +2375,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					for (uint32_t y = 0; y < height; y += rowsperstrip) {
 						uint32_t nrow = (y + rowsperstrip > height ? height - y : rowsperstrip);
 
+						if (!FreeImage_ReportProgress((double)y / height)) {
+							free(buf);
+							throw (char*)NULL;
+						}
+
 						if (TIFFReadEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), buf, nrow * src_line) == -1) {
 							free(buf);
 							throw FI_MSG_ERROR_PARSING;
@@ -2319,7 +2422,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		
 		// copy TIFF metadata (must be done after FreeImage_Allocate)
 
-		ReadMetadata(io, handle, tif, dib);
+		ReadMetadata(io, handle, tif, dib, flags);
 
 		// copy ICC profile data (must be done after FreeImage_Allocate)
 		
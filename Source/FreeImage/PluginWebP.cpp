@@ -406,8 +406,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				if(error_status == WEBP_MUX_OK) {
 					// read the Exif raw data as a blob
 					jpeg_read_exif_profile_raw(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
-					// read and decode the Exif data
-					jpeg_read_exif_profile(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
+					// read and decode the Exif data, on first access with FIF_LOAD_RAWMETADATA
+					if(!(flags & FIF_LOAD_RAWMETADATA) || !set_raw_profile(dib, FIMD_EXIF_MAIN, exif_metadata.bytes, (unsigned)exif_metadata.size)) {
+						jpeg_read_exif_profile(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
+					}
 				}
 			}
 		}
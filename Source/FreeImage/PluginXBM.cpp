@@ -24,6 +24,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 // ==========================================================
 // Internal functions
@@ -43,50 +44,44 @@ static const char *ERR_XBM_MEMORY	= "Out of memory";
 Get a string from a stream. 
 Read the string from the current stream to the first newline character. 
 The result stored in str is appended with a null character.
-@param str Storage location for data 
+@param str Storage location for data, at least n + 1 characters
 @param n Maximum number of characters to read 
-@param io Pointer to the FreeImageIO structure
-@param handle Handle to the stream
+@param reader Input stream
 @return Returns str. NULL is returned to indicate an error or an end-of-file condition.
 */
 static char* 
-readLine(char *str, int n, FreeImageIO *io, fi_handle handle) {
-	char c;
-	int count, i = 0;
+readLine(char *str, int n, BufferedReader& reader) {
+	int c;
+	int i = 0;
 	do {
-		count = io->read_proc(&c, 1, 1, handle);
-		str[i++] = c;
+		if((c = reader.getByte()) == EOF)
+			return NULL;
+		str[i++] = (char)c;
 	} while((c != '\n') && (i < n));
-	if(count <= 0)
-		return NULL;
 	str[i] = '\0';
 	return str;
 }
 
 /**
 Get a char from the stream
-@param io Pointer to the FreeImageIO structure
-@param handle Handle to the stream
-@return Returns the next character in the stream
+@param reader Input stream
+@return Returns the next character in the stream, or EOF at the end of the stream
 */
-static int 
-readChar(FreeImageIO *io, fi_handle handle) {
-	BYTE c;
-	io->read_proc(&c, 1, 1, handle);
-	return c;
+static inline int 
+readChar(BufferedReader& reader) {
+	return reader.getByte();
 }
 
 /**
 Read an XBM file into a buffer
-@param io Pointer to the FreeImageIO structure
-@param handle Handle to the stream
+@param reader Input stream
 @param widthP (return value) Pointer to the bitmap width
 @param heightP (return value) Pointer to the bitmap height
 @param dataP (return value) Pointer to the bitmap buffer
 @return Returns NULL if OK, returns an error message otherwise
 */
 static const char* 
-readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, char **dataP) {
+readXBMFile(BufferedReader& reader, int *widthP, int *heightP, char **dataP) {
 	char line[MAX_LINE], name_and_type[MAX_LINE];
 	char* ptr;
 	char* t;
@@ -109,7 +104,7 @@ readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, char *
 	
 	while(!found_declaration && !eof) {
 
-		if( readLine(line, MAX_LINE, io, handle) == NULL) {
+		if( readLine(line, MAX_LINE - 1, reader) == NULL) {
 			eof = TRUE;
 		}
 		else {
@@ -190,20 +185,20 @@ readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, char *
 
 	if(version == 10) {
 		for( bytes = 0, ptr = *dataP; bytes < raster_length; bytes += 2 ) {
-			while( ( c1 = readChar(io, handle) ) != 'x' ) {
+			while( ( c1 = readChar(reader) ) != 'x' ) {
 				if ( c1 == EOF )
 					return( ERR_XBM_EOFREAD );
 			}
 
-			c1 = readChar(io, handle);
-			c2 = readChar(io, handle);
+			c1 = readChar(reader);
+			c2 = readChar(reader);
 			if( c1 == EOF || c2 == EOF )
 				return( ERR_XBM_EOFREAD );
 			value1 = ( hex_table[c1] << 4 ) + hex_table[c2];
 			if ( value1 >= 256 )
 				return( ERR_XBM_SYNTAX );
-			c1 = readChar(io, handle);
-			c2 = readChar(io, handle);
+			c1 = readChar(reader);
+			c2 = readChar(reader);
 			if( c1 == EOF || c2 == EOF )
 				return( ERR_XBM_EOFREAD );
 			value2 = ( hex_table[c1] << 4 ) + hex_table[c2];
@@ -220,7 +215,7 @@ readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, char *
 			** skip until digit is found
 			*/
 			for( ; ; ) {
-				c1 = readChar(io, handle);
+				c1 = readChar(reader);
 				if ( c1 == EOF )
 					return( ERR_XBM_EOFREAD );
 				value1 = hex_table[c1];
@@ -231,7 +226,7 @@ readXBMFile(FreeImageIO *io, fi_handle handle, int *widthP, int *heightP, char *
 			** loop on digits
 			*/
 			for( ; ; ) {
-				c2 = readChar(io, handle);
+				c2 = readChar(reader);
 				if ( c2 == EOF )
 					return( ERR_XBM_EOFREAD );
 				value2 = hex_table[c2];
@@ -292,7 +287,8 @@ MimeType() {
 static BOOL DLL_CALLCONV
 Validate(FreeImageIO *io, fi_handle handle) {
 	char magic[8];
-	if(readLine(magic, 7, io, handle)) {
+	BufferedReader reader(io, handle, 8);
+	if(readLine(magic, 7, reader)) {
 		if(strcmp(magic, "#define") == 0)
 			return TRUE;
 	}
@@ -320,7 +316,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	try {
 
 		// load the bitmap data
-		const char* error = readXBMFile(io, handle, &width, &height, &buffer);
+		BufferedReader reader(io, handle);
+		if(reader.isNull()) throw (char*)ERR_XBM_MEMORY;
+		const char* error = readXBMFile(reader, &width, &height, &buffer);
+		reader.release();
 		// Microsoft doesn't implement throw between functions :(
 		if(error) throw (char*)error;
 
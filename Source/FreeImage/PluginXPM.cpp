@@ -37,6 +37,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 // ==========================================================
 // Plugin Interface
@@ -49,28 +50,26 @@ static int s_format_id;
 
 // read in and skip all junk until we find a certain char
 static BOOL
-FindChar(FreeImageIO *io, fi_handle handle, BYTE look_for) {
-	BYTE c;
-	io->read_proc(&c, sizeof(BYTE), 1, handle);
-	while(c != look_for) {
-		if( io->read_proc(&c, sizeof(BYTE), 1, handle) != 1 )
+FindChar(BufferedReader& reader, BYTE look_for) {
+	int c;
+	do {
+		if( (c = reader.getByte()) == EOF )
 			return FALSE;
-	}
+	} while(c != look_for);
 	return TRUE;
 }
 
 // find start of string, read data until ending quote found, allocate memory and return a string
 static char *
-ReadString(FreeImageIO *io, fi_handle handle) {
-	if( !FindChar(io, handle,'"') )
+ReadString(BufferedReader& reader) {
+	if( !FindChar(reader,'"') )
 		return NULL;
-	BYTE c;
+	int c;
 	std::string s;
-	io->read_proc(&c, sizeof(BYTE), 1, handle);
-	while(c != '"') {
-		s += c;
-		if( io->read_proc(&c, sizeof(BYTE), 1, handle) != 1 )
+	while( (c = reader.getByte()) != '"' ) {
+		if( c == EOF )
 			return NULL;
+		s += (char)c;
 	}
 	char *cstr = (char *)malloc(s.length()+1);
 	strcpy(cstr,s.c_str());
@@ -164,13 +163,17 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		char *str;
 		
 		BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
+		BufferedReader reader(io, handle);
+		if(reader.isNull())
+			throw FI_MSG_ERROR_MEMORY;
 		
 		//find the starting brace
-		if( !FindChar(io, handle,'{') )
+		if( !FindChar(reader,'{') )
 			throw "Could not find starting brace";
 
 		//read info string
-		str = ReadString(io, handle);
+		str = ReadString(reader);
 		if(!str)
 			throw "Error reading info string";
 
@@ -197,7 +200,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		for(int i = 0; i < colors; i++ ) {
 			FILE_RGBA rgba;
 
-			str = ReadString(io, handle);
+			str = ReadString(reader);
 			if(!str || (strlen(str) < (size_t)cpp))
 				throw "Error reading color strings";
 
@@ -306,13 +309,14 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 		if(header_only) {
 			// header only mode
+			reader.release();
 			return dib;
 		}
 
 		//read in pixel data
 		for(int y = 0; y < height; y++ ) {
 			BYTE *line = FreeImage_GetScanLine(dib, height - y - 1);
-			str = ReadString(io, handle);
+			str = ReadString(reader);
 			if(!str)
 				throw "Error reading pixel strings";
 			char *pixel_ptr = str;
@@ -339,6 +343,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 		//done reading pixel data
 
+		reader.release();
 		return dib;
 	} catch(const char *text) {
        FreeImage_OutputMessageProc(s_format_id, text);
@@ -0,0 +1,552 @@
+// ==========================================================
+// Run-length codecs shared by the plugins
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "FreeImageIO.h"
+#include "RLECodec.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FI_RLE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ----------------------------------------------------------
+//   Run detection
+// ----------------------------------------------------------
+
+#if defined(FI_RLE_SSE2)
+/**
+Index of the lowest set bit of a non-zero mask
+*/
+static inline unsigned
+CountTrailingZeros(unsigned mask) {
+#if defined(__GNUC__)
+	return (unsigned)__builtin_ctz(mask);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+#else
+	unsigned index = 0;
+	while((mask & 1) == 0) {
+		mask >>= 1;
+		index++;
+	}
+	return index;
+#endif
+}
+#endif // FI_RLE_SSE2
+
+/**
+Returns the number of leading bytes equal to src[0], at most size (size > 0)
+*/
+static inline unsigned
+RunLength(const BYTE *src, unsigned size) {
+	const BYTE value = src[0];
+	unsigned n = 1;
+
+#if defined(FI_RLE_SSE2)
+	const __m128i v = _mm_set1_epi8((char)value);
+	while(n + 16 <= size) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + n));
+		const unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(s, v)) ^ 0xFFFF;
+		if(mask) {
+			return n + CountTrailingZeros(mask);
+		}
+		n += 16;
+	}
+#endif // FI_RLE_SSE2
+
+	while((n < size) && (src[n] == value)) {
+		n++;
+	}
+	return n;
+}
+
+/**
+Returns the index of the first run of three equal bytes, or size if there is none
+*/
+static inline unsigned
+FindRepeat(const BYTE *src, unsigned size) {
+	unsigned i = 0;
+
+#if defined(FI_RLE_SSE2)
+	while(i + 18 <= size) {
+		const __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 1));
+		const __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 2));
+		const unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(b, c)));
+		if(mask) {
+			return i + CountTrailingZeros(mask);
+		}
+		i += 16;
+	}
+#endif // FI_RLE_SSE2
+
+	for(; i + 2 < size; i++) {
+		if((src[i] == src[i + 1]) && (src[i] == src[i + 2])) {
+			return i;
+		}
+	}
+	return size;
+}
+
+static inline BOOL
+IsEqualPixel(const BYTE *lhs, const BYTE *rhs, unsigned pixel_size) {
+	switch(pixel_size) {
+		case 1:
+			return lhs[0] == rhs[0];
+		case 2:
+			return (lhs[0] == rhs[0]) && (lhs[1] == rhs[1]);
+		case 3:
+			return (lhs[0] == rhs[0]) && (lhs[1] == rhs[1]) && (lhs[2] == rhs[2]);
+		default:
+			return memcmp(lhs, rhs, pixel_size) == 0;
+	}
+}
+
+/**
+Returns the number of leading pixels equal to the first one, at most count (count > 0)
+*/
+static inline unsigned
+PixelRunLength(const BYTE *src, unsigned count, unsigned pixel_size) {
+	if(pixel_size == 1) {
+		return RunLength(src, count);
+	}
+	unsigned n = 1;
+	while((n < count) && IsEqualPixel(src, src + n * pixel_size, pixel_size)) {
+		n++;
+	}
+	return n;
+}
+
+/**
+Returns the index of the first pixel worth starting a run packet, or count if there is none.
+Single byte pixels need three repeats to make a run shorter than a literal packet, larger pixels only two.
+*/
+static inline unsigned
+FindPixelRepeat(const BYTE *src, unsigned count, unsigned pixel_size) {
+	if(pixel_size == 1) {
+		return FindRepeat(src, count);
+	}
+	for(unsigned i = 0; i + 1 < count; i++) {
+		if(IsEqualPixel(src + i * pixel_size, src + (i + 1) * pixel_size, pixel_size)) {
+			return i;
+		}
+	}
+	return count;
+}
+
+/**
+Fills count pixels of dst with the pixel stored at dst, doubling the copied block at each step
+*/
+static inline void
+ExpandPixel(BYTE *dst, unsigned count, unsigned pixel_size) {
+	const unsigned size = count * pixel_size;
+	for(unsigned filled = pixel_size; filled < size; filled *= 2) {
+		memcpy(dst + filled, dst, MIN(filled, size - filled));
+	}
+}
+
+// ----------------------------------------------------------
+//   PackBits
+// ----------------------------------------------------------
+
+unsigned
+PackBits_Decode(BYTE *dst, unsigned dst_size, const BYTE *src, unsigned src_size) {
+	const BYTE* const src_end = src + src_size;
+	unsigned written = 0;
+
+	while((src < src_end) && (written < dst_size)) {
+		// NOTE len is signed byte in PackBits RLE
+		const unsigned len = *src++;
+
+		if(len < 128) {
+			// uncompressed packet : (len + 1) bytes of data are copied
+			unsigned n = MIN(len + 1, dst_size - written);
+			n = MIN(n, (unsigned)(src_end - src));
+			memcpy(dst + written, src, n);
+			written += n;
+			src += n;
+		}
+		else if(len > 128) {
+			// RLE compressed packet : one byte of data is repeated (-len + 1) times
+			if(src >= src_end) {
+				break;
+			}
+			const unsigned n = MIN(257 - len, dst_size - written);
+			memset(dst + written, *src++, n);
+			written += n;
+		}
+		// 128 is a no-op
+	}
+
+	return written;
+}
+
+unsigned
+PackBits_DecodeStrided(BYTE *dst, unsigned stride, unsigned count, const BYTE *src, unsigned src_size) {
+	if(stride == 1) {
+		return PackBits_Decode(dst, count, src, src_size);
+	}
+
+	const BYTE* const src_end = src + src_size;
+	unsigned written = 0;
+
+	while((src < src_end) && (written < count)) {
+		const unsigned len = *src++;
+
+		if(len < 128) {
+			unsigned n = MIN(len + 1, count - written);
+			n = MIN(n, (unsigned)(src_end - src));
+			for(unsigned i = 0; i < n; i++, dst += stride) {
+				*dst = src[i];
+			}
+			src += n;
+			written += n;
+		}
+		else if(len > 128) {
+			if(src >= src_end) {
+				break;
+			}
+			const BYTE value = *src++;
+			const unsigned n = MIN(257 - len, count - written);
+			for(unsigned i = 0; i < n; i++, dst += stride) {
+				*dst = value;
+			}
+			written += n;
+		}
+	}
+
+	return written;
+}
+
+unsigned
+PackBits_Encode(BYTE *dst, const BYTE *src, unsigned size) {
+	BYTE *p = dst;
+
+	while(size > 0) {
+		const unsigned run = RunLength(src, MIN(size, 128U));
+
+		if(run >= 2) {
+			// run packet
+			*p++ = (BYTE)(257 - run);
+			*p++ = *src;
+			src += run;
+			size -= run;
+		} else {
+			// literal packet, up to the next run of three bytes (a shorter run would not save anything)
+			const unsigned len = MIN(FindRepeat(src, MIN(size, 130U)), 128U);
+			*p++ = (BYTE)(len - 1);
+			memcpy(p, src, len);
+			p += len;
+			src += len;
+			size -= len;
+		}
+	}
+
+	return (unsigned)(p - dst);
+}
+
+// ----------------------------------------------------------
+//   SGI RLE
+// ----------------------------------------------------------
+
+unsigned
+SGIRLE_DecodeStrided(BYTE *dst, unsigned stride, unsigned count, const BYTE *src, unsigned src_size) {
+	const BYTE* const src_end = src + src_size;
+	unsigned written = 0;
+
+	while((src < src_end) && (written < count)) {
+		const BYTE header = *src++;
+		unsigned n = MIN((unsigned)(header & 0x7F), count - written);
+		if(n == 0) {
+			// end of row marker
+			continue;
+		}
+		if(header & 0x80) {
+			// literal packet
+			n = MIN(n, (unsigned)(src_end - src));
+			for(unsigned i = 0; i < n; i++, dst += stride) {
+				*dst = src[i];
+			}
+			src += n;
+		} else {
+			// run packet
+			if(src >= src_end) {
+				break;
+			}
+			const BYTE value = *src++;
+			for(unsigned i = 0; i < n; i++, dst += stride) {
+				*dst = value;
+			}
+		}
+		written += n;
+	}
+
+	return written;
+}
+
+// ----------------------------------------------------------
+//   PCX RLE
+// ----------------------------------------------------------
+
+unsigned
+PCXRLE_DecodeLine(BufferedReader &reader, BYTE *dst, unsigned size) {
+	unsigned written = 0;
+
+	// runs do not span scanlines
+	while(written < size) {
+		int value = reader.getByte();
+		if(value == EOF) {
+			break;
+		}
+		unsigned count = 1;
+		if((value & 0xC0) == 0xC0) {
+			// the lower 6 bits are the count of the next byte
+			count = value & 0x3F;
+			value = reader.getByte();
+			if(value == EOF) {
+				break;
+			}
+		}
+		count = MIN(count, size - written);
+		memset(dst + written, value, count);
+		written += count;
+	}
+
+	return written;
+}
+
+// ----------------------------------------------------------
+//   BMP RLE4 / RLE8
+// ----------------------------------------------------------
+
+static const BYTE BMPRLE_COMMAND     = 0;
+static const BYTE BMPRLE_ENDOFLINE   = 0;
+static const BYTE BMPRLE_ENDOFBITMAP = 1;
+static const BYTE BMPRLE_DELTA       = 2;
+
+static inline void
+SetNibble(BYTE *line, unsigned x, BYTE value) {
+	BYTE *p = line + (x >> 1);
+	*p = (x & 1) ? (BYTE)((*p & 0xF0) | (value & 0x0F)) : (BYTE)((*p & 0x0F) | (value << 4));
+}
+
+BOOL
+BMPRLE_Decode(BufferedReader &reader, BYTE *bits, unsigned pitch, unsigned width, unsigned height, unsigned bpp) {
+	unsigned x = 0;
+	unsigned y = 0;
+
+	while(y < height) {
+		BYTE *line = bits + (size_t)y * pitch;
+
+		const int first = reader.getByte();
+		const int second = reader.getByte();
+		if(second == EOF) {
+			return FALSE;
+		}
+
+		if(first != BMPRLE_COMMAND) {
+			// encoded mode : 'first' pixels built from 'second'
+			const unsigned count = (x < width) ? MIN((unsigned)first, width - x) : 0;
+			if(bpp == 8) {
+				memset(line + x, second, count);
+			} else {
+				const BYTE hi = (BYTE)(second >> 4);
+				const BYTE lo = (BYTE)(second & 0x0F);
+				for(unsigned i = 0; i < count; i++) {
+					SetNibble(line, x + i, (i & 1) ? lo : hi);
+				}
+			}
+			x += first;
+			continue;
+		}
+
+		switch(second) {
+			case BMPRLE_ENDOFLINE:
+				x = 0;
+				y++;
+				break;
+
+			case BMPRLE_ENDOFBITMAP:
+				return TRUE;
+
+			case BMPRLE_DELTA:
+			{
+				const BYTE *delta = reader.getBytes(2);
+				if(!delta) {
+					return FALSE;
+				}
+				x += delta[0];
+				y += delta[1];
+			}
+			break;
+
+			default:
+			{
+				// absolute mode : 'second' pixels follow, padded to a 16-bit boundary
+				const unsigned count = second;
+				const unsigned size = (bpp == 8) ? count : (count + 1) / 2;
+				const BYTE *data = reader.getBytes(size + (size & 1));
+				if(!data) {
+					return FALSE;
+				}
+				const unsigned n = (x < width) ? MIN(count, width - x) : 0;
+				if(bpp == 8) {
+					memcpy(line + x, data, n);
+				} else {
+					for(unsigned i = 0; i < n; i++) {
+						const BYTE value = data[i >> 1];
+						SetNibble(line, x + i, (i & 1) ? (BYTE)(value & 0x0F) : (BYTE)(value >> 4));
+					}
+				}
+				x += count;
+			}
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+unsigned
+BMPRLE_EncodeLine8(BYTE *dst, const BYTE *src, unsigned width) {
+	BYTE *p = dst;
+	unsigned i = 0;
+
+	while(i < width) {
+		const unsigned left = width - i;
+		const unsigned run = RunLength(src + i, MIN(left, 255U));
+
+		if(run >= 3) {
+			// encoded mode
+			*p++ = (BYTE)run;
+			*p++ = src[i];
+			i += run;
+			continue;
+		}
+
+		// absolute mode needs at least 3 pixels, up to the next run of three pixels
+		const unsigned len = MIN(FindRepeat(src + i, MIN(left, 257U)), 255U);
+		if(len >= 3) {
+			*p++ = BMPRLE_COMMAND;
+			*p++ = (BYTE)len;
+			memcpy(p, src + i, len);
+			p += len;
+			if(len & 1) {
+				*p++ = 0;
+			}
+			i += len;
+		} else {
+			// one or two pixels before a run or the end of line
+			const unsigned end = i + len;
+			while(i < end) {
+				const unsigned n = RunLength(src + i, end - i);
+				*p++ = (BYTE)n;
+				*p++ = src[i];
+				i += n;
+			}
+		}
+	}
+
+	*p++ = BMPRLE_COMMAND;
+	*p++ = BMPRLE_ENDOFLINE;
+
+	return (unsigned)(p - dst);
+}
+
+// ----------------------------------------------------------
+//   TARGA RLE
+// ----------------------------------------------------------
+
+unsigned
+TGARLE_DecodeLine(BufferedReader &reader, BYTE *dst, unsigned width, unsigned pixel_size, TGARLEState *state) {
+	unsigned written = 0;
+
+	while(written < width) {
+		if(state->count == 0) {
+			// read a packet header : type bit + zero-based count
+			const int header = reader.getByte();
+			if(header == EOF) {
+				break;
+			}
+			state->is_run = (header & 0x80) ? TRUE : FALSE;
+			if(state->is_run) {
+				const BYTE *value = reader.getBytes(pixel_size);
+				if(!value) {
+					break;
+				}
+				memcpy(state->value, value, pixel_size);
+			}
+			state->count = (header & 0x7F) + 1;
+		}
+
+		const unsigned count = MIN(state->count, width - written);
+		BYTE *p = dst + written * pixel_size;
+
+		if(state->is_run) {
+			if(pixel_size == 1) {
+				memset(p, state->value[0], count);
+			} else {
+				memcpy(p, state->value, pixel_size);
+				ExpandPixel(p, count, pixel_size);
+			}
+		} else if(reader.read(p, count * pixel_size) != count * pixel_size) {
+			state->count = 0;
+			break;
+		}
+
+		state->count -= count;
+		written += count;
+	}
+
+	return written;
+}
+
+unsigned
+TGARLE_EncodeLine(BYTE *dst, const BYTE *src, unsigned width, unsigned pixel_size) {
+	BYTE *p = dst;
+
+	// packets don't span multiple lines (TGA2.0 recommendation)
+	while(width > 0) {
+		const unsigned run = PixelRunLength(src, MIN(width, 128U), pixel_size);
+
+		if(run >= 2) {
+			*p++ = (BYTE)(0x80 | (run - 1));
+			memcpy(p, src, pixel_size);
+			p += pixel_size;
+			src += run * pixel_size;
+			width -= run;
+		} else {
+			const unsigned len = MIN(FindPixelRepeat(src, MIN(width, 130U), pixel_size), 128U);
+			*p++ = (BYTE)(len - 1);
+			memcpy(p, src, len * pixel_size);
+			p += len * pixel_size;
+			src += len * pixel_size;
+			width -= len;
+		}
+	}
+
+	return (unsigned)(p - dst);
+}
@@ -0,0 +1,124 @@
+#ifndef FREEIMAGE_RLE_CODEC_H
+#define FREEIMAGE_RLE_CODEC_H
+
+// ==========================================================
+// Run-length codecs shared by the plugins (see RLECodec.cpp)
+// ==========================================================
+
+#ifndef FREEIMAGE_IO_H
+#include "FreeImageIO.h"
+#endif
+
+// ----------------------------------------------------------
+//   PackBits (PSD, TIFF)
+// ----------------------------------------------------------
+
+/** Worst case size of size bytes packed with PackBits_Encode */
+#define PACKBITS_MAX_ENCODED_SIZE(size) ((size) + ((size) + 127) / 128)
+
+/**
+Unpacks a PackBits buffer
+@param dst Output buffer
+@param dst_size Output buffer size, extra output is discarded
+@param src PackBits data
+@param src_size Size of the packed data
+@return Returns the number of bytes written to dst
+*/
+unsigned PackBits_Decode(BYTE *dst, unsigned dst_size, const BYTE *src, unsigned src_size);
+/**
+Unpacks a PackBits buffer into every stride-th byte of dst
+@param dst Output buffer
+@param stride Distance in bytes between two output samples
+@param count Number of output samples
+@param src PackBits data
+@param src_size Size of the packed data
+@return Returns the number of samples written to dst
+*/
+unsigned PackBits_DecodeStrided(BYTE *dst, unsigned stride, unsigned count, const BYTE *src, unsigned src_size);
+/**
+Packs a buffer with PackBits
+@param dst Output buffer, at least PACKBITS_MAX_ENCODED_SIZE(size) bytes
+@param src Data to be packed
+@param size Size of the data
+@return Returns the packed size
+*/
+unsigned PackBits_Encode(BYTE *dst, const BYTE *src, unsigned size);
+
+// ----------------------------------------------------------
+//   SGI RLE
+// ----------------------------------------------------------
+
+/**
+Unpacks a SGI RLE row into every stride-th byte of dst
+@return Returns the number of samples written to dst
+*/
+unsigned SGIRLE_DecodeStrided(BYTE *dst, unsigned stride, unsigned count, const BYTE *src, unsigned src_size);
+
+// ----------------------------------------------------------
+//   PCX RLE
+// ----------------------------------------------------------
+
+/**
+Unpacks a PCX RLE scanline
+@return Returns the number of bytes written to dst
+*/
+unsigned PCXRLE_DecodeLine(BufferedReader &reader, BYTE *dst, unsigned size);
+
+// ----------------------------------------------------------
+//   BMP RLE4 / RLE8
+// ----------------------------------------------------------
+
+/** Worst case size of a scanline of width pixels packed with BMPRLE_EncodeLine8, end of line marker included */
+#define BMPRLE_MAX_ENCODED_SIZE(width) (2 * (width) + 2)
+
+/**
+Unpacks BI_RLE4 or BI_RLE8 data
+@param reader Input stream
+@param bits First scanline of the bitmap
+@param pitch Distance in bytes between two scanlines
+@param width Image width
+@param height Image height
+@param bpp 4 for BI_RLE4, 8 for BI_RLE8
+@return Returns TRUE if successful, returns FALSE if the stream ended before the bitmap
+*/
+BOOL BMPRLE_Decode(BufferedReader &reader, BYTE *bits, unsigned pitch, unsigned width, unsigned height, unsigned bpp);
+/**
+Packs a 8-bit scanline with BI_RLE8, the end of line marker included
+@return Returns the packed size
+*/
+unsigned BMPRLE_EncodeLine8(BYTE *dst, const BYTE *src, unsigned width);
+
+// ----------------------------------------------------------
+//   TARGA RLE
+// ----------------------------------------------------------
+
+/** Worst case size of a scanline of width pixels packed with TGARLE_EncodeLine */
+#define TGARLE_MAX_ENCODED_SIZE(width, pixel_size) ((width) * (pixel_size) + ((width) + 127) / 128)
+
+/**
+Decoder state, TARGA packets may span several scanlines
+*/
+typedef struct tagTGARLEState {
+	unsigned count;		//! pixels left in the current packet
+	BOOL is_run;		//! TRUE if the current packet is a run
+	BYTE value[4];		//! run value
+} TGARLEState;
+
+/**
+Unpacks a scanline of TARGA RLE pixels, left in file pixel format
+@param reader Input stream
+@param dst Output scanline
+@param width Number of pixels to unpack
+@param pixel_size Pixel size in bytes (1 to 4)
+@param state Decoder state, zeroed before the first scanline
+@return Returns the number of pixels written to dst
+*/
+unsigned TGARLE_DecodeLine(BufferedReader &reader, BYTE *dst, unsigned width, unsigned pixel_size, TGARLEState *state);
+/**
+Packs a scanline of pixels already in file pixel format
+@param dst Output buffer, at least TGARLE_MAX_ENCODED_SIZE(width, pixel_size) bytes
+@return Returns the packed size
+*/
+unsigned TGARLE_EncodeLine(BYTE *dst, const BYTE *src, unsigned width, unsigned pixel_size);
+
+#endif // FREEIMAGE_RLE_CODEC_H
@@ -0,0 +1,642 @@
+// ==========================================================
+// Worker pool and parallel loops
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "ThreadPool.h"
+
+// ----------------------------------------------------------
+//   Worker pool
+// ----------------------------------------------------------
+
+/** TRUE once a worker has deleted its own pool : the worker ends when its task returns, without touching the pool */
+static thread_local BOOL s_pool_deleted = FALSE;
+/** Pool of the worker running on this thread, NULL on the other threads */
+static thread_local const void *s_worker_pool = NULL;
+/** Index of the queue of the worker running on this thread */
+static thread_local size_t s_worker_index = 0;
+
+/**
+Worker threads with one task queue each.<br>
+A task submitted by a worker goes to the queue of that worker, which runs its own
+tasks newest first. Tasks submitted by other threads go to a shared queue, run in
+submission order. An idle worker takes the shared tasks, then steals the oldest
+tasks of the other workers, so that the parts of a loop started by a worker
+(e.g. from an asynchronous job) are spread over the idle ones.<br>
+The pool is reference counted : the library holds one reference while the pool is
+the current one, and each running parallel loop holds another. The last release
+stops the workers, once they have run the tasks left in the queues. The last release
+may come from a task run by one of the workers (e.g. an asynchronous job callback
+changing the thread count) : that worker is detached instead of joined.
+*/
+class ThreadPool {
+public:
+	/**
+	Start thread_count - 1 workers, the calling thread of a loop being the last one
+	*/
+	ThreadPool(int thread_count) : m_stop(false), m_pending(0), m_references(1) {
+		try {
+			// the queues are created before the workers look into them
+			m_queues.reserve(MAX(thread_count - 1, 0));
+			for(int i = 1; i < thread_count; i++) {
+				m_queues.push_back(new WORKQUEUE);
+			}
+			for(size_t i = 0; i < m_queues.size(); i++) {
+				m_threads.push_back(std::thread(&ThreadPool::run, this, i));
+			}
+		} catch(std::exception &) {
+			// run with the workers started so far
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_ready.notify_all();
+		const std::thread::id self = std::this_thread::get_id();
+		for(size_t i = 0; i < m_threads.size(); i++) {
+			if(m_threads[i].get_id() == self) {
+				m_threads[i].detach();
+				s_pool_deleted = TRUE;
+			} else {
+				m_threads[i].join();
+			}
+		}
+		// a worker deleting its pool runs the tasks no other worker was left to run
+		// (no reference is left, so these tasks cannot delete the pool again)
+		TASK task;
+		while(pop(&m_shared, task, FALSE)) {
+			task.first(task.second);
+		}
+		for(size_t i = 0; i < m_queues.size(); i++) {
+			while(pop(m_queues[i], task, FALSE)) {
+				task.first(task.second);
+			}
+			delete m_queues[i];
+		}
+	}
+
+	/**
+	@return Returns the number of workers
+	*/
+	int getWorkerCount() const {
+		return (int)m_threads.size();
+	}
+
+	/**
+	Queue a task, on the queue of the calling worker or on the shared queue
+	@return Returns FALSE if the pool has no worker or the task cannot be queued
+	*/
+	BOOL submit(FI_TaskProc proc, void *task) {
+		if(m_threads.empty()) {
+			return FALSE;
+		}
+		WORKQUEUE *queue = (s_worker_pool == this) ? m_queues[s_worker_index] : &m_shared;
+		try {
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			queue->tasks.push_back(TASK(proc, task));
+		} catch(std::bad_alloc &) {
+			return FALSE;
+		}
+		{
+			// counted under the lock of the idle workers, so that none misses the task
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending++;
+		}
+		m_ready.notify_one();
+		return TRUE;
+	}
+
+	void acquire() {
+		m_references++;
+	}
+
+	void release() {
+		if(--m_references == 0) {
+			delete this;
+		}
+	}
+
+private:
+	typedef std::pair<FI_TaskProc, void*> TASK;
+
+	/** Tasks of a worker, or tasks submitted by the other threads */
+	typedef struct tagWORKQUEUE {
+		std::mutex mutex;
+		std::deque<TASK> tasks;
+	} WORKQUEUE;
+
+	/**
+	Take a task from a queue
+	@param newest TRUE to take the newest task, FALSE for the oldest one
+	@return Returns FALSE if the queue is empty
+	*/
+	BOOL pop(WORKQUEUE *queue, TASK &task, BOOL newest) {
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if(queue->tasks.empty()) {
+			return FALSE;
+		}
+		if(newest) {
+			task = queue->tasks.back();
+			queue->tasks.pop_back();
+		} else {
+			task = queue->tasks.front();
+			queue->tasks.pop_front();
+		}
+		m_pending--;
+		return TRUE;
+	}
+
+	/**
+	Take the next task of a worker : its own newest task, else the oldest shared task,
+	else the oldest task of another worker
+	@return Returns FALSE if every queue is empty
+	*/
+	BOOL take(size_t index, TASK &task) {
+		if(pop(m_queues[index], task, TRUE) || pop(&m_shared, task, FALSE)) {
+			return TRUE;
+		}
+		for(size_t i = 1; i < m_queues.size(); i++) {
+			if(pop(m_queues[(index + i) % m_queues.size()], task, FALSE)) {
+				return TRUE;
+			}
+		}
+		return FALSE;
+	}
+
+	void run(size_t index) {
+		s_worker_pool = this;
+		s_worker_index = index;
+		for(;;) {
+			TASK task;
+			if(!take(index, task)) {
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while((m_pending <= 0) && !m_stop) {
+					m_ready.wait(lock);
+				}
+				if(m_pending <= 0) {
+					s_worker_pool = NULL;
+					return;
+				}
+				continue;
+			}
+			task.first(task.second);
+			if(s_pool_deleted) {
+				// the task released the last reference : this is gone, the thread is detached
+				s_pool_deleted = FALSE;
+				s_worker_pool = NULL;
+				return;
+			}
+		}
+	}
+
+	std::vector<std::thread> m_threads;
+	/** One queue per worker */
+	std::vector<WORKQUEUE*> m_queues;
+	/** Tasks submitted by the threads which are not workers of the pool */
+	WORKQUEUE m_shared;
+	/** Guards m_stop and the count of the queued tasks for the idle workers */
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	bool m_stop;
+	/** Number of queued tasks, may be briefly negative while a task is taken as it is counted */
+	std::atomic<int> m_pending;
+	std::atomic<int> m_references;
+};
+
+// ----------------------------------------------------------
+//   Library settings
+// ----------------------------------------------------------
+
+/** Guards the settings below */
+static std::mutex s_mutex;
+/** Number of threads of the pool, 0 for one per core */
+static int s_thread_count = 0;
+/** Executor set by the application, NULL to use the pool */
+static FI_ExecuteProc s_execute = NULL;
+static void *s_execute_data = NULL;
+static int s_execute_concurrency = 0;
+/**
+Current pool, started on first use. It is not destroyed when the process exits,
+its workers may then be gone already (e.g. on Windows, when the library is unloaded).
+*/
+static ThreadPool *s_pool = NULL;
+
+/** Maximum number of threads used by the calls of this thread, 0 if unlimited */
+static thread_local int s_max_parallelism = 0;
+/** TRUE while this thread runs the body of a parallel loop */
+static thread_local BOOL s_in_parallel_loop = FALSE;
+/** Progress handler of this thread */
+static thread_local FIPROGRESS s_progress = { NULL, NULL, 0, 1 };
+/** TRUE once the progress handler of this thread cancelled an operation watched by a CancelWatch */
+static thread_local BOOL s_cancelled = FALSE;
+
+static int
+GetCoreCount() {
+	const unsigned cores = std::thread::hardware_concurrency();
+	return (cores > 0) ? (int)cores : 1;
+}
+
+/**
+@return Returns the number of threads used by a parallel loop, the calling thread included
+*/
+static int
+GetLoopThreadCount() {
+	return (s_thread_count > 0) ? s_thread_count : GetCoreCount();
+}
+
+/**
+Get a reference to the current pool, started on first use (call with s_mutex locked).
+The pool has at least one worker, to run the background tasks, unless the
+application asked for a single thread.
+@return Returns NULL if the thread count is 1 or the pool cannot be started
+*/
+static ThreadPool*
+AcquirePool() {
+	if(s_thread_count == 1) {
+		return NULL;
+	}
+	if(!s_pool) {
+		s_pool = new(std::nothrow) ThreadPool(MAX(GetLoopThreadCount(), 2));
+	}
+	if(s_pool) {
+		s_pool->acquire();
+	}
+	return s_pool;
+}
+
+/**
+Replace the current pool by the one created on next use
+*/
+static void
+RetirePool() {
+	ThreadPool *pool = NULL;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		pool = s_pool;
+		s_pool = NULL;
+	}
+	if(pool) {
+		pool->release();
+	}
+}
+
+// ----------------------------------------------------------
+//   Parallel loop
+// ----------------------------------------------------------
+
+/**
+A parallel loop, shared by the calling thread and the tasks it submitted.<br>
+Each task holds a reference, so that a task started after the loop returned
+(finding no chunk left) still has a valid job.
+*/
+typedef struct tagPARALLELJOB {
+	FI_ParallelProc proc;
+	void *data;
+	unsigned count;						//! number of iterations
+	unsigned chunk;						//! number of iterations of a chunk
+	unsigned chunk_count;				//! number of chunks
+	std::atomic<unsigned> next;			//! next chunk to run
+	std::atomic<unsigned> done;			//! number of chunks run or skipped
+	std::atomic<bool> cancelled;		//! TRUE if the chunks left are skipped
+	std::atomic<int> references;		//! calling thread and submitted tasks
+	std::mutex mutex;
+	std::condition_variable finished;
+} PARALLELJOB;
+
+static void
+ReleaseJob(PARALLELJOB *job) {
+	if(--job->references == 0) {
+		delete job;
+	}
+}
+
+/**
+Run a chunk of a loop
+*/
+static void
+RunChunk(FI_ParallelProc proc, void *data, unsigned first, unsigned last) {
+	const BOOL in_parallel_loop = s_in_parallel_loop;
+	s_in_parallel_loop = TRUE;
+	proc(data, first, last);
+	s_in_parallel_loop = in_parallel_loop;
+}
+
+/**
+Run chunks of a loop until none is left
+@param report TRUE on the calling thread of the loop, which reports its progress
+*/
+static void
+RunChunks(PARALLELJOB *job, BOOL report) {
+	unsigned chunk;
+	while((chunk = job->next++) < job->chunk_count) {
+		if(!job->cancelled) {
+			const unsigned first = chunk * job->chunk;
+			RunChunk(job->proc, job->data, first, first + MIN(job->chunk, job->count - first));
+		}
+
+		const unsigned done = ++job->done;
+		if(done == job->chunk_count) {
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->finished.notify_all();
+		}
+
+		if(report && !job->cancelled && !FreeImage_ReportProgress((double)done / job->chunk_count)) {
+			job->cancelled = true;
+		}
+	}
+}
+
+static void DLL_CALLCONV
+RunTask(void *task) {
+	PARALLELJOB *job = (PARALLELJOB*)task;
+	RunChunks(job, FALSE);
+	ReleaseJob(job);
+}
+
+BOOL
+FreeImage_ParallelFor(unsigned count, unsigned chunk, FI_ParallelProc proc, void *data) {
+	if(count == 0) {
+		return TRUE;
+	}
+	chunk = MAX(chunk, 1U);
+
+	// no more threads than chunks
+	const unsigned chunk_count = count / chunk + ((count % chunk) ? 1 : 0);
+	int threads = s_in_parallel_loop ? 1 : (int)MIN(chunk_count, 0x10000U);
+	if(s_max_parallelism > 0) {
+		threads = MIN(threads, s_max_parallelism);
+	}
+
+	FI_ExecuteProc execute = NULL;
+	void *execute_data = NULL;
+	ThreadPool *pool = NULL;
+
+	if(threads > 1) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if(s_execute) {
+			execute = s_execute;
+			execute_data = s_execute_data;
+			threads = MIN(threads, s_execute_concurrency);
+		} else {
+			threads = MIN(threads, GetLoopThreadCount());
+			pool = (threads > 1) ? AcquirePool() : NULL;
+			threads = pool ? MIN(threads, pool->getWorkerCount() + 1) : 1;
+		}
+	}
+
+	PARALLELJOB *job = (threads > 1) ? new(std::nothrow) PARALLELJOB : NULL;
+	if(!job) {
+		if(pool) {
+			pool->release();
+		}
+		// run the chunks one after the other only when someone follows them
+		if(!s_progress.proc || s_in_parallel_loop) {
+			proc(data, 0, count);
+			return TRUE;
+		}
+		for(unsigned first = 0; first < count; first += chunk) {
+			RunChunk(proc, data, first, first + MIN(chunk, count - first));
+			if(!FreeImage_ReportProgress((double)MIN(first + chunk, count) / count)) {
+				return FALSE;
+			}
+		}
+		return TRUE;
+	}
+
+	job->proc = proc;
+	job->data = data;
+	job->count = count;
+	job->chunk = chunk;
+	job->chunk_count = chunk_count;
+	job->next = 0;
+	job->done = 0;
+	job->cancelled = false;
+
+	const int tasks = threads - 1;
+	job->references = 1 + tasks;
+	for(int i = 0; i < tasks; i++) {
+		if(execute) {
+			execute(RunTask, job, execute_data);
+		} else if(!pool->submit(RunTask, job)) {
+			ReleaseJob(job);
+		}
+	}
+
+	RunChunks(job, TRUE);
+
+	// wait for the chunks taken by other threads, tasks not started yet will find none left
+	{
+		std::unique_lock<std::mutex> lock(job->mutex);
+		while(job->done < job->chunk_count) {
+			job->finished.wait(lock);
+		}
+	}
+	const BOOL bSuccess = job->cancelled ? FALSE : TRUE;
+	ReleaseJob(job);
+
+	if(pool) {
+		pool->release();
+	}
+
+	return bSuccess;
+}
+
+// ----------------------------------------------------------
+//   Progress
+// ----------------------------------------------------------
+
+BOOL
+FreeImage_ReportProgress(double done) {
+	if(!s_progress.proc || s_in_parallel_loop) {
+		return TRUE;
+	}
+	done = CLAMP(done, 0.0, 1.0);
+	if(!s_progress.proc(s_progress.first + done * s_progress.range, s_progress.user_data)) {
+		s_cancelled = TRUE;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+ProgressStep::ProgressStep(double first, double last) : m_enclosing(s_progress) {
+	s_progress.first = m_enclosing.first + first * m_enclosing.range;
+	s_progress.range = (last - first) * m_enclosing.range;
+}
+
+ProgressStep::~ProgressStep() {
+	s_progress = m_enclosing;
+}
+
+ProgressHandler::ProgressHandler(FI_ProgressProc proc, void *user_data) : m_previous(s_progress) {
+	FreeImage_SetProgressHandler(proc, user_data);
+}
+
+ProgressHandler::~ProgressHandler() {
+	s_progress = m_previous;
+}
+
+CancelWatch::CancelWatch() : m_enclosing(s_cancelled) {
+	s_cancelled = FALSE;
+}
+
+CancelWatch::~CancelWatch() {
+	s_cancelled = (m_enclosing || s_cancelled) ? TRUE : FALSE;
+}
+
+BOOL
+CancelWatch::isCancelled() const {
+	return s_cancelled;
+}
+
+// ----------------------------------------------------------
+//   Background task
+// ----------------------------------------------------------
+
+BOOL
+FreeImage_SubmitTask(FI_TaskProc proc, void *task) {
+	FI_ExecuteProc execute = NULL;
+	void *execute_data = NULL;
+	ThreadPool *pool = NULL;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if(s_execute) {
+			execute = s_execute;
+			execute_data = s_execute_data;
+		} else {
+			pool = AcquirePool();
+		}
+	}
+
+	if(execute) {
+		execute(proc, task, execute_data);
+		return TRUE;
+	}
+	if(pool) {
+		const BOOL submitted = pool->submit(proc, task);
+		pool->release();
+		return submitted;
+	}
+	return FALSE;
+}
+
+// ----------------------------------------------------------
+//   Multithreading routines
+// ----------------------------------------------------------
+
+/**
+Set the number of threads used by the parallel parts of the library, the calling
+thread included. A count of 0 (the default) uses one thread per core, a count of 1
+runs everything on the calling thread, background jobs included. The worker threads
+are started on first use. Tasks queued on the previous workers run before this
+function returns.
+*/
+void DLL_CALLCONV
+FreeImage_SetThreadCount(int count) {
+	BOOL changed = FALSE;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		count = MAX(count, 0);
+		changed = (count != s_thread_count) ? TRUE : FALSE;
+		s_thread_count = count;
+	}
+	if(changed) {
+		RetirePool();
+	}
+}
+
+/**
+@return Returns the number of threads used by the parallel parts of the library,
+the concurrency of the executor if one is set
+*/
+int DLL_CALLCONV
+FreeImage_GetThreadCount() {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if(s_execute) {
+		return s_execute_concurrency;
+	}
+	return GetLoopThreadCount();
+}
+
+/**
+Run the parallel parts of the library on an application scheduler instead of the
+worker pool. The library calls execute(proc, task, user_data) for each task, and
+the scheduler must later call proc(task) exactly once, on any thread (the calling
+one included). The library never waits for a task that has not started, so a busy
+scheduler only delays the work it was given.
+@param execute Task submission function, NULL to use the worker pool again
+@param concurrency Maximum number of threads a call of the library uses, the
+calling thread included (0 for one per core)
+@param user_data Data given to execute
+*/
+void DLL_CALLCONV
+FreeImage_SetExecutor(FI_ExecuteProc execute, int concurrency, void *user_data) {
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_execute = execute;
+		s_execute_data = execute ? user_data : NULL;
+		s_execute_concurrency = execute ? ((concurrency > 0) ? concurrency : GetCoreCount()) : 0;
+	}
+	// the pool is started again if the executor is removed
+	if(execute) {
+		RetirePool();
+	}
+}
+
+/**
+Limit the number of threads used by the calls made from the calling thread, the
+calling thread included. A count of 0 (the default) removes the limit.
+*/
+void DLL_CALLCONV
+FreeImage_SetMaxParallelism(int count) {
+	s_max_parallelism = MAX(count, 0);
+}
+
+int DLL_CALLCONV
+FreeImage_GetMaxParallelism() {
+	return s_max_parallelism;
+}
+
+// ----------------------------------------------------------
+//   Progress routines
+// ----------------------------------------------------------
+
+/**
+Set the progress handler of the calling thread. Long operations run by the thread
+(large loads, rescaling, tone mapping, ...) call proc(progress, user_data) as they
+go, with the fraction of the operation done, from 0 to 1. The operation is cancelled
+when proc returns FALSE : it frees what it allocated and fails (e.g. a load returns NULL).
+Operations which do not report their progress ignore the handler.
+@param proc Progress handler, NULL to remove it
+@param user_data Data given to proc
+*/
+void DLL_CALLCONV
+FreeImage_SetProgressHandler(FI_ProgressProc proc, void *user_data) {
+	s_progress.proc = proc;
+	s_progress.user_data = proc ? user_data : NULL;
+	s_progress.first = 0;
+	s_progress.range = 1;
+}
@@ -22,6 +22,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ThreadPool.h"
 
 // ----------------------------------------------------------
 // Gradient domain HDR compression
@@ -131,6 +132,7 @@ static BOOL GaussianPyramid(FIBITMAP *H, FIBITMAP **pyramid, int nlevels) {
 		if(pyramid[0] == NULL) throw(1);
 		// compute next levels
 		for(int k = 1; k < nlevels; k++) {
+			ProgressStep step((double)(k-1) / (nlevels-1), (double)k / (nlevels-1));
 			pyramid[k] = GaussianLevel5x5(pyramid[k-1]);
 			if(pyramid[k] == NULL) throw(1);
 		}
@@ -250,6 +252,8 @@ static FIBITMAP* PhiMatrix(FIBITMAP **gradients, float *avgGrad, int nlevels, fl
 		memset(phi, 0, nlevels * sizeof(FIBITMAP*));
 
 		for(int k = nlevels-1; k >= 0; k--) {
+			ProgressStep step((double)(nlevels-1-k) / nlevels, (double)(nlevels-k) / nlevels);
+
 			// compute phi(k)
 
 			FIBITMAP *Gk = gradients[k];
@@ -508,8 +512,9 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 
 	try {
 		// get the normalized luminance
-		FIBITMAP *H = LogLuminance(Y);
+		H = LogLuminance(Y);
 		if(!H) throw(1);
+		if(!FreeImage_ReportProgress(0.02)) throw(1);
 		
 		// get the number of levels for the pyramid
 		const unsigned width = FreeImage_GetWidth(H);
@@ -525,7 +530,11 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 		if(!pyramid) throw(1);
 		memset(pyramid, 0, nlevels * sizeof(FIBITMAP*));
 
-		if(!GaussianPyramid(H, pyramid, nlevels)) throw(1);
+		{
+			ProgressStep step(0.02, 0.05);
+			if(!GaussianPyramid(H, pyramid, nlevels)) throw(1);
+		}
+		if(!FreeImage_ReportProgress(0.05)) throw(1);
 
 		// calculate gradient magnitude and its average value on each pyramid level
 		gradients = (FIBITMAP**)malloc(nlevels * sizeof(FIBITMAP*));
@@ -535,6 +544,7 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 		if(!avgGrad) throw(1);
 
 		if(!GradientPyramid(pyramid, nlevels, gradients, avgGrad)) throw(1);
+		if(!FreeImage_ReportProgress(0.08)) throw(1);
 
 		// free the Gaussian pyramid
 		for(k = 0; k < nlevels; k++) {
@@ -543,8 +553,12 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 		free(pyramid); pyramid = NULL;
 
 		// compute the gradient attenuation function PHI(x, y)
-		phy = PhiMatrix(gradients, avgGrad, nlevels, alpha, beta);
+		{
+			ProgressStep step(0.08, 0.12);
+			phy = PhiMatrix(gradients, avgGrad, nlevels, alpha, beta);
+		}
 		if(!phy) throw(1);
+		if(!FreeImage_ReportProgress(0.12)) throw(1);
 
 		// free the gradient pyramid
 		for(k = 0; k < nlevels; k++) {
@@ -557,13 +571,17 @@ static FIBITMAP* tmoFattal02(FIBITMAP *Y, float alpha, float beta) {
 		// then compute the divergence div G from the attenuated gradient. 
 		divG = Divergence(H, phy);
 		if(!divG) throw(1);
+		if(!FreeImage_ReportProgress(0.15)) throw(1);
 
 		// H & phy no longer needed
 		FreeImage_Unload(H); H = NULL;
 		FreeImage_Unload(phy); phy = NULL;
 
 		// solve the PDE (Poisson equation) using a multigrid solver and 3 cycles
-		FIBITMAP *U = FreeImage_MultigridPoissonSolver(divG, 3);
+		{
+			ProgressStep step(0.15, 1);
+			U = FreeImage_MultigridPoissonSolver(divG, 3);
+		}
 		if(!U) throw(1);
 
 		FreeImage_Unload(divG);
@@ -631,7 +649,10 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		if(!Yin) throw(1);
 
 		// perform the tone mapping
-		Yout = tmoFattal02(Yin, alpha, beta);
+		{
+			ProgressStep step(0, 0.95);
+			Yout = tmoFattal02(Yin, alpha, beta);
+		}
 		if(!Yout) throw(1);
 
 		// clip low and high values and normalize to [0..1]
@@ -651,6 +672,7 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		BYTE *bits_yout = (BYTE*)FreeImage_GetBits(Yout);
 
 		for(unsigned y = 0; y < height; y++) {
+			if(!FreeImage_ReportProgress(0.95 + 0.05 * y / height)) throw(1);
 			float *Lin = (float*)bits_yin;
 			float *Lout = (float*)bits_yout;
 			float *color = (float*)bits;
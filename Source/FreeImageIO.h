@@ -26,6 +26,9 @@
 #include "FreeImage.h"
 #endif
 
+#include <stdio.h>
+#include <string.h>
+
 // ----------------------------------------------------------
 
 FI_STRUCT (FIMEMORYHEADER) {
@@ -60,4 +63,162 @@ void SetDefaultIO(FreeImageIO *io);
 
 void SetMemoryIO(FreeImageIO *io);
 
+// ----------------------------------------------------------
+
+/**
+Buffered input stream, used by the plugins to parse a stream 
+without issuing one read_proc call per byte or per field.
+The stream reads ahead of the parser : call release() when the caller
+needs the stream position to match the bytes consumed so far.
+*/
+class BufferedReader
+{
+public:
+	BufferedReader(FreeImageIO *io, fi_handle handle, unsigned size = 65536);
+	~BufferedReader();
+
+	/** Returns TRUE if the buffer could not be allocated */
+	BOOL isNull() const { return _begin == NULL; }
+
+	/** Returns the next byte, or EOF at the end of the stream */
+	inline int getByte() {
+		if ((_ptr < _end) || fill(1)) {
+			return *_ptr++;
+		}
+		return EOF;
+	}
+
+	/** Returns a pointer to the next count bytes (count must not exceed the buffer size), or NULL at the end of the stream */
+	inline const BYTE* getBytes(unsigned count) {
+		if ((unsigned)(_end - _ptr) >= count || fill(count)) {
+			const BYTE *result = _ptr;
+			_ptr += count;
+			return result;
+		}
+		return NULL;
+	}
+
+	/** Returns a pointer to the next count bytes without consuming them (count must not exceed the buffer size), or NULL at the end of the stream */
+	inline const BYTE* peek(unsigned count) {
+		if ((unsigned)(_end - _ptr) >= count || fill(count)) {
+			return _ptr;
+		}
+		return NULL;
+	}
+
+	/** Reads a little endian WORD, returns FALSE at the end of the stream */
+	inline BOOL readWordLE(WORD *value) {
+		const BYTE *p = getBytes(2);
+		if (!p) {
+			return FALSE;
+		}
+		*value = (WORD)(p[0] | (p[1] << 8));
+		return TRUE;
+	}
+
+	/** Reads a big endian WORD, returns FALSE at the end of the stream */
+	inline BOOL readWordBE(WORD *value) {
+		const BYTE *p = getBytes(2);
+		if (!p) {
+			return FALSE;
+		}
+		*value = (WORD)((p[0] << 8) | p[1]);
+		return TRUE;
+	}
+
+	/** Reads a little endian DWORD, returns FALSE at the end of the stream */
+	inline BOOL readDWordLE(DWORD *value) {
+		const BYTE *p = getBytes(4);
+		if (!p) {
+			return FALSE;
+		}
+		*value = (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+		return TRUE;
+	}
+
+	/** Reads a big endian DWORD, returns FALSE at the end of the stream */
+	inline BOOL readDWordBE(DWORD *value) {
+		const BYTE *p = getBytes(4);
+		if (!p) {
+			return FALSE;
+		}
+		*value = ((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | (DWORD)p[3];
+		return TRUE;
+	}
+
+	/** Copies up to size bytes to dst and returns the number of bytes copied */
+	inline unsigned read(void *dst, unsigned size) {
+		if ((unsigned)(_end - _ptr) >= size) {
+			memcpy(dst, _ptr, size);
+			_ptr += size;
+			return size;
+		}
+		return readBlock(dst, size);
+	}
+	/** Skips size bytes, returns FALSE at the end of the stream */
+	BOOL skip(unsigned size);
+	/** 
+	Moves to a new position (see seek_proc), without reading the stream again when the position is buffered
+	@return Returns TRUE if successful, returns FALSE otherwise
+	*/
+	BOOL seek(long offset, int origin);
+	/** Returns the position of the first unread byte */
+	long tell() const;
+	/** Seeks the stream back to the first unread byte and empties the buffer */
+	void release();
+
+private:
+	BOOL fill(unsigned count);
+	unsigned readBlock(void *dst, unsigned size);
+
+	BufferedReader& operator=(const BufferedReader& src); // deleted
+	BufferedReader(const BufferedReader& other); // deleted
+
+private:
+	BYTE *_begin;
+	BYTE *_ptr;
+	BYTE *_end;
+	const unsigned _size;
+	FreeImageIO *_io;
+	fi_handle _handle;
+};
+
+/**
+Read-only IO reading from a BufferedReader, whose address is the IO handle.
+Used by plugins whose parsers are written on top of FreeImageIO.
+*/
+void SetBufferedIO(FreeImageIO *io);
+
+/**
+Maps size bytes of a stream, starting at offset, without reading them.
+Only files opened by FreeImage and memory streams can be mapped : files are mapped copy-on-write, 
+memory streams are copied into a private view, so that the view never writes to its stream.
+@param io Stream IO
+@param handle Stream handle
+@param offset Absolute offset of the first byte
+@param size Number of bytes to map
+@param mapping Receives the mapping to be released with UnmapIO
+@return Returns a pointer to the first byte, returns NULL if the stream cannot be mapped
+*/
+BYTE* MapIO(FreeImageIO *io, fi_handle handle, long offset, size_t size, void **mapping);
+
+/**
+Releases a mapping returned by MapIO
+*/
+void UnmapIO(void *mapping);
+
+/**
+Asks the system to read a mapping returned by MapIO in the background, so that the
+reads overlap with the decoding of the first bytes. Does nothing where unsupported.
+*/
+void PrefetchIO(void *mapping);
+
+/**
+Allocates a bitmap wrapping height * pitch bytes of a stream, starting at offset (see MapIO).
+File pixels are mapped copy-on-write, memory stream pixels are copied (see MapIO), 
+the view is released by FreeImage_Unload and the stream may be closed before the bitmap.
+@return Returns NULL if the stream cannot be mapped, the caller then loads the pixels as usual
+*/
+FIBITMAP* AllocateMappedBitmap(FreeImageIO *io, fi_handle handle, long offset, unsigned pitch, FREE_IMAGE_TYPE type, int width, int height, int bpp, unsigned red_mask = 0, unsigned green_mask = 0, unsigned blue_mask = 0);
+
 #endif // !FREEIMAGE_IO_H
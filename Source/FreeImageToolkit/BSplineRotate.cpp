@@ -44,8 +44,10 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 
 
 #include <float.h>
+#include <atomic>
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
 #define PI	((double)3.14159265358979323846264338327950288419716939937510)
 
@@ -54,38 +56,42 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 #define ROTATE_QUARTIC   4L	// Use B-splines of degree 4 (quartic interpolation)
 #define ROTATE_QUINTIC   5L	// Use B-splines of degree 5 (quintic interpolation)
 
+#define COLUMN_BLOCK	1024L	// number of interleaved samples filtered together along y
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Prototypes definition
 
-static void ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance);
-static double InitialCausalCoefficient(double *c, long DataLength, double z, double Tolerance);
-static void GetColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	GetRow(double *Image, long y, double *Line, long Width);
-static double InitialAntiCausalCoefficient(double *c, long DataLength, double z);
-static void	PutColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	PutRow(double *Image, long y, double *Line, long Width);
-static bool SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree);
-static double InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree);
+static void ConvertToInterpolationCoefficients(float *c, long DataLength, long Stride, long Lanes, double *z, long NbPoles, double Tolerance, float *Sum);
+static void InitialCausalCoefficient(float *c, long DataLength, long Stride, long Lanes, double z, double Tolerance, float *Sum);
+static void InitialAntiCausalCoefficient(float *c, long DataLength, long Stride, long Lanes, double z);
+static bool SamplesToCoefficients(float *Image, long Width, long Height, long Channels, long spline_degree);
 
-static FIBITMAP * Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask);
+static FIBITMAP * RotateBSpline(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask);
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Coefficients routines
 
 /**
- ConvertToInterpolationCoefficients
+ ConvertToInterpolationCoefficients.<br>
+ The recursive filter is applied to several interleaved signals (the lanes) at once : 
+ sample n of lane k is c[n * Stride + k]. Filtering the rows of an image uses one lane 
+ per channel, filtering its columns uses one lane per interleaved sample of a row, 
+ so that columns are processed in place, a whole block of them at a time. 
 
  @param c Input samples --> output coefficients
  @param DataLength Number of samples or coefficients
+ @param Stride Distance between two consecutive samples of a lane
+ @param Lanes Number of interleaved signals
  @param z Poles
  @param NbPoles Number of poles
  @param Tolerance Admissible relative error
+ @param Sum Work array of Lanes values
 */
 static void 
-ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance) {
+ConvertToInterpolationCoefficients(float *c, long DataLength, long Stride, long Lanes, double *z, long NbPoles, double Tolerance, float *Sum) {
 	double	Lambda = 1;
-	long	n, k;
+	long	n, k, i;
 
 	// special case required by mirror boundaries
 	if(DataLength == 1L) {
@@ -96,39 +102,55 @@ ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long N
 		Lambda = Lambda * (1.0 - z[k]) * (1.0 - 1.0 / z[k]);
 	}
 	// apply the gain 
+	const float fLambda = (float)Lambda;
 	for (n = 0L; n < DataLength; n++) {
-		c[n] *= Lambda;
+		float *cn = c + n * Stride;
+		for(i = 0L; i < Lanes; i++) {
+			cn[i] *= fLambda;
+		}
 	}
 	// loop over all poles 
 	for (k = 0L; k < NbPoles; k++) {
+		const float zk = (float)z[k];
 		// causal initialization 
-		c[0] = InitialCausalCoefficient(c, DataLength, z[k], Tolerance);
+		InitialCausalCoefficient(c, DataLength, Stride, Lanes, z[k], Tolerance, Sum);
 		// causal recursion 
 		for (n = 1L; n < DataLength; n++) {
-			c[n] += z[k] * c[n - 1L];
+			float *cn = c + n * Stride;
+			const float *cp = cn - Stride;
+			for(i = 0L; i < Lanes; i++) {
+				cn[i] += zk * cp[i];
+			}
 		}
 		// anticausal initialization 
-		c[DataLength - 1L] = InitialAntiCausalCoefficient(c, DataLength, z[k]);
+		InitialAntiCausalCoefficient(c, DataLength, Stride, Lanes, z[k]);
 		// anticausal recursion 
 		for (n = DataLength - 2L; 0 <= n; n--) {
-			c[n] = z[k] * (c[n + 1L] - c[n]);
+			float *cn = c + n * Stride;
+			const float *cp = cn + Stride;
+			for(i = 0L; i < Lanes; i++) {
+				cn[i] = zk * (cp[i] - cn[i]);
+			}
 		}
 	}
 } 
 
 /**
- InitialCausalCoefficient
+ InitialCausalCoefficient.<br>
+ The initial coefficient of each lane is stored in c[0 .. Lanes-1]. 
 
  @param c Coefficients
  @param DataLength Number of coefficients
+ @param Stride Distance between two consecutive samples of a lane
+ @param Lanes Number of interleaved signals
  @param z Actual pole
  @param Tolerance Admissible relative error
- @return
+ @param Sum Work array of Lanes values
 */
-static double 
-InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance) {
-	double	Sum, zn, z2n, iz;
-	long	n, Horizon;
+static void 
+InitialCausalCoefficient(float *c, long DataLength, long Stride, long Lanes, double z, double Tolerance, float *Sum) {
+	double	zn, z2n, iz;
+	long	n, i, Horizon;
 
 	// this initialization corresponds to mirror boundaries 
 	Horizon = DataLength;
@@ -138,117 +160,103 @@ InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance)
 	if(Horizon < DataLength) {
 		// accelerated loop
 		zn = z;
-		Sum = c[0];
 		for (n = 1L; n < Horizon; n++) {
-			Sum += zn * c[n];
+			const float fzn = (float)zn;
+			const float *cn = c + n * Stride;
+			for(i = 0L; i < Lanes; i++) {
+				c[i] += fzn * cn[i];
+			}
 			zn *= z;
 		}
-		return(Sum);
 	}
 	else {
 		// full loop 
 		zn = z;
 		iz = 1.0 / z;
 		z2n = pow(z, (double)(DataLength - 1L));
-		Sum = c[0] + z2n * c[DataLength - 1L];
+		const float *cl = c + (DataLength - 1L) * Stride;
+		for(i = 0L; i < Lanes; i++) {
+			Sum[i] = c[i] + (float)z2n * cl[i];
+		}
 		z2n *= z2n * iz;
 		for (n = 1L; n <= DataLength - 2L; n++) {
-			Sum += (zn + z2n) * c[n];
+			const float fz = (float)(zn + z2n);
+			const float *cn = c + n * Stride;
+			for(i = 0L; i < Lanes; i++) {
+				Sum[i] += fz * cn[i];
+			}
 			zn *= z;
 			z2n *= iz;
 		}
-		return(Sum / (1.0 - zn * zn));
-	}
-}
-
-/**
- GetColumn
-
- @param Image Input image array
- @param Width Width of the image
- @param x x coordinate of the selected line
- @param Line Output linear array
- @param Height Length of the line
-*/
-static void 
-GetColumn(double *Image, long Width, long x, double *Line, long Height) {
-	long y;
-
-	Image = Image + x;
-	for(y = 0L; y < Height; y++) {
-		Line[y] = (double)*Image;
-		Image += Width;
-	}
-}
-
-/**
- GetRow
-
- @param Image Input image array
- @param y y coordinate of the selected line
- @param Line Output linear array
- @param Width Length of the line
-*/
-static void	
-GetRow(double *Image, long y, double *Line, long Width) {
-	long	x;
-
-	Image = Image + (y * Width);
-	for(x = 0L; x < Width; x++) {
-		Line[x] = (double)*Image++;
+		const float fScale = (float)(1.0 / (1.0 - zn * zn));
+		for(i = 0L; i < Lanes; i++) {
+			c[i] = Sum[i] * fScale;
+		}
 	}
 }
 
 /**
- InitialAntiCausalCoefficient
+ InitialAntiCausalCoefficient.<br>
+ The initial coefficient of each lane is stored in the last sample of the lane. 
 
  @param c Coefficients
  @param DataLength Number of samples or coefficients
+ @param Stride Distance between two consecutive samples of a lane
+ @param Lanes Number of interleaved signals
  @param z Actual pole
- @return
 */
-static double 
-InitialAntiCausalCoefficient(double	*c, long DataLength, double	z) {
+static void 
+InitialAntiCausalCoefficient(float *c, long DataLength, long Stride, long Lanes, double z) {
 	// this initialization corresponds to mirror boundaries
-	return((z / (z * z - 1.0)) * (z * c[DataLength - 2L] + c[DataLength - 1L]));
+	const float fz = (float)z;
+	const float fScale = (float)(z / (z * z - 1.0));
+	float *cl = c + (DataLength - 1L) * Stride;
+	const float *cp = cl - Stride;
+	for(long i = 0L; i < Lanes; i++) {
+		cl[i] = fScale * (fz * cp[i] + cl[i]);
+	}
 }
 
-/**
- PutColumn
-
- @param Image Output image array
- @param Width Width of the image
- @param x x coordinate of the selected line
- @param Line Input linear array
- @param Height Length of the line and height of the image
+/** Arguments of the separable prefilter run on bands of rows or of column blocks in parallel
 */
-static void	
-PutColumn(double *Image, long Width, long x, double *Line, long Height) {
-	long	y;
-
-	Image = Image + x;
-	for(y = 0L; y < Height; y++) {
-		*Image = (double)Line[y];
-		Image += Width;
+typedef struct tagPREFILTERPASS {
+	float *Image;
+	long Width;
+	long Height;
+	long Line;					//! number of interleaved samples of a row
+	long Channels;
+	double Pole[2];
+	long NbPoles;
+	std::atomic<bool> failed;	//! true if a band could not allocate its work array
+} PREFILTERPASS;
+
+static void
+PrefilterRows(void *data, unsigned first, unsigned last) {
+	PREFILTERPASS *pass = (PREFILTERPASS*)data;
+	float *Sum = (float *)malloc(pass->Channels * sizeof(float));
+	if (Sum == NULL) {
+		pass->failed = true;
+		return;
 	}
+	for (long y = (long)first; y < (long)last; y++) {
+		ConvertToInterpolationCoefficients(pass->Image + y * pass->Line, pass->Width, pass->Channels, pass->Channels, pass->Pole, pass->NbPoles, FLT_EPSILON, Sum);
+	}
+	free(Sum);
 }
 
-/**
- PutRow
-
- @param Image Output image array
- @param y y coordinate of the selected line
- @param Line Input linear array
- @param Width length of the line and width of the image
-*/
-static void	
-PutRow(double *Image, long y, double *Line, long Width) {
-	long	x;
-
-	Image = Image + (y * Width);
-	for(x = 0L; x < Width; x++) {
-		*Image++ = (double)Line[x];
+static void
+PrefilterColumnBlocks(void *data, unsigned first, unsigned last) {
+	PREFILTERPASS *pass = (PREFILTERPASS*)data;
+	float *Sum = (float *)malloc(MIN(COLUMN_BLOCK, pass->Line) * sizeof(float));
+	if (Sum == NULL) {
+		pass->failed = true;
+		return;
+	}
+	for (long block = (long)first; block < (long)last; block++) {
+		const long x = block * COLUMN_BLOCK;
+		ConvertToInterpolationCoefficients(pass->Image + x, pass->Height, pass->Line, MIN(COLUMN_BLOCK, pass->Line - x), pass->Pole, pass->NbPoles, FLT_EPSILON, Sum);
 	}
+	free(Sum);
 }
 
 /**
@@ -258,19 +266,21 @@ PutRow(double *Image, long y, double *Line, long Width) {
  data are processed in-place. 
  Even though this algorithm is robust with respect to quantization, 
  we advocate the use of a floating-point format for the data. 
+ Rows are filtered one at a time, columns are filtered in blocks of COLUMN_BLOCK 
+ interleaved samples, directly inside the image. Each row and each block is 
+ independent of the others, so both passes are spread over the worker pool. 
 
- @param Image Input / Output image (in-place processing)
+ @param Image Input / Output image (in-place processing), with Channels interleaved samples per pixel
  @param Width Width of the image
  @param Height Height of the image
+ @param Channels Number of samples per pixel
  @param spline_degree Degree of the spline model
  @return Returns true if success, false otherwise
 */
 static bool	
-SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree) {
-	double	*Line;
+SamplesToCoefficients(float *Image, long Width, long Height, long Channels, long spline_degree) {
 	double	Pole[2];
 	long	NbPoles;
-	long	x, y;
 
 	// recover the poles from a lookup table
 	switch (spline_degree) {
@@ -301,31 +311,27 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 
 	// convert the image samples into interpolation coefficients 
 
+	PREFILTERPASS pass;
+	pass.Image = Image;
+	pass.Width = Width;
+	pass.Height = Height;
+	pass.Line = Width * Channels;
+	pass.Channels = Channels;
+	pass.Pole[0] = Pole[0];
+	pass.Pole[1] = Pole[1];
+	pass.NbPoles = NbPoles;
+	pass.failed = false;
+
 	// in-place separable process, along x 
-	Line = (double *)malloc(Width * sizeof(double));
-	if (Line == NULL) {
-		// Row allocation failed
+	if (!FreeImage_ParallelFor((unsigned)Height, FreeImage_GetRowChunk((unsigned)Width), PrefilterRows, &pass) || pass.failed) {
 		return false;
 	}
-	for (y = 0L; y < Height; y++) {
-		GetRow(Image, y, Line, Width);
-		ConvertToInterpolationCoefficients(Line, Width, Pole, NbPoles, DBL_EPSILON);
-		PutRow(Image, y, Line, Width);
-	}
-	free(Line);
 
 	// in-place separable process, along y 
-	Line = (double *)malloc(Height * sizeof(double));
-	if (Line == NULL) {
-		// Column allocation failed
+	const unsigned blocks = (unsigned)((pass.Line + COLUMN_BLOCK - 1) / COLUMN_BLOCK);
+	if (!FreeImage_ParallelFor(blocks, 1, PrefilterColumnBlocks, &pass) || pass.failed) {
 		return false;
 	}
-	for (x = 0L; x < Width; x++) {
-		GetColumn(Image, Width, x, Line, Height);
-		ConvertToInterpolationCoefficients(Line, Height, Pole, NbPoles, DBL_EPSILON);
-		PutColumn(Image, Width, x, Line, Height);
-	}
-	free(Line);
 
 	return true;
 }
@@ -334,173 +340,267 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 // Interpolation routines
 
 /**
-Perform the bidimensional interpolation of an image.
-Given an array of spline coefficients, return the value of 
-the underlying continuous spline model, sampled at the location (x, y). 
-The model degree can be 2 (quadratic), 3 (cubic), 4 (quartic), or 5 (quintic).
+Compute the interpolation indexes and weights along one axis. 
+The mirror boundary conditions are applied to the indexes. 
 
-@param Bcoeff Input B-spline array of coefficients
-@param Width Width of the image
-@param Height Height of the image
-@param x x coordinate where to interpolate
-@param y y coordinate where to interpolate
-@param spline_degree Degree of the spline model
-@return Returns the value of the underlying continuous spline model, 
-sampled at the location (x, y)
+@param x Coordinate where to interpolate
+@param Length Length of the axis (image width or height)
+@param Index Output spline_degree + 1 indexes
+@param Weight Output spline_degree + 1 weights
 */
-static double 
-InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree) {
-	double	*p;
-	double	xWeight[6], yWeight[6];
-	double	interpolated;
+template <long spline_degree> static void 
+InterpolationWeights(double x, long Length, long *Index, float *Weight) {
 	double	w, w2, w4, t, t0, t1;
-	long	xIndex[6], yIndex[6];
-	long	Width2 = 2L * Width - 2L, Height2 = 2L * Height - 2L;
-	long	i, j, k;
+	double	dWeight[6];
+	long	Length2 = 2L * Length - 2L;
+	long	i, k;
 
 	// compute the interpolation indexes
 	if (spline_degree & 1L) {
 		i = (long)floor(x) - spline_degree / 2L;
-		j = (long)floor(y) - spline_degree / 2L;
-		for(k = 0; k <= spline_degree; k++) {
-			xIndex[k] = i++;
-			yIndex[k] = j++;
-		}
 	}
 	else {
 		i = (long)floor(x + 0.5) - spline_degree / 2L;
-		j = (long)floor(y + 0.5) - spline_degree / 2L;
-		for (k = 0; k <= spline_degree; k++) {
-			xIndex[k] = i++;
-			yIndex[k] = j++;
-		}
+	}
+	for(k = 0; k <= spline_degree; k++) {
+		Index[k] = i++;
 	}
 
 	// compute the interpolation weights
 	switch (spline_degree) {
 		case 2L:
-			/* x */
-			w = x - (double)xIndex[1];
-			xWeight[1] = 3.0 / 4.0 - w * w;
-			xWeight[2] = (1.0 / 2.0) * (w - xWeight[1] + 1.0);
-			xWeight[0] = 1.0 - xWeight[1] - xWeight[2];
-			/* y */
-			w = y - (double)yIndex[1];
-			yWeight[1] = 3.0 / 4.0 - w * w;
-			yWeight[2] = (1.0 / 2.0) * (w - yWeight[1] + 1.0);
-			yWeight[0] = 1.0 - yWeight[1] - yWeight[2];
+			w = x - (double)Index[1];
+			dWeight[1] = 3.0 / 4.0 - w * w;
+			dWeight[2] = (1.0 / 2.0) * (w - dWeight[1] + 1.0);
+			dWeight[0] = 1.0 - dWeight[1] - dWeight[2];
 			break;
 		case 3L:
-			/* x */
-			w = x - (double)xIndex[1];
-			xWeight[3] = (1.0 / 6.0) * w * w * w;
-			xWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - xWeight[3];
-			xWeight[2] = w + xWeight[0] - 2.0 * xWeight[3];
-			xWeight[1] = 1.0 - xWeight[0] - xWeight[2] - xWeight[3];
-			/* y */
-			w = y - (double)yIndex[1];
-			yWeight[3] = (1.0 / 6.0) * w * w * w;
-			yWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - yWeight[3];
-			yWeight[2] = w + yWeight[0] - 2.0 * yWeight[3];
-			yWeight[1] = 1.0 - yWeight[0] - yWeight[2] - yWeight[3];
+			w = x - (double)Index[1];
+			dWeight[3] = (1.0 / 6.0) * w * w * w;
+			dWeight[0] = (1.0 / 6.0) + (1.0 / 2.0) * w * (w - 1.0) - dWeight[3];
+			dWeight[2] = w + dWeight[0] - 2.0 * dWeight[3];
+			dWeight[1] = 1.0 - dWeight[0] - dWeight[2] - dWeight[3];
 			break;
 		case 4L:
-			/* x */
-			w = x - (double)xIndex[2];
+			w = x - (double)Index[2];
 			w2 = w * w;
 			t = (1.0 / 6.0) * w2;
-			xWeight[0] = 1.0 / 2.0 - w;
-			xWeight[0] *= xWeight[0];
-			xWeight[0] *= (1.0 / 24.0) * xWeight[0];
+			dWeight[0] = 1.0 / 2.0 - w;
+			dWeight[0] *= dWeight[0];
+			dWeight[0] *= (1.0 / 24.0) * dWeight[0];
 			t0 = w * (t - 11.0 / 24.0);
 			t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-			xWeight[1] = t1 + t0;
-			xWeight[3] = t1 - t0;
-			xWeight[4] = xWeight[0] + t0 + (1.0 / 2.0) * w;
-			xWeight[2] = 1.0 - xWeight[0] - xWeight[1] - xWeight[3] - xWeight[4];
-			/* y */
-			w = y - (double)yIndex[2];
-			w2 = w * w;
-			t = (1.0 / 6.0) * w2;
-			yWeight[0] = 1.0 / 2.0 - w;
-			yWeight[0] *= yWeight[0];
-			yWeight[0] *= (1.0 / 24.0) * yWeight[0];
-			t0 = w * (t - 11.0 / 24.0);
-			t1 = 19.0 / 96.0 + w2 * (1.0 / 4.0 - t);
-			yWeight[1] = t1 + t0;
-			yWeight[3] = t1 - t0;
-			yWeight[4] = yWeight[0] + t0 + (1.0 / 2.0) * w;
-			yWeight[2] = 1.0 - yWeight[0] - yWeight[1] - yWeight[3] - yWeight[4];
+			dWeight[1] = t1 + t0;
+			dWeight[3] = t1 - t0;
+			dWeight[4] = dWeight[0] + t0 + (1.0 / 2.0) * w;
+			dWeight[2] = 1.0 - dWeight[0] - dWeight[1] - dWeight[3] - dWeight[4];
 			break;
 		case 5L:
-			/* x */
-			w = x - (double)xIndex[2];
-			w2 = w * w;
-			xWeight[5] = (1.0 / 120.0) * w * w2 * w2;
-			w2 -= w;
-			w4 = w2 * w2;
-			w -= 1.0 / 2.0;
-			t = w2 * (w2 - 3.0);
-			xWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - xWeight[5];
-			t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
-			t1 = (-1.0 / 12.0) * w * (t + 4.0);
-			xWeight[2] = t0 + t1;
-			xWeight[3] = t0 - t1;
-			t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
-			t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-			xWeight[1] = t0 + t1;
-			xWeight[4] = t0 - t1;
-			/* y */
-			w = y - (double)yIndex[2];
+			w = x - (double)Index[2];
 			w2 = w * w;
-			yWeight[5] = (1.0 / 120.0) * w * w2 * w2;
+			dWeight[5] = (1.0 / 120.0) * w * w2 * w2;
 			w2 -= w;
 			w4 = w2 * w2;
 			w -= 1.0 / 2.0;
 			t = w2 * (w2 - 3.0);
-			yWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - yWeight[5];
+			dWeight[0] = (1.0 / 24.0) * (1.0 / 5.0 + w2 + w4) - dWeight[5];
 			t0 = (1.0 / 24.0) * (w2 * (w2 - 5.0) + 46.0 / 5.0);
 			t1 = (-1.0 / 12.0) * w * (t + 4.0);
-			yWeight[2] = t0 + t1;
-			yWeight[3] = t0 - t1;
+			dWeight[2] = t0 + t1;
+			dWeight[3] = t0 - t1;
 			t0 = (1.0 / 16.0) * (9.0 / 5.0 - t);
 			t1 = (1.0 / 24.0) * w * (w4 - w2 - 5.0);
-			yWeight[1] = t0 + t1;
-			yWeight[4] = t0 - t1;
+			dWeight[1] = t0 + t1;
+			dWeight[4] = t0 - t1;
 			break;
-		default:
-			// Invalid spline degree
-			return 0;
 	}
 
 	// apply the mirror boundary conditions
 	for(k = 0; k <= spline_degree; k++) {
-		xIndex[k] = (Width == 1L) ? (0L) : ((xIndex[k] < 0L) ?
-			(-xIndex[k] - Width2 * ((-xIndex[k]) / Width2))
-			: (xIndex[k] - Width2 * (xIndex[k] / Width2)));
-		if (Width <= xIndex[k]) {
-			xIndex[k] = Width2 - xIndex[k];
+		Weight[k] = (float)dWeight[k];
+		if((0L <= Index[k]) && (Index[k] < Length)) {
+			// inside the image
+			continue;
+		}
+		Index[k] = (Length == 1L) ? (0L) : ((Index[k] < 0L) ?
+			(-Index[k] - Length2 * ((-Index[k]) / Length2))
+			: (Index[k] - Length2 * (Index[k] / Length2)));
+		if (Length <= Index[k]) {
+			Index[k] = Length2 - Index[k];
+		}
+	}
+}
+
+/**
+Weight tables of an output row : for each pixel of the row, 
+the spline_degree + 1 indexes and weights along x and y, 
+and whether the pixel is masked out. 
+*/
+typedef struct tagBSplineRowWeights {
+	long	*xIndex;
+	long	*yIndex;
+	float	*xWeight;
+	float	*yWeight;
+	BYTE	*masked;
+} BSplineRowWeights;
+
+/**
+Fill the weight tables of an output row. 
+The source location of pixel x is (x0 + a11 * x, y0 + a21 * x). 
+
+@param table Output weight tables (6 entries per pixel)
+@param count Number of pixels in the row
+@param x0 Source x coordinate of the first pixel
+@param y0 Source y coordinate of the first pixel
+@param a11 Source x increment
+@param a21 Source y increment
+@param Width Width of the image
+@param Height Height of the image
+@param use_mask Whether or not to mask the image
+*/
+template <long spline_degree> static void 
+RowWeights(BSplineRowWeights *table, long count, double x0, double y0, double a11, double a21, long Width, long Height, BOOL use_mask) {
+	for(long x = 0; x < count; x++) {
+		const double x1 = x0 + a11 * (double)x;
+		const double y1 = y0 + a21 * (double)x;
+		table->masked[x] = use_mask && ((x1 <= -0.5) || (((double)Width - 0.5) <= x1) || (y1 <= -0.5) || (((double)Height - 0.5) <= y1));
+		InterpolationWeights<spline_degree>(x1, Width, table->xIndex + 6 * x, table->xWeight + 6 * x);
+		InterpolationWeights<spline_degree>(y1, Height, table->yIndex + 6 * x, table->yWeight + 6 * x);
+	}
+}
+
+/**
+Perform the bidimensional interpolation of an output row, using precomputed weight tables. 
+Given an array of spline coefficients, compute the value of the underlying continuous 
+spline model for each pixel of the row, then clamp and convert it to BYTE. 
+Masked pixels are set to 0. 
+
+@param dst_bits Output row (Channels interleaved bytes per pixel)
+@param table Weight tables of the row
+@param count Number of pixels in the row
+@param Bcoeff Input B-spline array of coefficients (Channels interleaved samples per pixel)
+@param Width Width of the image
+@param spline_degree Degree of the spline model
+*/
+template <long Channels> static void 
+InterpolateRow(BYTE *dst_bits, const BSplineRowWeights *table, long count, const float *Bcoeff, long Width, long spline_degree) {
+	const long Line = Width * Channels;
+
+	for(long x = 0; x < count; x++, dst_bits += Channels) {
+		if(table->masked[x]) {
+			for(long c = 0; c < Channels; c++) {
+				dst_bits[c] = 0;
+			}
+			continue;
+		}
+		const long *xIndex = table->xIndex + 6 * x;
+		const long *yIndex = table->yIndex + 6 * x;
+		const float *xWeight = table->xWeight + 6 * x;
+		const float *yWeight = table->yWeight + 6 * x;
+
+		float interpolated[Channels];
+		for(long c = 0; c < Channels; c++) {
+			interpolated[c] = 0;
+		}
+		for(long j = 0; j <= spline_degree; j++) {
+			const float *p = Bcoeff + yIndex[j] * Line;
+			float w[Channels];
+			for(long c = 0; c < Channels; c++) {
+				w[c] = 0;
+			}
+			for(long i = 0; i <= spline_degree; i++) {
+				const float *q = p + xIndex[i] * Channels;
+				for(long c = 0; c < Channels; c++) {
+					w[c] += xWeight[i] * q[c];
+				}
+			}
+			for(long c = 0; c < Channels; c++) {
+				interpolated[c] += yWeight[j] * w[c];
+			}
 		}
-		yIndex[k] = (Height == 1L) ? (0L) : ((yIndex[k] < 0L) ?
-			(-yIndex[k] - Height2 * ((-yIndex[k]) / Height2))
-			: (yIndex[k] - Height2 * (yIndex[k] / Height2)));
-		if (Height <= yIndex[k]) {
-			yIndex[k] = Height2 - yIndex[k];
+		// clamp and convert to BYTE
+		for(long c = 0; c < Channels; c++) {
+			dst_bits[c] = (BYTE)MIN(MAX((int)0, (int)(interpolated[c] + 0.5F)), (int)255);
 		}
 	}
+}
 
-	// perform interpolation
-	interpolated = 0.0;
-	for(j = 0; j <= spline_degree; j++) {
-		p = Bcoeff + (yIndex[j] * Width);
-		w = 0.0;
-		for(i = 0; i <= spline_degree; i++) {
-			w += xWeight[i] * p[xIndex[i]];
+/** Arguments of the interpolation run on bands of output rows in parallel
+*/
+typedef struct tagINTERPOLATEPASS {
+	const float *Bcoeff;		//! B-spline coefficients of the input image
+	FIBITMAP *dst;
+	long Width;
+	long Height;
+	long Channels;
+	long spline_degree;
+	double a11, a12, a21, a22;	//! rotation matrix
+	double x_shift, y_shift;
+	BOOL use_mask;
+	std::atomic<bool> failed;	//! true if a band could not allocate its weight tables
+} INTERPOLATEPASS;
+
+/**
+Interpolate the output rows [first, last[, each band using its own weight tables
+*/
+static void
+InterpolateRows(void *data, unsigned first, unsigned last) {
+	INTERPOLATEPASS *pass = (INTERPOLATEPASS*)data;
+	const long width = pass->Width;
+	const long height = pass->Height;
+
+	BSplineRowWeights table;
+	table.xIndex = (long*)malloc(6 * width * sizeof(long));
+	table.yIndex = (long*)malloc(6 * width * sizeof(long));
+	table.xWeight = (float*)malloc(6 * width * sizeof(float));
+	table.yWeight = (float*)malloc(6 * width * sizeof(float));
+	table.masked = (BYTE*)malloc(width * sizeof(BYTE));
+
+	if(table.xIndex && table.yIndex && table.xWeight && table.yWeight && table.masked) {
+		for(long y = (long)first; y < (long)last; y++) {
+			BYTE *dst_bits = FreeImage_GetScanLine(pass->dst, height-1-y);
+
+			const double x0 = pass->a12 * (double)y + pass->x_shift;
+			const double y0 = pass->a22 * (double)y + pass->y_shift;
+
+			// compute the weights of the whole row
+			switch(pass->spline_degree) {
+				case 2L:
+					RowWeights<2L>(&table, width, x0, y0, pass->a11, pass->a21, width, height, pass->use_mask);
+					break;
+				case 3L:
+					RowWeights<3L>(&table, width, x0, y0, pass->a11, pass->a21, width, height, pass->use_mask);
+					break;
+				case 4L:
+					RowWeights<4L>(&table, width, x0, y0, pass->a11, pass->a21, width, height, pass->use_mask);
+					break;
+				case 5L:
+					RowWeights<5L>(&table, width, x0, y0, pass->a11, pass->a21, width, height, pass->use_mask);
+					break;
+			}
+
+			// then interpolate all channels of the row
+			switch(pass->Channels) {
+				case 1:
+					InterpolateRow<1>(dst_bits, &table, width, pass->Bcoeff, width, pass->spline_degree);
+					break;
+				case 3:
+					InterpolateRow<3>(dst_bits, &table, width, pass->Bcoeff, width, pass->spline_degree);
+					break;
+				case 4:
+					InterpolateRow<4>(dst_bits, &table, width, pass->Bcoeff, width, pass->spline_degree);
+					break;
+			}
 		}
-		interpolated += yWeight[j] * w;
+	} else {
+		pass->failed = true;
 	}
 
-	return interpolated;
+	free(table.xIndex);
+	free(table.yIndex);
+	free(table.xWeight);
+	free(table.yWeight);
+	free(table.masked);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -509,8 +609,11 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
 
 /** 
  Image translation and rotation using B-Splines.
+ All the channels of the image are processed together, using a single 
+ float array of interleaved B-spline coefficients. 
+ The output rows are interpolated in parallel on the worker pool.
 
- @param dib Input 8-bit greyscale image
+ @param dib Input 8-bit greyscale, 24- or 32-bit image
  @param angle Output image rotation in degree
  @param x_shift Output image horizontal shift
  @param y_shift Output image vertical shift
@@ -521,19 +624,19 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
  @return Returns the translated & rotated dib if successful, returns NULL otherwise
 */
 static FIBITMAP * 
-Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask) {
-	double	*ImageRasterArray;
-	double	p;
+RotateBSpline(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask) {
+	float	*ImageRasterArray;
 	double	a11, a12, a21, a22;
-	double	x0, y0, x1, y1;
+	double	x0, y0;
 	long	x, y;
 	long	spline;
 	bool	bResult;
 
 	int bpp = FreeImage_GetBPP(dib);
-	if(bpp != 8) {
+	if((bpp != 8) && (bpp != 24) && (bpp != 32)) {
 		return NULL;
 	}
+	const long channels = bpp / 8;
 	
 	int width = FreeImage_GetWidth(dib);
 	int height = FreeImage_GetHeight(dib);
@@ -555,80 +658,83 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 	}
 
 	// allocate output image
-	FIBITMAP *dst = FreeImage_Allocate(width, height, bpp);
-	if(!dst)
-		return NULL;
-	// buid a grey scale palette
-	RGBQUAD *pal = FreeImage_GetPalette(dst);
-	for(int i = 0; i < 256; i++) {
-		pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
+	FIBITMAP *dst = NULL;
+	if(bpp == 8) {
+		dst = FreeImage_Allocate(width, height, bpp);
+		if(!dst)
+			return NULL;
+		// buid a grey scale palette
+		RGBQUAD *pal = FreeImage_GetPalette(dst);
+		for(int i = 0; i < 256; i++) {
+			pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
+		}
+	} else {
+		dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+		if(!dst)
+			return NULL;
 	}
 
 	// allocate a temporary array
-	ImageRasterArray = (double*)malloc(width * height * sizeof(double));
-	if(!ImageRasterArray) {
-		FreeImage_Unload(dst);
-		return NULL;
-	}
-	// copy data samples
-	for(y = 0; y < height; y++) {
-		double *pImage = &ImageRasterArray[y*width];
-		BYTE *src_bits = FreeImage_GetScanLine(dib, height-1-y);
-
-		for(x = 0; x < width; x++) {
-			pImage[x] = (double)src_bits[x];
+	const long line = width * channels;
+	ImageRasterArray = (float*)malloc(line * height * sizeof(float));
+	bResult = (ImageRasterArray != NULL);
+
+	if(bResult) {
+		// copy data samples
+		for(y = 0; y < height; y++) {
+			float *pImage = &ImageRasterArray[y * line];
+			const BYTE *src_bits = FreeImage_GetScanLine(dib, height-1-y);
+
+			for(x = 0; x < line; x++) {
+				pImage[x] = (float)src_bits[x];
+			}
 		}
-	}
 
-	// convert between a representation based on image samples
-	// and a representation based on image B-spline coefficients
-	bResult = SamplesToCoefficients(ImageRasterArray, width, height, spline);
-	if(!bResult) {
-		FreeImage_Unload(dst);
-		free(ImageRasterArray);
-		return NULL;
+		// convert between a representation based on image samples
+		// and a representation based on image B-spline coefficients
+		bResult = SamplesToCoefficients(ImageRasterArray, width, height, channels, spline);
 	}
 
-	// prepare the geometry
-	angle *= PI / 180.0;
-	a11 = cos(angle);
-	a12 = -sin(angle);
-	a21 = sin(angle);
-	a22 = cos(angle);
-	x0 = a11 * (x_shift + x_origin) + a12 * (y_shift + y_origin);
-	y0 = a21 * (x_shift + x_origin) + a22 * (y_shift + y_origin);
-	x_shift = x_origin - x0;
-	y_shift = y_origin - y0;
-
-	// visit all pixels of the output image and assign their value
-	for(y = 0; y < height; y++) {
-		BYTE *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
-		
-		x0 = a12 * (double)y + x_shift;
-		y0 = a22 * (double)y + y_shift;
-
-		for(x = 0; x < width; x++) {
-			x1 = x0 + a11 * (double)x;
-			y1 = y0 + a21 * (double)x;
-			if(use_mask) {
-				if((x1 <= -0.5) || (((double)width - 0.5) <= x1) || (y1 <= -0.5) || (((double)height - 0.5) <= y1)) {
-					p = 0;
-				}
-				else {
-					p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
-				}
-			}
-			else {
-				p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
-			}
-			// clamp and convert to BYTE
-			dst_bits[x] = (BYTE)MIN(MAX((int)0, (int)(p + 0.5)), (int)255);
-		}
+	if(bResult) {
+		// prepare the geometry
+		angle *= PI / 180.0;
+		a11 = cos(angle);
+		a12 = -sin(angle);
+		a21 = sin(angle);
+		a22 = cos(angle);
+		x0 = a11 * (x_shift + x_origin) + a12 * (y_shift + y_origin);
+		y0 = a21 * (x_shift + x_origin) + a22 * (y_shift + y_origin);
+		x_shift = x_origin - x0;
+		y_shift = y_origin - y0;
+
+		// visit all pixels of the output image and assign their value
+		INTERPOLATEPASS pass;
+		pass.Bcoeff = ImageRasterArray;
+		pass.dst = dst;
+		pass.Width = width;
+		pass.Height = height;
+		pass.Channels = channels;
+		pass.spline_degree = spline;
+		pass.a11 = a11;
+		pass.a12 = a12;
+		pass.a21 = a21;
+		pass.a22 = a22;
+		pass.x_shift = x_shift;
+		pass.y_shift = y_shift;
+		pass.use_mask = use_mask;
+		pass.failed = false;
+
+		bResult = FreeImage_ParallelFor((unsigned)height, FreeImage_GetRowChunk((unsigned)width), InterpolateRows, &pass) && !pass.failed;
 	}
 
 	// free working array and return
 	free(ImageRasterArray);
 
+	if(!bResult) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
 	return dst;
 }
 
@@ -646,84 +752,17 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 */
 FIBITMAP * DLL_CALLCONV 
 FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask) {
-
-	int x, y, bpp;
-	int channel, nb_channels;
-	BYTE *src_bits, *dst_bits;
-	FIBITMAP *src8 = NULL, *dst8 = NULL, *dst = NULL;
-
 	if(!FreeImage_HasPixels(dib)) return NULL;
 
-	try {
-
-		bpp = FreeImage_GetBPP(dib);
-
-		if(bpp == 8) {
-			FIBITMAP *dst_8 = Rotate8Bit(dib, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-			if(dst_8) {
-				// copy metadata from src to dst
-				FreeImage_CloneMetadata(dst_8, dib);
-			}
-			return dst_8;
-		}
-		if((bpp == 24) || (bpp == 32)) {
-			// allocate dst image
-			int width  = FreeImage_GetWidth(dib);
-			int height = FreeImage_GetHeight(dib);
-			if( bpp == 24 ) {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-			} else {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-			}
-			if(!dst) throw(1);
-
-			// allocate a temporary 8-bit dib (no need to build a palette)
-			src8 = FreeImage_Allocate(width, height, 8);
-			if(!src8) throw(1);
-
-			// process each channel separately
-			// -------------------------------
-			nb_channels = (bpp / 8);
-
-			for(channel = 0; channel < nb_channels; channel++) {
-				// extract channel from source dib
-				for(y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dib, y);
-					dst_bits = FreeImage_GetScanLine(src8, y);
-					for(x = 0; x < width; x++) {
-						dst_bits[x] = src_bits[channel];
-						src_bits += nb_channels;
-					}
-				}
-
-				// process channel
-				dst8 = Rotate8Bit(src8, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-				if(!dst8) throw(1);
-
-				// insert channel to destination dib
-				for(y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dst8, y);
-					dst_bits = FreeImage_GetScanLine(dst, y);
-					for(x = 0; x < width; x++) {
-						dst_bits[channel] = src_bits[x];
-						dst_bits += nb_channels;
-					}
-				}
-
-				FreeImage_Unload(dst8);
-			}
-
-			FreeImage_Unload(src8);
+	const unsigned bpp = FreeImage_GetBPP(dib);
 
+	if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
+		FIBITMAP *dst = RotateBSpline(dib, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
+		if(dst) {
 			// copy metadata from src to dst
 			FreeImage_CloneMetadata(dst, dib);
-			
-			return dst;
 		}
-	} catch(int) {
-		if(src8) FreeImage_Unload(src8);
-		if(dst8) FreeImage_Unload(dst8);
-		if(dst)  FreeImage_Unload(dst);
+		return dst;
 	}
 
 	return NULL;
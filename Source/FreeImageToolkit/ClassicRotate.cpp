@@ -35,6 +35,12 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FI_ROTATE_SSE2
+#endif
 
 #define RBLOCK		64	// image blocks of RBLOCK*RBLOCK pixels
 
@@ -172,24 +178,27 @@ HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeigh
 }
 
 /**
-Skews a column vertically (with filtered weights). 
+Skews a band of adjacent columns vertically (with filtered weights). 
 Limited to 45 degree skewing only. Filters two adjacent pixels.
 Parameter T can be BYTE, WORD of float. 
+The columns of the band are processed together, one source row at a time, 
+so that the pass walks the images row by row instead of column by column.
+The result is the same as skewing each column on its own. 
 @param src Pointer to source image to rotate
 @param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
+@param col Index of the first column of the band
+@param ncols Number of columns in the band (at most RBLOCK)
+@param iOffset Skew offset of each column
+@param weight Relative weight of upper pixel, for each column
 @param bkcolor Background color
 */
 template <class T> void 
-VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight, const void *bkcolor = NULL) {
-	int iYPos;
+VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, unsigned ncols, const int *iOffset, const double *weight, const void *bkcolor = NULL) {
+	const int src_height = (int)FreeImage_GetHeight(src);
+	const int dst_height = (int)FreeImage_GetHeight(dst);
 
-	unsigned src_height = FreeImage_GetHeight(src);
-	unsigned dst_height = FreeImage_GetHeight(dst);
-
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
+	T pxlSrc[4], pxlLeft[4];
+	T pxlOldLeft[RBLOCK][4];	// 4 = 4*sizeof(T) max
 
 	// background
 	const T pxlBlack[4] = {0, 0, 0, 0 };
@@ -204,87 +213,70 @@ VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight,
 	// calculate the number of samples per pixel
 	const unsigned samples = bytespp / sizeof(T);
 
-	const unsigned src_pitch = FreeImage_GetPitch(src);
-	const unsigned dst_pitch = FreeImage_GetPitch(dst);
 	const unsigned index = col * bytespp;
 
-	BYTE *src_bits = FreeImage_GetBits(src) + index;
-	BYTE *dst_bits = FreeImage_GetBits(dst) + index;
-
 	// fill gap above skew with background
-	if(bkcolor) {
-		for(int k = 0; k < iOffset; k++) {
-			memcpy(dst_bits, bkcolor, bytespp);
-			dst_bits += dst_pitch;
+	for(unsigned c = 0; c < ncols; c++) {
+		const int top = MIN(iOffset[c], dst_height);
+		for(int k = 0; k < top; k++) {
+			AssignPixel(FreeImage_GetScanLine(dst, k) + index + c * bytespp, (const BYTE*)pxlBkg, bytespp);
 		}
-		memcpy(&pxlOldLeft[0], bkcolor, bytespp);
-	} else {
-		for(int k = 0; k < iOffset; k++) {
-			memset(dst_bits, 0, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memset(&pxlOldLeft[0], 0, bytespp);
+		AssignPixel((BYTE*)(&pxlOldLeft[c][0]), (const BYTE*)pxlBkg, bytespp);
 	}
 
-	for(unsigned i = 0; i < src_height; i++) {
-		// loop through column pixels
-		AssignPixel((BYTE*)(&pxlSrc[0]), src_bits, bytespp);
-		// calculate weights
-		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
-		}
-		// check boundaries
-		iYPos = i + iOffset;
-		if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-			// update left over on source
+	for(int i = 0; i < src_height; i++) {
+		// loop through the band, one source row at a time
+		const BYTE *src_bits = FreeImage_GetScanLine(src, i) + index;
+
+		for(unsigned c = 0; c < ncols; c++, src_bits += bytespp) {
+			AssignPixel((BYTE*)(&pxlSrc[0]), src_bits, bytespp);
+			// calculate weights
 			for(unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
+				pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight[c] + 0.5);
+			}
+			// check boundaries
+			const int iYPos = i + iOffset[c];
+			if((iYPos >= 0) && (iYPos < dst_height)) {
+				// update left over on source
+				for(unsigned j = 0; j < samples; j++) {
+					pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[c][j]);
+				}
+				AssignPixel(FreeImage_GetScanLine(dst, iYPos) + index + c * bytespp, (BYTE*)(&pxlSrc[0]), bytespp);
 			}
-			dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-			AssignPixel(dst_bits, (BYTE*)(&pxlSrc[0]), bytespp);
+			// save leftover for next pixel in scan
+			AssignPixel((BYTE*)(&pxlOldLeft[c][0]), (BYTE*)(&pxlLeft[0]), bytespp);
 		}
-		// save leftover for next pixel in scan
-		AssignPixel((BYTE*)(&pxlOldLeft[0]), (BYTE*)(&pxlLeft[0]), bytespp);
-
-		// next pixel in scan
-		src_bits += src_pitch;
 	}
-	// go to bottom point of skew
-	iYPos = src_height + iOffset;
 
-	if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-		dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
+	for(unsigned c = 0; c < ncols; c++) {
+		// go to bottom point of skew
+		int iYPos = src_height + iOffset[c];
 
-		// if still in image bounds, put leftovers there				
-		AssignPixel((BYTE*)(dst_bits), (BYTE*)(&pxlOldLeft[0]), bytespp);
+		if((iYPos >= 0) && (iYPos < dst_height)) {
+			// if still in image bounds, put leftovers there				
+			AssignPixel(FreeImage_GetScanLine(dst, iYPos) + index + c * bytespp, (BYTE*)(&pxlOldLeft[c][0]), bytespp);
 
-		// clear below skewed line with background
-		if(bkcolor) {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				AssignPixel((BYTE*)(dst_bits), (BYTE*)(bkcolor), bytespp);
-			}
-		} else {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				memset(dst_bits, 0, bytespp);
+			// clear below skewed line with background
+			while(++iYPos < dst_height) {
+				AssignPixel(FreeImage_GetScanLine(dst, iYPos) + index + c * bytespp, (const BYTE*)pxlBkg, bytespp);
 			}
 		}
 	}
 }
 
 /**
-Skews a column vertically (with filtered weights). 
+Skews a band of adjacent columns vertically (with filtered weights). 
 Limited to 45 degree skewing only. Filters two adjacent pixels.
 @param src Pointer to source image to rotate
 @param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
+@param col Index of the first column of the band
+@param ncols Number of columns in the band (at most RBLOCK)
+@param iOffset Skew offset of each column
+@param dWeight Relative weight of upper pixel, for each column
 @param bkcolor Background color
 */
 static void 
-VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight, const void *bkcolor) {
+VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, unsigned ncols, const int *iOffset, const double *dWeight, const void *bkcolor) {
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 
 	switch(image_type) {
@@ -293,23 +285,259 @@ VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight,
 				case 8:
 				case 24:
 				case 32:
-					VerticalSkewT<BYTE>(src, dst, col, iOffset, dWeight, bkcolor);
+					VerticalSkewT<BYTE>(src, dst, col, ncols, iOffset, dWeight, bkcolor);
 					break;
 			}
 			break;
 			case FIT_UINT16:
 			case FIT_RGB16:
 			case FIT_RGBA16:
-				VerticalSkewT<WORD>(src, dst, col, iOffset, dWeight, bkcolor);
+				VerticalSkewT<WORD>(src, dst, col, ncols, iOffset, dWeight, bkcolor);
 				break;
 			case FIT_FLOAT:
 			case FIT_RGBF:
 			case FIT_RGBAF:
-				VerticalSkewT<float>(src, dst, col, iOffset, dWeight, bkcolor);
+				VerticalSkewT<float>(src, dst, col, ncols, iOffset, dWeight, bkcolor);
 				break;
 	}
 } 
 
+/** Arguments of a skew pass run on bands of rows or columns in parallel
+*/
+typedef struct tagSKEWPASS {
+	FIBITMAP *src;
+	FIBITMAP *dst;
+	const int *iOffset;		//! skew offset of each row or column
+	const double *dWeight;	//! relative weight of each row or column
+	unsigned count;			//! number of rows or columns
+	const void *bkcolor;
+} SKEWPASS;
+
+static void
+HorizontalSkewRows(void *data, unsigned first, unsigned last) {
+	const SKEWPASS *pass = (SKEWPASS*)data;
+	for(unsigned u = first; u < last; u++) {
+		HorizontalSkew(pass->src, pass->dst, u, pass->iOffset[u], pass->dWeight[u], pass->bkcolor);
+	}
+}
+
+static void
+VerticalSkewBands(void *data, unsigned first, unsigned last) {
+	const SKEWPASS *pass = (SKEWPASS*)data;
+	for(unsigned band = first; band < last; band++) {
+		const unsigned u = band * RBLOCK;
+		const unsigned ncols = MIN((unsigned)RBLOCK, pass->count - u);
+		VerticalSkew(pass->src, pass->dst, u, ncols, pass->iOffset + u, pass->dWeight + u, pass->bkcolor);
+	}
+}
+
+/**
+Skews the rows of src into dst on the worker pool
+@return Returns FALSE if the pass was cancelled
+*/
+static BOOL
+HorizontalSkewPass(FIBITMAP *src, FIBITMAP *dst, const int *iOffset, const double *dWeight, const void *bkcolor) {
+	const SKEWPASS pass = { src, dst, iOffset, dWeight, FreeImage_GetHeight(dst), bkcolor };
+	return FreeImage_ParallelFor(pass.count, FreeImage_GetRowChunk(FreeImage_GetWidth(dst)), HorizontalSkewRows, (void*)&pass);
+}
+
+/**
+Skews the columns of src into dst on the worker pool, in bands of RBLOCK columns
+@return Returns FALSE if the pass was cancelled
+*/
+static BOOL
+VerticalSkewPass(FIBITMAP *src, FIBITMAP *dst, const int *iOffset, const double *dWeight, const void *bkcolor) {
+	const SKEWPASS pass = { src, dst, iOffset, dWeight, FreeImage_GetWidth(dst), bkcolor };
+	const unsigned bands = (pass.count + RBLOCK - 1) / RBLOCK;
+	return FreeImage_ParallelFor(bands, MAX(1U, FreeImage_GetRowChunk(FreeImage_GetHeight(dst)) / RBLOCK), VerticalSkewBands, (void*)&pass);
+}
+
+// --------------------------------------------------------------------------
+// Cache blocked transpose, used by the 90 / 270 degree rotations
+
+/**
+Copies the transpose of a width x height block of pixels :
+dst(row x, column y) = src(row y, column x).<br>
+Pitches may be negative, so that the rows of either image can be walked backwards, 
+which turns the transpose into a 90 or 270 degree rotation.
+@param dst Destination pixel (0, 0)
+@param dst_pitch Offset between two dst rows
+@param src Source pixel (0, 0)
+@param src_pitch Offset between two src rows
+@param width Source block width
+@param height Source block height
+@param bytespp Number of bytes per pixel
+*/
+static void
+TransposeTile(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch, unsigned width, unsigned height, unsigned bytespp) {
+	// size of the blocks transposed in registers (width_v x height_v pixels)
+	unsigned width_v = 0;
+	unsigned height_v = 0;
+
+#if defined(FI_ROTATE_SSE2)
+	switch(bytespp) {
+		case 1:
+			// 8 x 8 bytes
+			width_v = width & ~7;
+			height_v = height & ~7;
+			for(unsigned y = 0; y < height_v; y += 8) {
+				for(unsigned x = 0; x < width_v; x += 8) {
+					const BYTE *s = src + (int)y * src_pitch + x;
+					__m128i a[8];
+					for(int k = 0; k < 8; k++) {
+						a[k] = _mm_loadl_epi64((const __m128i*)(s + k * src_pitch));
+					}
+					const __m128i t0 = _mm_unpacklo_epi8(a[0], a[1]);
+					const __m128i t1 = _mm_unpacklo_epi8(a[2], a[3]);
+					const __m128i t2 = _mm_unpacklo_epi8(a[4], a[5]);
+					const __m128i t3 = _mm_unpacklo_epi8(a[6], a[7]);
+					const __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+					const __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+					const __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+					const __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+					// each vector now holds 2 columns of 8 bytes
+					const __m128i v[4] = {
+						_mm_unpacklo_epi32(u0, u2), _mm_unpackhi_epi32(u0, u2),
+						_mm_unpacklo_epi32(u1, u3), _mm_unpackhi_epi32(u1, u3)
+					};
+					BYTE *d = dst + (int)x * dst_pitch + y;
+					for(int k = 0; k < 4; k++) {
+						_mm_storel_epi64((__m128i*)(d + (2 * k) * dst_pitch), v[k]);
+						_mm_storel_epi64((__m128i*)(d + (2 * k + 1) * dst_pitch), _mm_unpackhi_epi64(v[k], v[k]));
+					}
+				}
+			}
+			break;
+
+		case 2:
+			// 8 x 8 words
+			width_v = width & ~7;
+			height_v = height & ~7;
+			for(unsigned y = 0; y < height_v; y += 8) {
+				for(unsigned x = 0; x < width_v; x += 8) {
+					const BYTE *s = src + (int)y * src_pitch + x * 2;
+					__m128i a[8];
+					for(int k = 0; k < 8; k++) {
+						a[k] = _mm_loadu_si128((const __m128i*)(s + k * src_pitch));
+					}
+					__m128i t[8], u[8];
+					for(int k = 0; k < 4; k++) {
+						t[2 * k] = _mm_unpacklo_epi16(a[2 * k], a[2 * k + 1]);
+						t[2 * k + 1] = _mm_unpackhi_epi16(a[2 * k], a[2 * k + 1]);
+					}
+					for(int k = 0; k < 2; k++) {
+						u[4 * k + 0] = _mm_unpacklo_epi32(t[4 * k + 0], t[4 * k + 2]);
+						u[4 * k + 1] = _mm_unpackhi_epi32(t[4 * k + 0], t[4 * k + 2]);
+						u[4 * k + 2] = _mm_unpacklo_epi32(t[4 * k + 1], t[4 * k + 3]);
+						u[4 * k + 3] = _mm_unpackhi_epi32(t[4 * k + 1], t[4 * k + 3]);
+					}
+					BYTE *d = dst + (int)x * dst_pitch + y * 2;
+					for(int k = 0; k < 4; k++) {
+						_mm_storeu_si128((__m128i*)(d + (2 * k) * dst_pitch), _mm_unpacklo_epi64(u[k], u[k + 4]));
+						_mm_storeu_si128((__m128i*)(d + (2 * k + 1) * dst_pitch), _mm_unpackhi_epi64(u[k], u[k + 4]));
+					}
+				}
+			}
+			break;
+
+		case 4:
+			// 4 x 4 dwords
+			width_v = width & ~3;
+			height_v = height & ~3;
+			for(unsigned y = 0; y < height_v; y += 4) {
+				for(unsigned x = 0; x < width_v; x += 4) {
+					const BYTE *s = src + (int)y * src_pitch + x * 4;
+					const __m128i a0 = _mm_loadu_si128((const __m128i*)(s));
+					const __m128i a1 = _mm_loadu_si128((const __m128i*)(s + src_pitch));
+					const __m128i a2 = _mm_loadu_si128((const __m128i*)(s + 2 * src_pitch));
+					const __m128i a3 = _mm_loadu_si128((const __m128i*)(s + 3 * src_pitch));
+					const __m128i t0 = _mm_unpacklo_epi32(a0, a1);
+					const __m128i t1 = _mm_unpacklo_epi32(a2, a3);
+					const __m128i t2 = _mm_unpackhi_epi32(a0, a1);
+					const __m128i t3 = _mm_unpackhi_epi32(a2, a3);
+					BYTE *d = dst + (int)x * dst_pitch + y * 4;
+					_mm_storeu_si128((__m128i*)(d), _mm_unpacklo_epi64(t0, t1));
+					_mm_storeu_si128((__m128i*)(d + dst_pitch), _mm_unpackhi_epi64(t0, t1));
+					_mm_storeu_si128((__m128i*)(d + 2 * dst_pitch), _mm_unpacklo_epi64(t2, t3));
+					_mm_storeu_si128((__m128i*)(d + 3 * dst_pitch), _mm_unpackhi_epi64(t2, t3));
+				}
+			}
+			break;
+
+		case 8:
+			// 2 x 2 qwords
+			width_v = width & ~1;
+			height_v = height & ~1;
+			for(unsigned y = 0; y < height_v; y += 2) {
+				for(unsigned x = 0; x < width_v; x += 2) {
+					const BYTE *s = src + (int)y * src_pitch + x * 8;
+					const __m128i a0 = _mm_loadu_si128((const __m128i*)(s));
+					const __m128i a1 = _mm_loadu_si128((const __m128i*)(s + src_pitch));
+					BYTE *d = dst + (int)x * dst_pitch + y * 8;
+					_mm_storeu_si128((__m128i*)(d), _mm_unpacklo_epi64(a0, a1));
+					_mm_storeu_si128((__m128i*)(d + dst_pitch), _mm_unpackhi_epi64(a0, a1));
+				}
+			}
+			break;
+	}
+#endif // FI_ROTATE_SSE2
+
+	// remaining pixels : right columns of all rows, then bottom rows of the left columns
+	for(unsigned y = 0; y < height; y++) {
+		const unsigned x_start = (y < height_v) ? width_v : 0;
+		const BYTE *s = src + (int)y * src_pitch + x_start * bytespp;
+		BYTE *d = dst + (int)x_start * dst_pitch + y * bytespp;
+		for(unsigned x = x_start; x < width; x++) {
+			AssignPixel(d, s, bytespp);
+			s += bytespp;
+			d += dst_pitch;
+		}
+	}
+}
+
+/** Arguments of a tiled transpose run on bands of tile rows in parallel
+*/
+typedef struct tagTRANSPOSETILES {
+	BYTE *dst;
+	int dst_pitch;
+	const BYTE *src;
+	int src_pitch;
+	unsigned width;
+	unsigned height;
+	unsigned bytespp;
+} TRANSPOSETILES;
+
+static void
+TransposeTileRows(void *data, unsigned first, unsigned last) {
+	const TRANSPOSETILES *tiles = (TRANSPOSETILES*)data;
+	const unsigned bytespp = tiles->bytespp;
+	// a tile row of the src is a tile column of the dst : bands never write the same dst bytes
+	for(unsigned ty = first; ty < last; ty++) {
+		const unsigned ys = ty * RBLOCK;
+		const unsigned tile_height = MIN((unsigned)RBLOCK, tiles->height - ys);
+		for(unsigned xs = 0; xs < tiles->width; xs += RBLOCK) {
+			const unsigned tile_width = MIN((unsigned)RBLOCK, tiles->width - xs);
+			TransposeTile(tiles->dst + (ptrdiff_t)xs * tiles->dst_pitch + ys * bytespp, tiles->dst_pitch, 
+				tiles->src + (ptrdiff_t)ys * tiles->src_pitch + xs * bytespp, tiles->src_pitch, tile_width, tile_height, bytespp);
+		}
+	}
+}
+
+/**
+Transposes a whole image, one RBLOCK x RBLOCK tile at a time, so that both
+the src rows and the dst rows touched by a tile stay in the CPU cache.
+The rows of tiles are spread over the worker pool.
+@see TransposeTile
+@return Returns FALSE if the transpose was cancelled
+*/
+static BOOL
+TransposePixels(BYTE *dst, int dst_pitch, const BYTE *src, int src_pitch, unsigned width, unsigned height, unsigned bytespp) {
+	const TRANSPOSETILES tiles = { dst, dst_pitch, src, src_pitch, width, height, bytespp };
+	const unsigned tile_rows = (height + RBLOCK - 1) / RBLOCK;
+	// a chunk covers about 64K pixels
+	return FreeImage_ParallelFor(tile_rows, MAX(1U, FreeImage_GetRowChunk(width) / RBLOCK), TransposeTileRows, (void*)&tiles);
+}
+
 /**
 Rotates an image by 90 degrees (counter clockwise). 
 Precise rotation, no filters required.<br>
@@ -337,6 +565,8 @@ Rotate90(FIBITMAP *src) {
 	const unsigned src_pitch  = FreeImage_GetPitch(src);
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
 
+	BOOL bSuccess = TRUE;
+
 	switch(image_type) {
 		case FIT_BITMAP:
 			if(bpp == 1) {
@@ -368,41 +598,11 @@ Rotate90(FIBITMAP *src) {
 				}
 			}
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
+				// anything other than BW : 
+				// dst(x, y) = src(dst_height - 1 - y, x), i.e. a transpose written bottom-up into dst
+
 				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							BYTE *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							BYTE *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
+				bSuccess = TransposePixels(FreeImage_GetScanLine(dst, dst_height - 1), -(int)dst_pitch, FreeImage_GetBits(src), src_pitch, src_width, src_height, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -412,25 +612,18 @@ Rotate90(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
-			}
+			bSuccess = TransposePixels(FreeImage_GetScanLine(dst, dst_height - 1), -(int)dst_pitch, FreeImage_GetBits(src), src_pitch, src_width, src_height, bytespp);
 		}
 		break;
 	}
 
+	if(!bSuccess) {
+		// cancelled
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
 	return dst;
 }
 
@@ -510,7 +703,7 @@ Code adapted from CxImage (http://www.xdp.it/cximage.htm)
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
+	int dlineup;
 
 	const unsigned bpp = FreeImage_GetBPP(src);
 
@@ -528,7 +721,9 @@ Rotate270(FIBITMAP *src) {
 	// get src and dst scan width
 	const unsigned src_pitch  = FreeImage_GetPitch(src);
 	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
-	
+
+	BOOL bSuccess = TRUE;
+
 	switch(image_type) {
 		case FIT_BITMAP:
 			if(bpp == 1) {
@@ -560,41 +755,11 @@ Rotate270(FIBITMAP *src) {
 				}
 			} 
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+				// anything other than BW : 
+				// dst(x, y) = src(y, dst_width - 1 - x), i.e. a transpose of the src read bottom-up
 
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							BYTE *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							BYTE *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
+				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+				bSuccess = TransposePixels(FreeImage_GetBits(dst), dst_pitch, FreeImage_GetScanLine(src, src_height - 1), -(int)src_pitch, src_width, src_height, bytespp);
 			}
 			break;
 		case FIT_UINT16:
@@ -604,25 +769,83 @@ Rotate270(FIBITMAP *src) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
 			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+			bSuccess = TransposePixels(FreeImage_GetBits(dst), dst_pitch, FreeImage_GetScanLine(src, src_height - 1), -(int)src_pitch, src_width, src_height, bytespp);
+		}
+		break;
+	}
 
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
+	if(!bSuccess) {
+		// cancelled
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
+FIBITMAP* 
+TransposeBitmap(FIBITMAP *src, BOOL bTransverse) {
+	if(!FreeImage_HasPixels(src)) return NULL;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned bpp = FreeImage_GetBPP(src);
+
+	switch(image_type) {
+		case FIT_BITMAP:
+			if((bpp != 8) && (bpp != 24) && (bpp != 32)) {
+				return NULL;
 			}
+			break;
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			break;
+		default:
+			return NULL;
+	}
+
+	const unsigned src_width  = FreeImage_GetWidth(src);
+	const unsigned src_height = FreeImage_GetHeight(src);
+
+	FIBITMAP *dst = FreeImage_AllocateT(image_type, src_height, src_width, bpp);
+	if(NULL == dst) return NULL;
+
+	const int src_pitch = (int)FreeImage_GetPitch(src);
+	const int dst_pitch = (int)FreeImage_GetPitch(dst);
+	const unsigned bytespp = FreeImage_GetLine(src) / src_width;
+
+	BOOL bSuccess = FALSE;
+	if(bTransverse) {
+		// mirroring along the anti-diagonal of the displayed (top-down) image 
+		// is a plain transpose of the bottom-up buffers
+		bSuccess = TransposePixels(FreeImage_GetBits(dst), dst_pitch, FreeImage_GetBits(src), src_pitch, src_width, src_height, bytespp);
+	} else {
+		// mirroring along the main diagonal : both buffers are walked backwards
+		bSuccess = TransposePixels(FreeImage_GetScanLine(dst, src_width - 1), -dst_pitch, FreeImage_GetScanLine(src, src_height - 1), -src_pitch, src_width, src_height, bytespp);
+	}
+	if(!bSuccess) {
+		// cancelled
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	if(bpp == 8) {
+		// copy the palette, transparency table and background color
+		memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(src), FreeImage_GetColorsUsed(src) * sizeof(RGBQUAD));
+		FreeImage_SetTransparencyTable(dst, FreeImage_GetTransparencyTable(src), FreeImage_GetTransparencyCount(src));
+		RGBQUAD bkcolor;
+		if(FreeImage_GetBackgroundColor(src, &bkcolor)) {
+			FreeImage_SetBackgroundColor(dst, &bkcolor);
 		}
-		break;
 	}
 
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, src);
+
 	return dst;
 }
 
@@ -662,6 +885,24 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	if(NULL == dst1) {
 		return NULL;
 	}
+
+	// Calc 2nd and 3rd shear destination image dimensions
+	const unsigned width_2  = width_1;
+	unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
+	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
+	const unsigned height_3 = height_2;
+
+	// skew offsets and weights of the rows or columns of a pass, 
+	// computed serially so that the passes can be run in parallel
+	const unsigned max_count = MAX(MAX(height_1, width_2), height_3);
+	int *iShear = (int*)malloc(max_count * sizeof(int));
+	double *dWeight = (double*)malloc(max_count * sizeof(double));
+	if(!iShear || !dWeight) {
+		free(iShear);
+		free(dWeight);
+		FreeImage_Unload(dst1);
+		return NULL;
+	}
 	
 	for(u = 0; u < height_1; u++) {  
 		double dShear;
@@ -674,20 +915,24 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 			// Negative angle
 			dShear = (double(u) - height_1 + 0.5) * dTan;
 		}
-		int iShear = int(floor(dShear));
-		HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
+		iShear[u] = int(floor(dShear));
+		dWeight[u] = dShear - double(iShear[u]);
+	}
+	if(!HorizontalSkewPass(src, dst1, iShear, dWeight, bkcolor)) {
+		free(iShear);
+		free(dWeight);
+		FreeImage_Unload(dst1);
+		return NULL;
 	}
 
 	// Perform 2nd shear  (vertical)
 	// ----------------------------------------------------------------------
 
-	// Calc 2nd shear (vertical) destination image dimensions
-	const unsigned width_2  = width_1;
-	unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
-
 	// Allocate image for 2nd shear
 	FIBITMAP *dst2 = FreeImage_AllocateT(image_type, width_2, height_2, bpp);
 	if(NULL == dst2) {
+		free(iShear);
+		free(dWeight);
 		FreeImage_Unload(dst1);
 		return NULL;
 	}
@@ -703,9 +948,11 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	}
 
 	for(u = 0; u < width_2; u++, dOffset -= dSinE) {
-		int iShear = int(floor(dOffset));
-		VerticalSkew(dst1, dst2, u, iShear, dOffset - double(iShear), bkcolor);
+		iShear[u] = int(floor(dOffset));
+		dWeight[u] = dOffset - double(iShear[u]);
 	}
+	// columns are skewed in bands of RBLOCK columns, so that each band is walked row by row
+	const BOOL bSkewed = VerticalSkewPass(dst1, dst2, iShear, dWeight, bkcolor);
 
 	// Perform 3rd shear (horizontal)
 	// ----------------------------------------------------------------------
@@ -713,13 +960,11 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	// Free result of 1st shear
 	FreeImage_Unload(dst1);
 
-	// Calc 3rd shear (horizontal) destination image dimensions
-	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
-	const unsigned height_3 = height_2;
-
 	// Allocate image for 3rd shear
-	FIBITMAP *dst3 = FreeImage_AllocateT(image_type, width_3, height_3, bpp);
+	FIBITMAP *dst3 = bSkewed ? FreeImage_AllocateT(image_type, width_3, height_3, bpp) : NULL;
 	if(NULL == dst3) {
+		free(iShear);
+		free(dWeight);
 		FreeImage_Unload(dst2);
 		return NULL;
 	}
@@ -733,12 +978,23 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = dTan * ( (src_width - 1.0) * -dSinE + (1.0 - height_3) );
 	}
 	for(u = 0; u < height_3; u++, dOffset += dTan) {
-		int iShear = int(floor(dOffset));
-		HorizontalSkew(dst2, dst3, u, iShear, dOffset - double(iShear), bkcolor);
+		iShear[u] = int(floor(dOffset));
+		dWeight[u] = dOffset - double(iShear[u]);
 	}
+	const BOOL bSheared = HorizontalSkewPass(dst2, dst3, iShear, dWeight, bkcolor);
+
+	free(iShear);
+	free(dWeight);
+
 	// Free result of 2nd shear    
 	FreeImage_Unload(dst2);
 
+	if(!bSheared) {
+		// cancelled
+		FreeImage_Unload(dst3);
+		return NULL;
+	}
+
 	// Return result of 3rd shear
 	return dst3;      
 }
@@ -821,6 +1077,316 @@ RotateAny(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	}
 }
 
+// --------------------------------------------------------------------------
+// Single pass rotation, using inverse mapping and bilinear interpolation
+
+#define RBILINEAR_BITS	7	// bits of subpixel precision (weights products must fit in a signed 16-bit word)
+#define RBILINEAR_ONE	(1 << RBILINEAR_BITS)
+
+/**
+Loads a 8-, 24- or 32-bit pixel into the low bytes of a DWORD
+*/
+static inline DWORD 
+LoadPixel32(const BYTE *bits, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			return bits[0];
+		case 3:
+			return (DWORD)bits[0] | ((DWORD)bits[1] << 8) | ((DWORD)bits[2] << 16);
+		default:
+		{
+			DWORD value;
+			memcpy(&value, bits, sizeof(DWORD));
+			return value;
+		}
+	}
+}
+
+#if defined(FI_ROTATE_SSE2)
+/**
+Blends 4 neighbouring pixels with packed weights, into 4 rounded 32-bit channel values
+@param wb Weights of p00 (low word) and p10 (high word)
+@param wt Weights of p01 (low word) and p11 (high word)
+*/
+static inline __m128i 
+BlendSum32(DWORD p00, DWORD p10, DWORD p01, DWORD p11, __m128i wb, __m128i wt) {
+	const __m128i zero = _mm_setzero_si128();
+	// interleave the channels of the left and right pixels as 16-bit pairs, 
+	// so that each pair is weighted and summed by a single madd
+	const __m128i bottom = _mm_unpacklo_epi16(
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)p00), zero), 
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)p10), zero));
+	const __m128i top = _mm_unpacklo_epi16(
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)p01), zero), 
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)p11), zero));
+	const __m128i sum = _mm_add_epi32(_mm_madd_epi16(bottom, wb), _mm_madd_epi16(top, wt));
+	return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (2 * RBILINEAR_BITS - 1))), 2 * RBILINEAR_BITS);
+}
+#endif // FI_ROTATE_SSE2
+
+/**
+Blends 4 neighbouring pixels (up to 4 channels of 8-bit each) with fixed point weights. 
+The weights sum to RBILINEAR_ONE * RBILINEAR_ONE.
+@param p00 Pixel at (x, y)
+@param p10 Pixel at (x + 1, y)
+@param p01 Pixel at (x, y + 1)
+@param p11 Pixel at (x + 1, y + 1)
+@param fx Horizontal weight of the right pixels, in [0..RBILINEAR_ONE]
+@param fy Vertical weight of the upper pixels, in [0..RBILINEAR_ONE]
+@return Returns the blended pixel
+*/
+static inline DWORD 
+BlendPixel32(DWORD p00, DWORD p10, DWORD p01, DWORD p11, int fx, int fy) {
+	const int w00 = (RBILINEAR_ONE - fx) * (RBILINEAR_ONE - fy);
+	const int w10 = fx * (RBILINEAR_ONE - fy);
+	const int w01 = (RBILINEAR_ONE - fx) * fy;
+	const int w11 = fx * fy;
+
+#if defined(FI_ROTATE_SSE2)
+	__m128i sum = BlendSum32(p00, p10, p01, p11, _mm_set1_epi32(w00 | (w10 << 16)), _mm_set1_epi32(w01 | (w11 << 16)));
+	sum = _mm_packs_epi32(sum, sum);
+	return (DWORD)_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+#else
+	const int round = 1 << (2 * RBILINEAR_BITS - 1);
+	DWORD result = 0;
+	for(int shift = 0; shift < 32; shift += 8) {
+		const int value = w00 * (int)((p00 >> shift) & 0xFF) + w10 * (int)((p10 >> shift) & 0xFF) 
+			+ w01 * (int)((p01 >> shift) & 0xFF) + w11 * (int)((p11 >> shift) & 0xFF);
+		result |= (DWORD)((value + round) >> (2 * RBILINEAR_BITS)) << shift;
+	}
+	return result;
+#endif // FI_ROTATE_SSE2
+}
+
+/**
+Blends 4 pixels at once, each from its 4 neighbours (see BlendPixel32). 
+With SSE2, the weights of the 4 pixels are computed together and the 4 results are packed by a single store.
+@param p Neighbours of each pixel, as p00, p10, p01, p11
+@param fx Horizontal weights of the 4 pixels
+@param fy Vertical weights of the 4 pixels
+@param result Blended pixels
+*/
+static inline void 
+BlendPixels32x4(const DWORD p[4][4], const int fx[4], const int fy[4], DWORD result[4]) {
+#if defined(FI_ROTATE_SSE2)
+	// the weights fit in 16-bit, so that 16-bit products give the 32-bit weights
+	const __m128i one = _mm_set1_epi32(RBILINEAR_ONE);
+	const __m128i vfx = _mm_loadu_si128((const __m128i*)fx);
+	const __m128i vfy = _mm_loadu_si128((const __m128i*)fy);
+	const __m128i gx = _mm_sub_epi32(one, vfx);
+	const __m128i gy = _mm_sub_epi32(one, vfy);
+	const __m128i wb = _mm_or_si128(_mm_mullo_epi16(gx, gy), _mm_slli_epi32(_mm_mullo_epi16(vfx, gy), 16));
+	const __m128i wt = _mm_or_si128(_mm_mullo_epi16(gx, vfy), _mm_slli_epi32(_mm_mullo_epi16(vfx, vfy), 16));
+
+	const __m128i s0 = BlendSum32(p[0][0], p[0][1], p[0][2], p[0][3], _mm_shuffle_epi32(wb, 0x00), _mm_shuffle_epi32(wt, 0x00));
+	const __m128i s1 = BlendSum32(p[1][0], p[1][1], p[1][2], p[1][3], _mm_shuffle_epi32(wb, 0x55), _mm_shuffle_epi32(wt, 0x55));
+	const __m128i s2 = BlendSum32(p[2][0], p[2][1], p[2][2], p[2][3], _mm_shuffle_epi32(wb, 0xAA), _mm_shuffle_epi32(wt, 0xAA));
+	const __m128i s3 = BlendSum32(p[3][0], p[3][1], p[3][2], p[3][3], _mm_shuffle_epi32(wb, 0xFF), _mm_shuffle_epi32(wt, 0xFF));
+	_mm_storeu_si128((__m128i*)result, _mm_packus_epi16(_mm_packs_epi32(s0, s1), _mm_packs_epi32(s2, s3)));
+#else
+	for(int k = 0; k < 4; k++) {
+		result[k] = BlendPixel32(p[k][0], p[k][1], p[k][2], p[k][3], fx[k], fy[k]);
+	}
+#endif // FI_ROTATE_SSE2
+}
+
+/**
+Stores the low bytespp bytes of a DWORD as a 8-, 24- or 32-bit pixel
+*/
+static inline void 
+StorePixel32(BYTE *bits, DWORD value, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			bits[0] = (BYTE)value;
+			break;
+		case 3:
+			bits[0] = (BYTE)value;
+			bits[1] = (BYTE)(value >> 8);
+			bits[2] = (BYTE)(value >> 16);
+			break;
+		default:
+			memcpy(bits, &value, sizeof(DWORD));
+			break;
+	}
+}
+
+/** Arguments of a bilinear rotation run on bands of destination rows in parallel
+*/
+typedef struct tagBILINEARPASS {
+	FIBITMAP *src;
+	FIBITMAP *dst;
+	DWORD bkg;				//! background color
+	double x0, y0;			//! source position of the destination pixel (0, 0)
+	double dSin, dCos;
+	INT64 step_x, step_y;	//! 16.16 fixed point source steps between horizontal neighbours
+} BILINEARPASS;
+
+/**
+Rotates the destination rows [first, last[ (see RotateBilinear)
+*/
+static void
+RotateBilinearRows(void *data, unsigned first, unsigned last) {
+	const BILINEARPASS *pass = (BILINEARPASS*)data;
+
+	const unsigned bytespp = FreeImage_GetBPP(pass->src) / 8;
+	const int src_width  = (int)FreeImage_GetWidth(pass->src);
+	const int src_height = (int)FreeImage_GetHeight(pass->src);
+	const unsigned src_pitch = FreeImage_GetPitch(pass->src);
+	const BYTE *src_bits = FreeImage_GetBits(pass->src);
+	const unsigned dst_width = FreeImage_GetWidth(pass->dst);
+	const DWORD bkg = pass->bkg;
+
+	const double scale = double(1 << 16);
+	const INT64 step_x = pass->step_x;
+	const INT64 step_y = pass->step_y;
+	const int fraction_shift = 16 - RBILINEAR_BITS;
+
+	for(unsigned y = first; y < last; y++) {
+		BYTE *dst_bits = FreeImage_GetScanLine(pass->dst, y);
+
+		INT64 sx = INT64(floor((pass->x0 + y * pass->dSin) * scale + 0.5));
+		INT64 sy = INT64(floor((pass->y0 + y * pass->dCos) * scale + 0.5));
+
+		unsigned x = 0;
+		while(x < dst_width) {
+			// runs of 4 pixels fully inside the source image are blended together : 
+			// source positions are linear in x, so the run is inside when its ends are
+			if(x + 4 <= dst_width) {
+				const INT64 ex = sx + 3 * step_x;
+				const INT64 ey = sy + 3 * step_y;
+				const int ix0 = int(sx >> 16), iy0 = int(sy >> 16);
+				const int ix3 = int(ex >> 16), iy3 = int(ey >> 16);
+				if((MIN(ix0, ix3) >= 0) && (MIN(iy0, iy3) >= 0) && (MAX(ix0, ix3) < src_width - 1) && (MAX(iy0, iy3) < src_height - 1)) {
+					DWORD p[4][4];
+					int fx[4], fy[4];
+					for(int k = 0; k < 4; k++, sx += step_x, sy += step_y) {
+						const BYTE *bits = src_bits + (ptrdiff_t)int(sy >> 16) * src_pitch + (ptrdiff_t)int(sx >> 16) * bytespp;
+						p[k][0] = LoadPixel32(bits, bytespp);
+						p[k][1] = LoadPixel32(bits + bytespp, bytespp);
+						p[k][2] = LoadPixel32(bits + src_pitch, bytespp);
+						p[k][3] = LoadPixel32(bits + src_pitch + bytespp, bytespp);
+						fx[k] = int(sx & 0xFFFF) >> fraction_shift;
+						fy[k] = int(sy & 0xFFFF) >> fraction_shift;
+					}
+					DWORD value[4];
+					BlendPixels32x4(p, fx, fy, value);
+					for(int k = 0; k < 4; k++, dst_bits += bytespp) {
+						StorePixel32(dst_bits, value[k], bytespp);
+					}
+					x += 4;
+					continue;
+				}
+			}
+
+			// floor : positions are at most a dst diagonal away from the source image, so they fit in an int
+			const int ix = int(sx >> 16);
+			const int iy = int(sy >> 16);
+			const int fx = int(sx & 0xFFFF) >> fraction_shift;
+			const int fy = int(sy & 0xFFFF) >> fraction_shift;
+			DWORD value;
+
+			if((ix >= 0) && (iy >= 0) && (ix < src_width - 1) && (iy < src_height - 1)) {
+				// fully inside the source image
+				const BYTE *p = src_bits + (ptrdiff_t)iy * src_pitch + (ptrdiff_t)ix * bytespp;
+				value = BlendPixel32(
+					LoadPixel32(p, bytespp), LoadPixel32(p + bytespp, bytespp), 
+					LoadPixel32(p + src_pitch, bytespp), LoadPixel32(p + src_pitch + bytespp, bytespp), 
+					fx, fy);
+			}
+			else if((ix < -1) || (iy < -1) || (ix >= src_width) || (iy >= src_height)) {
+				// fully outside the source image
+				value = bkg;
+			}
+			else {
+				// on the image border : missing neighbours take the background color
+				DWORD p[4];
+				for(int k = 0; k < 4; k++) {
+					const int px = ix + (k & 1);
+					const int py = iy + (k >> 1);
+					if((px >= 0) && (py >= 0) && (px < src_width) && (py < src_height)) {
+						p[k] = LoadPixel32(src_bits + (ptrdiff_t)py * src_pitch + (ptrdiff_t)px * bytespp, bytespp);
+					} else {
+						p[k] = bkg;
+					}
+				}
+				value = BlendPixel32(p[0], p[1], p[2], p[3], fx, fy);
+			}
+
+			StorePixel32(dst_bits, value, bytespp);
+			x++;
+			sx += step_x;
+			sy += step_y;
+			dst_bits += bytespp;
+		}
+	}
+}
+
+/**
+Rotates a 8-, 24- or 32-bit image by a given angle in a single pass. 
+Each destination pixel is mapped back into the source image and interpolated 
+from its 4 neighbours. Neighbours lying outside the source image take the 
+background color, so that the image borders are antialiased. 
+The destination rows are processed in parallel on the worker pool.
+@param src Pointer to source image to rotate
+@param dAngle Rotation angle, in degrees (counter clockwise)
+@param bkcolor Background color (at least bytespp bytes), or NULL for black
+@return Returns a pointer to a newly allocated rotated image if successful, returns NULL otherwise
+*/
+static FIBITMAP* 
+RotateBilinear(FIBITMAP *src, double dAngle, const void *bkcolor) {
+	const double ROTATE_PI = double(3.1415926535897932384626433832795);
+
+	const unsigned bpp = FreeImage_GetBPP(src);
+	const unsigned bytespp = bpp / 8;
+
+	const double dRadAngle = dAngle * ROTATE_PI / double(180); // Angle in radians
+	const double dSin = sin(dRadAngle);
+	const double dCos = cos(dRadAngle);
+
+	const int src_width  = (int)FreeImage_GetWidth(src);
+	const int src_height = (int)FreeImage_GetHeight(src);
+
+	// bounding box of the rotated image
+	const unsigned dst_width  = MAX(1U, unsigned(src_width * fabs(dCos) + src_height * fabs(dSin) + 0.5));
+	const unsigned dst_height = MAX(1U, unsigned(src_width * fabs(dSin) + src_height * fabs(dCos) + 0.5));
+
+	FIBITMAP *dst = FreeImage_Allocate(dst_width, dst_height, bpp);
+	if(NULL == dst) {
+		return NULL;
+	}
+
+	BILINEARPASS pass;
+	pass.src = src;
+	pass.dst = dst;
+	pass.bkg = 0;
+	if(bkcolor) {
+		memcpy(&pass.bkg, bkcolor, bytespp);
+	}
+
+	// the source position of a destination pixel (x, y) is 
+	// (sx, sy) = (x0 + x * dCos + y * dSin, y0 - x * dSin + y * dCos), 
+	// where the image centers are mapped onto each other
+	const double dx = 0.5 - dst_width / 2.0;
+	const double dy = 0.5 - dst_height / 2.0;
+	pass.x0 = dx * dCos + dy * dSin + src_width / 2.0 - 0.5;
+	pass.y0 = -dx * dSin + dy * dCos + src_height / 2.0 - 0.5;
+	pass.dSin = dSin;
+	pass.dCos = dCos;
+
+	// source positions are walked in 16.16 fixed point, 
+	// with 64-bit accumulators so that positions beyond 32767 pixels don't overflow
+	const double scale = double(1 << 16);
+	pass.step_x = INT64(floor(dCos * scale + 0.5));
+	pass.step_y = INT64(floor(-dSin * scale + 0.5));
+
+	if(!FreeImage_ParallelFor(dst_height, FreeImage_GetRowChunk(dst_width), RotateBilinearRows, &pass)) {
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
 // ==========================================================
 
 FIBITMAP *DLL_CALLCONV 
@@ -915,3 +1481,36 @@ FreeImage_Rotate(FIBITMAP *dib, double angle, const void *bkcolor) {
 	return NULL;
 }
 
+FIBITMAP *DLL_CALLCONV 
+FreeImage_RotateBilinear(FIBITMAP *dib, double angle, const void *bkcolor) {
+	if(!FreeImage_HasPixels(dib)) return NULL;
+
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	if((FreeImage_GetImageType(dib) != FIT_BITMAP) || ((bpp != 8) && (bpp != 24) && (bpp != 32)) || (fmod(angle, 90) == 0)) {
+		// unsupported format or lossless rotation : use the 3-shears rotation
+		return FreeImage_Rotate(dib, angle, bkcolor);
+	}
+
+	FIBITMAP *dst = RotateBilinear(dib, angle, bkcolor);
+	if(!dst) return NULL;
+
+	if(bpp == 8) {
+		// copy original palette to rotated bitmap
+		memcpy(FreeImage_GetPalette(dst), FreeImage_GetPalette(dib), 256 * sizeof(RGBQUAD));
+
+		// copy transparency table 
+		FreeImage_SetTransparencyTable(dst, FreeImage_GetTransparencyTable(dib), FreeImage_GetTransparencyCount(dib));
+
+		// copy background color 
+		RGBQUAD bkcolor; 
+		if( FreeImage_GetBackgroundColor(dib, &bkcolor) ) {
+			FreeImage_SetBackgroundColor(dst, &bkcolor); 
+		}
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, dib);
+
+	return dst;
+}
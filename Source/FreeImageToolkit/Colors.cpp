@@ -21,8 +21,11 @@
 // Use at your own risk!
 // ==========================================================
 
+#include <atomic>
+#include <mutex>
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
 // ----------------------------------------------------------
 //   Macros + structures
@@ -341,6 +344,426 @@ FreeImage_AdjustContrast(FIBITMAP *src, double percentage) {
 	return FreeImage_AdjustCurve(src, LUT, FICC_RGB);
 }
 
+// ----------------------------------------------------------
+//   Histogram helpers
+// ----------------------------------------------------------
+
+#define HISTO_BANKS		4	// sub-histograms per channel : consecutive samples are counted in different banks
+
+/**
+Counts 8-bit samples into HISTO_BANKS sub-histograms of 256 entries. 
+Consecutive samples increment different banks, so that runs of identical values 
+do not serialize on a single counter (store-to-load forwarding stalls). 
+@param banks HISTO_BANKS * 256 counters
+@param bits First sample
+@param stride Distance in bytes between two samples
+@param count Number of samples
+*/
+static void 
+CountSamples8(DWORD *banks, const BYTE *bits, unsigned stride, unsigned count) {
+	unsigned x = 0;
+	for(; x + 4 <= count; x += 4, bits += 4 * stride) {
+		banks[bits[0]]++;
+		banks[256 + bits[stride]]++;
+		banks[512 + bits[2 * stride]]++;
+		banks[768 + bits[3 * stride]]++;
+	}
+	for(; x < count; x++, bits += stride) {
+		banks[*bits]++;
+	}
+}
+
+/**
+Sums the HISTO_BANKS sub-histograms of a channel
+@param histo Output histogram of 256 entries
+@param banks HISTO_BANKS * 256 counters
+*/
+static void 
+MergeBanks8(DWORD *histo, const DWORD *banks) {
+	for(unsigned i = 0; i < 256; i++) {
+		histo[i] = banks[i] + banks[256 + i] + banks[512 + i] + banks[768 + i];
+	}
+}
+
+/** Arguments of a histogram computed on bands of rows in parallel. 
+Each band counts its rows into its own sub-histograms, which are then added to 
+the output histograms under the lock. 
+*/
+typedef struct tagHISTOGRAMROWS {
+	FIBITMAP *src;
+	FREE_IMAGE_TYPE image_type;
+	unsigned width;
+	unsigned bytespp;
+	unsigned channels;			//! samples per pixel (float histograms)
+	DWORD *histo[5];			//! red, green, blue, alpha, black histograms, or NULL
+	unsigned bins;				//! entries of each histogram
+	float min_value;			//! lower bound of the first bin (float histograms)
+	float scale;				//! number of bins per unit (float histograms)
+	std::mutex lock;			//! guards the output histograms
+	std::atomic<bool> failed;	//! true if a band could not allocate its work arrays
+} HISTOGRAMROWS;
+
+/**
+Adds the sub-histograms of a band to the output histograms
+*/
+static void 
+AddHistograms(HISTOGRAMROWS *rows, const DWORD *local) {
+	std::lock_guard<std::mutex> guard(rows->lock);
+	for(unsigned c = 0; c < 5; c++) {
+		if(rows->histo[c]) {
+			DWORD *histo = rows->histo[c];
+			const DWORD *sub = local + c * rows->bins;
+			for(unsigned i = 0; i < rows->bins; i++) {
+				histo[i] += sub[i];
+			}
+		}
+	}
+}
+
+static void 
+Histogram8Rows(void *data, unsigned first, unsigned last) {
+	HISTOGRAMROWS *rows = (HISTOGRAMROWS*)data;
+	const unsigned width = rows->width;
+	const unsigned bytespp = rows->bytespp;
+	DWORD * const *histo = rows->histo;
+	const unsigned offset[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+
+	DWORD *banks = (DWORD*)calloc(5 * HISTO_BANKS * 256, sizeof(DWORD));
+	DWORD *local = (DWORD*)malloc(5 * 256 * sizeof(DWORD));
+	BYTE *luma = (BYTE*)malloc(width * sizeof(BYTE));
+	if(!banks || !local || !luma) {
+		free(banks);
+		free(local);
+		free(luma);
+		rows->failed = true;
+		return;
+	}
+
+	for(unsigned y = first; y < last; y++) {
+		const BYTE *bits = FreeImage_GetScanLine(rows->src, y);
+
+		if(bytespp == 1) {
+			if(histo[4]) {
+				CountSamples8(banks + 4 * HISTO_BANKS * 256, bits, 1, width);
+			}
+			continue;
+		}
+
+		for(unsigned c = 0; c < 4; c++) {
+			if(histo[c]) {
+				CountSamples8(banks + c * HISTO_BANKS * 256, bits + offset[c], bytespp, width);
+			}
+		}
+		if(histo[4]) {
+			// RGB to GREY conversion, kept in a separate loop so that it can be vectorized
+			const BYTE *pixel = bits;
+			for(unsigned x = 0; x < width; x++, pixel += bytespp) {
+				luma[x] = GREY(pixel[FI_RGBA_RED], pixel[FI_RGBA_GREEN], pixel[FI_RGBA_BLUE]);
+			}
+			CountSamples8(banks + 4 * HISTO_BANKS * 256, luma, 1, width);
+		}
+	}
+
+	for(unsigned c = 0; c < 5; c++) {
+		if(histo[c]) {
+			MergeBanks8(local + c * 256, banks + c * HISTO_BANKS * 256);
+		}
+	}
+	AddHistograms(rows, local);
+
+	free(luma);
+	free(local);
+	free(banks);
+}
+
+/**
+Computes the 256 entries histograms of a 8-, 24- or 32-bit image in a single pass, 
+on bands of rows spread over the worker pool. 
+@see FreeImage_GetHistogramEx
+*/
+static BOOL 
+GetHistogram8(FIBITMAP *src, DWORD *red, DWORD *green, DWORD *blue, DWORD *alpha, DWORD *black) {
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+
+	// channel order of the banks : red, green, blue, alpha, black
+	DWORD *histo[5] = { red, green, blue, alpha, black };
+
+	if(bytespp == 1) {
+		// greyscale : every color channel has the histogram of the pixel values
+		histo[0] = histo[1] = histo[2] = NULL;
+		histo[3] = NULL;
+		if(alpha) {
+			memset(alpha, 0, 256 * sizeof(DWORD));
+		}
+		if(!black) {
+			black = red ? red : (green ? green : blue);
+		}
+		histo[4] = black;
+	}
+	else if(bytespp == 3) {
+		histo[3] = NULL;
+		if(alpha) {
+			memset(alpha, 0, 256 * sizeof(DWORD));
+		}
+	}
+
+	HISTOGRAMROWS rows;
+	rows.src = src;
+	rows.image_type = FIT_BITMAP;
+	rows.width = width;
+	rows.bytespp = bytespp;
+	rows.channels = bytespp;
+	rows.bins = 256;
+	rows.min_value = 0;
+	rows.scale = 1;
+	rows.failed = false;
+	for(unsigned c = 0; c < 5; c++) {
+		rows.histo[c] = histo[c];
+		if(histo[c]) {
+			memset(histo[c], 0, 256 * sizeof(DWORD));
+		}
+	}
+
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), Histogram8Rows, &rows) || rows.failed) {
+		return FALSE;
+	}
+
+	if(bytespp == 1) {
+		// copy the pixel values histogram to the other requested channels
+		DWORD *grey[3] = { red, green, blue };
+		for(unsigned c = 0; c < 3; c++) {
+			if(grey[c] && (grey[c] != black)) {
+				memcpy(grey[c], black, 256 * sizeof(DWORD));
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+Converts a scanline to interleaved float samples in R, G, B(, A) order
+@param dst Output samples (channels samples per pixel)
+@param bits Input scanline
+@param image_type Image type
+@param bytespp Number of bytes per pixel
+@param channels Number of samples per pixel
+@param width Number of pixels
+*/
+static void 
+GetHistogramLine(float *dst, const BYTE *bits, FREE_IMAGE_TYPE image_type, unsigned bytespp, unsigned channels, unsigned width) {
+	unsigned x;
+
+	switch(image_type) {
+		case FIT_BITMAP:
+			if(bytespp == 1) {
+				for(x = 0; x < width; x++) {
+					dst[x] = (float)bits[x];
+				}
+			} else {
+				for(x = 0; x < width; x++, bits += bytespp) {
+					*dst++ = (float)bits[FI_RGBA_RED];
+					*dst++ = (float)bits[FI_RGBA_GREEN];
+					*dst++ = (float)bits[FI_RGBA_BLUE];
+					if(bytespp == 4) {
+						*dst++ = (float)bits[FI_RGBA_ALPHA];
+					}
+				}
+			}
+			break;
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		{
+			const unsigned count = width * channels;
+			const WORD *src = (const WORD*)bits;
+			for(x = 0; x < count; x++) {
+				dst[x] = (float)src[x];
+			}
+		}
+		break;
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			memcpy(dst, bits, width * channels * sizeof(float));
+			break;
+		case FIT_RGB16F:
+		case FIT_RGBA16F:
+			ConvertLineHalfToFloat(dst, channels, (const WORD*)bits, channels, width);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+Counts float samples into a histogram of 'bins' entries. 
+Bin indexes are first computed for the whole line (a loop the compiler can vectorize), 
+then counted. 
+@param histo Histogram
+@param samples First sample
+@param stride Distance in samples between two samples
+@param count Number of samples
+@param min_value Lower bound of the first bin
+@param scale Number of bins per unit
+@param bins Number of bins
+@param index Work array of 'count' entries
+*/
+static void 
+CountSamplesF(DWORD *histo, const float *samples, unsigned stride, unsigned count, float min_value, float scale, unsigned bins, unsigned *index) {
+	const float last = (float)(bins - 1);
+	for(unsigned x = 0; x < count; x++) {
+		// samples outside the range are counted in the first or last bin
+		const float value = (samples[x * stride] - min_value) * scale;
+		index[x] = (unsigned)MAX(0.0F, MIN(value, last));
+	}
+	for(unsigned x = 0; x < count; x++) {
+		histo[index[x]]++;
+	}
+}
+
+static void 
+HistogramFRows(void *data, unsigned first, unsigned last) {
+	HISTOGRAMROWS *rows = (HISTOGRAMROWS*)data;
+	const unsigned width = rows->width;
+	const unsigned channels = rows->channels;
+	const unsigned bins = rows->bins;
+	DWORD * const *histo = rows->histo;
+
+	DWORD *local = (DWORD*)calloc(5 * bins, sizeof(DWORD));
+	float *line = (float*)malloc(width * channels * sizeof(float));
+	float *luma = (float*)malloc(width * sizeof(float));
+	unsigned *index = (unsigned*)malloc(width * sizeof(unsigned));
+	if(!local || !line || !luma || !index) {
+		free(local);
+		free(line);
+		free(luma);
+		free(index);
+		rows->failed = true;
+		return;
+	}
+
+	for(unsigned y = first; y < last; y++) {
+		GetHistogramLine(line, FreeImage_GetScanLine(rows->src, y), rows->image_type, rows->bytespp, channels, width);
+
+		if(channels == 1) {
+			if(histo[4]) {
+				CountSamplesF(local + 4 * bins, line, 1, width, rows->min_value, rows->scale, bins, index);
+			}
+			continue;
+		}
+		for(unsigned c = 0; c < 4; c++) {
+			if(histo[c]) {
+				CountSamplesF(local + c * bins, line + c, channels, width, rows->min_value, rows->scale, bins, index);
+			}
+		}
+		if(histo[4]) {
+			const float *pixel = line;
+			for(unsigned x = 0; x < width; x++, pixel += channels) {
+				luma[x] = LUMA_REC709(pixel[0], pixel[1], pixel[2]);
+			}
+			CountSamplesF(local + 4 * bins, luma, 1, width, rows->min_value, rows->scale, bins, index);
+		}
+	}
+
+	AddHistograms(rows, local);
+
+	free(index);
+	free(luma);
+	free(line);
+	free(local);
+}
+
+/**
+Computes the binned histograms of an image in a single pass, 
+on bands of rows spread over the worker pool. 
+@see FreeImage_GetHistogramEx
+*/
+static BOOL 
+GetHistogramF(FIBITMAP *src, DWORD *red, DWORD *green, DWORD *blue, DWORD *alpha, DWORD *black, unsigned bins, double min_value, double max_value) {
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+
+	unsigned channels = 0;
+	switch(image_type) {
+		case FIT_BITMAP:
+			channels = (bytespp == 1) ? 1 : ((bytespp == 3) ? 3 : 4);
+			break;
+		case FIT_UINT16:
+		case FIT_FLOAT:
+			channels = 1;
+			break;
+		case FIT_RGB16:
+		case FIT_RGBF:
+		case FIT_RGB16F:
+			channels = 3;
+			break;
+		case FIT_RGBA16:
+		case FIT_RGBAF:
+		case FIT_RGBA16F:
+			channels = 4;
+			break;
+		default:
+			return FALSE;
+	}
+
+	DWORD *histo[5] = { red, green, blue, alpha, black };
+
+	for(unsigned c = 0; c < 5; c++) {
+		if(histo[c]) {
+			memset(histo[c], 0, bins * sizeof(DWORD));
+		}
+	}
+	if(channels < 4) {
+		// no alpha channel : the alpha histogram is left empty
+		histo[3] = NULL;
+	}
+	if(channels == 1) {
+		// greyscale : every color channel has the histogram of the pixel values
+		if(!black) {
+			black = red ? red : (green ? green : blue);
+		}
+		histo[0] = histo[1] = histo[2] = NULL;
+		histo[4] = black;
+	}
+
+	HISTOGRAMROWS rows;
+	rows.src = src;
+	rows.image_type = image_type;
+	rows.width = width;
+	rows.bytespp = bytespp;
+	rows.channels = channels;
+	for(unsigned c = 0; c < 5; c++) {
+		rows.histo[c] = histo[c];
+	}
+	rows.bins = bins;
+	rows.min_value = (float)min_value;
+	rows.scale = (float)(bins / (max_value - min_value));
+	rows.failed = false;
+
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), HistogramFRows, &rows) || rows.failed) {
+		return FALSE;
+	}
+
+	if(channels == 1) {
+		// copy the pixel values histogram to the other requested channels
+		DWORD *grey[3] = { red, green, blue };
+		for(unsigned c = 0; c < 3; c++) {
+			if(grey[c] && (grey[c] != black)) {
+				memcpy(grey[c], black, bins * sizeof(DWORD));
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+// ----------------------------------------------------------
+
 /** @brief Computes image histogram
 
 For 24-bit and 32-bit images, histogram can be computed from red, green, blue and 
@@ -350,90 +773,32 @@ bit depth is not supported (nothing is done).
 @param histo Histogram array to fill. <b>The size of 'histo' is assumed to be 256.</b>
 @param channel Color channel to use
 @return Returns TRUE if succesful, returns FALSE if the image bit depth isn't supported.
+@see FreeImage_GetHistogramEx
 */
 BOOL DLL_CALLCONV 
 FreeImage_GetHistogram(FIBITMAP *src, DWORD *histo, FREE_IMAGE_COLOR_CHANNEL channel) {
-	BYTE pixel;
-	BYTE *bits = NULL;
-	unsigned x, y;
-
 	if(!FreeImage_HasPixels(src) || !histo) return FALSE;
 
-	unsigned width  = FreeImage_GetWidth(src);
-	unsigned height = FreeImage_GetHeight(src);
-	unsigned bpp    = FreeImage_GetBPP(src);
+	const unsigned bpp = FreeImage_GetBPP(src);
 
+	if(FreeImage_GetImageType(src) != FIT_BITMAP) {
+		return FALSE;
+	}
 	if(bpp == 8) {
-		// clear histogram array
-		memset(histo, 0, 256 * sizeof(DWORD));
 		// compute histogram for black channel
-		for(y = 0; y < height; y++) {
-			bits = FreeImage_GetScanLine(src, y);
-			for(x = 0; x < width; x++) {
-				// get pixel value
-				pixel = bits[x];
-				histo[pixel]++;
-			}
-		}
-		return TRUE;
+		return GetHistogram8(src, NULL, NULL, NULL, NULL, histo);
 	}
 	else if((bpp == 24) || (bpp == 32)) {
-		int bytespp = bpp / 8;	// bytes / pixel
-
-		// clear histogram array
-		memset(histo, 0, 256 * sizeof(DWORD));
-
 		switch(channel) {
 			case FICC_RED:
-				// compute histogram for red channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_RED];	// R
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
-				return TRUE;
-
+				return GetHistogram8(src, histo, NULL, NULL, NULL, NULL);
 			case FICC_GREEN:
-				// compute histogram for green channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_GREEN];	// G
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
-				return TRUE;
-
+				return GetHistogram8(src, NULL, histo, NULL, NULL, NULL);
 			case FICC_BLUE:
-				// compute histogram for blue channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						pixel = bits[FI_RGBA_BLUE];	// B
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
-				return TRUE;
-
+				return GetHistogram8(src, NULL, NULL, histo, NULL, NULL);
 			case FICC_BLACK:
 			case FICC_RGB:
-				// compute histogram for black channel
-				for(y = 0; y < height; y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for(x = 0; x < width; x++) {
-						// RGB to GREY conversion
-						pixel = GREY(bits[FI_RGBA_RED], bits[FI_RGBA_GREEN], bits[FI_RGBA_BLUE]);
-						histo[pixel]++;
-						bits += bytespp;
-					}
-				}
-				return TRUE;
-				
+				return GetHistogram8(src, NULL, NULL, NULL, NULL, histo);
 			default:
 				return FALSE;
 		}
@@ -442,6 +807,49 @@ FreeImage_GetHistogram(FIBITMAP *src, DWORD *histo, FREE_IMAGE_COLOR_CHANNEL cha
 	return FALSE;
 }
 
+/** @brief Computes the histograms of several channels in a single pass
+
+Any of the histogram arrays may be NULL, in which case the channel is skipped. 
+The black histogram is computed from the luminance of the pixels. 
+For greyscale images (8-bit, FIT_UINT16, FIT_FLOAT), the red, green, blue and black 
+histograms are those of the pixel values. The alpha histogram is left empty 
+for images without an alpha channel. <br>
+Each histogram has 'bins' entries spanning [min_value .. max_value] : sample v is 
+counted in bin (v - min_value) * bins / (max_value - min_value), and samples outside 
+the range are counted in the first or last bin. The defaults give the usual 256 
+entries histogram of 8-bit samples. 
+@param src Input image to be processed (8-, 24-, 32-bit, FIT_UINT16, FIT_RGB16, FIT_RGBA16, 
+FIT_FLOAT, FIT_RGBF, FIT_RGBAF, FIT_RGB16F or FIT_RGBA16F)
+@param red Red histogram, or NULL
+@param green Green histogram, or NULL
+@param blue Blue histogram, or NULL
+@param alpha Alpha histogram, or NULL
+@param black Luminance histogram, or NULL
+@param bins Number of entries of each histogram
+@param min_value Lower bound of the first bin
+@param max_value Upper bound of the last bin
+@return Returns TRUE if succesful, returns FALSE if the image type isn't supported 
+or if the parameters are invalid.
+*/
+BOOL DLL_CALLCONV 
+FreeImage_GetHistogramEx(FIBITMAP *src, DWORD *red, DWORD *green, DWORD *blue, DWORD *alpha, DWORD *black, unsigned bins, double min_value, double max_value) {
+	if(!FreeImage_HasPixels(src) || (bins == 0) || !(max_value > min_value)) return FALSE;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned bpp = FreeImage_GetBPP(src);
+
+	if((image_type == FIT_BITMAP) && (bpp != 8) && (bpp != 24) && (bpp != 32)) {
+		return FALSE;
+	}
+
+	if((image_type == FIT_BITMAP) && (bins == 256) && (min_value == 0) && (max_value == 255)) {
+		// 8-bit samples counted directly
+		return GetHistogram8(src, red, green, blue, alpha, black);
+	}
+
+	return GetHistogramF(src, red, green, blue, alpha, black, bins, min_value, max_value);
+}
+
 // ----------------------------------------------------------
 
 
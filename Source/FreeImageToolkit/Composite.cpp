@@ -0,0 +1,778 @@
+// ==========================================================
+// Porter-Duff alpha compositing routines
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include <atomic>
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "ThreadPool.h"
+
+// the vector kernels assume the alpha byte is the 4th byte of a 32-bit pixel
+#if (FI_RGBA_ALPHA == 3)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FI_COMPOSITE_SSE2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FI_COMPOSITE_NEON
+#endif
+#endif
+
+// ----------------------------------------------------------
+//   8-bit arithmetic helpers
+// ----------------------------------------------------------
+
+/**
+Exact rounded division by 255 of a value in [0..255*255]
+*/
+static inline unsigned
+Div255(unsigned x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+/**
+Rounded product of two values in [0..255], normalized to [0..255]
+*/
+static inline unsigned
+Mul255(unsigned a, unsigned b) {
+	return Div255(a * b);
+}
+
+#if defined(FI_COMPOSITE_SSE2)
+
+/// Div255 applied to 8 unsigned 16-bit lanes
+static inline __m128i
+Div255_epu16(__m128i x) {
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/// Broadcast the alpha lane of each of the 2 pixels held in 8 x 16-bit lanes
+static inline __m128i
+BroadcastAlpha_epi16(__m128i x) {
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+	return _mm_shufflehi_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+#endif // FI_COMPOSITE_SSE2
+
+// ----------------------------------------------------------
+//   Line kernels used by FreeImage_Paste and FreeImage_Composite
+// ----------------------------------------------------------
+
+void
+BlendLineConstant(BYTE *dst, const BYTE *src, unsigned count, unsigned alpha) {
+	unsigned i = 0;
+
+	// dst = (src * alpha + dst * (256 - alpha)) / 256
+	// which is the same as ((src - dst) * alpha + (dst << 8)) >> 8
+	// (the weights add up to 256, so the shift is the exact division of the scalar code)
+
+#if defined(FI_COMPOSITE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i va = _mm_set1_epi16((short)alpha);
+	const __m128i vna = _mm_set1_epi16((short)(256 - alpha));
+	for(; i + 16 <= count; i += 16) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		// s * a + d * (256 - a) <= 255 * 256 : no 16-bit overflow
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), va), _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), vna));
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), va), _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), vna));
+		lo = _mm_srli_epi16(lo, 8);
+		hi = _mm_srli_epi16(hi, 8);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+#elif defined(FI_COMPOSITE_NEON)
+	const uint16x8_t va = vdupq_n_u16((uint16_t)alpha);
+	const uint16x8_t vna = vdupq_n_u16((uint16_t)(256 - alpha));
+	for(; i + 16 <= count; i += 16) {
+		const uint8x16_t s = vld1q_u8(src + i);
+		const uint8x16_t d = vld1q_u8(dst + i);
+		uint16x8_t lo = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(s)), va), vmovl_u8(vget_low_u8(d)), vna);
+		uint16x8_t hi = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(s)), va), vmovl_u8(vget_high_u8(d)), vna);
+		vst1q_u8(dst + i, vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+	}
+#endif
+
+	for(; i < count; i++) {
+		dst[i] = (BYTE)(((src[i] - dst[i]) * (int)alpha + (dst[i] << 8)) >> 8);
+	}
+}
+
+void
+CompositeLineOverBackground(BYTE *dst, const BYTE *fg, const BYTE *bg, unsigned width_in_pixels) {
+	unsigned x = 0;
+
+	// alpha == 0 : dst = bg
+	// alpha == 255 : dst = fg
+	// otherwise : dst = (alpha * fg + (255 - alpha) * bg) >> 8
+	// (the shift, rather than a division by 255, is the arithmetic of the previous scalar code)
+
+#if defined(FI_COMPOSITE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i v255 = _mm_set1_epi16(255);
+	const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+	for(; x + 4 <= width_in_pixels; x += 4) {
+		const __m128i f = _mm_loadu_si128((const __m128i*)(fg + 4 * x));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(bg + 4 * x));
+		__m128i result[2];
+		for(int k = 0; k < 2; k++) {
+			const __m128i f16 = k ? _mm_unpackhi_epi8(f, zero) : _mm_unpacklo_epi8(f, zero);
+			const __m128i b16 = k ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+			const __m128i a16 = BroadcastAlpha_epi16(f16);
+			__m128i r = _mm_add_epi16(_mm_mullo_epi16(a16, f16), _mm_mullo_epi16(_mm_sub_epi16(v255, a16), b16));
+			r = _mm_srli_epi16(r, 8);
+			// select fg where alpha == 255, bg where alpha == 0
+			const __m128i m255 = _mm_cmpeq_epi16(a16, v255);
+			const __m128i m0 = _mm_cmpeq_epi16(a16, zero);
+			r = _mm_or_si128(_mm_andnot_si128(_mm_or_si128(m255, m0), r), _mm_or_si128(_mm_and_si128(m255, f16), _mm_and_si128(m0, b16)));
+			result[k] = r;
+		}
+		// the result is opaque
+		_mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_or_si128(_mm_packus_epi16(result[0], result[1]), alpha_mask));
+	}
+#endif
+
+	for(; x < width_in_pixels; x++) {
+		const BYTE *f = fg + 4 * x;
+		const BYTE *b = bg + 4 * x;
+		BYTE *d = dst + 4 * x;
+		const BYTE alpha = f[FI_RGBA_ALPHA];
+		if(alpha == 0) {
+			d[FI_RGBA_BLUE]  = b[FI_RGBA_BLUE];
+			d[FI_RGBA_GREEN] = b[FI_RGBA_GREEN];
+			d[FI_RGBA_RED]   = b[FI_RGBA_RED];
+		} else if(alpha == 255) {
+			d[FI_RGBA_BLUE]  = f[FI_RGBA_BLUE];
+			d[FI_RGBA_GREEN] = f[FI_RGBA_GREEN];
+			d[FI_RGBA_RED]   = f[FI_RGBA_RED];
+		} else {
+			const BYTE not_alpha = (BYTE)~alpha;
+			d[FI_RGBA_BLUE]  = (BYTE)((alpha * (WORD)f[FI_RGBA_BLUE]  + not_alpha * (WORD)b[FI_RGBA_BLUE]) >> 8);
+			d[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)f[FI_RGBA_GREEN] + not_alpha * (WORD)b[FI_RGBA_GREEN]) >> 8);
+			d[FI_RGBA_RED]   = (BYTE)((alpha * (WORD)f[FI_RGBA_RED]   + not_alpha * (WORD)b[FI_RGBA_RED]) >> 8);
+		}
+		d[FI_RGBA_ALPHA] = 0xFF;
+	}
+}
+
+// ----------------------------------------------------------
+//   Premultiply / unpremultiply line kernels
+// ----------------------------------------------------------
+
+#if defined(FI_COMPOSITE_SSE2)
+
+/// Exact rounded division by 65535 of 4 unsigned 32-bit lanes in [0..65535*65535]
+static inline __m128i
+Div65535_epu32(__m128i x) {
+	x = _mm_add_epi32(x, _mm_set1_epi32(32768));
+	return _mm_srli_epi32(_mm_add_epi32(x, _mm_srli_epi32(x, 16)), 16);
+}
+
+/// Pack 2 x 4 unsigned 32-bit lanes holding values in [0..65535] into 8 x 16-bit lanes
+static inline __m128i
+PackLow16_epu32(__m128i lo, __m128i hi) {
+	// sign extend the low 16 bits so that the signed saturation keeps the bit pattern
+	lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+	hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+	return _mm_packs_epi32(lo, hi);
+}
+
+/// Replace the alpha lane of (f0, f1, f2, f3) with 1, giving a per-channel factor that leaves alpha unchanged
+static inline __m128
+AlphaFactor_ps(__m128 f) {
+	const __m128 color_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	return _mm_or_ps(_mm_and_ps(color_mask, f), _mm_andnot_ps(color_mask, _mm_set1_ps(1.0F)));
+}
+
+#endif // FI_COMPOSITE_SSE2
+
+void
+PreMultiplyLine32(BYTE *bits, unsigned width_in_pixels) {
+	unsigned x = 0;
+
+	// channel = (channel * alpha + 127) / 255, i.e. Mul255(channel, alpha)
+
+#if defined(FI_COMPOSITE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	// the alpha lanes are multiplied by 255, which leaves them unchanged
+	const __m128i color_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	const __m128i alpha_255 = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+	for(; x + 4 <= width_in_pixels; x += 4) {
+		const __m128i p = _mm_loadu_si128((const __m128i*)(bits + 4 * x));
+		__m128i result[2];
+		for(int k = 0; k < 2; k++) {
+			const __m128i c16 = k ? _mm_unpackhi_epi8(p, zero) : _mm_unpacklo_epi8(p, zero);
+			const __m128i m16 = _mm_or_si128(_mm_and_si128(BroadcastAlpha_epi16(c16), color_mask), alpha_255);
+			result[k] = Div255_epu16(_mm_mullo_epi16(c16, m16));
+		}
+		_mm_storeu_si128((__m128i*)(bits + 4 * x), _mm_packus_epi16(result[0], result[1]));
+	}
+#endif
+
+	for(; x < width_in_pixels; x++) {
+		BYTE *p = bits + 4 * x;
+		const unsigned alpha = p[FI_RGBA_ALPHA];
+		if(alpha != 0xFF) {
+			p[FI_RGBA_BLUE]  = (BYTE)Mul255(p[FI_RGBA_BLUE], alpha);
+			p[FI_RGBA_GREEN] = (BYTE)Mul255(p[FI_RGBA_GREEN], alpha);
+			p[FI_RGBA_RED]   = (BYTE)Mul255(p[FI_RGBA_RED], alpha);
+		}
+	}
+}
+
+void
+UnPreMultiplyLine32(BYTE *bits, unsigned width_in_pixels) {
+	unsigned x = 0;
+
+	// channel = min(255, (channel * 255 + alpha / 2) / alpha), or 0 when alpha is 0
+
+#if defined(FI_COMPOSITE_SSE2)
+	// the float quotient is exact up to a tiny error, while its fractional part is either 0
+	// or at least 1/255 away from the next integer : a small bias makes truncation exact
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha_mask = _mm_set_epi32(-1, 0, 0, 0);
+	const __m128 v255 = _mm_set1_ps(255.0F);
+	const __m128 bias = _mm_set1_ps(1.0F / 512);
+	for(; x + 4 <= width_in_pixels; x += 4) {
+		const __m128i p = _mm_loadu_si128((const __m128i*)(bits + 4 * x));
+		const __m128i p16[2] = { _mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero) };
+		__m128i r[4];
+		for(int k = 0; k < 4; k++) {
+			const __m128i c32 = (k & 1) ? _mm_unpackhi_epi16(p16[k >> 1], zero) : _mm_unpacklo_epi16(p16[k >> 1], zero);
+			const __m128 c = _mm_cvtepi32_ps(c32);
+			const __m128 a = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3));
+			// numerator = channel * 255 + alpha / 2 (integer division)
+			const __m128i a32 = _mm_shuffle_epi32(c32, _MM_SHUFFLE(3, 3, 3, 3));
+			const __m128 num = _mm_add_ps(_mm_mul_ps(c, v255), _mm_cvtepi32_ps(_mm_srli_epi32(a32, 1)));
+			__m128 q = _mm_add_ps(_mm_div_ps(num, a), bias);
+			q = _mm_and_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()), _mm_min_ps(q, v255));
+			// keep the alpha lane
+			r[k] = _mm_or_si128(_mm_andnot_si128(alpha_mask, _mm_cvttps_epi32(q)), _mm_and_si128(alpha_mask, c32));
+		}
+		_mm_storeu_si128((__m128i*)(bits + 4 * x), _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(r[2], r[3])));
+	}
+#endif
+
+	for(; x < width_in_pixels; x++) {
+		BYTE *p = bits + 4 * x;
+		const unsigned alpha = p[FI_RGBA_ALPHA];
+		if(alpha == 0) {
+			p[FI_RGBA_BLUE] = p[FI_RGBA_GREEN] = p[FI_RGBA_RED] = 0;
+		} else if(alpha != 0xFF) {
+			p[FI_RGBA_BLUE]  = (BYTE)MIN(255U, (p[FI_RGBA_BLUE] * 255U + alpha / 2) / alpha);
+			p[FI_RGBA_GREEN] = (BYTE)MIN(255U, (p[FI_RGBA_GREEN] * 255U + alpha / 2) / alpha);
+			p[FI_RGBA_RED]   = (BYTE)MIN(255U, (p[FI_RGBA_RED] * 255U + alpha / 2) / alpha);
+		}
+	}
+}
+
+void
+PreMultiplyLineRGBA16(FIRGBA16 *bits, unsigned width_in_pixels) {
+	unsigned x = 0;
+
+	// channel = (channel * alpha + 32767) / 65535
+
+#if defined(FI_COMPOSITE_SSE2)
+	const __m128i color_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	const __m128i alpha_65535 = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	for(; x + 2 <= width_in_pixels; x += 2) {
+		const __m128i c = _mm_loadu_si128((const __m128i*)(bits + x));
+		const __m128i m = _mm_or_si128(_mm_and_si128(BroadcastAlpha_epi16(c), color_mask), alpha_65535);
+		// full 32-bit products
+		const __m128i lo = _mm_mullo_epi16(c, m);
+		const __m128i hi = _mm_mulhi_epu16(c, m);
+		const __m128i p0 = Div65535_epu32(_mm_unpacklo_epi16(lo, hi));
+		const __m128i p1 = Div65535_epu32(_mm_unpackhi_epi16(lo, hi));
+		_mm_storeu_si128((__m128i*)(bits + x), PackLow16_epu32(p0, p1));
+	}
+#endif
+
+	for(; x < width_in_pixels; x++) {
+		FIRGBA16 *p = bits + x;
+		const unsigned alpha = p->alpha;
+		if(alpha != 0xFFFF) {
+			p->red   = (WORD)((p->red * alpha + 32767) / 65535);
+			p->green = (WORD)((p->green * alpha + 32767) / 65535);
+			p->blue  = (WORD)((p->blue * alpha + 32767) / 65535);
+		}
+	}
+}
+
+void
+UnPreMultiplyLineRGBA16(FIRGBA16 *bits, unsigned width_in_pixels) {
+	// channel = min(65535, (channel * 65535 + alpha / 2) / alpha), or 0 when alpha is 0
+	// (a float quotient isn't exact enough for 16-bit values, so this is kept as integer code)
+
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		FIRGBA16 *p = bits + x;
+		const unsigned alpha = p->alpha;
+		if(alpha == 0) {
+			p->red = p->green = p->blue = 0;
+		} else if(alpha != 0xFFFF) {
+			p->red   = (WORD)MIN(65535U, (p->red * 65535U + alpha / 2) / alpha);
+			p->green = (WORD)MIN(65535U, (p->green * 65535U + alpha / 2) / alpha);
+			p->blue  = (WORD)MIN(65535U, (p->blue * 65535U + alpha / 2) / alpha);
+		}
+	}
+}
+
+void
+PreMultiplyLineRGBAF(FIRGBAF *bits, unsigned width_in_pixels) {
+#if defined(FI_COMPOSITE_SSE2)
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		const __m128 c = _mm_loadu_ps((const float*)(bits + x));
+		const __m128 a = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps((float*)(bits + x), _mm_mul_ps(c, AlphaFactor_ps(a)));
+	}
+#else
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		FIRGBAF *p = bits + x;
+		p->red   *= p->alpha;
+		p->green *= p->alpha;
+		p->blue  *= p->alpha;
+	}
+#endif
+}
+
+void
+UnPreMultiplyLineRGBAF(FIRGBAF *bits, unsigned width_in_pixels) {
+#if defined(FI_COMPOSITE_SSE2)
+	const __m128 one = _mm_set1_ps(1.0F);
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		const __m128 c = _mm_loadu_ps((const float*)(bits + x));
+		const __m128 a = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3));
+		// 1 / alpha may be computed from an approximate reciprocal (fast-math),
+		// so opaque pixels are explicitly left unchanged
+		const __m128 opaque = _mm_cmpeq_ps(a, one);
+		__m128 f = _mm_and_ps(_mm_cmpneq_ps(a, _mm_setzero_ps()), _mm_div_ps(one, a));
+		f = _mm_or_ps(_mm_and_ps(opaque, one), _mm_andnot_ps(opaque, f));
+		_mm_storeu_ps((float*)(bits + x), _mm_mul_ps(c, AlphaFactor_ps(f)));
+	}
+#else
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		FIRGBAF *p = bits + x;
+		if(p->alpha != 1) {
+			const float f = (p->alpha != 0) ? 1 / p->alpha : 0;
+			p->red   *= f;
+			p->green *= f;
+			p->blue  *= f;
+		}
+	}
+#endif
+}
+
+// ----------------------------------------------------------
+//   Porter-Duff kernels, 8-bit
+// ----------------------------------------------------------
+
+/**
+Blend function B(cs, cb) applied to premultiplied colors, i.e. returns as * ab * B(Cs, Cb)
+*/
+static inline int
+BlendPremultiplied8(FREE_IMAGE_BLEND_MODE mode, unsigned cs, unsigned cb, unsigned as, unsigned ab) {
+	switch(mode) {
+		case FIBM_MULTIPLY:
+			return (int)Mul255(cs, cb);
+		case FIBM_SCREEN:
+			// as * ab * (Cs + Cb - Cs * Cb)
+			return (int)Mul255(cs, ab) + (int)Mul255(cb, as) - (int)Mul255(cs, cb);
+		case FIBM_SRC_OVER:
+		default:
+			return (int)Mul255(cs, ab);
+	}
+}
+
+/**
+Composite one 32-bit src pixel over one 32-bit dst pixel (generic scalar path)
+*/
+static inline void
+CompositePixel8(BYTE *d, const BYTE *s, FREE_IMAGE_BLEND_MODE mode, BOOL premultiplied, unsigned opacity) {
+	const unsigned as = (opacity < 255) ? Mul255(s[FI_RGBA_ALPHA], opacity) : s[FI_RGBA_ALPHA];
+	const unsigned ab = d[FI_RGBA_ALPHA];
+	const int channel[3] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE };
+
+	if(!premultiplied && (mode == FIBM_SRC_OVER) && (ab == 255)) {
+		// opaque background : plain linear interpolation
+		for(int k = 0; k < 3; k++) {
+			const int c = channel[k];
+			d[c] = (BYTE)Div255(s[c] * as + d[c] * (255 - as));
+		}
+		return;
+	}
+
+	// co = cs * (1 - ab) + cb * (1 - as) + as * ab * B(Cs, Cb)
+	// ao = as + ab - as * ab
+	const unsigned ao = as + ab - Mul255(as, ab);
+
+	if(premultiplied) {
+		for(int k = 0; k < 3; k++) {
+			const int c = channel[k];
+			const unsigned cs = (opacity < 255) ? Mul255(s[c], opacity) : s[c];
+			const unsigned cb = d[c];
+			d[c] = (BYTE)CLAMP((int)Mul255(cs, 255 - ab) + (int)Mul255(cb, 255 - as) + BlendPremultiplied8(mode, cs, cb, as, ab), 0, 255);
+		}
+	} else {
+		// straight colors : premultiplying then dividing by ao in 8-bit loses too much
+		// precision for small alpha values, so this (slow) path is done in float
+		const float fas = as / 255.0F;
+		const float fab = ab / 255.0F;
+		const float fao = fas + fab - fas * fab;
+		for(int k = 0; k < 3; k++) {
+			const int c = channel[k];
+			const float cs = s[c] * fas;
+			const float cb = d[c] * fab;
+			float blend;
+			switch(mode) {
+				case FIBM_MULTIPLY:
+					blend = cs * cb / 255.0F;
+					break;
+				case FIBM_SCREEN:
+					blend = cs * fab + cb * fas - cs * cb / 255.0F;
+					break;
+				case FIBM_SRC_OVER:
+				default:
+					blend = cs * fab;
+					break;
+			}
+			const float co = cs * (1 - fab) + cb * (1 - fas) + blend;
+			d[c] = (fao > 0) ? (BYTE)CLAMP((int)(co / fao + 0.5F), 0, 255) : 0;
+		}
+	}
+	d[FI_RGBA_ALPHA] = (BYTE)ao;
+}
+
+/**
+Composite a line of 32-bit src pixels over a line of 32-bit dst pixels
+@param opacity Global opacity applied to src, in [0..255]
+*/
+static void
+CompositeLine8(BYTE *dst, const BYTE *src, unsigned width_in_pixels, FREE_IMAGE_BLEND_MODE mode, BOOL premultiplied, unsigned opacity) {
+	unsigned x = 0;
+
+#if defined(FI_COMPOSITE_SSE2)
+	if(mode == FIBM_SRC_OVER) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i v255 = _mm_set1_epi16(255);
+		const __m128i vop = _mm_set1_epi16((short)opacity);
+		const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+
+		for(; x + 4 <= width_in_pixels; x += 4) {
+			const __m128i s = _mm_loadu_si128((const __m128i*)(src + 4 * x));
+			const __m128i d = _mm_loadu_si128((const __m128i*)(dst + 4 * x));
+
+			if(premultiplied) {
+				// every channel, alpha included : o = s + d * (1 - as)
+				__m128i result[2];
+				for(int k = 0; k < 2; k++) {
+					__m128i s16 = k ? _mm_unpackhi_epi8(s, zero) : _mm_unpacklo_epi8(s, zero);
+					const __m128i d16 = k ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+					if(opacity < 255) {
+						s16 = Div255_epu16(_mm_mullo_epi16(s16, vop));
+					}
+					const __m128i na16 = _mm_sub_epi16(v255, BroadcastAlpha_epi16(s16));
+					result[k] = _mm_add_epi16(s16, Div255_epu16(_mm_mullo_epi16(d16, na16)));
+				}
+				_mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_packus_epi16(result[0], result[1]));
+			}
+			else if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(d, alpha_mask), alpha_mask)) == 0xFFFF) {
+				// straight alpha over an opaque background : o = (s * as + d * (255 - as)) / 255
+				__m128i result[2];
+				for(int k = 0; k < 2; k++) {
+					const __m128i s16 = k ? _mm_unpackhi_epi8(s, zero) : _mm_unpacklo_epi8(s, zero);
+					const __m128i d16 = k ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+					__m128i a16 = BroadcastAlpha_epi16(s16);
+					if(opacity < 255) {
+						a16 = Div255_epu16(_mm_mullo_epi16(a16, vop));
+					}
+					result[k] = Div255_epu16(_mm_add_epi16(_mm_mullo_epi16(s16, a16), _mm_mullo_epi16(d16, _mm_sub_epi16(v255, a16))));
+				}
+				// the background stays opaque
+				_mm_storeu_si128((__m128i*)(dst + 4 * x), _mm_or_si128(_mm_packus_epi16(result[0], result[1]), alpha_mask));
+			}
+			else {
+				for(unsigned k = 0; k < 4; k++) {
+					CompositePixel8(dst + 4 * (x + k), src + 4 * (x + k), mode, premultiplied, opacity);
+				}
+			}
+		}
+	}
+#endif // FI_COMPOSITE_SSE2
+
+	for(; x < width_in_pixels; x++) {
+		if(premultiplied && (mode == FIBM_SRC_OVER)) {
+			// same arithmetic as the vector path
+			BYTE *d = dst + 4 * x;
+			const BYTE *s = src + 4 * x;
+			unsigned sv[4];
+			for(int c = 0; c < 4; c++) {
+				sv[c] = (opacity < 255) ? Mul255(s[c], opacity) : s[c];
+			}
+			const unsigned na = 255 - sv[FI_RGBA_ALPHA];
+			for(int c = 0; c < 4; c++) {
+				d[c] = (BYTE)MIN(sv[c] + Mul255(d[c], na), (unsigned)255);
+			}
+		} else {
+			CompositePixel8(dst + 4 * x, src + 4 * x, mode, premultiplied, opacity);
+		}
+	}
+}
+
+// ----------------------------------------------------------
+//   Porter-Duff kernels, float
+// ----------------------------------------------------------
+
+/**
+Composite a line of RGBAF src pixels over a line of RGBAF dst pixels
+@param opacity Global opacity applied to src, in [0..1]
+*/
+static void
+CompositeLineF(FIRGBAF *dst, const FIRGBAF *src, unsigned width_in_pixels, FREE_IMAGE_BLEND_MODE mode, BOOL premultiplied, float opacity) {
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		FIRGBAF &d = dst[x];
+		const FIRGBAF &s = src[x];
+
+		const float as = s.alpha * opacity;
+		const float ab = d.alpha;
+		const float ks = premultiplied ? opacity : as;	// factor applied to src colors
+		const float kb = premultiplied ? 1.0F : ab;		// factor applied to dst colors
+
+		float cs[3] = { s.red * ks, s.green * ks, s.blue * ks };
+		float cb[3] = { d.red * kb, d.green * kb, d.blue * kb };
+		float co[3];
+
+		for(int c = 0; c < 3; c++) {
+			float b;
+			switch(mode) {
+				case FIBM_MULTIPLY:
+					b = cs[c] * cb[c];
+					break;
+				case FIBM_SCREEN:
+					b = cs[c] * ab + cb[c] * as - cs[c] * cb[c];
+					break;
+				case FIBM_SRC_OVER:
+				default:
+					b = cs[c] * ab;
+					break;
+			}
+			co[c] = cs[c] * (1 - ab) + cb[c] * (1 - as) + b;
+		}
+
+		const float ao = as + ab - as * ab;
+
+		if(premultiplied) {
+			d.red = co[0];
+			d.green = co[1];
+			d.blue = co[2];
+		} else {
+			const float inv = (ao > 0) ? 1 / ao : 0;
+			d.red = co[0] * inv;
+			d.green = co[1] * inv;
+			d.blue = co[2] * inv;
+		}
+		d.alpha = ao;
+	}
+}
+
+// ----------------------------------------------------------
+//   Line expansion helpers
+// ----------------------------------------------------------
+
+static void
+ConvertLineRGBFToRGBAF(FIRGBAF *dst, const FIRGBF *src, unsigned width_in_pixels) {
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		dst[x].red = src[x].red;
+		dst[x].green = src[x].green;
+		dst[x].blue = src[x].blue;
+		dst[x].alpha = 1.0F;
+	}
+}
+
+static void
+ConvertLineRGBAFToRGBF(FIRGBF *dst, const FIRGBAF *src, unsigned width_in_pixels) {
+	for(unsigned x = 0; x < width_in_pixels; x++) {
+		dst[x].red = src[x].red;
+		dst[x].green = src[x].green;
+		dst[x].blue = src[x].blue;
+	}
+}
+
+// ----------------------------------------------------------
+//   Porter-Duff compositing
+// ----------------------------------------------------------
+
+/** Arguments of FreeImage_AlphaComposite, run on bands of rows in parallel
+*/
+typedef struct tagALPHACOMPOSITEROWS {
+	FIBITMAP *dst;
+	FIBITMAP *src;
+	int left;
+	unsigned dst_y0;				//! first dst scanline covered by src
+	unsigned width;
+	FREE_IMAGE_BLEND_MODE mode;
+	BOOL premultiplied;
+	double opacity;
+	std::atomic<bool> failed;		//! TRUE if a band could not allocate its work lines
+} ALPHACOMPOSITEROWS;
+
+static void
+CompositeRows8(void *data, unsigned first, unsigned last) {
+	ALPHACOMPOSITEROWS *rows = (ALPHACOMPOSITEROWS*)data;
+	const unsigned width = rows->width;
+	const unsigned src_bpp = FreeImage_GetBPP(rows->src);
+	const unsigned dst_bpp = FreeImage_GetBPP(rows->dst);
+	const unsigned op8 = (unsigned)(rows->opacity * 255 + 0.5);
+
+	// 24-bit lines are expanded to 32-bit (opaque) work lines
+	BYTE *src_line = (src_bpp == 24) ? (BYTE*)malloc(width * 4) : NULL;
+	BYTE *dst_line = (dst_bpp == 24) ? (BYTE*)malloc(width * 4) : NULL;
+	if(((src_bpp == 24) && !src_line) || ((dst_bpp == 24) && !dst_line)) {
+		free(src_line);
+		free(dst_line);
+		rows->failed = true;
+		return;
+	}
+
+	for(unsigned y = first; y < last; y++) {
+		BYTE *src_bits = FreeImage_GetScanLine(rows->src, y);
+		BYTE *dst_bits = FreeImage_GetScanLine(rows->dst, rows->dst_y0 + y) + rows->left * (dst_bpp / 8);
+
+		const BYTE *s = src_bits;
+		if(src_line) {
+			FreeImage_ConvertLine24To32(src_line, src_bits, width);
+			s = src_line;
+		}
+		if(dst_line) {
+			FreeImage_ConvertLine24To32(dst_line, dst_bits, width);
+			CompositeLine8(dst_line, s, width, rows->mode, rows->premultiplied, op8);
+			FreeImage_ConvertLine32To24(dst_bits, dst_line, width);
+		} else {
+			CompositeLine8(dst_bits, s, width, rows->mode, rows->premultiplied, op8);
+		}
+	}
+
+	free(src_line);
+	free(dst_line);
+}
+
+static void
+CompositeRowsF(void *data, unsigned first, unsigned last) {
+	ALPHACOMPOSITEROWS *rows = (ALPHACOMPOSITEROWS*)data;
+	const unsigned width = rows->width;
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(rows->src);
+	const FREE_IMAGE_TYPE dst_type = FreeImage_GetImageType(rows->dst);
+
+	// RGBF lines are expanded to RGBAF (opaque) work lines
+	FIRGBAF *src_line = (src_type == FIT_RGBF) ? (FIRGBAF*)malloc(width * sizeof(FIRGBAF)) : NULL;
+	FIRGBAF *dst_line = (dst_type == FIT_RGBF) ? (FIRGBAF*)malloc(width * sizeof(FIRGBAF)) : NULL;
+	if(((src_type == FIT_RGBF) && !src_line) || ((dst_type == FIT_RGBF) && !dst_line)) {
+		free(src_line);
+		free(dst_line);
+		rows->failed = true;
+		return;
+	}
+
+	for(unsigned y = first; y < last; y++) {
+		BYTE *src_bits = FreeImage_GetScanLine(rows->src, y);
+		BYTE *dst_bits = FreeImage_GetScanLine(rows->dst, rows->dst_y0 + y);
+
+		const FIRGBAF *s = (const FIRGBAF*)src_bits;
+		if(src_line) {
+			ConvertLineRGBFToRGBAF(src_line, (const FIRGBF*)src_bits, width);
+			s = src_line;
+		}
+		if(dst_line) {
+			FIRGBF *d = (FIRGBF*)dst_bits + rows->left;
+			ConvertLineRGBFToRGBAF(dst_line, d, width);
+			CompositeLineF(dst_line, s, width, rows->mode, rows->premultiplied, (float)rows->opacity);
+			ConvertLineRGBAFToRGBF(d, dst_line, width);
+		} else {
+			CompositeLineF((FIRGBAF*)dst_bits + rows->left, s, width, rows->mode, rows->premultiplied, (float)rows->opacity);
+		}
+	}
+
+	free(src_line);
+	free(dst_line);
+}
+
+/**
+Composite a src image over a dst image, using Porter-Duff src-over with an optional blend mode.
+
+Supported combinations are 24- or 32-bit FIT_BITMAP src over 24- or 32-bit FIT_BITMAP dst,
+and FIT_RGBF or FIT_RGBAF src over FIT_RGBF or FIT_RGBAF dst. Images without alpha are treated as opaque.
+
+@param dst Destination image, modified in place
+@param src Source image
+@param left Left position of src in dst
+@param top Top position of src in dst
+@param mode Blend mode
+@param premultiplied If TRUE, both images store premultiplied colors, otherwise straight colors
+@param opacity Global opacity of src, in [0..1]
+@return Returns TRUE if successful, FALSE otherwise
+@see FreeImage_Paste, FreeImage_PreMultiplyWithAlpha
+*/
+BOOL DLL_CALLCONV
+FreeImage_AlphaComposite(FIBITMAP *dst, FIBITMAP *src, int left, int top, FREE_IMAGE_BLEND_MODE mode, BOOL premultiplied, double opacity) {
+	if(!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst)) return FALSE;
+
+	if((mode != FIBM_SRC_OVER) && (mode != FIBM_MULTIPLY) && (mode != FIBM_SCREEN)) {
+		return FALSE;
+	}
+
+	// check the size of src image
+	if((left < 0) || (top < 0)) {
+		return FALSE;
+	}
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	if((left + width > FreeImage_GetWidth(dst)) || (top + height > FreeImage_GetHeight(dst))) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(src);
+	const FREE_IMAGE_TYPE dst_type = FreeImage_GetImageType(dst);
+	const unsigned src_bpp = FreeImage_GetBPP(src);
+	const unsigned dst_bpp = FreeImage_GetBPP(dst);
+
+	BOOL bIsStandard = FALSE;
+	if((src_type == FIT_BITMAP) && (dst_type == FIT_BITMAP)) {
+		if(((src_bpp != 24) && (src_bpp != 32)) || ((dst_bpp != 24) && (dst_bpp != 32))) {
+			return FALSE;
+		}
+		bIsStandard = TRUE;
+	}
+	else if(((src_type != FIT_RGBF) && (src_type != FIT_RGBAF)) || ((dst_type != FIT_RGBF) && (dst_type != FIT_RGBAF))) {
+		return FALSE;
+	}
+
+	opacity = CLAMP(opacity, 0.0, 1.0);
+
+	// first dst scanline covered by src (scanlines are bottom-up)
+	const unsigned dst_y0 = FreeImage_GetHeight(dst) - height - top;
+
+	ALPHACOMPOSITEROWS rows = { dst, src, left, dst_y0, width, mode, premultiplied, opacity };
+	rows.failed = false;
+
+	// composite bands of rows on the worker pool
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), bIsStandard ? CompositeRows8 : CompositeRowsF, &rows)) {
+		return FALSE;
+	}
+
+	return rows.failed ? FALSE : TRUE;
+}
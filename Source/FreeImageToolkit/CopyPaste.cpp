@@ -25,11 +25,41 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
 
 // ----------------------------------------------------------
 //   Helpers
 // ----------------------------------------------------------
 
+/** Arguments of a constant alpha blend run on bands of rows in parallel
+*/
+typedef struct tagBLENDROWS {
+	BYTE *dst_bits;
+	const BYTE *src_bits;
+	unsigned dst_pitch;
+	unsigned src_pitch;
+	unsigned line;		//! number of bytes to blend per row
+	unsigned alpha;
+} BLENDROWS;
+
+static void
+BlendRows(void *data, unsigned first, unsigned last) {
+	const BLENDROWS *rows = (BLENDROWS*)data;
+	for(unsigned y = first; y < last; y++) {
+		BlendLineConstant(rows->dst_bits + (size_t)y * rows->dst_pitch, rows->src_bits + (size_t)y * rows->src_pitch, rows->line, rows->alpha);
+	}
+}
+
+/**
+Blend the rows of a src image into a dst image with a constant alpha, on the worker pool
+@return Returns FALSE if the blend was cancelled
+*/
+static BOOL
+BlendImage(BYTE *dst_bits, FIBITMAP *dst_dib, BYTE *src_bits, FIBITMAP *src_dib, unsigned alpha) {
+	const BLENDROWS rows = { dst_bits, src_bits, FreeImage_GetPitch(dst_dib), FreeImage_GetPitch(src_dib), FreeImage_GetLine(src_dib), alpha };
+	return FreeImage_ParallelFor(FreeImage_GetHeight(src_dib), FreeImage_GetRowChunk(rows.line), BlendRows, (void*)&rows);
+}
+
 /////////////////////////////////////////////////////////////
 // Alpha blending / combine functions
 
@@ -218,14 +248,7 @@ Combine8(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		}
 	} else {
 		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
+		return BlendImage(dst_bits, dst_dib, src_bits, src_dib, alpha);
 	}
 
 	return TRUE;
@@ -384,14 +407,7 @@ Combine24(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		}
 	} else {
 		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
+		return BlendImage(dst_bits, dst_dib, src_bits, src_dib, alpha);
 	}
 
 	return TRUE;
@@ -426,14 +442,7 @@ Combine32(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		}
 	} else {
 		// alpha blend images
-		for(unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for(unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {
-				dst_bits[cols] = (BYTE)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
+		return BlendImage(dst_bits, dst_dib, src_bits, src_dib, alpha);
 	}
 
 	return TRUE;
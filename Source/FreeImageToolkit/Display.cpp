@@ -19,8 +19,131 @@
 // Use at your own risk!
 // ==========================================================
 
+#include <atomic>
+
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+// ----------------------------------------------------------
+
+/** Arguments of FreeImage_Composite, run on bands of rows in parallel
+*/
+typedef struct tagCOMPOSITEROWS {
+	FIBITMAP *fg;
+	FIBITMAP *bg;
+	FIBITMAP *composite;
+	int width;
+	int bpp;
+	RGBQUAD *pal;
+	BOOL bIsTransparent;
+	BYTE *trns;
+	BOOL bHasBkColor;
+	RGBQUAD bkc;					//! background color
+	std::atomic<bool> failed;		//! TRUE if a band could not allocate its work lines
+} COMPOSITEROWS;
+
+static void
+CompositeRows(void *data, unsigned first, unsigned last) {
+	COMPOSITEROWS *rows = (COMPOSITEROWS*)data;
+	const int width = rows->width;
+	int x, c;
+
+	// work lines : 32-bit foreground and 32-bit background / result
+	BYTE *fg_line = (BYTE*)malloc(width * 4 * sizeof(BYTE));
+	BYTE *bk_line = (BYTE*)malloc(width * 4 * sizeof(BYTE));
+	if(!fg_line || !bk_line) {
+		free(fg_line);
+		free(bk_line);
+		rows->failed = true;
+		return;
+	}
+
+	for(int y = (int)first; y < (int)last; y++) {
+		// foreground
+		BYTE *fg_bits = FreeImage_GetScanLine(rows->fg, y);
+		// composite image
+		BYTE *cp_bits = FreeImage_GetScanLine(rows->composite, y);
+
+		// foreground color + alpha
+
+		const BYTE *fg32 = fg_bits;
+		if(rows->bpp == 8) {
+			BYTE *p = fg_line;
+			for(x = 0; x < width; x++, p += 4) {
+				const BYTE index = fg_bits[x];
+				p[FI_RGBA_BLUE]  = rows->pal[index].rgbBlue;
+				p[FI_RGBA_GREEN] = rows->pal[index].rgbGreen;
+				p[FI_RGBA_RED]   = rows->pal[index].rgbRed;
+				p[FI_RGBA_ALPHA] = rows->bIsTransparent ? rows->trns[index] : 255;
+			}
+			fg32 = fg_line;
+		}
+
+		// background color
+
+		if(rows->bHasBkColor) {
+			BYTE *p = bk_line;
+			for(x = 0; x < width; x++, p += 4) {
+				p[FI_RGBA_BLUE]  = rows->bkc.rgbBlue;
+				p[FI_RGBA_GREEN] = rows->bkc.rgbGreen;
+				p[FI_RGBA_RED]   = rows->bkc.rgbRed;
+			}
+		}
+		else if(rows->bg) {
+			// get the background color from the background image
+			FreeImage_ConvertLine24To32(bk_line, FreeImage_GetScanLine(rows->bg, y), width);
+		}
+		else {
+			// use a checkerboard pattern
+			BYTE *p = bk_line;
+			for(x = 0; x < width; x++, p += 4) {
+				c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
+				c = c ? c : 255;
+				p[FI_RGBA_BLUE]  = (BYTE)c;
+				p[FI_RGBA_GREEN] = (BYTE)c;
+				p[FI_RGBA_RED]   = (BYTE)c;
+			}
+		}
+
+		// composition : output = alpha * foreground + (1-alpha) * background
+
+		CompositeLineOverBackground(bk_line, fg32, bk_line, width);
+		FreeImage_ConvertLine32To24(cp_bits, bk_line, width);
+	}
+
+	free(fg_line);
+	free(bk_line);
+}
+
+/**
+Premultiply (or unpremultiply) bands of rows of a 32-bit, FIT_RGBA16 or FIT_RGBAF image
+*/
+template <BOOL bPremultiply> static void
+PreMultiplyRows(void *data, unsigned first, unsigned last) {
+	FIBITMAP *dib = (FIBITMAP*)data;
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned width = FreeImage_GetWidth(dib);
+
+	for(unsigned y = first; y < last; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib, y);
+		switch(image_type) {
+			case FIT_BITMAP:
+				bPremultiply ? PreMultiplyLine32(bits, width) : UnPreMultiplyLine32(bits, width);
+				break;
+			case FIT_RGBA16:
+				bPremultiply ? PreMultiplyLineRGBA16((FIRGBA16*)bits, width) : UnPreMultiplyLineRGBA16((FIRGBA16*)bits, width);
+				break;
+			case FIT_RGBAF:
+				bPremultiply ? PreMultiplyLineRGBAF((FIRGBAF*)bits, width) : UnPreMultiplyLineRGBAF((FIRGBAF*)bits, width);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+// ----------------------------------------------------------
 
 
 /**
@@ -57,125 +180,49 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 			return NULL;
 	}
 
-	int bytespp = (bpp == 8) ? 1 : 4;
-
-	
-	int x, y, c;
-	BYTE alpha = 0, not_alpha;
-	BYTE index;
-	RGBQUAD fgc;	// foreground color
-	RGBQUAD bkc;	// background color
-
-	memset(&fgc, 0, sizeof(RGBQUAD));
-	memset(&bkc, 0, sizeof(RGBQUAD));
+	COMPOSITEROWS rows;
+	memset(&rows.bkc, 0, sizeof(RGBQUAD));
+	rows.fg = fg;
+	rows.bg = bg;
+	rows.width = width;
+	rows.bpp = bpp;
+	rows.failed = false;
 
 	// allocate the composite image
 	FIBITMAP *composite = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 	if(!composite) return NULL;
+	rows.composite = composite;
 
 	// get the palette
-	RGBQUAD *pal = FreeImage_GetPalette(fg);
+	rows.pal = FreeImage_GetPalette(fg);
 
 	// retrieve the alpha table from the foreground image
-	BOOL bIsTransparent = FreeImage_IsTransparent(fg);
-	BYTE *trns = FreeImage_GetTransparencyTable(fg);
+	rows.bIsTransparent = FreeImage_IsTransparent(fg);
+	rows.trns = FreeImage_GetTransparencyTable(fg);
 
 	// retrieve the background color from the foreground image
-	BOOL bHasBkColor = FALSE;
+	rows.bHasBkColor = FALSE;
 
 	if(useFileBkg && FreeImage_HasBackgroundColor(fg)) {
-		FreeImage_GetBackgroundColor(fg, &bkc);
-		bHasBkColor = TRUE;
+		FreeImage_GetBackgroundColor(fg, &rows.bkc);
+		rows.bHasBkColor = TRUE;
 	} else {
 		// no file background color
 		// use application background color ?
 		if(appBkColor) {
-			memcpy(&bkc, appBkColor, sizeof(RGBQUAD));
-			bHasBkColor = TRUE;
+			memcpy(&rows.bkc, appBkColor, sizeof(RGBQUAD));
+			rows.bHasBkColor = TRUE;
 		}
 		// use background image ?
 		else if(bg) {
-			bHasBkColor = FALSE;
+			rows.bHasBkColor = FALSE;
 		}
 	}
 
-	for(y = 0; y < height; y++) {
-		// foreground
-		BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
-		// background
-		BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
-		// composite image
-		BYTE *cp_bits = FreeImage_GetScanLine(composite, y);
-
-		for(x = 0; x < width; x++) {
-
-			// foreground color + alpha
-
-			if(bpp == 8) {
-				// get the foreground color
-				index = fg_bits[0];
-				memcpy(&fgc, &pal[index], sizeof(RGBQUAD));
-				// get the alpha
-				if(bIsTransparent) {
-					alpha = trns[index];
-				} else {
-					alpha = 255;
-				}
-			}
-			else if(bpp == 32) {
-				// get the foreground color
-				fgc.rgbBlue  = fg_bits[FI_RGBA_BLUE];
-				fgc.rgbGreen = fg_bits[FI_RGBA_GREEN];
-				fgc.rgbRed   = fg_bits[FI_RGBA_RED];
-				// get the alpha
-				alpha = fg_bits[FI_RGBA_ALPHA];
-			}
-
-			// background color
-
-			if(!bHasBkColor) {
-				if(bg) {
-					// get the background color from the background image
-					bkc.rgbBlue  = bg_bits[FI_RGBA_BLUE];
-					bkc.rgbGreen = bg_bits[FI_RGBA_GREEN];
-					bkc.rgbRed   = bg_bits[FI_RGBA_RED];
-				}
-				else {
-					// use a checkerboard pattern
-					c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
-					c = c ? c : 255;
-					bkc.rgbBlue  = (BYTE)c;
-					bkc.rgbGreen = (BYTE)c;
-					bkc.rgbRed   = (BYTE)c;
-				}
-			}
-
-			// composition
-
-			if(alpha == 0) {
-				// output = background
-				cp_bits[FI_RGBA_BLUE] = bkc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = bkc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = bkc.rgbRed;
-			}
-			else if(alpha == 255) {
-				// output = foreground
-				cp_bits[FI_RGBA_BLUE] = fgc.rgbBlue;
-				cp_bits[FI_RGBA_GREEN] = fgc.rgbGreen;
-				cp_bits[FI_RGBA_RED] = fgc.rgbRed;
-			}
-			else {
-				// output = alpha * foreground + (1-alpha) * background
-				not_alpha = (BYTE)~alpha;
-				cp_bits[FI_RGBA_BLUE] = (BYTE)((alpha * (WORD)fgc.rgbBlue  + not_alpha * (WORD)bkc.rgbBlue) >> 8);
-				cp_bits[FI_RGBA_GREEN] = (BYTE)((alpha * (WORD)fgc.rgbGreen + not_alpha * (WORD)bkc.rgbGreen) >> 8);
-				cp_bits[FI_RGBA_RED] = (BYTE)((alpha * (WORD)fgc.rgbRed   + not_alpha * (WORD)bkc.rgbRed) >> 8);
-			}
-
-			fg_bits += bytespp;
-			bg_bits += 3;
-			cp_bits += 3;
-		}
+	// composite bands of rows on the worker pool
+	if(!FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), CompositeRows, &rows) || rows.failed) {
+		FreeImage_Unload(composite);
+		return NULL;
 	}
 
 	// copy metadata from src to dst
@@ -185,46 +232,45 @@ FreeImage_Composite(FIBITMAP *fg, BOOL useFileBkg, RGBQUAD *appBkColor, FIBITMAP
 }
 
 /**
-Pre-multiplies a 32-bit image's red-, green- and blue channels with it's alpha channel 
+Pre-multiplies a 32-bit, FIT_RGBA16 or FIT_RGBAF image's red-, green- and blue channels with it's alpha channel 
 for to be used with e.g. the Windows GDI function AlphaBlend(). 
 The transformation changes the red-, green- and blue channels according to the following equation:  
 channel(x, y) = channel(x, y) * alpha_channel(x, y) / 255  
+(with 255 replaced by 65535 for FIT_RGBA16 images and by 1 for FIT_RGBAF images)
 @param dib Input/Output dib to be premultiplied
 @return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
+@see FreeImage_UnPreMultiplyWithAlpha
 */
 BOOL DLL_CALLCONV 
 FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
 	if (!FreeImage_HasPixels(dib)) return FALSE;
-	
-	if ((FreeImage_GetBPP(dib) != 32) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	if (!((image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) == 32)) && (image_type != FIT_RGBA16) && (image_type != FIT_RGBAF)) {
 		return FALSE;
 	}
 
-	int width = FreeImage_GetWidth(dib);
-	int height = FreeImage_GetHeight(dib);
+	return FreeImage_ParallelFor(FreeImage_GetHeight(dib), FreeImage_GetRowChunk(FreeImage_GetWidth(dib)), PreMultiplyRows<TRUE>, dib);
+}
 
-	for(int y = 0; y < height; y++) {
-		BYTE *bits = FreeImage_GetScanLine(dib, y);
-		for (int x = 0; x < width; x++, bits += 4) {
-			const BYTE alpha = bits[FI_RGBA_ALPHA];
-			// slightly faster: care for two special cases
-			if(alpha == 0x00) {
-				// special case for alpha == 0x00
-				// color * 0x00 / 0xFF = 0x00
-				bits[FI_RGBA_BLUE] = 0x00;
-				bits[FI_RGBA_GREEN] = 0x00;
-				bits[FI_RGBA_RED] = 0x00;
-			} else if(alpha == 0xFF) {
-				// nothing to do for alpha == 0xFF
-				// color * 0xFF / 0xFF = color
-				continue;
-			} else {
-				bits[FI_RGBA_BLUE] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_BLUE] + 127) / 255 );
-				bits[FI_RGBA_GREEN] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_GREEN] + 127) / 255 );
-				bits[FI_RGBA_RED] = (BYTE)( (alpha * (WORD)bits[FI_RGBA_RED] + 127) / 255 );
-			}
-		}
+/**
+Reverts FreeImage_PreMultiplyWithAlpha on a 32-bit, FIT_RGBA16 or FIT_RGBAF image, 
+i.e. divides the red-, green- and blue channels by the alpha channel : 
+channel(x, y) = channel(x, y) * 255 / alpha_channel(x, y)  
+Color channels of fully transparent pixels are set to 0. 
+@param dib Input/Output dib to be unpremultiplied
+@return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
+@see FreeImage_PreMultiplyWithAlpha
+*/
+BOOL DLL_CALLCONV 
+FreeImage_UnPreMultiplyWithAlpha(FIBITMAP *dib) {
+	if (!FreeImage_HasPixels(dib)) return FALSE;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	if (!((image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) == 32)) && (image_type != FIT_RGBA16) && (image_type != FIT_RGBAF)) {
+		return FALSE;
 	}
-	return TRUE;
+
+	return FreeImage_ParallelFor(FreeImage_GetHeight(dib), FreeImage_GetRowChunk(FreeImage_GetWidth(dib)), PreMultiplyRows<FALSE>, dib);
 }
 
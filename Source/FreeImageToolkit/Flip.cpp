@@ -23,6 +23,98 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FI_FLIP_SSE2
+#endif
+
+#if defined(FI_FLIP_SSE2)
+/**
+Reverse the order of the pixels held in a 16-byte vector
+@param v Input vector
+@param bytespp Number of bytes per pixel (1, 2, 4, 8 or 16)
+*/
+static inline __m128i
+ReversePixels(__m128i v, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+		case 2:
+			// reverse dwords, then words inside dwords
+			v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+			v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+			if(bytespp == 1) {
+				// then bytes inside words
+				v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			}
+			return v;
+		case 4:
+			return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+		case 8:
+			return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+		default:
+			return v;
+	}
+}
+#endif // FI_FLIP_SSE2
+
+/**
+Mirror a line of 8-bit or wider pixels in place, swapping pixels from both ends of the line
+@param bits Input / Output line
+@param width Line width in pixels
+@param bytespp Number of bytes per pixel
+*/
+static void
+MirrorLine(BYTE *bits, unsigned width, unsigned bytespp) {
+	unsigned left = 0;
+	unsigned right = width;	// exclusive
+
+#if defined(FI_FLIP_SSE2)
+	if((16 % bytespp) == 0) {
+		// swap 16-byte blocks taken from both ends of the line, reversed in registers
+		const unsigned n = 16 / bytespp;
+		while(right - left >= 2 * n) {
+			BYTE *l = bits + left * bytespp;
+			BYTE *r = bits + (right - n) * bytespp;
+			const __m128i vl = _mm_loadu_si128((const __m128i*)l);
+			const __m128i vr = _mm_loadu_si128((const __m128i*)r);
+			_mm_storeu_si128((__m128i*)l, ReversePixels(vr, bytespp));
+			_mm_storeu_si128((__m128i*)r, ReversePixels(vl, bytespp));
+			left += n;
+			right -= n;
+		}
+	}
+#endif
+
+	BYTE tmp[16];
+	while(right - left >= 2) {
+		right--;
+		BYTE *l = bits + left * bytespp;
+		BYTE *r = bits + right * bytespp;
+		AssignPixel(tmp, l, bytespp);
+		AssignPixel(l, r, bytespp);
+		AssignPixel(r, tmp, bytespp);
+		left++;
+	}
+}
+
+/** Arguments of a mirror run on bands of rows in parallel
+*/
+typedef struct tagMIRRORROWS {
+	FIBITMAP *dib;
+	unsigned width;
+	unsigned bytespp;
+} MIRRORROWS;
+
+static void
+MirrorRows(void *data, unsigned first, unsigned last) {
+	const MIRRORROWS *rows = (MIRRORROWS*)data;
+	for(unsigned y = first; y < last; y++) {
+		MirrorLine(FreeImage_GetScanLine(rows->dib, y), rows->width, rows->bytespp);
+	}
+}
 
 /**
 Flip the image horizontally along the vertical axis.
@@ -37,8 +129,15 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 	unsigned width	= FreeImage_GetWidth(src);
 	unsigned height = FreeImage_GetHeight(src);
 
+	const unsigned bpp = FreeImage_GetBPP(src);
 	unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 
+	if (bpp >= 8) {
+		// mirror the buffer in place, on bands of rows
+		const MIRRORROWS rows = { src, width, bytespp };
+		return FreeImage_ParallelFor(height, FreeImage_GetRowChunk(width), MirrorRows, (void*)&rows);
+	}
+
 	// copy between aligned memories
 	BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
 	if (!new_bits) return FALSE;
@@ -49,7 +148,7 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 		BYTE *bits = FreeImage_GetScanLine(src, y);
 		memcpy(new_bits, bits, line);
 
-		switch (FreeImage_GetBPP(src)) {
+		switch (bpp) {
 			case 1 :
 			{				
 				for(unsigned x = 0; x < width; x++) {
@@ -74,45 +173,6 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 				}
 			}
 			break;
-
-			case 8:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 16:
-			{				
-				WORD *dst_data = (WORD*) bits; 				
-				WORD *src_data = (WORD*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
-
-			case 24 :
-			case 32 :
-			case 48:
-			case 64:
-			case 96:
-			case 128:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 		
-					for(unsigned k = 0; k < bytespp; k++) {
-						*dst_data++ = src_data[k];  
-					}
-					src_data -= bytespp;
-				} 
-			}
-			break;
-
 		}
 	}
 
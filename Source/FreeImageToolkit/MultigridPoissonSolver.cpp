@@ -25,6 +25,7 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "ThreadPool.h"
 
 static const int NPRE	= 1;		// Number of relaxation sweeps before ...
 static const int NPOST	= 1;		// ... and after the coarse-grid correction is computed
@@ -307,6 +308,10 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 	
 	int ng = 0;		// number of allocated grids
 
+	// progress is measured in relaxations of a grid point : a step of a V-cycle
+	// on a grid of n x n points weights n x n, the coarsest grids are neglected
+	double work = 0, work_done = 0;
+
 // --------------------------------------------------------------------------
 
 #define _CREATE_ARRAY_GRID_(array, array_size) \
@@ -379,6 +384,14 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 
 		ngrid = ng;
 
+		for (j = 1, nn = 3; j < ngrid; j++) {
+			nn = 2*nn - 1;
+			for (jj = j, nf = nn; jj >= 1; jj--, nf = nf/2 + 1) {
+				work += 2.0 * ncycle * nf * nf;
+			}
+		}
+		nn = 3;
+
 		// nested iteration loop
 		for (j = 1; j < ngrid; j++) {
 			nn = 2*nn - 1;
@@ -402,6 +415,8 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 				nf = nn;
 				// downward stoke of the V
 				for (jj = j; jj >= 1; jj--) {
+					if (!FreeImage_ReportProgress(work_done / work)) throw(1);
+					work_done += (double)nf * nf;
 					// pre-smoothing
 					for (jpre = 0; jpre < NPRE; jpre++) {
 						fmg_relaxation(IU[jj], IRHS[jj], nf);
@@ -419,6 +434,8 @@ static BOOL fmg_mglin(FIBITMAP *U, int n, int ncycle) {
 				// upward stroke of V.
 				for (jj = 1; jj <= j; jj++) { 
 					nf = 2*nf - 1;
+					if (!FreeImage_ReportProgress(work_done / work)) throw(1);
+					work_done += (double)nf * nf;
 					// use res for temporary storage inside addint
 					fmg_addint(IU[jj], IU[jj-1], IRES[jj], nf);				
 					// post-smoothing
@@ -460,7 +477,7 @@ NB: The input image is first stored inside a square image whose size is (2^j + 1
 where j is such that 2^j is the nearest larger dimension corresponding to MAX(image width, image height). 
 @param Laplacian Laplacian image
 @param ncycle Number of cycles in the multigrid algorithm (usually 2 or 3)
-@return Returns the solved PDE equations if successful, returns NULL otherwise
+@return Returns the solved PDE equations if successful, returns NULL otherwise (e.g. when cancelled, see FreeImage_SetProgressHandler)
 */
 FIBITMAP* DLL_CALLCONV 
 FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle) {
@@ -487,7 +504,10 @@ FreeImage_MultigridPoissonSolver(FIBITMAP *Laplacian, int ncycle) {
 	FreeImage_Paste(I, Laplacian, 1, 1, 255);
 
 	// solve the PDE equation
-	fmg_mglin(I, size, ncycle);
+	if(!fmg_mglin(I, size, ncycle)) {
+		FreeImage_Unload(I);
+		return NULL;
+	}
 
 	// shift pixels back
 	FIBITMAP *U = FreeImage_Copy(I, 1, 1, width + 1, height + 1);
@@ -22,9 +22,28 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "ThreadPool.h"
 
 #include "half.h"
 
+/**
+Turns color sums accumulated with alpha weighted filter weights back into straight
+colors, i.e. divides them by the filtered alpha (see FI_RESCALE_PREMULTIPLY_ALPHA).
+A negative alpha (filter ringing) is kept as a divisor, so that a second filter pass
+recovers the premultiplied sums exactly. Colors are set to zero when alpha is zero.
+*/
+template <class T> static inline void
+UnweightColors(T &r, T &g, T &b, const T a) {
+	if (a != 0) {
+		const T f = 1 / a;
+		r *= f;
+		g *= f;
+		b *= f;
+	} else {
+		r = g = b = 0;
+	}
+}
+
 /**
 Returns the color type of a bitmap. In contrast to FreeImage_GetColorType,
 this function optionally supports a boolean OUT parameter, that receives TRUE,
@@ -236,6 +255,9 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 	const unsigned src_bpp = FreeImage_GetBPP(src);
 
+	// filter RGBA colors in premultiplied space (ignored for images without alpha)
+	m_bPremultiply = ((flags & FI_RESCALE_PREMULTIPLY_ALPHA) == FI_RESCALE_PREMULTIPLY_ALPHA) ? TRUE : FALSE;
+
 	// determine the image's color type
 	BOOL bIsGreyscale = FALSE;
 	FREE_IMAGE_COLOR_TYPE color_type;
@@ -362,6 +384,10 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	unsigned src_offset_x = src_left;
 	unsigned src_offset_y = FreeImage_GetHeight(src) - src_height - src_top;
 
+	// part of the progress covered by the first pass (all of it when there is a single pass)
+	const double first_pass = ((src_width != dst_width) && (src_height != dst_height)) ? 0.5 : 1;
+	BOOL bSuccess = TRUE;
+
 	/*
 	Decide which filtering order (xy or yx) is faster for this mapping. 
 	--- The theory ---
@@ -405,7 +431,8 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 
 			// scale source image horizontally into temporary (or destination) image
-			horizontalFilter(src, src_height, src_width, src_offset_x, src_offset_y, src_pal, tmp, dst_width);
+			ProgressStep step(0, first_pass);
+			bSuccess = horizontalFilter(src, src_height, src_width, src_offset_x, src_offset_y, src_pal, tmp, dst_width);
 
 			// set x and y offsets to zero for the second filter method
 			// invocation (the temporary image only contains the portion of
@@ -425,10 +452,11 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			tmp = src;
 		}
 
-		if (src_height != dst_height) {
+		if (bSuccess && (src_height != dst_height)) {
 			// source and destination heights are different so, scale
 			// temporary (or source) image vertically into destination image
-			verticalFilter(tmp, dst_width, src_height, src_offset_x, src_offset_y, src_pal, dst, dst_height);
+			ProgressStep step(1 - first_pass, 1);
+			bSuccess = verticalFilter(tmp, dst_width, src_height, src_offset_x, src_offset_y, src_pal, dst, dst_height);
 		}
 
 		// free temporary image, if not pointing to either src or dst
@@ -471,7 +499,8 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 
 			// scale source image vertically into temporary (or destination) image
-			verticalFilter(src, src_width, src_height, src_offset_x, src_offset_y, src_pal, tmp, dst_height);
+			ProgressStep step(0, first_pass);
+			bSuccess = verticalFilter(src, src_width, src_height, src_offset_x, src_offset_y, src_pal, tmp, dst_height);
 
 			// set x and y offsets to zero for the second filter method
 			// invocation (the temporary image only contains the portion of
@@ -492,10 +521,11 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			tmp = src;
 		}
 
-		if (src_width != dst_width) {
+		if (bSuccess && (src_width != dst_width)) {
 			// source and destination heights are different so, scale
 			// temporary (or source) image horizontally into destination image
-			horizontalFilter(tmp, dst_height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
+			ProgressStep step(1 - first_pass, 1);
+			bSuccess = horizontalFilter(tmp, dst_height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
 		}
 
 		// free temporary image, if not pointing to either src or dst
@@ -504,14 +534,40 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 		}
 	}
 
+	if (!bSuccess) {
+		// cancelled
+		FreeImage_Unload(dst);
+		return NULL;
+	}
+
 	return dst;
 } 
 
-void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
+/**
+Body of a parallel filtering pass : filter the rows (horizontal pass) or the columns
+(vertical pass) [first, last) of the pass
+*/
+void CResizeEngine::filterProc(void *data, unsigned first, unsigned last) {
+	const FilterPass *pass = (FilterPass*)data;
+	if (pass->bHorizontal) {
+		pass->engine->horizontalFilter(*pass->weightsTable, pass->src, first, last, pass->src_length, pass->src_offset_x, pass->src_offset_y, pass->src_pal, pass->dst, pass->dst_length);
+	} else {
+		pass->engine->verticalFilter(*pass->weightsTable, pass->src, pass->length, first, last, pass->src_length, pass->src_offset_x, pass->src_offset_y, pass->src_pal, pass->dst, pass->dst_length);
+	}
+}
+
+BOOL CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
 
 	// allocate and calculate the contributions
 	CWeightsTable weightsTable(m_pFilter, dst_width, src_width);
 
+	// filter bands of rows on the worker pool
+	const FilterPass pass = { this, &weightsTable, TRUE, src, height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width };
+	return FreeImage_ParallelFor(height, FreeImage_GetRowChunk(MAX(src_width, dst_width)), filterProc, (void*)&pass);
+}
+
+void CResizeEngine::horizontalFilter(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned first_row, unsigned last_row, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
+
 	// step through rows
 	switch(FreeImage_GetImageType(src)) {
 		case FIT_BITMAP:
@@ -526,7 +582,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -550,7 +606,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -583,7 +639,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							src_offset_x >>= 3;
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -614,7 +670,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -651,7 +707,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette here
 							src_offset_x >>= 3;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -668,12 +724,18 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										const double weight = weightsTable.getWeight(x, i - iLeft);
 										const unsigned pixel = (src_bits[i >> 3] & (0x80 >> (i & 0x07))) != 0;
 										const BYTE * const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										// colors are weighted by alpha when filtering in premultiplied space
+										const double cw = m_bPremultiply ? weight * entry[FI_RGBA_ALPHA] : weight;
+										r += (cw * (double)entry[FI_RGBA_RED]);
+										g += (cw * (double)entry[FI_RGBA_GREEN]);
+										b += (cw * (double)entry[FI_RGBA_BLUE]);
 										a += (weight * (double)entry[FI_RGBA_ALPHA]);
 									}
 
+									if (m_bPremultiply) {
+										UnweightColors(r, g, b, a);
+									}
+
 									// clamp and place result in destination pixel
 									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
 									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
@@ -697,7 +759,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -728,7 +790,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -766,7 +828,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// we always have got a palette for 4-bit images
 							src_offset_x >>= 1;
 
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -783,12 +845,18 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										const double weight = weightsTable.getWeight(x, i - iLeft);
 										const unsigned pixel = i & 0x01 ? src_bits[i >> 1] & 0x0F : src_bits[i >> 1] >> 4;
 										const BYTE * const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										// colors are weighted by alpha when filtering in premultiplied space
+										const double cw = m_bPremultiply ? weight * entry[FI_RGBA_ALPHA] : weight;
+										r += (cw * (double)entry[FI_RGBA_RED]);
+										g += (cw * (double)entry[FI_RGBA_GREEN]);
+										b += (cw * (double)entry[FI_RGBA_BLUE]);
 										a += (weight * (double)entry[FI_RGBA_ALPHA]);
 									}
 
+									if (m_bPremultiply) {
+										UnweightColors(r, g, b, a);
+									}
+
 									// clamp and place result in destination pixel
 									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
 									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
@@ -812,7 +880,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -837,7 +905,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE * const dst_bits = FreeImage_GetScanLine(dst, y);
@@ -869,7 +937,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -901,7 +969,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned y = 0; y < height; y++) {
+								for (unsigned y = first_row; y < last_row; y++) {
 									// scale each row
 									const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 									BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -937,7 +1005,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned y = 0; y < height; y++) {
+							for (unsigned y = first_row; y < last_row; y++) {
 								// scale each row
 								const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 								BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -955,12 +1023,18 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 										// accumulate weighted effect of each neighboring pixel
 										const double weight = weightsTable.getWeight(x, i);
 										const BYTE * const entry = (BYTE *)&src_pal[pixel[i]];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										// colors are weighted by alpha when filtering in premultiplied space
+										const double cw = m_bPremultiply ? weight * entry[FI_RGBA_ALPHA] : weight;
+										r += (cw * (double)entry[FI_RGBA_RED]);
+										g += (cw * (double)entry[FI_RGBA_GREEN]);
+										b += (cw * (double)entry[FI_RGBA_BLUE]);
 										a += (weight * (double)entry[FI_RGBA_ALPHA]);
 									}
 
+									if (m_bPremultiply) {
+										UnweightColors(r, g, b, a);
+									}
+
 									// clamp and place result in destination pixel
 									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
 									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
@@ -980,7 +1054,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 					// transparently convert the 16-bit non-transparent image to 24 bpp
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = first_row; y < last_row; y++) {
 							// scale each row
 							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1012,7 +1086,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						}
 					} else {
 						// image has 555 format
-						for (unsigned y = 0; y < height; y++) {
+						for (unsigned y = first_row; y < last_row; y++) {
 							// scale each row
 							const WORD * const src_bits = (WORD *)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x;
 							BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1049,7 +1123,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 24:
 				{
 					// scale the 24-bit non-transparent image into a 24 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					for (unsigned y = first_row; y < last_row; y++) {
 						// scale each row
 						const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 3;
 						BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1085,7 +1159,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 				case 32:
 				{
 					// scale the 32-bit transparent image into a 32 bpp destination image
-					for (unsigned y = 0; y < height; y++) {
+					for (unsigned y = first_row; y < last_row; y++) {
 						// scale each row
 						const BYTE * const src_bits = FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x * 4;
 						BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
@@ -1102,13 +1176,19 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 								// scan between boundaries
 								// accumulate weighted effect of each neighboring pixel
 								const double weight = weightsTable.getWeight(x, i);
-								r += (weight * (double)pixel[FI_RGBA_RED]);
-								g += (weight * (double)pixel[FI_RGBA_GREEN]);
-								b += (weight * (double)pixel[FI_RGBA_BLUE]);
+								// colors are weighted by alpha when filtering in premultiplied space
+								const double cw = m_bPremultiply ? weight * pixel[FI_RGBA_ALPHA] : weight;
+								r += (cw * (double)pixel[FI_RGBA_RED]);
+								g += (cw * (double)pixel[FI_RGBA_GREEN]);
+								b += (cw * (double)pixel[FI_RGBA_BLUE]);
 								a += (weight * (double)pixel[FI_RGBA_ALPHA]);
 								pixel += 4;
 							}
 
+							if (m_bPremultiply) {
+								UnweightColors(r, g, b, a);
+							}
+
 							// clamp and place result in destination pixel
 							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
 							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
@@ -1128,7 +1208,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
@@ -1162,7 +1242,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
@@ -1200,7 +1280,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const half *src_bits = (half*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				half *dst_bits = (half*)FreeImage_GetScanLine(dst, y);
@@ -1238,7 +1318,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const WORD *src_bits = (WORD*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				WORD *dst_bits = (WORD*)FreeImage_GetScanLine(dst, y);
@@ -1255,13 +1335,19 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						// scan between boundaries
 						// accumulate weighted effect of each neighboring pixel
 						const double weight = weightsTable.getWeight(x, i);						
-						r += (weight * (double)pixel[0]);
-						g += (weight * (double)pixel[1]);
-						b += (weight * (double)pixel[2]);
+						// colors are weighted by alpha when filtering in premultiplied space
+						const double cw = m_bPremultiply ? weight * pixel[3] : weight;
+						r += (cw * (double)pixel[0]);
+						g += (cw * (double)pixel[1]);
+						b += (cw * (double)pixel[2]);
 						a += (weight * (double)pixel[3]);
 						pixel += wordspp;
 					}
 
+					if (m_bPremultiply) {
+						UnweightColors(r, g, b, a);
+					}
+
 					// clamp and place result in destination pixel
 					dst_bits[0] = (WORD)CLAMP<int>((int)(r + 0.5), 0, 0xFFFF);
 					dst_bits[1] = (WORD)CLAMP<int>((int)(g + 0.5), 0, 0xFFFF);
@@ -1278,7 +1364,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
 			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
 
-			for (unsigned y = 0; y < height; y++) {
+			for (unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const half *src_bits = (half*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(WORD);
 				half *dst_bits = (half*)FreeImage_GetScanLine(dst, y);
@@ -1295,13 +1381,19 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						// scan between boundaries
 						// accumulate weighted effect of each neighboring pixel
 						const float weight = weightsTable.getWeight(x, i);						
-						r += (weight * pixel[0]);
-						g += (weight * pixel[1]);
-						b += (weight * pixel[2]);
+						// colors are weighted by alpha when filtering in premultiplied space
+						const float cw = m_bPremultiply ? weight * pixel[3] : weight;
+						r += (cw * pixel[0]);
+						g += (cw * pixel[1]);
+						b += (cw * pixel[2]);
 						a += (weight * pixel[3]);
 						pixel += wordspp;
 					}
 
+					if (m_bPremultiply) {
+						UnweightColors(r, g, b, a);
+					}
+
 					// clamp and place result in destination pixel
 					dst_bits[0] = r;
 					dst_bits[1] = g;
@@ -1319,8 +1411,9 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
 			const unsigned floatspp = (FreeImage_GetLine(src) / src_width) / sizeof(float);
+			const BOOL bPremultiply = m_bPremultiply && (floatspp == 4);
 
-			for(unsigned y = 0; y < height; y++) {
+			for(unsigned y = first_row; y < last_row; y++) {
 				// scale each row
 				const float *src_bits = (float*)FreeImage_GetScanLine(src, y + src_offset_y) + src_offset_x / sizeof(float);
 				float *dst_bits = (float*)FreeImage_GetScanLine(dst, y);
@@ -1337,11 +1430,17 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 						const double weight = weightsTable.getWeight(x, i-iLeft);
 
 						unsigned index = i * floatspp;	// pixel index
+						// colors are weighted by alpha when filtering in premultiplied space
+						const double cw = bPremultiply ? weight * src_bits[index + 3] : weight;
 						for (unsigned j = 0; j < floatspp; j++) {
-							value[j] += (weight * (double)src_bits[index++]);
+							value[j] += (((j < 3) ? cw : weight) * (double)src_bits[index++]);
 						}
 					}
 
+					if (bPremultiply) {
+						UnweightColors(value[0], value[1], value[2], value[3]);
+					}
+
 					// place result in destination pixel
 					for (unsigned j = 0; j < floatspp; j++) {
 						dst_bits[j] = (float)value[j];
@@ -1356,11 +1455,19 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 }
 
 /// Performs vertical image filtering
-void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
+BOOL CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
 
 	// allocate and calculate the contributions
 	CWeightsTable weightsTable(m_pFilter, dst_height, src_height);
 
+	// filter bands of columns on the worker pool, at least 64 columns wide
+	// so that two threads rarely write the same cache line
+	const FilterPass pass = { this, &weightsTable, FALSE, src, width, src_height, src_offset_x, src_offset_y, src_pal, dst, dst_height };
+	return FreeImage_ParallelFor(width, MAX(FreeImage_GetRowChunk(MAX(src_height, dst_height)), 64U), filterProc, (void*)&pass);
+}
+
+void CResizeEngine::verticalFilter(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned width, unsigned first_column, unsigned last_column, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
+
 	// step through columns
 	switch(FreeImage_GetImageType(src)) {
 		case FIT_BITMAP:
@@ -1380,7 +1487,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the 1-bit non-transparent greyscale image to 8 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 									const unsigned index = x >> 3;
@@ -1410,7 +1517,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 									const unsigned index = x >> 3;
@@ -1446,7 +1553,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 1-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 									const unsigned index = x >> 3;
@@ -1481,7 +1588,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 									const unsigned index = x >> 3;
@@ -1519,7 +1626,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 1-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_column; x < last_column; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 4;
 								const unsigned index = x >> 3;
@@ -1539,13 +1646,19 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 										const double weight = weightsTable.getWeight(y, i);
 										const unsigned pixel = (*src_bits & mask) != 0;
 										const BYTE * const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										// colors are weighted by alpha when filtering in premultiplied space
+										const double cw = m_bPremultiply ? weight * entry[FI_RGBA_ALPHA] : weight;
+										r += (cw * (double)entry[FI_RGBA_RED]);
+										g += (cw * (double)entry[FI_RGBA_GREEN]);
+										b += (cw * (double)entry[FI_RGBA_BLUE]);
 										a += (weight * (double)entry[FI_RGBA_ALPHA]);
 										src_bits += src_pitch;
 									}
 
+									if (m_bPremultiply) {
+										UnweightColors(r, g, b, a);
+									}
+
 									// clamp and place result in destination pixel
 									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
 									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
@@ -1570,7 +1683,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the non-transparent 4-bit greyscale image to 8 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_column; x < last_column; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x;
 								const unsigned index = x >> 1;
@@ -1603,7 +1716,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the non-transparent 4-bit image to 24 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_column; x < last_column; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 3;
 								const unsigned index = x >> 1;
@@ -1642,7 +1755,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 4-bit image to 32 bpp; 
 							// we always have got a palette for 4-bit images
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_column; x < last_column; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 4;
 								const unsigned index = x >> 1;
@@ -1661,13 +1774,19 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 										const double weight = weightsTable.getWeight(y, i);
 										const unsigned pixel = x & 0x01 ? *src_bits & 0x0F : *src_bits >> 4;
 										const BYTE *const entry = (BYTE *)&src_pal[pixel];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										// colors are weighted by alpha when filtering in premultiplied space
+										const double cw = m_bPremultiply ? weight * entry[FI_RGBA_ALPHA] : weight;
+										r += (cw * (double)entry[FI_RGBA_RED]);
+										g += (cw * (double)entry[FI_RGBA_GREEN]);
+										b += (cw * (double)entry[FI_RGBA_BLUE]);
 										a += (weight * (double)entry[FI_RGBA_ALPHA]);
 										src_bits += src_pitch;
 									}
 
+									if (m_bPremultiply) {
+										UnweightColors(r, g, b, a);
+									}
+
 									// clamp and place result in destination pixel
 									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
 									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
@@ -1693,7 +1812,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// scale the 8-bit non-transparent greyscale image into an 8 bpp destination image
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 
@@ -1719,7 +1838,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x;
 
@@ -1752,7 +1871,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 							// transparently convert the non-transparent 8-bit image to 24 bpp
 							if (src_pal) {
 								// we have got a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 
@@ -1784,7 +1903,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								}
 							} else {
 								// we do not have a palette
-								for (unsigned x = 0; x < width; x++) {
+								for (unsigned x = first_column; x < last_column; x++) {
 									// work on column x in dst
 									BYTE *dst_bits = dst_base + x * 3;
 
@@ -1819,7 +1938,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						{
 							// transparently convert the transparent 8-bit image to 32 bpp; 
 							// we always have got a palette here
-							for (unsigned x = 0; x < width; x++) {
+							for (unsigned x = first_column; x < last_column; x++) {
 								// work on column x in dst
 								BYTE *dst_bits = dst_base + x * 4;
 
@@ -1836,13 +1955,19 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 										// accumulate weighted effect of each neighboring pixel
 										const double weight = weightsTable.getWeight(y, i);
 										const BYTE * const entry = (BYTE *)&src_pal[*src_bits];
-										r += (weight * (double)entry[FI_RGBA_RED]);
-										g += (weight * (double)entry[FI_RGBA_GREEN]);
-										b += (weight * (double)entry[FI_RGBA_BLUE]);
+										// colors are weighted by alpha when filtering in premultiplied space
+										const double cw = m_bPremultiply ? weight * entry[FI_RGBA_ALPHA] : weight;
+										r += (cw * (double)entry[FI_RGBA_RED]);
+										g += (cw * (double)entry[FI_RGBA_GREEN]);
+										b += (cw * (double)entry[FI_RGBA_BLUE]);
 										a += (weight * (double)entry[FI_RGBA_ALPHA]);
 										src_bits += src_pitch;
 									}
 
+									if (m_bPremultiply) {
+										UnweightColors(r, g, b, a);
+									}
+
 									// clamp and place result in destination pixel
 									dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int)(r + 0.5), 0, 0xFF);
 									dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int)(g + 0.5), 0, 0xFF);
@@ -1865,7 +1990,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = first_column; x < last_column; x++) {
 							// work on column x in dst
 							BYTE *dst_bits = dst_base + x * 3;
 
@@ -1896,7 +2021,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						}
 					} else {
 						// image has 555 format
-						for (unsigned x = 0; x < width; x++) {
+						for (unsigned x = first_column; x < last_column; x++) {
 							// work on column x in dst
 							BYTE *dst_bits = dst_base + x * 3;
 
@@ -1935,7 +2060,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 					const unsigned src_pitch = FreeImage_GetPitch(src);
 					const BYTE *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 3;
 
-					for (unsigned x = 0; x < width; x++) {
+					for (unsigned x = first_column; x < last_column; x++) {
 						// work on column x in dst
 						const unsigned index = x * 3;
 						BYTE *dst_bits = dst_base + index;
@@ -1974,7 +2099,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 					const unsigned src_pitch = FreeImage_GetPitch(src);
 					const BYTE *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 4;
 
-					for (unsigned x = 0; x < width; x++) {
+					for (unsigned x = first_column; x < last_column; x++) {
 						// work on column x in dst
 						const unsigned index = x * 4;
 						BYTE *dst_bits = dst_base + index;
@@ -1991,13 +2116,19 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 								// scan between boundaries
 								// accumulate weighted effect of each neighboring pixel
 								const double weight = weightsTable.getWeight(y, i);
-								r += (weight * (double)src_bits[FI_RGBA_RED]);
-								g += (weight * (double)src_bits[FI_RGBA_GREEN]);
-								b += (weight * (double)src_bits[FI_RGBA_BLUE]);
+								// colors are weighted by alpha when filtering in premultiplied space
+								const double cw = m_bPremultiply ? weight * src_bits[FI_RGBA_ALPHA] : weight;
+								r += (cw * (double)src_bits[FI_RGBA_RED]);
+								g += (cw * (double)src_bits[FI_RGBA_GREEN]);
+								b += (cw * (double)src_bits[FI_RGBA_BLUE]);
 								a += (weight * (double)src_bits[FI_RGBA_ALPHA]);
 								src_bits += src_pitch;
 							}
 
+							if (m_bPremultiply) {
+								UnweightColors(r, g, b, a);
+							}
+
 							// clamp and place result in destination pixel
 							dst_bits[FI_RGBA_RED]	= (BYTE)CLAMP<int>((int) (r + 0.5), 0, 0xFF);
 							dst_bits[FI_RGBA_GREEN]	= (BYTE)CLAMP<int>((int) (g + 0.5), 0, 0xFF);
@@ -2023,7 +2154,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src)	+ src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_column; x < last_column; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				WORD *dst_bits = dst_base + index;
@@ -2064,7 +2195,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_column; x < last_column; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				WORD *dst_bits = dst_base + index;
@@ -2110,7 +2241,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const half *const src_base = (half *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_column; x < last_column; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				half *dst_bits = dst_base + index;
@@ -2156,7 +2287,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const WORD *const src_base = (WORD *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_column; x < last_column; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				WORD *dst_bits = dst_base + index;
@@ -2173,14 +2304,20 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						// scan between boundaries
 						// accumulate weighted effect of each neighboring pixel
 						const double weight = weightsTable.getWeight(y, i);					
-						r += (weight * (double)src_bits[0]);
-						g += (weight * (double)src_bits[1]);
-						b += (weight * (double)src_bits[2]);
+						// colors are weighted by alpha when filtering in premultiplied space
+						const double cw = m_bPremultiply ? weight * src_bits[3] : weight;
+						r += (cw * (double)src_bits[0]);
+						g += (cw * (double)src_bits[1]);
+						b += (cw * (double)src_bits[2]);
 						a += (weight * (double)src_bits[3]);
 
 						src_bits += src_pitch;
 					}
 
+					if (m_bPremultiply) {
+						UnweightColors(r, g, b, a);
+					}
+
 					// clamp and place result in destination pixel
 					dst_bits[0] = (WORD)CLAMP<int>((int)(r + 0.5), 0, 0xFFFF);
 					dst_bits[1] = (WORD)CLAMP<int>((int)(g + 0.5), 0, 0xFFFF);
@@ -2204,7 +2341,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(WORD);
 			const half *const src_base = (half *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_column; x < last_column; x++) {
 				// work on column x in dst
 				const unsigned index = x * wordspp;	// pixel index
 				half *dst_bits = dst_base + index;
@@ -2221,14 +2358,20 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						// scan between boundaries
 						// accumulate weighted effect of each neighboring pixel
 						const float weight = weightsTable.getWeight(y, i);					
-						r += (weight * src_bits[0]);
-						g += (weight * src_bits[1]);
-						b += (weight * src_bits[2]);
+						// colors are weighted by alpha when filtering in premultiplied space
+						const float cw = m_bPremultiply ? weight * src_bits[3] : weight;
+						r += (cw * src_bits[0]);
+						g += (cw * src_bits[1]);
+						b += (cw * src_bits[2]);
 						a += (weight * src_bits[3]);
 
 						src_bits += src_pitch;
 					}
 
+					if (m_bPremultiply) {
+						UnweightColors(r, g, b, a);
+					}
+
 					// clamp and place result in destination pixel
 					dst_bits[0] = r;
 					dst_bits[1] = g;
@@ -2247,6 +2390,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
 			const unsigned floatspp = (FreeImage_GetLine(src) / width) / sizeof(float);
+			const BOOL bPremultiply = m_bPremultiply && (floatspp == 4);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(float);
 			float *const dst_base = (float *)FreeImage_GetBits(dst);
@@ -2254,7 +2398,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(float);
 			const float *const src_base = (float *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * floatspp;
 
-			for (unsigned x = 0; x < width; x++) {
+			for (unsigned x = first_column; x < last_column; x++) {
 				// work on column x in dst
 				const unsigned index = x * floatspp;	// pixel index
 				float *dst_bits = (float *)dst_base + index;
@@ -2271,12 +2415,18 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 						// scan between boundaries
 						// accumulate weighted effect of each neighboring pixel
 						const double weight = weightsTable.getWeight(y, i - iLeft);
+						// colors are weighted by alpha when filtering in premultiplied space
+						const double cw = bPremultiply ? weight * src_bits[3] : weight;
 						for (unsigned j = 0; j < floatspp; j++) {
-							value[j] += (weight * (double)src_bits[j]);
+							value[j] += (((j < 3) ? cw : weight) * (double)src_bits[j]);
 						}
 						src_bits += src_pitch;
 					}
 
+					if (bPremultiply) {
+						UnweightColors(value[0], value[1], value[2], value[3]);
+					}
+
 					// place result in destination pixel
 					for (unsigned j = 0; j < floatspp; j++) {
 						dst_bits[j] = (float)value[j];
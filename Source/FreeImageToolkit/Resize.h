@@ -74,7 +74,7 @@ public:
 	@param src_pos Pixel position in source line buffer
 	@return Returns the filter weight
 	*/
-	double getWeight(unsigned dst_pos, unsigned src_pos) {
+	double getWeight(unsigned dst_pos, unsigned src_pos) const {
 		return m_WeightTable[dst_pos].Weights[src_pos];
 	}
 
@@ -82,7 +82,7 @@ public:
 	@param dst_pos Pixel position in destination line buffer
 	@return Returns the left boundary of source line buffer
 	*/
-	unsigned getLeftBoundary(unsigned dst_pos) {
+	unsigned getLeftBoundary(unsigned dst_pos) const {
 		return m_WeightTable[dst_pos].Left;
 	}
 
@@ -90,7 +90,7 @@ public:
 	@param dst_pos Pixel position in destination line buffer
 	@return Returns the right boundary of source line buffer
 	*/
-	unsigned getRightBoundary(unsigned dst_pos) {
+	unsigned getRightBoundary(unsigned dst_pos) const {
 		return m_WeightTable[dst_pos].Right;
 	}
 };
@@ -116,6 +116,23 @@ class CResizeEngine
 private:
 	/// Pointer to the FIR / IIR filter
 	CGenericFilter* m_pFilter;
+	/// TRUE when RGBA colors are filtered weighted by alpha (see FI_RESCALE_PREMULTIPLY_ALPHA)
+	BOOL m_bPremultiply;
+
+	/// Arguments of a filtering pass, shared by the threads running it
+	typedef struct {
+		CResizeEngine *engine;
+		CWeightsTable *weightsTable;
+		BOOL bHorizontal;
+		FIBITMAP *src;
+		unsigned length;		// height of a horizontal pass, width of a vertical pass
+		unsigned src_length;	// source width of a horizontal pass, source height of a vertical pass
+		unsigned src_offset_x;
+		unsigned src_offset_y;
+		const RGBQUAD *src_pal;
+		FIBITMAP *dst;
+		unsigned dst_length;	// destination width of a horizontal pass, destination height of a vertical pass
+	} FilterPass;
 
 public:
 
@@ -123,7 +140,7 @@ public:
 	Constructor
 	@param filter FIR /IIR filter to be used
 	*/
-	CResizeEngine(CGenericFilter* filter):m_pFilter(filter) {}
+	CResizeEngine(CGenericFilter* filter):m_pFilter(filter), m_bPremultiply(FALSE) {}
 
 	/// Destructor
 	virtual ~CResizeEngine() {}
@@ -162,7 +179,7 @@ public:
 private:
 
 	/**
-	Performs horizontal image filtering
+	Performs horizontal image filtering, on bands of rows run in parallel
 
 	@param src Source image
 	@param height Source / Destination image height
@@ -172,13 +189,14 @@ private:
 	@param src_pal
 	@param dst Destination image
 	@param dst_width Destination image width
+	@return Returns FALSE if the operation was cancelled (see FreeImage_ReportProgress)
 	*/
-	void horizontalFilter(FIBITMAP * const src, const unsigned height, const unsigned src_width,
+	BOOL horizontalFilter(FIBITMAP * const src, const unsigned height, const unsigned src_width,
 			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_width);
 
 	/**
-	Performs vertical image filtering
+	Performs vertical image filtering, on bands of columns run in parallel
 	@param src Source image
 	@param width Source / Destination image width
 	@param src_height Source image height
@@ -187,10 +205,35 @@ private:
 	@param src_pal
 	@param dst Destination image
 	@param dst_height Destination image height
+	@return Returns FALSE if the operation was cancelled (see FreeImage_ReportProgress)
 	*/
-	void verticalFilter(FIBITMAP * const src, const unsigned width, const unsigned src_height,
+	BOOL verticalFilter(FIBITMAP * const src, const unsigned width, const unsigned src_height,
 			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_height);
+
+	/**
+	Performs horizontal image filtering of the rows [first_row, last_row)
+	@param weightsTable Filter weights of the pass
+	@see horizontalFilter
+	*/
+	void horizontalFilter(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned first_row, const unsigned last_row,
+			const unsigned src_width, const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_width);
+
+	/**
+	Performs vertical image filtering of the columns [first_column, last_column)
+	@param weightsTable Filter weights of the pass
+	@see verticalFilter
+	*/
+	void verticalFilter(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned width, const unsigned first_column, const unsigned last_column,
+			const unsigned src_height, const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
+			FIBITMAP * const dst, const unsigned dst_height);
+
+	/**
+	Body of the parallel loop of a filtering pass
+	@param data Pointer to the FilterPass
+	*/
+	static void filterProc(void *data, unsigned first, unsigned last);
 };
 
 #endif //   _RESIZE_H_
@@ -573,10 +573,11 @@ Process Exif directory
 @param dwProfileOffset File offset to be used when reading 'offset/value' tags
 @param msb_order Endianness order of the Exif file (TRUE if big-endian, FALSE if little-endian)
 @param starting_md_model Metadata model of the IFD (should be TagLib::EXIF_MAIN for a jpeg)
+@param read_thumbnail If TRUE, load the thumbnail stored in the 1st IFD
 @return Returns TRUE if sucessful, returns FALSE otherwise
 */
 static BOOL 
-jpeg_read_exif_dir(FIBITMAP *dib, const BYTE *tiffp, DWORD dwOffsetIfd0, DWORD dwLength, DWORD dwProfileOffset, BOOL msb_order, TagLib::MDMODEL starting_md_model) {
+jpeg_read_exif_dir(FIBITMAP *dib, const BYTE *tiffp, DWORD dwOffsetIfd0, DWORD dwLength, DWORD dwProfileOffset, BOOL msb_order, TagLib::MDMODEL starting_md_model, BOOL read_thumbnail = TRUE) {
 	WORD de, nde;
 
 	std::stack<WORD>			destack;	// directory entries stack
@@ -769,6 +770,10 @@ jpeg_read_exif_dir(FIBITMAP *dib, const BYTE *tiffp, DWORD dwOffsetIfd0, DWORD d
 	// --- handle thumbnail data ---
 	//
 
+	if(!read_thumbnail) {
+		return TRUE;
+	}
+
 	const WORD entriesCount0th = ReadUint16(msb_order, ifd0th);
 	
 	const BYTE* de_addr = DIR_ENTRY_ADDR(ifd0th, entriesCount0th);
@@ -864,10 +869,11 @@ Read and decode JPEG_APP1 marker (Exif profile)
 @param dib Image to be processed
 @param data Pointer to the APP1 marker
 @param length APP1 marker length
+@param read_thumbnail If TRUE, load the Exif thumbnail
 @return Returns TRUE if successful, FALSE otherwise
 */
-BOOL  
-jpeg_read_exif_profile(FIBITMAP *dib, const BYTE *data, unsigned length) {
+static BOOL  
+read_exif_profile(FIBITMAP *dib, const BYTE *data, unsigned length, BOOL read_thumbnail) {
     // marker identifying string for Exif = "Exif\0\0"
     BYTE exif_signature[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
 	BYTE lsb_first[4] = { 0x49, 0x49, 0x2A, 0x00 };		// Classic TIFF signature - little-endian order
@@ -924,12 +930,30 @@ jpeg_read_exif_profile(FIBITMAP *dib, const BYTE *data, unsigned length) {
 		*/
 
 		// process Exif directories, starting with Exif-TIFF IFD
-		return jpeg_read_exif_dir(dib, pbProfile, dwFirstOffset, dwProfileLength, 0, bBigEndian, TagLib::EXIF_MAIN);
+		return jpeg_read_exif_dir(dib, pbProfile, dwFirstOffset, dwProfileLength, 0, bBigEndian, TagLib::EXIF_MAIN, read_thumbnail);
 	}
 
 	return FALSE;
 }
 
+/**
+Read and decode JPEG_APP1 marker (Exif profile), including the Exif thumbnail
+@see read_exif_profile
+*/
+BOOL  
+jpeg_read_exif_profile(FIBITMAP *dib, const BYTE *data, unsigned length) {
+	return read_exif_profile(dib, data, length, TRUE);
+}
+
+/**
+Read and decode JPEG_APP1 marker (Exif profile), without loading the Exif thumbnail
+@see read_exif_profile
+*/
+BOOL  
+jpeg_read_exif_tags(FIBITMAP *dib, const BYTE *data, unsigned length) {
+	return read_exif_profile(dib, data, length, FALSE);
+}
+
 // ==========================================================
 // Exif JPEG helper routines
 // ==========================================================
@@ -1044,22 +1068,34 @@ RotateExif(FIBITMAP **dib) {
 				case 4:		// "bottom, left side" => flip up-down
 					FreeImage_FlipVertical(*dib);
 					break;
-				case 5:		// "left side, top" => +90 + flip up-down
-					rotated = FreeImage_Rotate(*dib, 90);
-					FreeImage_Unload(*dib);
-					*dib = rotated;
-					FreeImage_FlipVertical(*dib);
+				case 5:		// "left side, top" => +90 + flip up-down, i.e. transpose
+					rotated = TransposeBitmap(*dib, FALSE);
+					if(rotated) {
+						FreeImage_Unload(*dib);
+						*dib = rotated;
+					} else {
+						rotated = FreeImage_Rotate(*dib, 90);
+						FreeImage_Unload(*dib);
+						*dib = rotated;
+						FreeImage_FlipVertical(*dib);
+					}
 					break;
 				case 6:		// "right side, top" => -90
 					rotated = FreeImage_Rotate(*dib, -90);
 					FreeImage_Unload(*dib);
 					*dib = rotated;
 					break;
-				case 7:		// "right side, bottom" => -90 + flip up-down
-					rotated = FreeImage_Rotate(*dib, -90);
-					FreeImage_Unload(*dib);
-					*dib = rotated;
-					FreeImage_FlipVertical(*dib);
+				case 7:		// "right side, bottom" => -90 + flip up-down, i.e. transverse
+					rotated = TransposeBitmap(*dib, TRUE);
+					if(rotated) {
+						FreeImage_Unload(*dib);
+						*dib = rotated;
+					} else {
+						rotated = FreeImage_Rotate(*dib, -90);
+						FreeImage_Unload(*dib);
+						*dib = rotated;
+						FreeImage_FlipVertical(*dib);
+					}
 					break;
 				case 8:		// "left side, bottom" => +90
 					rotated = FreeImage_Rotate(*dib, 90);
@@ -1087,9 +1123,52 @@ public:
 };
 
 /**
-Write a metadata model as a TIF IFD to a FIMEMORY handle.
+Fingerprint of the tags of a metadata model (64-bit FNV-1a hash of their key, type, count and value).
+Used to reuse a serialized IFD while the tags are unchanged.
+@param dib Input FIBITMAP
+@param md_model Metadata model
+@return Returns the fingerprint
+*/
+static UINT64
+tiff_get_ifd_fingerprint(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model) {
+	struct FNV1a {
+		static UINT64 hash(UINT64 h, const void *data, size_t size) {
+			const BYTE *p = (const BYTE*)data;
+			for(size_t i = 0; i < size; i++) {
+				h = (h ^ p[i]) * 0x100000001B3ULL;
+			}
+			return h;
+		}
+	};
+
+	UINT64 h = 0xCBF29CE484222325ULL;
+
+	FITAG *tag = NULL;
+	FIMETADATA *mdhandle = FreeImage_FindFirstMetadata(md_model, dib, &tag);
+	if(mdhandle) {
+		do {
+			const char *key = FreeImage_GetTagKey(tag);
+			if(key) {
+				h = FNV1a::hash(h, key, strlen(key) + 1);
+			}
+			const WORD tag_type = (WORD)FreeImage_GetTagType(tag);
+			const DWORD tag_count = FreeImage_GetTagCount(tag);
+			const DWORD tag_length = FreeImage_GetTagLength(tag);
+			h = FNV1a::hash(h, &tag_type, sizeof(tag_type));
+			h = FNV1a::hash(h, &tag_count, sizeof(tag_count));
+			h = FNV1a::hash(h, &tag_length, sizeof(tag_length));
+			h = FNV1a::hash(h, FreeImage_GetTagValue(tag), tag_length);
+		} while(FreeImage_FindNextMetadata(mdhandle, &tag));
+
+		FreeImage_FindCloseMetadata(mdhandle);
+	}
+
+	return h;
+}
+
+/**
+Write a metadata model as a TIF IFD to a buffer.
 The entries in the TIF IFD are sorted in ascending order by tag id.	
-The last entry is written as 0 (4 bytes) which means no more IFD to follow. 
 Supported metadata models are
 <ul>
 <li>FIMD_EXIF_MAIN
@@ -1097,28 +1176,24 @@ Supported metadata models are
 <li>FIMD_EXIF_GPS
 <li>FIMD_EXIF_INTEROP
 </ul>
-The end of the buffer is filled with 4 bytes equal to 0 (end of IFD offset)
+The IFD entries are followed by the values larger than 4 bytes (WORD-aligned), 
+the end of the buffer is filled with 4 bytes equal to 0 (end of IFD offset). 
+The profile size is computed first, so that the buffer is allocated once.
 
 @param dib Input FIBITMAP
 @param md_model Metadata model to write
-@param hmem Memory handle
+@param ppbProfile Returned buffer, (re-)allocated with 'realloc'
+@param uProfileLength Returned buffer size
 @return Returns TRUE if successful, FALSE otherwise
 @see tiff_get_ifd_profile
 */
 static BOOL
-tiff_write_ifd(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, FIMEMORY *hmem) {
+tiff_write_ifd(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, BYTE **ppbProfile, unsigned *uProfileLength) {
 	FITAG *tag = NULL;
 	FIMETADATA *mdhandle = NULL;
 	std::vector<FITAG*> vTagList;
 	TagLib::MDMODEL internal_md_model;
 
-	DWORD ifd_offset = 0;	// WORD-aligned IFD value offset
-
-	const BYTE empty_byte = 0;
-
-	// start of the file
-	const long start_of_file = FreeImage_TellMemory(hmem);
-
 	// get the metadata count
 	unsigned metadata_count = FreeImage_GetMetadataCount(md_model, dib);
 	if(metadata_count == 0) {
@@ -1180,7 +1255,7 @@ tiff_write_ifd(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, FIMEMORY *hmem) {
 			throw(1);
 		}
 
-		// 2) prepare the place for each IFD entries.
+		// 2) compute the profile size
 
 		/*
 		An Image File Directory (IFD) consists of a 2-byte count of the number of directory entries (i.e., the number of fields), 
@@ -1188,64 +1263,70 @@ tiff_write_ifd(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, FIMEMORY *hmem) {
 		followed by a 4-byte offset of the next IFD (or 0 if none). Do not forget to write the 4 bytes of 0 after the last IFD.
 		*/
 
-		{		
-			// prepare place for 2 bytes for number of entries + 12 bytes for each entry
-			unsigned ifd_size = 2 + 12 * metadata_count;
-			FreeImage_WriteMemory(&empty_byte, 1, ifd_size, hmem);
-			// record the offset used to write values > 4-bytes
-			ifd_offset = FreeImage_TellMemory(hmem);
-			// rewind
-			FreeImage_SeekMemory(hmem, start_of_file, SEEK_SET);
+		// 2 bytes for number of entries + 12 bytes for each entry
+		const unsigned ifd_size = 2 + 12 * metadata_count;
+		// values > 4-bytes, WORD-aligned, and end-of-IFD
+		unsigned profile_size = ifd_size + 4;
+		for(unsigned i = 0; i < metadata_count; i++) {
+			const unsigned tag_length = FreeImage_GetTagLength(vTagList[i]);
+			if(tag_length > 4) {
+				profile_size += tag_length + (tag_length & 1);
+			}
+		}
+
+		BYTE *profile = (BYTE*)realloc(*ppbProfile, profile_size);
+		if(!profile) {
+			throw(1);
 		}
+		*ppbProfile = profile;
+		*uProfileLength = profile_size;
 
 		// 3) write each IFD entry in tag id ascending order
 
+		BYTE *entry = profile;
+		// offset used to write values > 4-bytes
+		BYTE *value = profile + ifd_size;
+
 		// number of directory entries
-		WORD nde = (WORD)metadata_count;
-		FreeImage_WriteMemory(&nde, 1, 2, hmem);
+		const WORD nde = (WORD)metadata_count;
+		memcpy(entry, &nde, 2);
+		entry += 2;
 
 		// for each entry ...
 		for(unsigned i = 0; i < metadata_count; i++) {
 			FITAG *tag = vTagList[i];
 			// tag id
-			WORD tag_id = FreeImage_GetTagID(tag);
-			FreeImage_WriteMemory(&tag_id, 1, 2, hmem);
+			const WORD tag_id = FreeImage_GetTagID(tag);
+			memcpy(entry, &tag_id, 2);
 			// tag type (compliant with TIFF specification)
-			WORD tag_type = (WORD)FreeImage_GetTagType(tag);
-			FreeImage_WriteMemory(&tag_type, 1, 2, hmem);
+			const WORD tag_type = (WORD)FreeImage_GetTagType(tag);
+			memcpy(entry + 2, &tag_type, 2);
 			// tag count
-			DWORD tag_count = FreeImage_GetTagCount(tag);
-			FreeImage_WriteMemory(&tag_count, 1, 4, hmem);
+			const DWORD tag_count = FreeImage_GetTagCount(tag);
+			memcpy(entry + 4, &tag_count, 4);
 			// tag value or offset (results are in BYTE's units)
-			unsigned tag_length = FreeImage_GetTagLength(tag);
+			const unsigned tag_length = FreeImage_GetTagLength(tag);
 			if(tag_length <= 4) {
 				// 4 bytes or less, write the value (left justified)
-				const BYTE *tag_value = (BYTE*)FreeImage_GetTagValue(tag);
-				FreeImage_WriteMemory(tag_value, 1, tag_length, hmem);
-				for(unsigned k = tag_length; k < 4; k++) {
-					FreeImage_WriteMemory(&empty_byte, 1, 1, hmem);
-				}
+				memcpy(entry + 8, FreeImage_GetTagValue(tag), tag_length);
+				memset(entry + 8 + tag_length, 0, 4 - tag_length);
 			} else {
 				// write an offset
-				FreeImage_WriteMemory(&ifd_offset, 1, 4, hmem);
+				const DWORD ifd_offset = (DWORD)(value - profile);
+				memcpy(entry + 8, &ifd_offset, 4);
 				// write the value
-				long current_position = FreeImage_TellMemory(hmem);
-				FreeImage_SeekMemory(hmem, ifd_offset, SEEK_SET);
-				FreeImage_WriteMemory(FreeImage_GetTagValue(tag), 1, tag_length, hmem);
+				memcpy(value, FreeImage_GetTagValue(tag), tag_length);
+				value += tag_length;
 				if(tag_length & 1) {
 					// align to the next WORD boundary
-					FreeImage_WriteMemory(&empty_byte, 1, 1, hmem);
+					*value++ = 0;
 				}
-				// next offset to use
-				ifd_offset = FreeImage_TellMemory(hmem);
-				// rewind
-				FreeImage_SeekMemory(hmem, current_position, SEEK_SET);
 			}
+			entry += 12;
 		}
 
 		// end-of-IFD or next IFD (0 == none)
-		FreeImage_SeekMemory(hmem, ifd_offset, SEEK_SET);
-		FreeImage_WriteMemory(&empty_byte, 1, 4, hmem);
+		memset(value, 0, 4);
 
 		return TRUE;
 	}
@@ -1257,6 +1338,8 @@ tiff_write_ifd(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, FIMEMORY *hmem) {
 /**
 Write a metadata model as a TIF IFD, returns the IFD as a buffer.
 The buffer is allocated by the function and must be freed by the caller, using 'free'.
+The IFD is cached on the bitmap, so that saving it several times with the same tags 
+(e.g. in several sizes or formats) serializes the tags once.
 @param dib Input FIBITMAP
 @param md_model Metadata model to write
 @param ppbProfile Returned buffer
@@ -1266,47 +1349,23 @@ The buffer is allocated by the function and must be freed by the caller, using '
 */
 BOOL
 tiff_get_ifd_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, BYTE **ppbProfile, unsigned *uProfileLength) {
-	FIMEMORY *hmem = NULL;
-
-	try {
-		// open a memory stream
-		hmem = FreeImage_OpenMemory(NULL, 0);
-		if(!hmem) {
-			throw(1);
-		}
-
-		// write the metadata model as a TIF IFD
-		BOOL bResult = tiff_write_ifd(dib, md_model, hmem);
-
-		if(bResult) {
-			BYTE *data = NULL;
-			DWORD size_in_bytes = 0;
-
-			// get a pointer to the stream buffer
-			FreeImage_AcquireMemory(hmem, &data, &size_in_bytes);
-			
-			// (re-)allocate output buffer
-			BYTE *pbProfile = *ppbProfile;
-			pbProfile = (BYTE*)realloc(pbProfile, size_in_bytes);
-			if(!pbProfile) {
-				throw(1);
-			} else {
-				// copy IFD
-				memcpy(pbProfile, data, size_in_bytes);
-				*ppbProfile = pbProfile;
-				*uProfileLength = size_in_bytes;
-			}
-		}
-
-		// free the memory stream
-		FreeImage_CloseMemory(hmem);
+	if(FreeImage_GetMetadataCount(md_model, dib) == 0) {
+		return FALSE;
+	}
 
-		return bResult;
+	// reuse a previous IFD if the tags are unchanged
+	const UINT64 fingerprint = tiff_get_ifd_fingerprint(dib, md_model);
+	if(get_cached_profile(dib, md_model, fingerprint, ppbProfile, uProfileLength)) {
+		return TRUE;
+	}
 
-	} catch(int) {
-		FreeImage_CloseMemory(hmem);
-		return FALSE;
+	// write the metadata model as a TIF IFD
+	if(tiff_write_ifd(dib, md_model, ppbProfile, uProfileLength)) {
+		set_cached_profile(dib, md_model, fingerprint, *ppbProfile, *uProfileLength);
+		return TRUE;
 	}
+
+	return FALSE;
 }
 
 // ----------------------------------------------------------
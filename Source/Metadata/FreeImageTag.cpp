@@ -39,8 +39,35 @@ FI_STRUCT (FITAGHEADER) {
 	DWORD count;		// number of components (in 'tag data types' units)
 	DWORD length;		// value length in bytes
 	void *value;		// tag value
+	WORD interned;		// FITAG_KEY_INTERNED, FITAG_DESCRIPTION_INTERNED : strings owned by TagLib, not freed
 };
 
+#define FITAG_KEY_INTERNED			0x01
+#define FITAG_DESCRIPTION_INTERNED	0x02
+
+/**
+Copy a tag key or description. 
+A known field name or description is not copied, the TagLib string is shared instead.
+@param str String to copy
+@param interned_flag Flag set in interned when the string is shared
+@param interned (in/out) Interned strings of the tag
+@return Returns the copy, or NULL if the allocation failed
+*/
+static char* 
+CopyTagString(const char *str, WORD interned_flag, WORD *interned) {
+	char *copy = (char*)TagLib::instance().internString(str);
+	if(copy) {
+		*interned |= interned_flag;
+	} else {
+		*interned &= ~interned_flag;
+		copy = (char*)malloc(strlen(str) + 1);
+		if(copy) {
+			strcpy(copy, str);
+		}
+	}
+	return copy;
+}
+
 // --------------------------------------------------------------------------
 // FITAG creation / destruction
 // --------------------------------------------------------------------------
@@ -68,8 +95,12 @@ FreeImage_DeleteTag(FITAG *tag) {
 		if (NULL != tag->data) {
 			FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
 			// delete tag members
-			free(tag_header->key); 
-			free(tag_header->description); 
+			if(!(tag_header->interned & FITAG_KEY_INTERNED)) {
+				free(tag_header->key); 
+			}
+			if(!(tag_header->interned & FITAG_DESCRIPTION_INTERNED)) {
+				free(tag_header->description); 
+			}
 			free(tag_header->value);
 			// delete the tag
 			free(tag->data);
@@ -94,16 +125,20 @@ FreeImage_CloneTag(FITAG *tag) {
 
 		// tag ID
 		dst_tag->id = src_tag->id;
-		// tag key
-		if(src_tag->key) {
+		// tag key and description, interned strings are shared
+		dst_tag->interned = src_tag->interned;
+		if(src_tag->interned & FITAG_KEY_INTERNED) {
+			dst_tag->key = src_tag->key;
+		} else if(src_tag->key) {
 			dst_tag->key = (char*)malloc((strlen(src_tag->key) + 1) * sizeof(char));
 			if(!dst_tag->key) {
 				throw FI_MSG_ERROR_MEMORY;
 			}
 			strcpy(dst_tag->key, src_tag->key);
 		}
-		// tag description
-		if(src_tag->description) {
+		if(src_tag->interned & FITAG_DESCRIPTION_INTERNED) {
+			dst_tag->description = src_tag->description;
+		} else if(src_tag->description) {
 			dst_tag->description = (char*)malloc((strlen(src_tag->description) + 1) * sizeof(char));
 			if(!dst_tag->description) {
 				throw FI_MSG_ERROR_MEMORY;
@@ -187,9 +222,13 @@ BOOL DLL_CALLCONV
 FreeImage_SetTagKey(FITAG *tag, const char *key) {
 	if(tag && key) {
 		FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
-		if(tag_header->key) free(tag_header->key);
-		tag_header->key = (char*)malloc(strlen(key) + 1);
-		strcpy(tag_header->key, key);
+		if(key == tag_header->key) {
+			return TRUE;
+		}
+		char *old_key = tag_header->key;
+		const BOOL old_interned = (tag_header->interned & FITAG_KEY_INTERNED) ? TRUE : FALSE;
+		tag_header->key = CopyTagString(key, FITAG_KEY_INTERNED, &tag_header->interned);
+		if(old_key && !old_interned) free(old_key);
 		return TRUE;
 	}
 	return FALSE;
@@ -199,9 +238,13 @@ BOOL DLL_CALLCONV
 FreeImage_SetTagDescription(FITAG *tag, const char *description) {
 	if(tag && description) {
 		FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
-		if(tag_header->description) free(tag_header->description);
-		tag_header->description = (char*)malloc(strlen(description) + 1);
-		strcpy(tag_header->description, description);
+		if(description == tag_header->description) {
+			return TRUE;
+		}
+		char *old_description = tag_header->description;
+		const BOOL old_interned = (tag_header->interned & FITAG_DESCRIPTION_INTERNED) ? TRUE : FALSE;
+		tag_header->description = CopyTagString(description, FITAG_DESCRIPTION_INTERNED, &tag_header->interned);
+		if(old_description && !old_interned) free(old_description);
 		return TRUE;
 	}
 	return FALSE;
@@ -330,10 +373,10 @@ FreeImage_GetTagMemorySize(FITAG *tag) {
 		FITAGHEADER *tag_header = (FITAGHEADER *)tag->data;
 		size += sizeof(FITAG);
 		size += sizeof(FITAGHEADER);
-		if (tag_header->key) {
+		if (tag_header->key && !(tag_header->interned & FITAG_KEY_INTERNED)) {
 			size += strlen(tag_header->key) + 1;
 		}
-		if (tag_header->description) {
+		if (tag_header->description && !(tag_header->interned & FITAG_DESCRIPTION_INTERNED)) {
 			size += strlen(tag_header->description) + 1;
 		}
 		if (tag_header->value) {
@@ -22,6 +22,9 @@
 #ifndef FREEIMAGE_TAG_H
 #define FREEIMAGE_TAG_H
 
+#include <mutex>
+#include <vector>
+
 // ==========================================================
 // Exif JPEG tags
 // ==========================================================
@@ -340,6 +343,8 @@ The classic solution to this problem is to use mutual exclusion on the class tha
 indicates that the object is being instantiated.
 The FreeImage solution is to instantiate the singleton before any other thread is launched, 
 i.e. inside the FreeImage_Initialise function (see Plugin.cpp). 
+The constructor does no work : the hash tables of a metadata model are built on first use
+of the model, and the interned strings on first use of internString, each under a std::once_flag.
 */
 
 class TagLib {
@@ -378,17 +383,30 @@ public:
 
 private:
 
-	typedef std::map<WORD, TagInfo*> TAGINFO;
-	typedef std::map<int, TAGINFO*>  TABLEMAP;
+	/**
+	Open addressing hash tables indexing a tag info table, 
+	the size of a table is a power of 2 and empty slots are NULL
+	*/
+	typedef struct tagTagIndex {
+		std::vector<const TagInfo*> by_id;		//! tag info by tag ID
+		std::vector<const TagInfo*> by_name;	//! tag info by tag field name
+	} TAGINDEX;
+
+	/// store hash tables for all known tag info tables, indexed by MDMODEL (NULL if none or not built yet)
+	TAGINDEX *_table_map[ANIMATION + 1];
+	/// guards the lazy build of _table_map
+	std::once_flag _table_once[ANIMATION + 1];
 
-	/// store hash tables for all known tag info tables
-	TABLEMAP _table_map;
+	/// field names and descriptions of all known tags, as an open addressing hash table
+	std::vector<const char*> _strings;
+	/// guards the lazy build of _strings
+	std::once_flag _strings_once;
 
 private:
 	/**
 	Constructor (private)<br>
-	This is where the tag info tables are initialized.
-	@see addMetadataModel
+	The tag info tables are indexed on first use.
+	@see getModelIndex
 	*/
 	TagLib();
 
@@ -398,13 +416,33 @@ private:
 	/// Copy constructor (disabled)
 	TagLib(const TagLib&);
 	
-	/** 
-	Used in the constructor to initialize the tag tables
+	/**
+	Build the hash tables of a tag info table
 	@param md_model Internal metadata model
 	@param tag_table Tag info table
 	@return Returns TRUE if successful, returns FALSE otherwise
 	*/
-	BOOL addMetadataModel(MDMODEL md_model, TagInfo *tag_table);
+	BOOL addMetadataModel(MDMODEL md_model, const TagInfo *tag_table);
+
+	/**
+	@return Returns the hash tables of a metadata model, built on first call, or NULL if none
+	*/
+	const TAGINDEX* getModelIndex(MDMODEL md_model);
+
+	/**
+	Build the interned strings from all the tag info tables
+	*/
+	void addStrings();
+
+	/**
+	Used by addStrings to add a field name or description to the interned strings
+	*/
+	void addString(const char *str);
+
+	/**
+	@return Returns the interned copy of str, or NULL if str is not interned
+	*/
+	const char* findString(const char *str) const;
 
 public:
 	/// Destructor
@@ -452,6 +490,15 @@ public:
 	*/
 	int getTagID(MDMODEL md_model, const char *key);
 
+	/**
+	Given a string, returns the copy of this string held by the tag info tables. 
+	The returned pointer stays valid until the library is unloaded and can be 
+	shared by any number of tags instead of a copy of the string.
+	@param str Tag field name or description
+	@return Returns the tag info table string if str is a known field name or description, returns NULL otherwise
+	*/
+	const char* internString(const char *str);
+
 	/**
 	Perform a conversion between internal metadata models and FreeImage public metadata models
 	@param md_model Internal metadata model
@@ -481,6 +528,7 @@ extern "C" {
 // JPEG / JPEG-XR Exif profile (see Exif.cpp)
 // --------------------------------------------------------------------------
 BOOL jpeg_read_exif_profile(FIBITMAP *dib, const BYTE *dataptr, unsigned datalen);
+BOOL jpeg_read_exif_tags(FIBITMAP *dib, const BYTE *dataptr, unsigned datalen);
 BOOL jpeg_read_exif_profile_raw(FIBITMAP *dib, const BYTE *profile, unsigned length);
 BOOL jpegxr_read_exif_profile(FIBITMAP *dib, const BYTE *profile, unsigned length, unsigned file_offset);
 BOOL jpegxr_read_exif_gps_profile(FIBITMAP *dib, const BYTE *profile, unsigned length, unsigned file_offset);
@@ -488,6 +536,18 @@ BOOL jpegxr_read_exif_gps_profile(FIBITMAP *dib, const BYTE *profile, unsigned l
 BOOL tiff_get_ifd_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, BYTE **ppbProfile, unsigned *uProfileLength);
 
 
+// Serialized profiles cached on a FIBITMAP, under a per-bitmap lock so that concurrent saves can fill them (see BitmapAccess.cpp)
+// --------------------------------------------------------------------------
+BOOL get_cached_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, UINT64 fingerprint, BYTE **ppbProfile, unsigned *uProfileLength);
+BOOL set_cached_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, UINT64 fingerprint, const BYTE *profile, unsigned length);
+
+
+// Raw profiles parsed on first access to their tags, under a per-bitmap lock so that concurrent metadata reads are safe (see BitmapAccess.cpp)
+// --------------------------------------------------------------------------
+BOOL set_raw_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, const BYTE *profile, unsigned length);
+BOOL get_raw_profile(FIBITMAP *dib, FREE_IMAGE_MDMODEL md_model, std::vector<BYTE> *profile);
+
+
 // PSD Exif profile (see Exif.cpp)
 // --------------------------------------------------------------------------
 BOOL psd_read_exif_profile(FIBITMAP *dib, const BYTE *dataptr, unsigned datalen);
@@ -497,6 +557,7 @@ BOOL psd_read_exif_profile_raw(FIBITMAP *dib, const BYTE *dataptr, unsigned data
 // JPEG / PSD / TIFF IPTC profile (see IPTC.cpp)
 // --------------------------------------------------------------------------
 BOOL read_iptc_profile(FIBITMAP *dib, const BYTE *dataptr, unsigned int datalen);
+BOOL read_iptc_profile_raw(FIBITMAP *dib, const BYTE *dataptr, unsigned int datalen);
 BOOL write_iptc_profile(FIBITMAP *dib, BYTE **profile, unsigned *profile_size);
 
 #if defined(__cplusplus)
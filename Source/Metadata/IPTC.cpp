@@ -219,6 +219,52 @@ read_iptc_profile(FIBITMAP *dib, const BYTE *dataptr, unsigned int datalen) {
 	return TRUE;
 }
 
+/**
+Attach the IPTC datasets of a binary profile to a bitmap without decoding them. 
+The datasets are decoded by read_iptc_profile on first access to the FIMD_IPTC model, 
+and written back as is by write_iptc_profile until then.
+@see set_raw_profile
+*/
+BOOL 
+read_iptc_profile_raw(FIBITMAP *dib, const BYTE *dataptr, unsigned int datalen) {
+	if(!dataptr || (datalen == 0)) {
+		return FALSE;
+	}
+
+	if(datalen > 8) {
+		if(memcmp("Adobe_CM", dataptr, 8) == 0) {
+			// not an IPTC profile (see read_iptc_profile)
+			return FALSE;
+		}
+	}
+
+	// find start of the BIM portion of the binary data
+	size_t start = 0;
+	while(start < datalen - 1) {
+		if((dataptr[start] == 0x1C) && (dataptr[start+1] == 0x02))
+			break;
+		start++;
+	}
+
+	// skip the datasets read_iptc_profile would decode
+	size_t offset = start;
+	size_t end = start;
+	while(((offset + 5) < datalen) && (dataptr[offset] == 0x1C)) {
+		const size_t tagByteCount = (dataptr[offset + 3] << 8) | dataptr[offset + 4];
+		if((offset + 5 + tagByteCount) > datalen) {
+			break;
+		}
+		offset += 5 + tagByteCount;
+		end = offset;
+	}
+
+	if(end == start) {
+		return FALSE;
+	}
+
+	return set_raw_profile(dib, FIMD_IPTC, dataptr + start, (unsigned)(end - start));
+}
+
 // --------------------------------------------------------------------------
 
 static BYTE* 
@@ -266,6 +312,21 @@ write_iptc_profile(FIBITMAP *dib, BYTE **profile, unsigned *profile_size) {
 	BYTE *buffer = NULL;
 	unsigned buffer_size = 0;
 
+	// write back a profile not decoded yet (see read_iptc_profile_raw)
+	std::vector<BYTE> raw_profile;
+	if(get_raw_profile(dib, FIMD_IPTC, &raw_profile)) {
+		buffer = (BYTE*)malloc(raw_profile.size());
+		if(!buffer) {
+			return FALSE;
+		}
+		memcpy(buffer, &raw_profile[0], raw_profile.size());
+
+		*profile = buffer;
+		*profile_size = (unsigned)raw_profile.size();
+
+		return TRUE;
+	}
+
 	// parse all IPTC tags and rebuild a IPTC profile
 	mdhandle = FreeImage_FindFirstMetadata(FIMD_IPTC, dib, &tag);
 
@@ -1469,63 +1469,175 @@ static TagInfo
 
 
 /**
-This is where the tag info tables are initialized
+Hash of a tag ID (Fibonacci hashing)
 */
+static inline size_t 
+HashTagID(WORD tagID) {
+	return (size_t)(((DWORD)tagID * 2654435769U) >> 16);
+}
+
+/**
+FNV-1a hash of a string
+*/
+static inline size_t 
+HashString(const char *str) {
+	DWORD hash = 2166136261U;
+	for(; *str; str++) {
+		hash ^= (BYTE)*str;
+		hash *= 16777619U;
+	}
+	return (size_t)hash;
+}
+
+/**
+Size of an open addressing hash table holding count entries : a power of 2, at most half full
+*/
+static size_t 
+GetHashTableSize(size_t count) {
+	size_t size = 16;
+	while(size < 2 * count) {
+		size <<= 1;
+	}
+	return size;
+}
+
+/**
+@return Returns the tag info table of a metadata model, returns NULL if the model has none
+*/
+static const TagInfo*
+GetModelTable(TagLib::MDMODEL md_model) {
+	switch(md_model) {
+		// Exif
+		case TagLib::EXIF_MAIN:
+		case TagLib::EXIF_EXIF:
+			return exif_exif_tag_table;
+		case TagLib::EXIF_GPS:
+			return exif_gps_tag_table;
+		case TagLib::EXIF_INTEROP:
+			return exif_interop_tag_table;
+
+		// Exif maker note
+		case TagLib::EXIF_MAKERNOTE_CANON:
+			return exif_canon_tag_table;
+		case TagLib::EXIF_MAKERNOTE_CASIOTYPE1:
+			return exif_casio_type1_tag_table;
+		case TagLib::EXIF_MAKERNOTE_CASIOTYPE2:
+			return exif_casio_type2_tag_table;
+		case TagLib::EXIF_MAKERNOTE_FUJIFILM:
+			return exif_fujifilm_tag_table;
+		case TagLib::EXIF_MAKERNOTE_KYOCERA:
+			return exif_kyocera_tag_table;
+		case TagLib::EXIF_MAKERNOTE_MINOLTA:
+			return exif_minolta_tag_table;
+		case TagLib::EXIF_MAKERNOTE_NIKONTYPE1:
+			return exif_nikon_type1_tag_table;
+		case TagLib::EXIF_MAKERNOTE_NIKONTYPE2:
+			return exif_nikon_type2_tag_table;
+		case TagLib::EXIF_MAKERNOTE_NIKONTYPE3:
+			return exif_nikon_type3_tag_table;
+		case TagLib::EXIF_MAKERNOTE_OLYMPUSTYPE1:
+			return exif_olympus_type1_tag_table;
+		case TagLib::EXIF_MAKERNOTE_PANASONIC:
+			return exif_panasonic_tag_table;
+		case TagLib::EXIF_MAKERNOTE_ASAHI:
+			return exif_asahi_tag_table;
+		case TagLib::EXIF_MAKERNOTE_PENTAX:
+			return exif_pentax_tag_table;
+		case TagLib::EXIF_MAKERNOTE_SONY:
+			return exif_sony_tag_table;
+		case TagLib::EXIF_MAKERNOTE_SIGMA_SD1:
+			return exif_sigma_sd1_tag_table;
+		case TagLib::EXIF_MAKERNOTE_SIGMA_FOVEON:
+			return exif_sigma_foveon_tag_table;
+		case TagLib::EXIF_MAKERNOTE_APPLE_IOS:
+			return exif_apple_ios_tag_table;
+
+		// IPTC/NAA
+		case TagLib::IPTC:
+			return iptc_tag_table;
+
+		// GeoTIFF
+		case TagLib::GEOTIFF:
+			return geotiff_tag_table;
+
+		// Animation
+		case TagLib::ANIMATION:
+			return animation_tag_table;
+
+		default:
+			return NULL;
+	}
+}
+
+/**
+Look for a tag ID in the tag ID hash table of a model
+*/
+static inline const TagInfo*
+FindTagInfo(const std::vector<const TagInfo*> &by_id, WORD tagID) {
+	const size_t mask = by_id.size() - 1;
+	for(size_t slot = HashTagID(tagID) & mask; by_id[slot]; slot = (slot + 1) & mask) {
+		if(by_id[slot]->tag == tagID) {
+			return by_id[slot];
+		}
+	}
+	return NULL;
+}
+
 TagLib::TagLib() {
-	// initialize all known metadata models
-	// ====================================
-
-	// Exif
-	addMetadataModel(TagLib::EXIF_MAIN, exif_exif_tag_table);
-	addMetadataModel(TagLib::EXIF_EXIF, exif_exif_tag_table);
-	addMetadataModel(TagLib::EXIF_GPS, exif_gps_tag_table);
-	addMetadataModel(TagLib::EXIF_INTEROP, exif_interop_tag_table);
-
-	// Exif maker note
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_CANON, exif_canon_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_CASIOTYPE1, exif_casio_type1_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_CASIOTYPE2, exif_casio_type2_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_FUJIFILM, exif_fujifilm_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_KYOCERA, exif_kyocera_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_MINOLTA, exif_minolta_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_NIKONTYPE1, exif_nikon_type1_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_NIKONTYPE2, exif_nikon_type2_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_NIKONTYPE3, exif_nikon_type3_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_OLYMPUSTYPE1, exif_olympus_type1_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_PANASONIC, exif_panasonic_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_ASAHI, exif_asahi_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_PENTAX, exif_pentax_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_SONY, exif_sony_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_SIGMA_SD1, exif_sigma_sd1_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_SIGMA_FOVEON, exif_sigma_foveon_tag_table);
-	addMetadataModel(TagLib::EXIF_MAKERNOTE_APPLE_IOS, exif_apple_ios_tag_table);
-
-	// IPTC/NAA
-	addMetadataModel(TagLib::IPTC, iptc_tag_table);
-
-	// GeoTIFF
-	addMetadataModel(TagLib::GEOTIFF, geotiff_tag_table);
-
-	// Animation
-	addMetadataModel(TagLib::ANIMATION, animation_tag_table);
+	for(int i = 0; i <= ANIMATION; i++) {
+		_table_map[i] = NULL;
+	}
 }
 
-BOOL TagLib::addMetadataModel(MDMODEL md_model, TagInfo *tag_table) {
+BOOL TagLib::addMetadataModel(MDMODEL md_model, const TagInfo *tag_table) {
 	// check that the model doesn't already exist
-	if((_table_map.find(md_model) == _table_map.end()) && (tag_table != NULL)) {
+	if((_table_map[md_model] == NULL) && (tag_table != NULL)) {
+
+		size_t count = 0;
+		while((tag_table[count].tag != 0) || (tag_table[count].fieldname != NULL)) {
+			count++;
+		}
 
 		// add the tag description table
-		TAGINFO *info_map = new(std::nothrow) TAGINFO();
-		if(!info_map) return FALSE;
+		TAGINDEX *index = new(std::nothrow) TAGINDEX();
+		if(!index) return FALSE;
+
+		try {
+			index->by_id.resize(GetHashTableSize(count), NULL);
+			index->by_name.resize(GetHashTableSize(count), NULL);
+		} catch(std::bad_alloc &) {
+			delete index;
+			return FALSE;
+		}
 
-		for(int i = 0; ; i++) {
-			if((tag_table[i].tag == 0) && (tag_table[i].fieldname == NULL))
-				break;
-			(*info_map)[tag_table[i].tag] = &tag_table[i];
+		// a tag ID defined twice keeps its last definition
+		const size_t id_mask = index->by_id.size() - 1;
+		for(size_t i = 0; i < count; i++) {
+			size_t slot = HashTagID(tag_table[i].tag) & id_mask;
+			while(index->by_id[slot] && (index->by_id[slot]->tag != tag_table[i].tag)) {
+				slot = (slot + 1) & id_mask;
+			}
+			index->by_id[slot] = &tag_table[i];
+		}
+
+		// a field name defined twice keeps its lowest tag ID
+		const size_t name_mask = index->by_name.size() - 1;
+		for(size_t i = 0; i < count; i++) {
+			const TagInfo *info = &tag_table[i];
+			if(FindTagInfo(index->by_id, info->tag) != info) {
+				continue;
+			}
+			size_t slot = HashString(info->fieldname) & name_mask;
+			while(index->by_name[slot] && (strcmp(index->by_name[slot]->fieldname, info->fieldname) != 0)) {
+				slot = (slot + 1) & name_mask;
+			}
+			if(!index->by_name[slot] || (info->tag < index->by_name[slot]->tag)) {
+				index->by_name[slot] = info;
+			}
 		}
 
 		// add the metadata model
-		_table_map[md_model] = info_map;
+		_table_map[md_model] = index;
 
 		return TRUE;
 	}
@@ -1533,11 +1645,52 @@ BOOL TagLib::addMetadataModel(MDMODEL md_model, TagInfo *tag_table) {
 	return FALSE;
 }
 
+const TagLib::TAGINDEX*
+TagLib::getModelIndex(MDMODEL md_model) {
+	if((unsigned)md_model > ANIMATION) {
+		return NULL;
+	}
+	std::call_once(_table_once[md_model], &TagLib::addMetadataModel, this, md_model, GetModelTable(md_model));
+	return _table_map[md_model];
+}
+
+void TagLib::addStrings() {
+	// intern the field names and descriptions of all models
+	size_t count = 0;
+	for(int i = 0; i <= ANIMATION; i++) {
+		for(const TagInfo *info = GetModelTable((MDMODEL)i); info && ((info->tag != 0) || (info->fieldname != NULL)); info++) {
+			count += 2;
+		}
+	}
+	try {
+		_strings.resize(GetHashTableSize(count), NULL);
+		for(int i = 0; i <= ANIMATION; i++) {
+			for(const TagInfo *info = GetModelTable((MDMODEL)i); info && ((info->tag != 0) || (info->fieldname != NULL)); info++) {
+				addString(info->fieldname);
+				addString(info->description);
+			}
+		}
+	} catch(std::bad_alloc &) {
+		// strings are then copied into the tags
+		_strings.clear();
+	}
+}
+
+void TagLib::addString(const char *str) {
+	if(str && !findString(str)) {
+		const size_t mask = _strings.size() - 1;
+		size_t slot = HashString(str) & mask;
+		while(_strings[slot]) {
+			slot = (slot + 1) & mask;
+		}
+		_strings[slot] = str;
+	}
+}
+
 TagLib::~TagLib() {
 	// delete metadata models
-	for(TABLEMAP::iterator i = _table_map.begin(); i != _table_map.end(); i++) {
-		TAGINFO *info_map = (*i).second;
-		delete info_map;
+	for(int i = 0; i <= ANIMATION; i++) {
+		delete _table_map[i];
 	}
 }
 
@@ -1551,14 +1704,8 @@ TagLib::instance() {
 const TagInfo* 
 TagLib::getTagInfo(MDMODEL md_model, WORD tagID) {
 
-	if(_table_map.find(md_model) != _table_map.end()) {
-
-		TAGINFO *info_map = (TAGINFO*)_table_map[md_model];
-		if(info_map->find(tagID) != info_map->end()) {
-			return (*info_map)[tagID];
-		}
-	}
-	return NULL;
+	const TAGINDEX *index = getModelIndex(md_model);
+	return index ? FindTagInfo(index->by_id, tagID) : NULL;
 }
 
 const char* 
@@ -1590,19 +1737,39 @@ TagLib::getTagDescription(MDMODEL md_model, WORD tagID) {
 
 int TagLib::getTagID(MDMODEL md_model, const char *key) {
 
-	if(_table_map.find(md_model) != _table_map.end()) {
-
-		TAGINFO *info_map = (TAGINFO*)_table_map[md_model];
-		for(TAGINFO::iterator i = info_map->begin(); i != info_map->end(); i++) {
-			const TagInfo *info = (*i).second;
-			if(info && (strcmp(info->fieldname, key) == 0)) {
-				return (int)info->tag;
+	const TAGINDEX *index = getModelIndex(md_model);
+	if(index && key) {
+		const size_t mask = index->by_name.size() - 1;
+		for(size_t slot = HashString(key) & mask; index->by_name[slot]; slot = (slot + 1) & mask) {
+			if(strcmp(index->by_name[slot]->fieldname, key) == 0) {
+				return (int)index->by_name[slot]->tag;
 			}
 		}
 	}
 	return -1;
 }
 
+const char* 
+TagLib::internString(const char *str) {
+
+	std::call_once(_strings_once, &TagLib::addStrings, this);
+	return findString(str);
+}
+
+const char* 
+TagLib::findString(const char *str) const {
+
+	if(str && !_strings.empty()) {
+		const size_t mask = _strings.size() - 1;
+		for(size_t slot = HashString(str) & mask; _strings[slot]; slot = (slot + 1) & mask) {
+			if(strcmp(_strings[slot], str) == 0) {
+				return _strings[slot];
+			}
+		}
+	}
+	return NULL;
+}
+
 FREE_IMAGE_MDMODEL 
 TagLib::getFreeImageModel(MDMODEL model) {
 	switch(model) {
@@ -58,6 +58,40 @@ FI_STRUCT (PluginNode) {
 	const char *m_regexpr;
 };
 
+// =====================================================================
+//  Plugin name index
+// =====================================================================
+
+/**
+Case insensitive hash index from a name (format, file extension or MIME type)
+to the plugin nodes it designates. Names point to the plugin strings, which
+live as long as the plugin. A name designating several nodes has one entry
+per node, found in the order of increasing FIF.
+*/
+class PluginIndex {
+public :
+	PluginIndex();
+
+	void Add(const char *name, size_t length, PluginNode *node);
+	void AddList(const char *list, PluginNode *node);
+	PluginNode *Find(const char *name) const;
+
+private :
+	struct Entry {
+		const char *m_name;
+		size_t m_length;
+		PluginNode *m_node;
+	};
+
+	void Insert(int entry);
+	void Rehash(size_t size);
+
+	/** Indexed names */
+	std::vector<Entry> m_entries;
+	/** Open addressing table of entry indexes, -1 for an empty slot */
+	std::vector<int> m_slots;
+};
+
 // =====================================================================
 //  Internal Plugin List
 // =====================================================================
@@ -70,6 +104,7 @@ public :
 	FREE_IMAGE_FORMAT AddNode(FI_InitProc proc, void *instance = NULL, const char *format = 0, const char *description = 0, const char *extension = 0, const char *regexpr = 0);
 	PluginNode *FindNodeFromFormat(const char *format);
 	PluginNode *FindNodeFromMime(const char *mime);
+	PluginNode *FindNodeFromExtension(const char *extension);
 	PluginNode *FindNodeFromFIF(int node_id);
 
 	int Size() const;
@@ -78,6 +113,13 @@ public :
 private :
 	std::map<int, PluginNode *> m_plugin_map;
 	int m_node_count;
+
+	/** Format strings */
+	PluginIndex m_format_index;
+	/** MIME types */
+	PluginIndex m_mime_index;
+	/** Format strings and file extensions (see FreeImage_GetFIFFromFilename) */
+	PluginIndex m_extension_index;
 };
 
 // ==========================================================
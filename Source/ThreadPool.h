@@ -0,0 +1,137 @@
+// ==========================================================
+// Parallel loops on the library worker pool, progress of the library operations
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_THREADPOOL_H
+#define FREEIMAGE_THREADPOOL_H
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+
+/**
+Body of a parallel loop
+@param data User data of the loop
+@param first First iteration to run
+@param last Iteration following the last one to run
+*/
+typedef void (*FI_ParallelProc)(void *data, unsigned first, unsigned last);
+
+/**
+Run the iterations [0, count) of a loop on the calling thread and on the worker pool
+(or on the executor set with FreeImage_SetExecutor).<br>
+The iterations are split into chunks of chunk iterations, taken in turn by the threads
+until none is left, so that threads finishing early take more chunks. The calling thread
+takes part and the function returns once every chunk has run. Bodies must not throw and
+must not depend on the order of the chunks.<br>
+The loop runs on the calling thread alone when it has a single chunk, when the
+calling thread is limited to one thread (see FreeImage_SetMaxParallelism), or when it
+is called from the body of another parallel loop.<br>
+The calling thread reports the fraction of the chunks run (see FreeImage_ReportProgress).
+When the operation is cancelled, the chunks not started yet are skipped.
+@param count Number of iterations
+@param chunk Number of iterations of a chunk
+@param proc Loop body
+@param data User data given to proc
+@return Returns FALSE if the loop was cancelled before all its chunks had run
+*/
+BOOL FreeImage_ParallelFor(unsigned count, unsigned chunk, FI_ParallelProc proc, void *data);
+
+/**
+Run a task in the background, on the worker pool or on the executor set with
+FreeImage_SetExecutor. Once submitted, the task runs exactly once.
+@return Returns FALSE if the task cannot be submitted (e.g. with a thread count of 1),
+the caller then runs it
+*/
+BOOL FreeImage_SubmitTask(FI_TaskProc proc, void *task);
+
+/**
+Number of rows of a chunk of a parallel loop over the rows of an image,
+so that a chunk covers about 64K pixels
+*/
+inline unsigned
+FreeImage_GetRowChunk(unsigned width) {
+	return (width < 65536) ? (65536 / (width ? width : 1)) : 1;
+}
+
+// ----------------------------------------------------------
+
+/**
+Progress handler of a thread, and part of the operation run by the thread
+covered by the current step
+*/
+typedef struct tagFIPROGRESS {
+	FI_ProgressProc proc;
+	void *user_data;
+	double first;		//! progress of the operation at the start of the step
+	double range;		//! part of the operation covered by the step
+} FIPROGRESS;
+
+/**
+Report the progress of the operation run by the calling thread to the handler set
+with FreeImage_SetProgressHandler, and ask it whether the operation goes on.<br>
+Long operations call it at scanline, strip or band granularity. When it returns FALSE,
+they stop, free what they allocated (the partial bitmap included) and fail.
+Calls made from the body of a parallel loop are ignored, the loop reports its progress.
+@param done Fraction of the current step done, between 0 and 1
+@return Returns FALSE if the operation is cancelled
+*/
+BOOL FreeImage_ReportProgress(double done);
+
+/**
+A step of an operation. While it lives, the fractions reported on the calling thread
+are fractions of the part [first, last] of the enclosing step.
+*/
+class ProgressStep {
+public:
+	ProgressStep(double first, double last);
+	~ProgressStep();
+
+private:
+	FIPROGRESS m_enclosing;
+};
+
+/**
+Progress handler of the calling thread while it lives,
+the previous handler is restored when it ends
+*/
+class ProgressHandler {
+public:
+	ProgressHandler(FI_ProgressProc proc, void *user_data);
+	~ProgressHandler();
+
+private:
+	FIPROGRESS m_previous;
+};
+
+/**
+Watch for the cancellation of the operations run by the calling thread while it lives, 
+so that a failed operation can tell a cancellation from other errors. 
+Watches nest : a cancellation seen by a watch is also seen by the enclosing ones.
+*/
+class CancelWatch {
+public:
+	CancelWatch();
+	~CancelWatch();
+	/// Returns TRUE if the progress handler cancelled an operation since the watch was created
+	BOOL isCancelled() const;
+
+private:
+	BOOL m_enclosing;
+};
+
+#endif // FREEIMAGE_THREADPOOL_H
@@ -392,6 +392,108 @@ Rotate a dib according to Exif info
 */
 void RotateExif(FIBITMAP **dib);
 
+/**
+Convert a line of half-float (IEEE 754 binary16) pixels to float pixels.
+Source and destination may have either 3 (RGB) or 4 (RGBA) channels:
+the alpha channel is dropped or set to 1 as needed.
+The F16C instructions are used on x86 CPUs supporting them (checked at run time), 
+the FP16 NEON instructions are used when the compiler targets AArch64.
+@param dst Output float pixels
+@param dst_channels Number of channels in dst (3 or 4)
+@param src Input half-float pixels, stored as raw 16-bit words
+@param src_channels Number of channels in src (3 or 4)
+@param width_in_pixels Number of pixels to convert
+@see See definition in ConversionRGB16F.cpp
+*/
+void ConvertLineHalfToFloat(float *dst, unsigned dst_channels, const WORD *src, unsigned src_channels, unsigned width_in_pixels);
+
+/**
+Convert a line of float pixels to half-float (IEEE 754 binary16) pixels, with rounding to nearest.
+Source and destination may have either 3 (RGB) or 4 (RGBA) channels:
+the alpha channel is dropped or set to 1 as needed.
+@param dst Output half-float pixels, stored as raw 16-bit words
+@param dst_channels Number of channels in dst (3 or 4)
+@param src Input float pixels
+@param src_channels Number of channels in src (3 or 4)
+@param width_in_pixels Number of pixels to convert
+@see See definition in ConversionRGB16F.cpp
+*/
+void ConvertLineFloatToHalf(WORD *dst, unsigned dst_channels, const float *src, unsigned src_channels, unsigned width_in_pixels);
+
+/**
+Blend src bytes into dst bytes using a constant alpha : dst = (src * alpha + dst * (256 - alpha)) / 256
+@param dst Input / Output bytes
+@param src Input bytes
+@param count Number of bytes to blend
+@param alpha Constant alpha, in [0..255]
+@see See definition in Composite.cpp
+*/
+void BlendLineConstant(BYTE *dst, const BYTE *src, unsigned count, unsigned alpha);
+
+/**
+Composite a 32-bit foreground line over a 32-bit background line, using the foreground alpha channel :
+dst = (alpha * fg + (255 - alpha) * bg) >> 8, except for alpha 0 (dst = bg) and 255 (dst = fg).
+The dst alpha channel is set to 0xFF.
+@param dst Output 32-bit line (may be the same as bg)
+@param fg Foreground 32-bit line
+@param bg Background 32-bit line
+@param width_in_pixels Number of pixels to composite
+@see See definition in Composite.cpp
+*/
+void CompositeLineOverBackground(BYTE *dst, const BYTE *fg, const BYTE *bg, unsigned width_in_pixels);
+
+/**
+Premultiply the color channels of a 32-bit line with its alpha channel : channel = channel * alpha / 255 (rounded)
+@param bits Input / Output 32-bit line
+@param width_in_pixels Number of pixels to process
+@see See definition in Composite.cpp
+*/
+void PreMultiplyLine32(BYTE *bits, unsigned width_in_pixels);
+
+/**
+Inverse of PreMultiplyLine32 : channel = min(255, channel * 255 / alpha), or 0 when alpha is 0
+@param bits Input / Output 32-bit line
+@param width_in_pixels Number of pixels to process
+@see See definition in Composite.cpp
+*/
+void UnPreMultiplyLine32(BYTE *bits, unsigned width_in_pixels);
+
+/**
+Premultiply the color channels of a FIT_RGBA16 line with its alpha channel
+@see See definition in Composite.cpp
+*/
+void PreMultiplyLineRGBA16(FIRGBA16 *bits, unsigned width_in_pixels);
+
+/**
+Inverse of PreMultiplyLineRGBA16
+@see See definition in Composite.cpp
+*/
+void UnPreMultiplyLineRGBA16(FIRGBA16 *bits, unsigned width_in_pixels);
+
+/**
+Premultiply the color channels of a FIT_RGBAF line with its alpha channel
+@see See definition in Composite.cpp
+*/
+void PreMultiplyLineRGBAF(FIRGBAF *bits, unsigned width_in_pixels);
+
+/**
+Inverse of PreMultiplyLineRGBAF (colors are set to 0 when alpha is 0)
+@see See definition in Composite.cpp
+*/
+void UnPreMultiplyLineRGBAF(FIRGBAF *bits, unsigned width_in_pixels);
+
+/**
+Mirror an 8-, 24-, 32-bit or a FIT_UINT16, FIT_RGB16, FIT_RGBA16, FIT_FLOAT, FIT_RGBF, FIT_RGBAF image 
+along its main diagonal (transpose) or its anti-diagonal (transverse), in a single pass. 
+Diagonals refer to the displayed (top-down) image. 
+Palette, transparency table, background color and metadata are copied to the new image.
+@param src Input image
+@param bTransverse FALSE to transpose, TRUE to transverse
+@return Returns the new image if successful, returns NULL otherwise
+@see See definition in ClassicRotate.cpp
+*/
+FIBITMAP* TransposeBitmap(FIBITMAP *src, BOOL bTransverse);
+
 
 // ==========================================================
 //   Big Endian / Little Endian utility functions
@@ -64,6 +64,7 @@ int main(int argc, char *argv[]) {
 
 	// test plugins capabilities
 	showPlugins();
+	testFIFLookup();
 
 	// test the clone function
 	testAllocateCloneUnload("exif.jpg");
@@ -74,9 +75,18 @@ int main(int argc, char *argv[]) {
 	// test loading / saving / converting image types using the TIFF plugin
 	testImageTypeTIFF(width, height);
 
+	// test the worker pool
+	testThreads(width, height);
+	testAsync(width, height);
+	testProgress(width, height);
+
 	// test memory IO
 	testMemIO("sample.png");
 	testMemIO("exif.jxr");
+	testRLEMemIO(width, height);
+	testMappedIO(width, height);
+	testPNMMemIO(width, height);
+	testBufferedMemIO(width, height);
 
 	// test multipage functions
 	testMultiPage("sample.png");
@@ -98,6 +108,9 @@ int main(int argc, char *argv[]) {
 	
 	// test Exif raw metadata loading & saving
 	testExifRaw();
+	testExifIFD();
+	testRawMetadata();
+	testMetadataScan();
 
 	// test thumbnail functions
 	testThumbnail("exif.jpg", 0);
@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if (defined(WIN32) || defined(__WIN32__))
 #if (defined(_DEBUG))
@@ -40,10 +41,12 @@
 // Some useful tools
 // ==========================================================
 FIBITMAP* createZonePlateImage(unsigned width, unsigned height, int scale);
+void FreeImageErrorHandler(FREE_IMAGE_FORMAT fif, const char *message);
 
 // Test plugins capabilities
 // ==========================================================
 void showPlugins();
+void testFIFLookup();
 
 // Image types test suite
 // ==========================================================
@@ -52,6 +55,13 @@ BOOL testAllocateCloneUnloadType(FREE_IMAGE_TYPE image_type, unsigned width, uns
 void testImageType(unsigned width, unsigned height);
 void testImageTypeTIFF(unsigned width, unsigned height);
 
+// Multithreading test suite
+// ==========================================================
+
+void testThreads(unsigned width, unsigned height);
+void testAsync(unsigned width, unsigned height);
+void testProgress(unsigned width, unsigned height);
+
 // Header loading test suite
 // ==========================================================
 void testHeaderOnly();
@@ -59,11 +69,18 @@ void testHeaderOnly();
 // Exif raw metadata loading & saving test suite
 // ==========================================================
 void testExifRaw();
+void testExifIFD();
+void testRawMetadata();
+void testMetadataScan();
 
 // IO test suite
 // ==========================================================
 
 void testMemIO(const char *lpszPathName);
+void testRLEMemIO(unsigned width, unsigned height);
+void testMappedIO(unsigned width, unsigned height);
+void testPNMMemIO(unsigned width, unsigned height);
+void testBufferedMemIO(unsigned width, unsigned height);
 
 // Multipage test suite
 // ==========================================================
@@ -109,6 +109,356 @@ void testRGBAChannels(FREE_IMAGE_TYPE image_type, unsigned width, unsigned heigh
 	FreeImage_Unload(src);
 }
 
+void testAlphaComposite(unsigned width, unsigned height) {
+	BOOL bResult = FALSE;
+
+	// half transparent red over opaque blue
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 32);
+	FIBITMAP *src = FreeImage_Allocate(width / 2, height / 2, 32);
+	assert(dst && src);
+
+	RGBQUAD blue = { 255, 0, 0, 255 };
+	RGBQUAD red = { 0, 0, 255, 255 };
+	FreeImage_FillBackground(dst, &blue, FI_COLOR_IS_RGBA_COLOR);
+	FreeImage_FillBackground(src, &red, FI_COLOR_IS_RGBA_COLOR);
+	for(unsigned y = 0; y < FreeImage_GetHeight(src); y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < FreeImage_GetWidth(src); x++) {
+			bits[FI_RGBA_ALPHA] = 128;
+			bits += 4;
+		}
+	}
+
+	bResult = FreeImage_AlphaComposite(dst, src, 0, 0, FIBM_SRC_OVER, FALSE, 1.0);
+	assert(bResult);
+
+	// top-left pixel is blended, bottom-left pixel is untouched
+	RGBQUAD value;
+	FreeImage_GetPixelColor(dst, 0, height - 1, &value);
+	assert((abs(value.rgbRed - 128) <= 1) && (abs(value.rgbBlue - 127) <= 1) && (value.rgbReserved == 255));
+	FreeImage_GetPixelColor(dst, 0, 0, &value);
+	assert((value.rgbRed == 0) && (value.rgbBlue == 255));
+
+	// same result with premultiplied colors
+	FreeImage_PreMultiplyWithAlpha(src);
+	FreeImage_FillBackground(dst, &blue, FI_COLOR_IS_RGBA_COLOR);
+	bResult = FreeImage_AlphaComposite(dst, src, 0, 0, FIBM_SRC_OVER, TRUE, 1.0);
+	assert(bResult);
+	FreeImage_GetPixelColor(dst, 0, height - 1, &value);
+	assert((abs(value.rgbRed - 128) <= 1) && (abs(value.rgbBlue - 127) <= 1) && (value.rgbReserved == 255));
+
+	// out of bounds
+	bResult = FreeImage_AlphaComposite(dst, src, width, 0, FIBM_SRC_OVER, FALSE, 1.0);
+	assert(!bResult);
+
+	FreeImage_Unload(src);
+	FreeImage_Unload(dst);
+}
+
+void testPreMultiply(FREE_IMAGE_TYPE image_type, unsigned width, unsigned height) {
+	BOOL bResult = FALSE;
+
+	FIBITMAP *src = (image_type == FIT_BITMAP) ? FreeImage_Allocate(width, height, 32) : FreeImage_AllocateT(image_type, width, height);
+	assert(src != NULL);
+
+	// opaque and fully transparent pixels only : the round trip is lossless, transparent colors become black
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++) {
+			BYTE *pixel = bits + x * bytespp;
+			const BOOL bOpaque = (x & 1) ? TRUE : FALSE;
+			switch(image_type) {
+				case FIT_BITMAP:
+					pixel[FI_RGBA_RED] = (BYTE)x;
+					pixel[FI_RGBA_GREEN] = (BYTE)y;
+					pixel[FI_RGBA_BLUE] = 0x80;
+					pixel[FI_RGBA_ALPHA] = bOpaque ? 0xFF : 0;
+					break;
+				case FIT_RGBA16:
+					((FIRGBA16*)pixel)->red = (WORD)(x * 256);
+					((FIRGBA16*)pixel)->green = (WORD)(y * 256);
+					((FIRGBA16*)pixel)->blue = 0x8000;
+					((FIRGBA16*)pixel)->alpha = bOpaque ? 0xFFFF : 0;
+					break;
+				case FIT_RGBAF:
+					((FIRGBAF*)pixel)->red = x / 256.0F;
+					((FIRGBAF*)pixel)->green = y / 256.0F;
+					((FIRGBAF*)pixel)->blue = 0.5F;
+					((FIRGBAF*)pixel)->alpha = bOpaque ? 1.0F : 0;
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	FIBITMAP *dst = FreeImage_Clone(src);
+	assert(dst != NULL);
+	bResult = FreeImage_PreMultiplyWithAlpha(dst);
+	assert(bResult);
+	bResult = FreeImage_UnPreMultiplyWithAlpha(dst);
+	assert(bResult);
+
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		const BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++) {
+			if(x & 1) {
+				for(unsigned k = 0; k < bytespp; k++) {
+					assert(src_bits[x * bytespp + k] == dst_bits[x * bytespp + k]);
+				}
+			}
+		}
+	}
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(src);
+}
+
+void testPreMultiplyAlpha(FREE_IMAGE_TYPE image_type) {
+	BOOL bResult = FALSE;
+
+	// intermediate alpha values, at every position of a line (vectorized blocks and scalar tail)
+	const unsigned width = 259;
+	const unsigned height = 16;
+
+	FIBITMAP *src = (image_type == FIT_BITMAP) ? FreeImage_Allocate(width, height, 32) : FreeImage_AllocateT(image_type, width, height);
+	assert(src != NULL);
+
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++) {
+			switch(image_type) {
+				case FIT_BITMAP:
+					bits[4 * x + FI_RGBA_RED] = (BYTE)(x * 7);
+					bits[4 * x + FI_RGBA_GREEN] = (BYTE)(255 - y * 9);
+					bits[4 * x + FI_RGBA_BLUE] = 0xC0;
+					bits[4 * x + FI_RGBA_ALPHA] = (BYTE)(x + y);
+					break;
+				case FIT_RGBA16:
+					((FIRGBA16*)bits)[x].red = (WORD)(x * 1013);
+					((FIRGBA16*)bits)[x].green = (WORD)(65535 - y * 2311);
+					((FIRGBA16*)bits)[x].blue = 0xC0C0;
+					((FIRGBA16*)bits)[x].alpha = (WORD)(x * 253 + y * 4099);
+					break;
+				case FIT_RGBAF:
+					((FIRGBAF*)bits)[x].red = (x % 64) / 63.0F;
+					((FIRGBAF*)bits)[x].green = 1 - y / 16.0F;
+					((FIRGBAF*)bits)[x].blue = 0.75F;
+					((FIRGBAF*)bits)[x].alpha = ((x + y) % 256) / 255.0F;
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	FIBITMAP *pre = FreeImage_Clone(src);
+	assert(pre != NULL);
+	bResult = FreeImage_PreMultiplyWithAlpha(pre);
+	assert(bResult);
+	FIBITMAP *dst = FreeImage_Clone(pre);
+	assert(dst != NULL);
+	bResult = FreeImage_UnPreMultiplyWithAlpha(dst);
+	assert(bResult);
+
+	// premultiply : channel = (channel * alpha + max / 2) / max
+	// unpremultiply : channel = min(max, (channel * max + alpha / 2) / alpha), or 0 when alpha is 0
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		const BYTE *pre_bits = FreeImage_GetScanLine(pre, y);
+		const BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++) {
+			if(image_type == FIT_BITMAP) {
+				const BYTE *s = src_bits + 4 * x;
+				const BYTE *p = pre_bits + 4 * x;
+				const BYTE *d = dst_bits + 4 * x;
+				const unsigned alpha = s[FI_RGBA_ALPHA];
+				assert((p[FI_RGBA_ALPHA] == alpha) && (d[FI_RGBA_ALPHA] == alpha));
+				for(unsigned c = 0; c < 3; c++) {
+					assert(p[c] == (s[c] * alpha + 127) / 255);
+					const unsigned value = (alpha == 0) ? 0 : (p[c] * 255 + alpha / 2) / alpha;
+					assert(d[c] == ((value < 255) ? value : 255));
+					// the round trip is within 1 for alpha >= 128
+					assert((alpha < 128) || (abs((int)d[c] - (int)s[c]) <= 1));
+				}
+			}
+			else if(image_type == FIT_RGBA16) {
+				const WORD *s = (const WORD*)((const FIRGBA16*)src_bits + x);
+				const WORD *p = (const WORD*)((const FIRGBA16*)pre_bits + x);
+				const WORD *d = (const WORD*)((const FIRGBA16*)dst_bits + x);
+				const unsigned alpha = s[3];
+				assert((p[3] == alpha) && (d[3] == alpha));
+				for(unsigned c = 0; c < 3; c++) {
+					assert(p[c] == (s[c] * alpha + 32767) / 65535);
+					const unsigned value = (alpha == 0) ? 0 : (p[c] * 65535U + alpha / 2) / alpha;
+					assert(d[c] == ((value < 65535) ? value : 65535));
+					assert((alpha < 32768) || (abs((int)d[c] - (int)s[c]) <= 1));
+				}
+			}
+			else if(image_type == FIT_RGBAF) {
+				const float *s = (const float*)((const FIRGBAF*)src_bits + x);
+				const float *p = (const float*)((const FIRGBAF*)pre_bits + x);
+				const float *d = (const float*)((const FIRGBAF*)dst_bits + x);
+				const float alpha = s[3];
+				assert((p[3] == alpha) && (d[3] == alpha));
+				for(unsigned c = 0; c < 3; c++) {
+					assert(fabs(p[c] - s[c] * alpha) <= 1e-6F);
+					assert(fabs(d[c] - ((alpha > 0) ? s[c] : 0)) <= 1e-3F);
+				}
+			}
+		}
+	}
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(pre);
+	FreeImage_Unload(src);
+}
+
+void testPreMultipliedRescale() {
+	// opaque red on the left, fully transparent green on the right
+	FIBITMAP *src = FreeImage_Allocate(32, 32, 32);
+	assert(src != NULL);
+	for(unsigned y = 0; y < 32; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < 32; x++, bits += 4) {
+			const BOOL bOpaque = (x < 16) ? TRUE : FALSE;
+			bits[FI_RGBA_RED] = bOpaque ? 255 : 0;
+			bits[FI_RGBA_GREEN] = bOpaque ? 0 : 255;
+			bits[FI_RGBA_BLUE] = 0;
+			bits[FI_RGBA_ALPHA] = bOpaque ? 255 : 0;
+		}
+	}
+
+	// filtering straight colors bleeds the hidden green into the edge pixels (halo)
+	FIBITMAP *straight = FreeImage_RescaleRect(src, 64, 64, 0, 0, 32, 32, FILTER_BILINEAR, FI_RESCALE_DEFAULT);
+	// filtering premultiplied colors leaves the edge pixels pure red
+	FIBITMAP *dst = FreeImage_RescaleRect(src, 64, 64, 0, 0, 32, 32, FILTER_BILINEAR, FI_RESCALE_PREMULTIPLY_ALPHA);
+	assert(straight && dst);
+	assert((FreeImage_GetBPP(dst) == 32) && (FreeImage_GetWidth(dst) == 64) && (FreeImage_GetHeight(dst) == 64));
+
+	unsigned edge_pixels = 0;
+	BOOL bHalo = FALSE;
+	for(unsigned y = 0; y < 64; y++) {
+		const BYTE *straight_bits = FreeImage_GetScanLine(straight, y);
+		const BYTE *bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < 64; x++, straight_bits += 4, bits += 4) {
+			const unsigned alpha = bits[FI_RGBA_ALPHA];
+			if((alpha > 0) && (alpha < 255)) {
+				edge_pixels++;
+				assert((bits[FI_RGBA_RED] >= 254) && (bits[FI_RGBA_GREEN] <= 1) && (bits[FI_RGBA_BLUE] == 0));
+				if(straight_bits[FI_RGBA_GREEN] > 1) {
+					bHalo = TRUE;
+				}
+			}
+			if(alpha == 255) {
+				assert((bits[FI_RGBA_RED] == 255) && (bits[FI_RGBA_GREEN] == 0));
+			}
+		}
+	}
+	assert((edge_pixels > 0) && bHalo);
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(straight);
+	FreeImage_Unload(src);
+}
+
+void testComposite(unsigned width, unsigned height) {
+	// every alpha value at every position of a line, so that both the vectorized blocks 
+	// and the scalar tail of the line compositing are covered
+	FIBITMAP *fg = FreeImage_Allocate(width, height, 32);
+	FIBITMAP *bg = FreeImage_Allocate(width, height, 24);
+	assert(fg && bg);
+
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
+		BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
+		for(unsigned x = 0; x < width; x++, fg_bits += 4, bg_bits += 3) {
+			fg_bits[FI_RGBA_RED] = (BYTE)(x * 7);
+			fg_bits[FI_RGBA_GREEN] = (BYTE)(255 - y);
+			fg_bits[FI_RGBA_BLUE] = 0xC0;
+			fg_bits[FI_RGBA_ALPHA] = (BYTE)(x + y);
+			bg_bits[FI_RGBA_RED] = (BYTE)y;
+			bg_bits[FI_RGBA_GREEN] = (BYTE)(x * 3);
+			bg_bits[FI_RGBA_BLUE] = 0x30;
+		}
+	}
+
+	FIBITMAP *dst = FreeImage_Composite(fg, FALSE, NULL, bg);
+	assert(dst && (FreeImage_GetBPP(dst) == 24));
+
+	// dst = (alpha * fg + (255 - alpha) * bg) >> 8, fg and bg for alpha 255 and 0
+	for(unsigned y = 0; y < height; y++) {
+		const BYTE *fg_bits = FreeImage_GetScanLine(fg, y);
+		const BYTE *bg_bits = FreeImage_GetScanLine(bg, y);
+		const BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x = 0; x < width; x++, fg_bits += 4, bg_bits += 3, dst_bits += 3) {
+			const unsigned alpha = fg_bits[FI_RGBA_ALPHA];
+			for(unsigned c = 0; c < 3; c++) {
+				const unsigned value = (alpha == 0) ? bg_bits[c] : ((alpha == 255) ? fg_bits[c] : (alpha * fg_bits[c] + (255 - alpha) * bg_bits[c]) >> 8);
+				assert(dst_bits[c] == value);
+			}
+		}
+	}
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(bg);
+	FreeImage_Unload(fg);
+}
+
+void testHistogram(unsigned width, unsigned height) {
+	DWORD histo[5][256], check[5][256];
+	BOOL bResult = FALSE;
+
+	// create a 32-bit image with pseudo random pixels
+	FIBITMAP *src = FreeImage_Allocate(width, height, 32);
+	assert(src != NULL);
+	memset(check, 0, sizeof(check));
+	unsigned seed = 1;
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++, bits += 4) {
+			for(unsigned c = 0; c < 4; c++) {
+				seed = seed * 1103515245 + 12345;
+				bits[c] = (BYTE)(seed >> 16);
+			}
+			check[0][bits[FI_RGBA_RED]]++;
+			check[1][bits[FI_RGBA_GREEN]]++;
+			check[2][bits[FI_RGBA_BLUE]]++;
+			check[3][bits[FI_RGBA_ALPHA]]++;
+			check[4][(BYTE)(0.2126F * bits[FI_RGBA_RED] + 0.7152F * bits[FI_RGBA_GREEN] + 0.0722F * bits[FI_RGBA_BLUE] + 0.5F)]++;
+		}
+	}
+
+	// all channels in a single pass
+	bResult = FreeImage_GetHistogramEx(src, histo[0], histo[1], histo[2], histo[3], histo[4]);
+	assert(bResult);
+	assert(memcmp(histo, check, sizeof(check)) == 0);
+
+	// one channel at a time
+	bResult = FreeImage_GetHistogram(src, histo[1], FICC_GREEN);
+	assert(bResult);
+	assert(memcmp(histo[1], check[1], sizeof(check[1])) == 0);
+
+	// binned histogram of the same samples as floats
+	FIBITMAP *rgbaf = FreeImage_ConvertToRGBAF(src);
+	assert(rgbaf != NULL);
+	bResult = FreeImage_GetHistogramEx(rgbaf, histo[0], NULL, NULL, histo[3], NULL, 16, 0, 1);
+	assert(bResult);
+	for(unsigned i = 0; i < 16; i++) {
+		DWORD red = 0, alpha = 0;
+		for(unsigned k = 0; k < 16; k++) {
+			red += check[0][i * 16 + k];
+			alpha += check[3][i * 16 + k];
+		}
+		assert((histo[0][i] == red) && (histo[3][i] == alpha));
+	}
+	FreeImage_Unload(rgbaf);
+
+	FreeImage_Unload(src);
+}
+
 // Main test functions
 // ----------------------------------------------------------
 
@@ -124,4 +474,21 @@ void testImageChannels(unsigned width, unsigned height) {
 
 	testRGBAChannels(FIT_RGBF, width, height, FALSE);
 	testRGBAChannels(FIT_RGBAF, width, height, TRUE);
+
+	testAlphaComposite(width, height);
+
+	// 64 blocks of 4 pixels and a 3 pixels tail
+	testComposite(259, 256);
+
+	testPreMultiply(FIT_BITMAP, width, height);
+	testPreMultiply(FIT_RGBA16, width, height);
+	testPreMultiply(FIT_RGBAF, width, height);
+
+	testPreMultiplyAlpha(FIT_BITMAP);
+	testPreMultiplyAlpha(FIT_RGBA16);
+	testPreMultiplyAlpha(FIT_RGBAF);
+
+	testPreMultipliedRescale();
+
+	testHistogram(width, height);
 }
@@ -22,6 +22,9 @@
 
 #include "TestSuite.h"
 
+#include <atomic>
+#include <thread>
+
 // Local test functions
 // ----------------------------------------------------------
 
@@ -209,6 +212,290 @@ testExifRawFile(const char *lpszPathName, int load_flags, int save_flags) {
 	return FALSE; 
 }
 
+/**
+Save a bitmap to a memory stream
+@return Returns the stream, or NULL if the save failed
+*/
+static FIMEMORY* 
+saveToMemory(FREE_IMAGE_FORMAT fif, FIBITMAP *dib) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	if(hmem && !FreeImage_SaveToMemory(fif, dib, hmem, 0)) {
+		FreeImage_CloseMemory(hmem);
+		hmem = NULL;
+	}
+	return hmem;
+}
+
+/**
+Test the Exif IFD written by JPEG-XR, saved twice with the same tags, then with a modified tag
+*/
+static BOOL 
+testExifIFDFile(const char *lpszPathName) {
+	FIBITMAP *dib = NULL, *dst = NULL;
+	FIMEMORY *hmem1 = NULL, *hmem2 = NULL, *hmem3 = NULL;
+
+	try {
+		dib = FreeImage_Load(FreeImage_GetFIFFromFilename(lpszPathName), lpszPathName, 0);
+		if(!dib) throw(1);
+
+		FITAG *tag = NULL;
+		if(!FreeImage_GetMetadata(FIMD_EXIF_EXIF, dib, "DateTimeOriginal", &tag)) throw(1);
+
+		// the second save reuses the IFD serialized by the first one
+		hmem1 = saveToMemory(FIF_JXR, dib);
+		hmem2 = saveToMemory(FIF_JXR, dib);
+		if(!hmem1 || !hmem2) throw(1);
+
+		BYTE *data1 = NULL, *data2 = NULL;
+		DWORD size1 = 0, size2 = 0;
+		FreeImage_AcquireMemory(hmem1, &data1, &size1);
+		FreeImage_AcquireMemory(hmem2, &data2, &size2);
+		if((size1 != size2) || (memcmp(data1, data2, size1) != 0)) throw(1);
+
+		// a tag modified in place must be written
+		((char*)FreeImage_GetTagValue(tag))[0] = '1';
+		hmem3 = saveToMemory(FIF_JXR, dib);
+		if(!hmem3) throw(1);
+
+		FreeImage_SeekMemory(hmem3, 0, SEEK_SET);
+		dst = FreeImage_LoadFromMemory(FIF_JXR, hmem3, 0);
+		if(!dst) throw(1);
+
+		FITAG *dst_tag = NULL;
+		if(!FreeImage_GetMetadata(FIMD_EXIF_EXIF, dst, "DateTimeOriginal", &dst_tag)) throw(1);
+		if(strcmp((char*)FreeImage_GetTagValue(tag), (char*)FreeImage_GetTagValue(dst_tag)) != 0) throw(1);
+
+		FreeImage_Unload(dst);
+		FreeImage_CloseMemory(hmem3);
+		FreeImage_CloseMemory(hmem2);
+		FreeImage_CloseMemory(hmem1);
+		FreeImage_Unload(dib);
+
+		return TRUE;
+	} 
+	catch(int) {
+		if(dst) FreeImage_Unload(dst);
+		if(hmem3) FreeImage_CloseMemory(hmem3);
+		if(hmem2) FreeImage_CloseMemory(hmem2);
+		if(hmem1) FreeImage_CloseMemory(hmem1);
+		if(dib) FreeImage_Unload(dib); 
+	}
+	
+	return FALSE; 
+}
+
+/**
+Check that two bitmaps hold the same number of tags in the Exif and IPTC models
+*/
+static BOOL 
+sameMetadataCount(FIBITMAP *dib1, FIBITMAP *dib2) {
+	const FREE_IMAGE_MDMODEL models[] = { FIMD_EXIF_MAIN, FIMD_EXIF_EXIF, FIMD_EXIF_GPS, FIMD_EXIF_MAKERNOTE, FIMD_EXIF_INTEROP, FIMD_IPTC };
+	for(int i = 0; i < (int)(sizeof(models) / sizeof(models[0])); i++) {
+		if(FreeImage_GetMetadataCount(models[i], dib1) != FreeImage_GetMetadataCount(models[i], dib2)) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Read the tags of a bitmap loaded with FIF_LOAD_RAWMETADATA, from one of several threads
+*/
+static void
+readRawMetadata(FIBITMAP *raw, FIBITMAP *eager, std::atomic<int> *failures) {
+	// models without a raw profile are looked up while another thread parses the Exif profile
+	if(FreeImage_GetMetadataCount(FIMD_COMMENTS, raw) != FreeImage_GetMetadataCount(FIMD_COMMENTS, eager)) {
+		(*failures)++;
+	}
+	FITAG *tag = NULL;
+	if(!FreeImage_GetMetadata(FIMD_IPTC, raw, "Caption-Abstract", &tag) || (strcmp((char*)FreeImage_GetTagValue(tag), "FreeImage") != 0)) {
+		(*failures)++;
+	}
+	if(!sameMetadataCount(eager, raw)) {
+		(*failures)++;
+	}
+}
+
+/**
+Test the Exif and IPTC profiles loaded with FIF_LOAD_RAWMETADATA, written as is then decoded on demand
+*/
+static BOOL 
+testRawMetadataFile(const char *lpszPathName) {
+	FIBITMAP *dib = NULL, *eager = NULL, *raw = NULL, *clone = NULL, *dst = NULL;
+	FIMEMORY *hmem1 = NULL, *hmem2 = NULL;
+
+	try {
+		// add an IPTC profile to an Exif file
+		dib = FreeImage_Load(FreeImage_GetFIFFromFilename(lpszPathName), lpszPathName, 0);
+		if(!dib) throw(1);
+		if(!FreeImage_SetMetadataKeyValue(FIMD_IPTC, dib, "Caption-Abstract", "FreeImage")) throw(1);
+		hmem1 = saveToMemory(FIF_JPEG, dib);
+		if(!hmem1) throw(1);
+
+		FreeImage_SeekMemory(hmem1, 0, SEEK_SET);
+		eager = FreeImage_LoadFromMemory(FIF_JPEG, hmem1, 0);
+		FreeImage_SeekMemory(hmem1, 0, SEEK_SET);
+		raw = FreeImage_LoadFromMemory(FIF_JPEG, hmem1, FIF_LOAD_RAWMETADATA);
+		if(!eager || !raw) throw(1);
+
+		// the profiles are written without being decoded
+		hmem2 = saveToMemory(FIF_JPEG, raw);
+		if(!hmem2) throw(1);
+		FreeImage_SeekMemory(hmem2, 0, SEEK_SET);
+		dst = FreeImage_LoadFromMemory(FIF_JPEG, hmem2, 0);
+		if(!dst) throw(1);
+		if(!sameMetadataCount(eager, dst)) throw(1);
+
+		FITAG *tag = NULL;
+		if(!FreeImage_GetMetadata(FIMD_IPTC, dst, "Caption-Abstract", &tag)) throw(1);
+		if(strcmp((char*)FreeImage_GetTagValue(tag), "FreeImage") != 0) throw(1);
+
+		// a clone gets the profiles not decoded yet
+		clone = FreeImage_Clone(raw);
+		if(!clone) throw(1);
+		if(!sameMetadataCount(eager, clone)) throw(1);
+
+		// the profiles are decoded on first access
+		if(!sameMetadataCount(eager, raw)) throw(1);
+		if(FreeImage_GetMetadataCount(FIMD_EXIF_MAIN, raw) == 0) throw(1);
+
+		// concurrent reads wait for the profiles decoded by the first one
+		for(int pass = 0; pass < 8; pass++) {
+			FreeImage_Unload(raw);
+			FreeImage_SeekMemory(hmem1, 0, SEEK_SET);
+			raw = FreeImage_LoadFromMemory(FIF_JPEG, hmem1, FIF_LOAD_RAWMETADATA);
+			if(!raw) throw(1);
+
+			std::atomic<int> failures(0);
+			std::thread readers[4];
+			for(int i = 0; i < 4; i++) {
+				readers[i] = std::thread(readRawMetadata, raw, eager, &failures);
+			}
+			for(int i = 0; i < 4; i++) {
+				readers[i].join();
+			}
+			if(failures != 0) throw(1);
+		}
+
+		FreeImage_Unload(clone);
+		FreeImage_Unload(dst);
+		FreeImage_Unload(raw);
+		FreeImage_Unload(eager);
+		FreeImage_CloseMemory(hmem2);
+		FreeImage_CloseMemory(hmem1);
+		FreeImage_Unload(dib);
+
+		return TRUE;
+	} 
+	catch(int) {
+		if(clone) FreeImage_Unload(clone);
+		if(dst) FreeImage_Unload(dst);
+		if(raw) FreeImage_Unload(raw);
+		if(eager) FreeImage_Unload(eager);
+		if(hmem2) FreeImage_CloseMemory(hmem2);
+		if(hmem1) FreeImage_CloseMemory(hmem1);
+		if(dib) FreeImage_Unload(dib); 
+	}
+	
+	return FALSE; 
+}
+
+/**
+Compare the scan of a file with its header and tags loaded by FreeImage_Load
+*/
+static BOOL 
+sameScanResult(FIMETADATASCAN *scan, int index, const char *lpszPathName, const FIMETADATAKEY *keys, int key_count) {
+	FIBITMAP *dib = FreeImage_Load(FreeImage_GetFileType(lpszPathName), lpszPathName, FIF_LOAD_NOPIXELS);
+	if(!dib) {
+		return FALSE;
+	}
+
+	BOOL bResult = (FreeImage_GetScanImageType(scan, index) == FreeImage_GetImageType(dib))
+		&& (FreeImage_GetScanWidth(scan, index) == FreeImage_GetWidth(dib))
+		&& (FreeImage_GetScanHeight(scan, index) == FreeImage_GetHeight(dib))
+		&& (FreeImage_GetScanBPP(scan, index) == FreeImage_GetBPP(dib));
+
+	for(int k = 0; bResult && (k < key_count); k++) {
+		FITAG *tag = NULL;
+		FreeImage_GetMetadata(keys[k].model, dib, keys[k].key, &tag);
+		FITAG *scan_tag = FreeImage_GetScanTag(scan, index, k);
+		if(!tag || !scan_tag) {
+			bResult = (tag == scan_tag);
+		} else {
+			bResult = (FreeImage_GetTagType(tag) == FreeImage_GetTagType(scan_tag))
+				&& (FreeImage_GetTagLength(tag) == FreeImage_GetTagLength(scan_tag))
+				&& (memcmp(FreeImage_GetTagValue(tag), FreeImage_GetTagValue(scan_tag), FreeImage_GetTagLength(tag)) == 0);
+		}
+	}
+
+	FreeImage_Unload(dib);
+
+	return bResult;
+}
+
+/**
+Test a batch scan of files and of handles, a missing file included
+*/
+static BOOL 
+testMetadataScanFiles(const char **files, int count) {
+	const FIMETADATAKEY keys[] = {
+		{ FIMD_EXIF_MAIN, "Make" },
+		{ FIMD_EXIF_EXIF, "ExposureTime" },
+		{ FIMD_COMMENTS, "Comment" }
+	};
+	const int key_count = sizeof(keys) / sizeof(keys[0]);
+
+	FIMETADATASCAN *scan = FreeImage_ScanMetadata(files, count, keys, key_count);
+	if(!scan) {
+		return FALSE;
+	}
+
+	BOOL bResult = (FreeImage_GetScanCount(scan) == count);
+	for(int i = 0; bResult && (i < count); i++) {
+		const FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(files[i]);
+		bResult = (FreeImage_GetScanFormat(scan, i) == fif);
+		if(bResult && (fif != FIF_UNKNOWN)) {
+			bResult = sameScanResult(scan, i, files[i], keys, key_count);
+		}
+	}
+	// out of range queries
+	bResult = bResult && (FreeImage_GetScanTag(scan, count, 0) == NULL) && (FreeImage_GetScanTag(scan, 0, key_count) == NULL);
+
+	// same scan through user handles
+	FreeImageIO io;
+	io.read_proc = (FI_ReadProc)fread;
+	io.write_proc = (FI_WriteProc)fwrite;
+	io.seek_proc = (FI_SeekProc)fseek;
+	io.tell_proc = (FI_TellProc)ftell;
+
+	fi_handle *handles = (fi_handle*)malloc(count * sizeof(fi_handle));
+	if(!handles) {
+		FreeImage_CloseMetadataScan(scan);
+		return FALSE;
+	}
+	for(int i = 0; i < count; i++) {
+		handles[i] = (fi_handle)fopen(files[i], "rb");
+	}
+	FIMETADATASCAN *handle_scan = FreeImage_ScanMetadataFromHandle(&io, handles, count, keys, key_count);
+	bResult = bResult && handle_scan;
+	for(int i = 0; bResult && (i < count); i++) {
+		bResult = (FreeImage_GetScanFormat(handle_scan, i) == FreeImage_GetScanFormat(scan, i))
+			&& (FreeImage_GetScanWidth(handle_scan, i) == FreeImage_GetScanWidth(scan, i));
+		for(int k = 0; bResult && (k < key_count); k++) {
+			bResult = ((FreeImage_GetScanTag(handle_scan, i, k) == NULL) == (FreeImage_GetScanTag(scan, i, k) == NULL));
+		}
+	}
+	for(int i = 0; i < count; i++) {
+		if(handles[i]) fclose((FILE*)handles[i]);
+	}
+	free(handles);
+
+	FreeImage_CloseMetadataScan(handle_scan);
+	FreeImage_CloseMetadataScan(scan);
+
+	return bResult;
+}
+
 // Main test functions
 // ----------------------------------------------------------
 
@@ -255,3 +542,39 @@ void testExifRaw() {
 	assert(bResult);
 
 }
+
+void testExifIFD() {
+	const char *src_file_jpg = "exif.jpg";
+
+	BOOL bResult = TRUE;
+
+	printf("testExifIFD ...\n");
+
+	// Exif IFD serialization
+	bResult = testExifIFDFile(src_file_jpg);
+	assert(bResult);
+}
+
+void testRawMetadata() {
+	const char *src_file_jpg = "exif.jpg";
+
+	BOOL bResult = TRUE;
+
+	printf("testRawMetadata ...\n");
+
+	// Exif and IPTC passthrough
+	bResult = testRawMetadataFile(src_file_jpg);
+	assert(bResult);
+}
+
+void testMetadataScan() {
+	const char *files[] = { "exif.jpg", "sample.png", "missing.jpg", "exif.jpg", "sample.tif" };
+
+	BOOL bResult = TRUE;
+
+	printf("testMetadataScan ...\n");
+
+	// batch metadata scan
+	bResult = testMetadataScanFiles(files, sizeof(files) / sizeof(files[0]));
+	assert(bResult);
+}
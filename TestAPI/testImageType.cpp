@@ -416,6 +416,531 @@ BOOL testLoadSaveConvertComplexType(FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL chan
 	return TRUE;
 }
 
+BOOL testConvertHalfType(unsigned width, unsigned height) {
+	FIBITMAP *src = NULL;
+	FIBITMAP *half = NULL;
+	FIBITMAP *chk = NULL;
+	unsigned x, y;
+
+	try {
+		// create a RGBAF test image
+		src = FreeImage_AllocateT(FIT_RGBAF, width, height);
+		if(!src) throw(1);
+		for(y = 0; y < height; y++) {
+			FIRGBAF *bits = (FIRGBAF *)FreeImage_GetScanLine(src, y);
+			for(x = 0; x < width; x++) {
+				bits[x].red = (float)x / width;
+				bits[x].green = (float)y / height;
+				bits[x].blue = 4.0F * x / width;
+				bits[x].alpha = 0.5F;
+			}
+		}
+
+		// RGBAF => RGB16F => RGBAF (alpha is dropped, then set to 1)
+		half = FreeImage_ConvertToType(src, FIT_RGB16F);
+		if(!half) throw(1);
+		chk = FreeImage_ConvertToType(half, FIT_RGBAF);
+		if(!chk) throw(1);
+		for(y = 0; y < height; y++) {
+			FIRGBAF *src_bits = (FIRGBAF *)FreeImage_GetScanLine(src, y);
+			FIRGBAF *chk_bits = (FIRGBAF *)FreeImage_GetScanLine(chk, y);
+			for(x = 0; x < width; x++) {
+				// half precision : 10-bit mantissa
+				if(fabs(chk_bits[x].red - src_bits[x].red) > 1e-3F * (1 + src_bits[x].red)) throw(1);
+				if(fabs(chk_bits[x].green - src_bits[x].green) > 1e-3F * (1 + src_bits[x].green)) throw(1);
+				if(fabs(chk_bits[x].blue - src_bits[x].blue) > 1e-3F * (1 + src_bits[x].blue)) throw(1);
+				if(chk_bits[x].alpha != 1.0F) throw(1);
+			}
+		}
+		FreeImage_Unload(half);
+		FreeImage_Unload(chk);
+		chk = NULL;
+
+		// RGBAF => RGBA16F => RGBF
+		half = FreeImage_ConvertToType(src, FIT_RGBA16F);
+		if(!half) throw(1);
+		chk = FreeImage_ConvertToType(half, FIT_RGBF);
+		if(!chk) throw(1);
+		for(y = 0; y < height; y++) {
+			FIRGBAF *src_bits = (FIRGBAF *)FreeImage_GetScanLine(src, y);
+			FIRGBF *chk_bits = (FIRGBF *)FreeImage_GetScanLine(chk, y);
+			for(x = 0; x < width; x++) {
+				if(fabs(chk_bits[x].blue - src_bits[x].blue) > 1e-3F * (1 + src_bits[x].blue)) throw(1);
+			}
+		}
+		FreeImage_Unload(chk);
+		chk = NULL;
+
+		// RGBA16F => 32-bit (values are clamped to [0..1])
+		chk = FreeImage_ConvertToType(half, FIT_BITMAP);
+		if(!chk) throw(1);
+		if(FreeImage_GetBPP(chk) != 32) throw(1);
+		for(y = 0; y < height; y++) {
+			FIRGBAF *src_bits = (FIRGBAF *)FreeImage_GetScanLine(src, y);
+			BYTE *chk_bits = FreeImage_GetScanLine(chk, y);
+			for(x = 0; x < width; x++, chk_bits += 4) {
+				if(abs(chk_bits[FI_RGBA_RED] - (int)(src_bits[x].red * 255 + 0.5F)) > 1) throw(1);
+				if(abs(chk_bits[FI_RGBA_GREEN] - (int)(src_bits[x].green * 255 + 0.5F)) > 1) throw(1);
+				if(abs(chk_bits[FI_RGBA_BLUE] - (src_bits[x].blue < 1 ? (int)(src_bits[x].blue * 255 + 0.5F) : 255)) > 1) throw(1);
+				if(chk_bits[FI_RGBA_ALPHA] != 128) throw(1);
+			}
+		}
+		FreeImage_Unload(chk);
+		chk = NULL;
+
+		// save / load as OpenEXR half without widening to float
+		if(!FreeImage_Save(FIF_EXR, half, "TestImageType.exr", EXR_DEFAULT)) throw(1);
+		chk = FreeImage_Load(FIF_EXR, "TestImageType.exr", EXR_ALLOW_FOR_FP16);
+		if(!chk) throw(1);
+		if(FreeImage_GetImageType(chk) != FIT_RGBA16F) throw(1);
+		for(y = 0; y < height; y++) {
+			FIRGBA16 *half_bits = (FIRGBA16 *)FreeImage_GetScanLine(half, y);
+			FIRGBA16 *chk_bits = (FIRGBA16 *)FreeImage_GetScanLine(chk, y);
+			for(x = 0; x < width; x++) {
+				if((half_bits[x].red != chk_bits[x].red) || (half_bits[x].blue != chk_bits[x].blue) || (half_bits[x].alpha != chk_bits[x].alpha))
+					throw(1);
+			}
+		}
+
+		FreeImage_Unload(chk);
+		FreeImage_Unload(half);
+		FreeImage_Unload(src);
+
+	} catch(int) {
+		if(src) FreeImage_Unload(src);
+		if(half) FreeImage_Unload(half);
+		if(chk) FreeImage_Unload(chk);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+Set the value of a pixel of a greyscale image of any type
+*/
+static void
+setGreyValue(FIBITMAP *dib, unsigned x, unsigned y, double value) {
+	BYTE *bits = FreeImage_GetScanLine(dib, y);
+	switch(FreeImage_GetImageType(dib)) {
+		case FIT_UINT16:
+			((WORD*)bits)[x] = (WORD)value;
+			break;
+		case FIT_INT16:
+			((short*)bits)[x] = (short)value;
+			break;
+		case FIT_UINT32:
+			((DWORD*)bits)[x] = (DWORD)value;
+			break;
+		case FIT_INT32:
+			((LONG*)bits)[x] = (LONG)value;
+			break;
+		case FIT_FLOAT:
+			((float*)bits)[x] = (float)value;
+			break;
+		case FIT_DOUBLE:
+			((double*)bits)[x] = value;
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+Value of the pixel (x, y) of the ramp images used by testMinMaxType
+*/
+static double
+rampValue(FREE_IMAGE_TYPE image_type, unsigned x, unsigned y) {
+	const BOOL bSigned = (image_type == FIT_INT16) || (image_type == FIT_INT32) || (image_type == FIT_FLOAT) || (image_type == FIT_DOUBLE);
+	return (double)((x + 3 * y) % 1000) - (bSigned ? 300 : 0);
+}
+
+/**
+Test FreeImage_GetMinMax and FreeImage_ConvertToStandardTypeRange on a greyscale image type
+*/
+static BOOL
+testMinMaxType(FREE_IMAGE_TYPE image_type, unsigned width, unsigned height) {
+	FIBITMAP *dib = NULL;
+	FIBITMAP *range = NULL;
+	FIBITMAP *standard = NULL;
+	unsigned x, y;
+	double min_value, max_value;
+
+	try {
+		dib = FreeImage_AllocateT(image_type, width, height);
+		if(!dib) throw(1);
+
+		// ramp image : true min and max
+		double ramp_min = rampValue(image_type, 0, 0);
+		double ramp_max = ramp_min;
+		for(y = 0; y < height; y++) {
+			for(x = 0; x < width; x++) {
+				const double value = rampValue(image_type, x, y);
+				setGreyValue(dib, x, y, value);
+				ramp_min = (value < ramp_min) ? value : ramp_min;
+				ramp_max = (value > ramp_max) ? value : ramp_max;
+			}
+		}
+		if(!FreeImage_GetMinMax(dib, &min_value, &max_value)) throw(1);
+		if((min_value != ramp_min) || (max_value != ramp_max)) throw(1);
+
+		// the range conversion gives the result of the standard conversion for the same range
+		// (the standard conversion range always includes some part of [0..255])
+		range = FreeImage_ConvertToStandardTypeRange(dib, (min_value < 255) ? min_value : 255, (max_value > 0) ? max_value : 0);
+		standard = FreeImage_ConvertToStandardType(dib, TRUE);
+		if(!range || !standard) throw(1);
+		for(y = 0; y < height; y++) {
+			if(memcmp(FreeImage_GetScanLine(range, y), FreeImage_GetScanLine(standard, y), width) != 0) throw(1);
+		}
+		FreeImage_Unload(range); range = NULL;
+		FreeImage_Unload(standard); standard = NULL;
+
+		// values outside the range are clamped
+		range = FreeImage_ConvertToStandardTypeRange(dib, 100, 200);
+		if(!range) throw(1);
+		for(y = 0; y < height; y++) {
+			const BYTE *bits = FreeImage_GetScanLine(range, y);
+			for(x = 0; x < width; x++) {
+				const double value = rampValue(image_type, x, y);
+				if((value <= 100) && (bits[x] != 0)) throw(1);
+				if((value >= 200) && (bits[x] != 255)) throw(1);
+				if((value > 100) && (value < 200) && (fabs((value - 100) * 255 / 100 - bits[x]) > 1)) throw(1);
+			}
+		}
+		FreeImage_Unload(range); range = NULL;
+
+		// empty or reversed ranges are rejected
+		if(FreeImage_ConvertToStandardTypeRange(dib, 200, 200) != NULL) throw(1);
+		if(FreeImage_ConvertToStandardTypeRange(dib, 200, 100) != NULL) throw(1);
+
+		if((image_type == FIT_FLOAT) || (image_type == FIT_DOUBLE)) {
+			// NaN values are ignored, the first pixel included, and converted to 0
+			const double nan = sqrt(-1.0);
+			setGreyValue(dib, 0, 0, nan);
+			setGreyValue(dib, width / 2, height / 2, nan);
+			if(!FreeImage_GetMinMax(dib, &min_value, &max_value)) throw(1);
+			if((min_value != ramp_min) || (max_value != ramp_max)) throw(1);
+			range = FreeImage_ConvertToStandardTypeRange(dib, min_value, max_value);
+			if(!range) throw(1);
+			if(FreeImage_GetScanLine(range, height / 2)[width / 2] != 0) throw(1);
+			FreeImage_Unload(range); range = NULL;
+
+			// an image without any number has no range
+			for(y = 0; y < height; y++) {
+				for(x = 0; x < width; x++) {
+					setGreyValue(dib, x, y, nan);
+				}
+			}
+			if(FreeImage_GetMinMax(dib, &min_value, &max_value)) throw(1);
+		}
+
+		// constant image
+		for(y = 0; y < height; y++) {
+			for(x = 0; x < width; x++) {
+				setGreyValue(dib, x, y, 42);
+			}
+		}
+		if(!FreeImage_GetMinMax(dib, &min_value, &max_value, 1)) throw(1);
+		if((min_value != 42) || (max_value != 42)) throw(1);
+
+		FreeImage_Unload(dib);
+
+	} catch(int) {
+		if(dib) FreeImage_Unload(dib);
+		if(range) FreeImage_Unload(range);
+		if(standard) FreeImage_Unload(standard);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL testReadWriteRect(unsigned width, unsigned height) {
+	FIBITMAP *dib = NULL;
+	BYTE *rgba = NULL;
+	BYTE *bgra = NULL;
+	float *planes = NULL;
+	int x, y;
+
+	// rectangle in the lower right quarter of the image
+	const int left = width / 2;
+	const int top = height / 2;
+	const int w = width - left;
+	const int h = height - top;
+
+	try {
+		rgba = (BYTE*)malloc(w * h * 4);
+		bgra = (BYTE*)malloc(w * h * 4);
+		planes = (float*)malloc(w * h * 4 * sizeof(float));
+		if(!rgba || !bgra || !planes) throw(1);
+		for(y = 0; y < h; y++) {
+			for(x = 0; x < w; x++) {
+				BYTE *p = rgba + 4 * (y * w + x);
+				p[0] = (BYTE)x; p[1] = (BYTE)y; p[2] = (BYTE)(x + y); p[3] = 0x80;
+			}
+		}
+
+		// 32-bit : RGBA8 in, BGRA8 out
+		dib = FreeImage_Allocate(width, height, 32);
+		if(!dib) throw(1);
+		if(!FreeImage_WriteRect(dib, left, top, w, h, rgba, w * 4, FIPL_RGBA8)) throw(1);
+		if(!FreeImage_ReadRect(dib, left, top, w, h, bgra, w * 4, FIPL_BGRA8)) throw(1);
+		for(y = 0; y < h; y++) {
+			for(x = 0; x < w; x++) {
+				const BYTE *p = rgba + 4 * (y * w + x);
+				const BYTE *q = bgra + 4 * (y * w + x);
+				if((p[0] != q[2]) || (p[1] != q[1]) || (p[2] != q[0]) || (p[3] != q[3])) throw(1);
+			}
+		}
+		// the caller buffer is top-down
+		RGBQUAD color;
+		FreeImage_GetPixelColor(dib, left, height - 1 - top, &color);
+		if((color.rgbRed != rgba[0]) || (color.rgbBlue != rgba[2])) throw(1);
+		// out of range rectangle
+		if(FreeImage_ReadRect(dib, left + 1, top, w, h, bgra, w * 4, FIPL_BGRA8)) throw(1);
+		// left + width overflows
+		if(FreeImage_ReadRect(dib, 1, top, 0x7FFFFFFF, h, bgra, w * 4, FIPL_BGRA8)) throw(1);
+		if(FreeImage_ReadRect(dib, left, 0x7FFFFFFF, w, 2, bgra, w * 4, FIPL_BGRA8)) throw(1);
+
+		// 32-bit : RGBAF in and out (values are clamped, NaN values give 0)
+		for(y = 0; y < h; y++) {
+			for(x = 0; x < w; x++) {
+				float *p = planes + 4 * (y * w + x);
+				p[0] = (x & 0xFF) / 255.0F; p[1] = -1.0F + (x & 3); p[2] = (x % 5 == 0) ? (float)NAN : 0.25F; p[3] = 0.5F;
+			}
+		}
+		if(!FreeImage_WriteRect(dib, left, top, w, h, planes, w * 4 * sizeof(float), FIPL_RGBAF)) throw(1);
+		if(!FreeImage_ReadRect(dib, left, top, w, h, bgra, w * 4, FIPL_RGBA8)) throw(1);
+		for(y = 0; y < h; y++) {
+			for(x = 0; x < w; x++) {
+				const BYTE *q = bgra + 4 * (y * w + x);
+				const BYTE green = ((x & 3) <= 1) ? 0 : 255;
+				const BYTE blue = (x % 5 == 0) ? 0 : 64;
+				if((q[0] != (BYTE)x) || (q[1] != green) || (q[2] != blue) || (q[3] != 128)) throw(1);
+			}
+		}
+		if(!FreeImage_ReadRect(dib, left, top, w, h, planes, w * 4 * sizeof(float), FIPL_RGBAF)) throw(1);
+		for(y = 0; y < h; y++) {
+			for(x = 0; x < w; x++) {
+				const BYTE *q = bgra + 4 * (y * w + x);
+				const float *p = planes + 4 * (y * w + x);
+				for(int c = 0; c < 4; c++) {
+					if(fabs(p[c] - q[c] / 255.0F) > 1e-6F) throw(1);
+				}
+			}
+		}
+		FreeImage_Unload(dib);
+
+		// RGBA16 : RGBA8 in, planar RGBAF out
+		dib = FreeImage_AllocateT(FIT_RGBA16, width, height);
+		if(!dib) throw(1);
+		if(!FreeImage_WriteRect(dib, left, top, w, h, rgba, w * 4, FIPL_RGBA8)) throw(1);
+		if(!FreeImage_ReadRect(dib, left, top, w, h, planes, w * sizeof(float), FIPL_RGBAF_PLANAR)) throw(1);
+		for(y = 0; y < h; y++) {
+			for(x = 0; x < w; x++) {
+				const BYTE *p = rgba + 4 * (y * w + x);
+				for(int c = 0; c < 4; c++) {
+					const float value = planes[c * w * h + y * w + x];
+					if(fabs(value - p[c] / 255.0F) > 1e-6F) throw(1);
+				}
+			}
+		}
+		FreeImage_Unload(dib);
+		dib = NULL;
+
+		free(rgba);
+		free(bgra);
+		free(planes);
+
+	} catch(int) {
+		if(dib) FreeImage_Unload(dib);
+		free(rgba);
+		free(bgra);
+		free(planes);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+BOOL testRotateFlipType(FREE_IMAGE_TYPE image_type, unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = FreeImage_AllocateT(image_type, width, height, bpp);
+	if(!src) return FALSE;
+
+	// fill with a pattern where every byte depends on its position
+	const unsigned line = FreeImage_GetLine(src);
+	const unsigned bytespp = line / width;
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned i = 0; i < line; i++) {
+			bits[i] = (BYTE)(i * 7 + y * 13);
+		}
+	}
+
+	// rotating by 90 degree moves pixel (x, y) to (height - 1 - y, x) in buffer coordinates
+	FIBITMAP *dst = FreeImage_Rotate(src, 90);
+	if(!dst) return FALSE;
+	BOOL bResult = (FreeImage_GetWidth(dst) == height) && (FreeImage_GetHeight(dst) == width);
+	for(unsigned y = 0; (y < height) && bResult; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++) {
+			const BYTE *dst_bits = FreeImage_GetScanLine(dst, x) + (height - 1 - y) * bytespp;
+			if(memcmp(dst_bits, src_bits + x * bytespp, bytespp) != 0) {
+				bResult = FALSE;
+				break;
+			}
+		}
+	}
+
+	// rotating back gives the original image, a horizontal flip moves pixel (x, y) to (width - 1 - x, y)
+	FIBITMAP *back = FreeImage_Rotate(dst, -90);
+	bResult = bResult && back && FreeImage_FlipHorizontal(back);
+	for(unsigned y = 0; (y < height) && bResult; y++) {
+		const BYTE *src_bits = FreeImage_GetScanLine(src, y);
+		const BYTE *dst_bits = FreeImage_GetScanLine(back, y);
+		for(unsigned x = 0; x < width; x++) {
+			if(memcmp(dst_bits + (width - 1 - x) * bytespp, src_bits + x * bytespp, bytespp) != 0) {
+				bResult = FALSE;
+				break;
+			}
+		}
+	}
+
+	// flipping twice gives the original image
+	bResult = bResult && FreeImage_FlipHorizontal(back);
+	for(unsigned y = 0; (y < height) && bResult; y++) {
+		bResult = (memcmp(FreeImage_GetScanLine(back, y), FreeImage_GetScanLine(src, y), line) == 0);
+	}
+
+	FreeImage_Unload(back);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(src);
+
+	return bResult;
+}
+
+BOOL testRotateBilinear(unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = FreeImage_Allocate(width, height, bpp);
+	if(!src) return FALSE;
+
+	// fill with a smooth gradient
+	const unsigned bytespp = bpp / 8;
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++) {
+			for(unsigned c = 0; c < bytespp; c++) {
+				bits[x * bytespp + c] = (BYTE)((c & 1) ? (x * 255) / width : (y * 255) / height);
+			}
+		}
+	}
+
+	// the single pass rotation must agree with the 3-shears rotation, away from the borders
+	FIBITMAP *shear = FreeImage_Rotate(src, 30);
+	FIBITMAP *bilinear = FreeImage_RotateBilinear(src, 30);
+	BOOL bResult = (shear != NULL) && (bilinear != NULL);
+	if(bResult) {
+		const int w1 = FreeImage_GetWidth(shear), h1 = FreeImage_GetHeight(shear);
+		const int w2 = FreeImage_GetWidth(bilinear), h2 = FreeImage_GetHeight(bilinear);
+		for(int y = h2 / 2 - (int)height / 4; (y < h2 / 2 + (int)height / 4) && bResult; y++) {
+			const BYTE *bits1 = FreeImage_GetScanLine(shear, y + (h1 - h2) / 2) + ((w1 - w2) / 2) * bytespp;
+			const BYTE *bits2 = FreeImage_GetScanLine(bilinear, y);
+			for(int i = (w2 / 2 - (int)height / 4) * bytespp; i < (w2 / 2 + (int)height / 4) * (int)bytespp; i++) {
+				if(abs(bits1[i] - bits2[i]) > 3) {
+					bResult = FALSE;
+					break;
+				}
+			}
+		}
+	}
+
+	// rotating by a multiple of 90 degree is lossless
+	FIBITMAP *dst = FreeImage_RotateBilinear(src, 90);
+	FIBITMAP *ref = FreeImage_Rotate(src, 90);
+	bResult = bResult && dst && ref && (FreeImage_GetWidth(dst) == height);
+	for(unsigned y = 0; (y < width) && bResult; y++) {
+		bResult = (memcmp(FreeImage_GetScanLine(dst, y), FreeImage_GetScanLine(ref, y), FreeImage_GetLine(ref)) == 0);
+	}
+
+	FreeImage_Unload(ref);
+	FreeImage_Unload(dst);
+	FreeImage_Unload(bilinear);
+	FreeImage_Unload(shear);
+	FreeImage_Unload(src);
+
+	return bResult;
+}
+
+BOOL testRotateBilinearWide() {
+	// source positions beyond 32767 pixels must not overflow
+	const unsigned width = 40000;
+	const unsigned height = 16;
+	FIBITMAP *src = FreeImage_Allocate(width, height, 8);
+	if(!src) return FALSE;
+
+	// runs of 200 pixels of the same value
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[x] = (BYTE)(1 + (x / 200) % 255);
+		}
+	}
+
+	// an almost null angle leaves the center of every run unchanged
+	FIBITMAP *dst = FreeImage_RotateBilinear(src, 0.001);
+	BOOL bResult = (dst != NULL) && (FreeImage_GetWidth(dst) == width);
+	if(bResult) {
+		const BYTE *bits = FreeImage_GetScanLine(dst, FreeImage_GetHeight(dst) / 2);
+		for(unsigned x = 100; (x < width) && bResult; x += 200) {
+			bResult = (bits[x] == (BYTE)(1 + (x / 200) % 255));
+		}
+	}
+
+	FreeImage_Unload(dst);
+	FreeImage_Unload(src);
+
+	return bResult;
+}
+
+BOOL testRotateEx(unsigned bpp, unsigned width, unsigned height) {
+	FIBITMAP *src = FreeImage_Allocate(width, height, bpp);
+	if(!src) return FALSE;
+
+	// fill with a pattern where every byte depends on its position
+	const unsigned line = FreeImage_GetLine(src);
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned i = 0; i < line; i++) {
+			bits[i] = (BYTE)(i * 7 + y * 13);
+		}
+	}
+
+	// B-spline interpolation at the sample locations gives back the samples
+	FIBITMAP *dst = FreeImage_RotateEx(src, 0, 0, 0, width / 2, height / 2, FALSE);
+	BOOL bResult = (dst != NULL) && (FreeImage_GetBPP(dst) == bpp);
+	for(unsigned y = 0; (y < height) && bResult; y++) {
+		bResult = (memcmp(FreeImage_GetScanLine(dst, y), FreeImage_GetScanLine(src, y), line) == 0);
+	}
+	FreeImage_Unload(dst);
+
+	// pixels mapped from outside the image are masked
+	dst = FreeImage_RotateEx(src, 0, (double)width, 0, 0, 0, TRUE);
+	bResult = bResult && (dst != NULL);
+	for(unsigned y = 0; (y < height) && bResult; y++) {
+		const BYTE *bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned i = 0; i < line; i++) {
+			if(bits[i] != 0) {
+				bResult = FALSE;
+				break;
+			}
+		}
+	}
+	FreeImage_Unload(dst);
+
+	FreeImage_Unload(src);
+
+	return bResult;
+}
+
 // Main test functions
 // ----------------------------------------------------------
 
@@ -448,6 +973,60 @@ void testImageType(unsigned width, unsigned height) {
 	assert(bResult);
 	bResult = testAllocateCloneUnloadType(FIT_RGBAF, width, height);
 	assert(bResult);
+
+	// half-float conversions
+	bResult = testConvertHalfType(width, height);
+	assert(bResult);
+
+	// min / max search and range conversion
+	bResult = testMinMaxType(FIT_UINT16, width, height);
+	assert(bResult);
+	bResult = testMinMaxType(FIT_INT16, width, height);
+	assert(bResult);
+	bResult = testMinMaxType(FIT_UINT32, width, height);
+	assert(bResult);
+	bResult = testMinMaxType(FIT_INT32, width, height);
+	assert(bResult);
+	bResult = testMinMaxType(FIT_FLOAT, width, height);
+	assert(bResult);
+	bResult = testMinMaxType(FIT_DOUBLE, width, height);
+	assert(bResult);
+	double min_value, max_value;
+	FIBITMAP *rgbf = FreeImage_AllocateT(FIT_RGBF, width, height);
+	assert(!FreeImage_GetMinMax(rgbf, &min_value, &max_value));
+	FreeImage_Unload(rgbf);
+
+	// bulk rectangle access
+	bResult = testReadWriteRect(width, height);
+	assert(bResult);
+
+	// 90 degree rotations and horizontal flip
+	bResult = testRotateFlipType(FIT_BITMAP, 8, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateFlipType(FIT_BITMAP, 24, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateFlipType(FIT_BITMAP, 32, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateFlipType(FIT_UINT16, 16, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateFlipType(FIT_RGBA16, 64, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateFlipType(FIT_RGBF, 96, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateBilinear(8, width, height);
+	assert(bResult);
+	bResult = testRotateBilinear(24, width, height);
+	assert(bResult);
+	bResult = testRotateBilinear(32, width, height);
+	assert(bResult);
+	bResult = testRotateBilinearWide();
+	assert(bResult);
+	bResult = testRotateEx(8, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateEx(24, width + 3, height + 1);
+	assert(bResult);
+	bResult = testRotateEx(32, width + 3, height + 1);
+	assert(bResult);
 }
 
 
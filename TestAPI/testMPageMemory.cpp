@@ -21,6 +21,7 @@
 
 
 #include "TestSuite.h"
+#include <vector>
 
 // --------------------------------------------------------------------------
 
@@ -252,6 +253,167 @@ BOOL testMemoryStreamMultiPageOpenSave(const char *lpszPathName, char *output, i
 
 // --------------------------------------------------------------------------
 
+static void 
+putBigEndian(std::vector<BYTE>& data, unsigned value, unsigned size) {
+	for(int i = (int)size - 1; i >= 0; i--) {
+		data.push_back((BYTE)(value >> (8 * i)));
+	}
+}
+
+static void 
+putLayerRecord(std::vector<BYTE>& data, int top, int left, int bottom, int right, const short *ids, const unsigned *lengths, unsigned nChannels, const BYTE *mask, const char *name) {
+	putBigEndian(data, top, 4);
+	putBigEndian(data, left, 4);
+	putBigEndian(data, bottom, 4);
+	putBigEndian(data, right, 4);
+	putBigEndian(data, nChannels, 2);
+	for(unsigned c = 0; c < nChannels; c++) {
+		putBigEndian(data, (WORD)ids[c], 2);
+		putBigEndian(data, lengths[c], 4);
+	}
+	data.insert(data.end(), (const BYTE*)"8BIMnorm", (const BYTE*)"8BIMnorm" + 8);
+	putBigEndian(data, 255, 1);	// opacity
+	putBigEndian(data, 0, 3);	// clipping, flags, filler
+	// extra data : mask data, blending ranges, name padded to 4 bytes
+	putBigEndian(data, 4 + (mask ? 20 : 0) + 4 + 4, 4);
+	putBigEndian(data, mask ? 20 : 0, 4);
+	if(mask) {
+		data.insert(data.end(), mask, mask + 20);
+	}
+	putBigEndian(data, 0, 4);
+	putBigEndian(data, 1, 1);
+	putBigEndian(data, name[0], 1);
+	putBigEndian(data, 0, 2);
+}
+
+/**
+Build a RGB document with two layers : 
+layer A covers the document and has a transparency channel (raw channels), 
+layer B is 2x2 at (1,1) with RLE channels and a 2x1 user mask at (1,1), default color 0
+*/
+static void 
+buildLayeredPSD(std::vector<BYTE>& psd) {
+	// header, empty color mode data and image resources
+	psd.insert(psd.end(), (const BYTE*)"8BPS", (const BYTE*)"8BPS" + 4);
+	putBigEndian(psd, 1, 2);
+	putBigEndian(psd, 0, 6);
+	putBigEndian(psd, 3, 2);
+	putBigEndian(psd, 3, 4);	// height
+	putBigEndian(psd, 4, 4);	// width
+	putBigEndian(psd, 8, 2);
+	putBigEndian(psd, 3, 2);	// RGB
+	putBigEndian(psd, 0, 4);
+	putBigEndian(psd, 0, 4);
+
+	// layer info
+	std::vector<BYTE> info;
+	putBigEndian(info, (WORD)-2, 2);	// negative count : merged transparency in the first alpha channel
+
+	const short idsA[] = { -1, 0, 1, 2 };
+	const unsigned lengthsA[] = { 2 + 12, 2 + 12, 2 + 12, 2 + 12 };
+	putLayerRecord(info, 0, 0, 3, 4, idsA, lengthsA, 4, NULL, "A");
+
+	BYTE mask[20];
+	memset(mask, 0, sizeof(mask));
+	mask[3] = 1; mask[7] = 1; mask[11] = 2; mask[15] = 3;	// top 1, left 1, bottom 2, right 3
+	const short idsB[] = { 0, 1, 2, -2 };
+	const unsigned lengthsB[] = { 2 + 4 + 6, 2 + 4 + 6, 2 + 4 + 6, 2 + 2 };
+	putLayerRecord(info, 1, 1, 3, 3, idsB, lengthsB, 4, mask, "B");
+
+	// layer A : alpha 200, channel c of pixel (x, y) = 10 * c + 4 * y + x + 1
+	putBigEndian(info, 0, 2);
+	for(unsigned i = 0; i < 12; i++) {
+		putBigEndian(info, 200, 1);
+	}
+	for(unsigned c = 0; c < 3; c++) {
+		putBigEndian(info, 0, 2);
+		for(unsigned i = 0; i < 12; i++) {
+			putBigEndian(info, 10 * c + i + 1, 1);
+		}
+	}
+	// layer B : channel c of pixel (x, y) = 100 + 10 * c + 2 * y + x, rows packed as 2 literal bytes
+	for(unsigned c = 0; c < 3; c++) {
+		putBigEndian(info, 1, 2);
+		putBigEndian(info, 3, 2);
+		putBigEndian(info, 3, 2);
+		for(unsigned y = 0; y < 2; y++) {
+			putBigEndian(info, 1, 1);
+			putBigEndian(info, 100 + 10 * c + 2 * y, 1);
+			putBigEndian(info, 100 + 10 * c + 2 * y + 1, 1);
+		}
+	}
+	// user mask
+	putBigEndian(info, 0, 2);
+	putBigEndian(info, 0x40, 1);
+	putBigEndian(info, 0x80, 1);
+
+	// layer and mask information section
+	putBigEndian(psd, 4 + (unsigned)info.size() + 4, 4);
+	putBigEndian(psd, (unsigned)info.size(), 4);
+	psd.insert(psd.end(), info.begin(), info.end());
+	putBigEndian(psd, 0, 4);
+
+	// merged image, raw
+	putBigEndian(psd, 0, 2);
+	putBigEndian(psd, 0, 3 * 12);
+}
+
+static BOOL 
+checkLayerPixel(FIBITMAP *dib, unsigned x, unsigned y, BYTE red, BYTE green, BYTE blue, BYTE alpha) {
+	// y is given top-down
+	const BYTE *pixel = FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - 1 - y) + 4 * x;
+	return (pixel[FI_RGBA_RED] == red) && (pixel[FI_RGBA_GREEN] == green) && (pixel[FI_RGBA_BLUE] == blue) && (pixel[FI_RGBA_ALPHA] == alpha);
+}
+
+static BOOL 
+testLayeredPSDMemory() {
+	BOOL bResult = TRUE;
+
+	std::vector<BYTE> psd;
+	buildLayeredPSD(psd);
+
+	FIMEMORY *hmem = FreeImage_OpenMemory(&psd[0], (DWORD)psd.size());
+	FIMULTIBITMAP *src = FreeImage_LoadMultiBitmapFromMemory(FIF_PSD, hmem, 0);
+	if(!src) {
+		FreeImage_CloseMemory(hmem);
+		return FALSE;
+	}
+
+	// merged image and 2 layers
+	bResult &= (FreeImage_GetPageCount(src) == 3);
+
+	// pages are requested out of order, the layer index is reused
+	FIBITMAP *layerB = FreeImage_LockPage(src, 2);
+	bResult &= (layerB != NULL) && (FreeImage_GetWidth(layerB) == 2) && (FreeImage_GetHeight(layerB) == 2) && (FreeImage_GetBPP(layerB) == 32);
+	if(bResult) {
+		// the user mask covers the first row, its default color hides the second one
+		bResult &= checkLayerPixel(layerB, 0, 0, 100, 110, 120, 0x40);
+		bResult &= checkLayerPixel(layerB, 1, 0, 101, 111, 121, 0x80);
+		bResult &= checkLayerPixel(layerB, 0, 1, 102, 112, 122, 0);
+		bResult &= checkLayerPixel(layerB, 1, 1, 103, 113, 123, 0);
+
+		FITAG *tag = NULL;
+		bResult &= FreeImage_GetMetadata(FIMD_CUSTOM, layerB, "LayerName", &tag) && (strcmp((const char*)FreeImage_GetTagValue(tag), "B") == 0);
+		bResult &= FreeImage_GetMetadata(FIMD_CUSTOM, layerB, "LayerLeft", &tag) && (strcmp((const char*)FreeImage_GetTagValue(tag), "1") == 0);
+	}
+	FreeImage_UnlockPage(src, layerB, FALSE);
+
+	FIBITMAP *layerA = FreeImage_LockPage(src, 1);
+	bResult &= (layerA != NULL) && (FreeImage_GetWidth(layerA) == 4) && (FreeImage_GetHeight(layerA) == 3) && (FreeImage_GetBPP(layerA) == 32);
+	if(bResult) {
+		bResult &= checkLayerPixel(layerA, 0, 0, 1, 11, 21, 200);
+		bResult &= checkLayerPixel(layerA, 3, 2, 12, 22, 32, 200);
+	}
+	FreeImage_UnlockPage(src, layerA, FALSE);
+
+	FreeImage_CloseMultiBitmap(src, 0);
+	FreeImage_CloseMemory(hmem);
+
+	return bResult;
+}
+
+// --------------------------------------------------------------------------
+
 void testMultiPageMemory(const char *lpszPathName) {
 	BOOL bSuccess;
 
@@ -268,4 +430,8 @@ void testMultiPageMemory(const char *lpszPathName) {
 	bSuccess = testMemoryStreamMultiPageOpenSave("sample.tif", "mpage-mstream-redirect.tif", 0, 0);
 	assert(bSuccess);
 
+	// test the layers of a PSD document
+	bSuccess = testLayeredPSDMemory();
+	assert(bSuccess);
+
 }
@@ -146,3 +146,349 @@ void testMemIO(const char *lpszPathName) {
 	testAcquireMemIO(lpszPathName);
 }
 
+// ----------------------------------------------------------
+
+/**
+Save dib to a memory stream, load it back and compare the pixels
+*/
+static BOOL testMemoryRoundTrip(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags) {
+	BOOL bResult = FALSE;
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+
+	if(FreeImage_SaveToMemory(fif, dib, hmem, flags)) {
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		FIBITMAP *check = FreeImage_LoadFromMemory(fif, hmem, 0);
+
+		if(check 
+			&& (FreeImage_GetWidth(check) == FreeImage_GetWidth(dib))
+			&& (FreeImage_GetHeight(check) == FreeImage_GetHeight(dib))
+			&& (FreeImage_GetBPP(check) == FreeImage_GetBPP(dib))) {
+
+			bResult = TRUE;
+			for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+				if(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(check, y), FreeImage_GetLine(dib)) != 0) {
+					bResult = FALSE;
+					break;
+				}
+			}
+		}
+		FreeImage_Unload(check);
+	}
+
+	FreeImage_CloseMemory(hmem);
+
+	return bResult;
+}
+
+/**
+Save dib to a memory stream, then load the first half of the stream : 
+the load must not fail on the missing data
+*/
+static BOOL testTruncatedLoad(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int flags) {
+	BOOL bResult = FALSE;
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+
+	if(FreeImage_SaveToMemory(fif, dib, hmem, flags)) {
+		BYTE *data = NULL;
+		DWORD size_in_bytes = 0;
+		FreeImage_AcquireMemory(hmem, &data, &size_in_bytes);
+
+		FIMEMORY *hhalf = FreeImage_OpenMemory(data, size_in_bytes / 2);
+		FIBITMAP *check = FreeImage_LoadFromMemory(fif, hhalf, 0);
+		bResult = check 
+			&& (FreeImage_GetWidth(check) == FreeImage_GetWidth(dib))
+			&& (FreeImage_GetHeight(check) == FreeImage_GetHeight(dib));
+		FreeImage_Unload(check);
+		FreeImage_CloseMemory(hhalf);
+	}
+
+	FreeImage_CloseMemory(hmem);
+
+	return bResult;
+}
+
+void testRLEMemIO(unsigned width, unsigned height) {
+	BOOL bResult;
+
+	printf("testRLEMemIO ...\n");
+
+	// use an odd width, so that packets do not end on a round boundary
+	FIBITMAP *dib8 = createZonePlateImage(width + 3, height, 128);
+	assert(dib8 != NULL);
+
+	// add long runs, and short runs that defeat the compression
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib8, y);
+		if(y < height / 4) {
+			memset(bits, (BYTE)y, width / 2);
+		} else if(y < height / 2) {
+			for(unsigned x = 0; x < width / 2; x++) {
+				bits[x] = (x % 3 == 2) ? (BYTE)x : (BYTE)y;
+			}
+		}
+	}
+
+	FIBITMAP *dib16 = FreeImage_ConvertTo16Bits555(dib8);
+	assert(dib16 != NULL);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	assert(dib24 != NULL);
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib8);
+	assert(dib32 != NULL);
+
+	bResult = testMemoryRoundTrip(FIF_TARGA, dib8, TARGA_SAVE_RLE);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_TARGA, dib16, TARGA_SAVE_RLE);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_TARGA, dib24, TARGA_SAVE_RLE);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_TARGA, dib32, TARGA_SAVE_RLE);
+	assert(bResult);
+
+	bResult = testMemoryRoundTrip(FIF_BMP, dib8, BMP_SAVE_RLE);
+	assert(bResult);
+
+	bResult = testMemoryRoundTrip(FIF_PSD, dib24, PSD_RLE);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PSD, dib32, PSD_RLE);
+	assert(bResult);
+
+	// 16-bit samples are byte swapped through a line cache
+	FIBITMAP *dib48 = FreeImage_ConvertToRGB16(dib24);
+	assert(dib48 != NULL);
+	FIBITMAP *dib64 = FreeImage_ConvertToRGBA16(dib32);
+	assert(dib64 != NULL);
+	bResult = testMemoryRoundTrip(FIF_PSD, dib48, PSD_RLE);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PSD, dib64, PSD_RLE);
+	assert(bResult);
+
+	// missing rows of a truncated file are decoded as zeros
+	bResult = testTruncatedLoad(FIF_PSD, dib24, PSD_RLE);
+	assert(bResult);
+	bResult = testTruncatedLoad(FIF_PSD, dib64, PSD_RLE);
+	assert(bResult);
+
+	FreeImage_Unload(dib64);
+	FreeImage_Unload(dib48);
+	FreeImage_Unload(dib32);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib16);
+	FreeImage_Unload(dib8);
+}
+
+void testPNMMemIO(unsigned width, unsigned height) {
+	BOOL bResult;
+
+	printf("testPNMMemIO ...\n");
+
+	// use an odd width, so that rows do not end on a parser block boundary
+	FIBITMAP *dib8 = createZonePlateImage(width + 3, height, 128);
+	assert(dib8 != NULL);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	assert(dib24 != NULL);
+	FIBITMAP *dib16 = FreeImage_ConvertToUINT16(dib8);
+	assert(dib16 != NULL);
+	FIBITMAP *dib48 = FreeImage_ConvertToRGB16(dib24);
+	assert(dib48 != NULL);
+
+	// spread the 16-bit values, so that numbers have 1 to 5 digits
+	for(unsigned y = 0; y < height; y++) {
+		WORD *bits = (WORD*)FreeImage_GetScanLine(dib16, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[x] = (WORD)(bits[x] * (x + y));
+		}
+	}
+
+	bResult = testMemoryRoundTrip(FIF_PGM, dib8, PNM_SAVE_ASCII);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PGM, dib8, PNM_SAVE_RAW);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PPM, dib24, PNM_SAVE_ASCII);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PPM, dib24, PNM_SAVE_RAW);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PGM, dib16, PNM_SAVE_ASCII);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PGM, dib16, PNM_SAVE_RAW);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PPM, dib48, PNM_SAVE_ASCII);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_PPM, dib48, PNM_SAVE_RAW);
+	assert(bResult);
+
+	FreeImage_Unload(dib48);
+	FreeImage_Unload(dib16);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+
+	// long numbers saturate instead of wrapping : the sample is clamped to maxval, 
+	// the width (2^32 + 2 would wrap to 2) is rejected
+	{
+		const char pgm[] = "P2\n2 1\n255\n7 99999999999999999999\n";
+		FIMEMORY *hmem = FreeImage_OpenMemory((BYTE*)pgm, (DWORD)strlen(pgm));
+		FIBITMAP *check = FreeImage_LoadFromMemory(FIF_PGM, hmem, 0);
+		bResult = (check != NULL) && (FreeImage_GetScanLine(check, 0)[0] == 7) && (FreeImage_GetScanLine(check, 0)[1] == 255);
+		assert(bResult);
+		FreeImage_Unload(check);
+		FreeImage_CloseMemory(hmem);
+	}
+	{
+		const char pgm[] = "P2\n4294967298 1\n255\n7 8\n";
+		FIMEMORY *hmem = FreeImage_OpenMemory((BYTE*)pgm, (DWORD)strlen(pgm));
+		FIBITMAP *check = FreeImage_LoadFromMemory(FIF_PGM, hmem, 0);
+		bResult = (check == NULL) || (FreeImage_GetWidth(check) != 2);
+		assert(bResult);
+		FreeImage_Unload(check);
+		FreeImage_CloseMemory(hmem);
+	}
+}
+
+// ----------------------------------------------------------
+
+void testBufferedMemIO(unsigned width, unsigned height) {
+	BOOL bResult;
+
+	printf("testBufferedMemIO ...\n");
+
+	// plugins parsing the stream a few bytes at a time, through a BufferedReader
+	FIBITMAP *dib8 = createZonePlateImage(width + 3, height, 128);
+	assert(dib8 != NULL);
+	FIBITMAP *icon = FreeImage_Copy(dib8, 0, 0, 64, 64);
+	assert(icon != NULL);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	assert(dib24 != NULL);
+
+	// more than 256 colors, so that XPM keeps the RGB pixels
+	for(unsigned y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(dib24, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[x * 3 + FI_RGBA_BLUE] = (BYTE)(x + y);
+		}
+	}
+
+	bResult = testMemoryRoundTrip(FIF_XPM, dib24, 0);
+	assert(bResult);
+	bResult = testMemoryRoundTrip(FIF_ICO, icon, 0);
+	assert(bResult);
+
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(icon);
+	FreeImage_Unload(dib8);
+}
+
+// ----------------------------------------------------------
+
+/**
+Compare the pixels of two dibs
+*/
+static BOOL isSamePixels(FIBITMAP *dib, FIBITMAP *check) {
+	if(!check 
+		|| (FreeImage_GetWidth(check) != FreeImage_GetWidth(dib))
+		|| (FreeImage_GetHeight(check) != FreeImage_GetHeight(dib))
+		|| (FreeImage_GetBPP(check) != FreeImage_GetBPP(dib))) {
+		return FALSE;
+	}
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+		if(memcmp(FreeImage_GetScanLine(dib, y), FreeImage_GetScanLine(check, y), FreeImage_GetLine(dib)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Save dib to a memory stream and to a file, load both with FIF_LOAD_MAPPED and check that the pixels are wrapped
+*/
+static BOOL testMappedLoad(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *lpszPathName) {
+	BOOL bResult = FALSE;
+
+	// memory stream : the dib owns a private copy of the stream pixels
+
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIBITMAP *check = NULL;
+
+	if(FreeImage_SaveToMemory(fif, dib, hmem, 0)) {
+		BYTE *data = NULL;
+		DWORD size_in_bytes = 0;
+		FreeImage_AcquireMemory(hmem, &data, &size_in_bytes);
+
+		FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+		check = FreeImage_LoadFromMemory(fif, hmem, FIF_LOAD_MAPPED);
+
+		bResult = isSamePixels(dib, check)
+			&& ((FreeImage_GetBits(check) < data) || (FreeImage_GetBits(check) >= data + size_in_bytes));
+
+		if(bResult) {
+			// changing the pixels must leave the stream untouched
+			memset(FreeImage_GetBits(check), 0x55, FreeImage_GetLine(check));
+			FreeImage_SeekMemory(hmem, 0L, SEEK_SET);
+			FIBITMAP *reloaded = FreeImage_LoadFromMemory(fif, hmem, 0);
+			bResult = isSamePixels(dib, reloaded);
+			FreeImage_Unload(reloaded);
+		}
+	}
+
+	// the dib outlives its stream
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(check);
+
+	if(!bResult) {
+		return FALSE;
+	}
+
+	// file : the dib owns a private view of the file
+
+	if(!FreeImage_Save(fif, dib, lpszPathName, 0)) {
+		return FALSE;
+	}
+
+	check = FreeImage_Load(fif, lpszPathName, FIF_LOAD_MAPPED);
+	bResult = isSamePixels(dib, check);
+
+	if(bResult) {
+		// changing the pixels must leave the file untouched
+		memset(FreeImage_GetBits(check), 0x55, FreeImage_GetLine(check));
+		FIBITMAP *reloaded = FreeImage_Load(fif, lpszPathName, 0);
+		bResult = isSamePixels(dib, reloaded);
+		FreeImage_Unload(reloaded);
+	}
+
+	FreeImage_Unload(check);
+	remove(lpszPathName);
+
+	return bResult;
+}
+
+void testMappedIO(unsigned width, unsigned height) {
+	BOOL bResult;
+
+	printf("testMappedIO ...\n");
+
+	// use an odd width, so that scanlines are padded in BMP files
+	FIBITMAP *dib8 = createZonePlateImage(width + 3, height, 128);
+	assert(dib8 != NULL);
+	FIBITMAP *dib24 = FreeImage_ConvertTo24Bits(dib8);
+	assert(dib24 != NULL);
+	FIBITMAP *dib32 = FreeImage_ConvertTo32Bits(dib8);
+	assert(dib32 != NULL);
+
+	bResult = testMappedLoad(FIF_BMP, dib8, "mapped.bmp");
+	assert(bResult);
+	bResult = testMappedLoad(FIF_BMP, dib24, "mapped.bmp");
+	assert(bResult);
+	bResult = testMappedLoad(FIF_BMP, dib32, "mapped.bmp");
+	assert(bResult);
+
+	bResult = testMappedLoad(FIF_TARGA, dib8, "mapped.tga");
+	assert(bResult);
+	bResult = testMappedLoad(FIF_TARGA, dib24, "mapped.tga");
+	assert(bResult);
+	bResult = testMappedLoad(FIF_TARGA, dib32, "mapped.tga");
+	assert(bResult);
+
+	FreeImage_Unload(dib32);
+	FreeImage_Unload(dib24);
+	FreeImage_Unload(dib8);
+}
@@ -36,3 +36,48 @@ void showPlugins() {
 	printf("\n");
 }
 
+// Format lookups
+// ----------------------------------------------------------
+void testFIFLookup() {
+	printf("testFIFLookup ...\n");
+
+	// every format string designates its own plugin, whatever its case
+	for(int j = 0; j < FreeImage_GetFIFCount(); j++) {
+		const FREE_IMAGE_FORMAT fif = (FREE_IMAGE_FORMAT)j;
+		const char *format = FreeImage_GetFormatFromFIF(fif);
+		assert(FreeImage_GetFIFFromFormat(format) == fif);
+
+		char lower[64];
+		strncpy(lower, format, sizeof(lower) - 1);
+		lower[sizeof(lower) - 1] = 0;
+		for(char *c = lower; *c; c++) {
+			if((*c >= 'A') && (*c <= 'Z')) *c += 'a' - 'A';
+		}
+		assert(FreeImage_GetFIFFromFormat(lower) == fif);
+
+		const char *mime = FreeImage_GetFIFMimeType(fif);
+		if(mime) {
+			assert(FreeImage_GetFIFFromMime(mime) != FIF_UNKNOWN);
+		}
+	}
+
+	// extensions, the lowest enabled format wins
+	assert(FreeImage_GetFIFFromFilename("dir.x/photo.JPG") == FIF_JPEG);
+	assert(FreeImage_GetFIFFromFilename("jpeg") == FIF_JPEG);
+	assert(FreeImage_GetFIFFromFilename("photo.tiff") == FIF_TIFF);
+	assert(FreeImage_GetFIFFromFilename("photo.") == FIF_UNKNOWN);
+	assert(FreeImage_GetFIFFromFilename("photo.jp") == FIF_UNKNOWN);
+	assert(FreeImage_GetFIFFromFilename("image.pbm") == FIF_PBM);
+	assert(FreeImage_GetFIFFromMime("IMAGE/JPEG") == FIF_JPEG);
+
+	FreeImage_SetPluginEnabled(FIF_PBM, FALSE);
+	FreeImage_SetPluginEnabled(FIF_JPEG, FALSE);
+	assert(FreeImage_GetFIFFromFilename("image.pbm") == FIF_PBMRAW);
+	assert(FreeImage_GetFIFFromFilename("photo.jpg") == FIF_UNKNOWN);
+	assert(FreeImage_GetFIFFromFormat("JPEG") == FIF_UNKNOWN);
+	assert(FreeImage_GetFIFFromMime("image/jpeg") == FIF_UNKNOWN);
+	FreeImage_SetPluginEnabled(FIF_JPEG, TRUE);
+	FreeImage_SetPluginEnabled(FIF_PBM, TRUE);
+	assert(FreeImage_GetFIFFromFilename("image.pbm") == FIF_PBM);
+	assert(FreeImage_GetFIFFromFilename("photo.jpg") == FIF_JPEG);
+}
@@ -0,0 +1,592 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+
+#include <atomic>
+#include <thread>
+
+// ----------------------------------------------------------
+
+static BOOL
+sameBits(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if(!dib1 || !dib2) {
+		return FALSE;
+	}
+	if((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2)) || (FreeImage_GetLine(dib1) != FreeImage_GetLine(dib2))) {
+		return FALSE;
+	}
+	for(unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if(memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+Rescale and convert an image serially, then in parallel, and compare the results
+*/
+static void
+checkParallelResults(FIBITMAP *dib) {
+	FreeImage_SetMaxParallelism(1);
+	FIBITMAP *up = FreeImage_Rescale(dib, 1000, 700, FILTER_CATMULLROM);
+	FIBITMAP *down = FreeImage_Rescale(dib, 300, 200, FILTER_LANCZOS3);
+	FreeImage_SetMaxParallelism(0);
+
+	FIBITMAP *p_up = FreeImage_Rescale(dib, 1000, 700, FILTER_CATMULLROM);
+	FIBITMAP *p_down = FreeImage_Rescale(dib, 300, 200, FILTER_LANCZOS3);
+	assert(sameBits(up, p_up));
+	assert(sameBits(down, p_down));
+
+	FreeImage_Unload(up);
+	FreeImage_Unload(down);
+	FreeImage_Unload(p_up);
+	FreeImage_Unload(p_down);
+}
+
+/**
+Composite and premultiply a 32-bit image serially, then in parallel, and compare the results
+*/
+static void
+checkParallelCompositing(FIBITMAP *rgba, FIBITMAP *rgb) {
+	// transparency taken from the (reversed) image
+	FIBITMAP *fg = FreeImage_Clone(rgba);
+	FIBITMAP *alpha = FreeImage_GetChannel(rgb, FICC_GREEN);
+	FreeImage_Invert(alpha);
+	assert(FreeImage_SetChannel(fg, alpha, FICC_ALPHA));
+	FreeImage_Unload(alpha);
+
+	FIBITMAP *results[2][4];
+	for(int k = 0; k < 2; k++) {
+		FreeImage_SetMaxParallelism(k ? 0 : 1);
+		results[k][0] = FreeImage_Composite(fg, FALSE, NULL, rgb);
+		results[k][1] = FreeImage_Clone(rgb);
+		assert(FreeImage_AlphaComposite(results[k][1], fg, 0, 0, FIBM_SCREEN, FALSE, 0.75));
+		results[k][2] = FreeImage_Clone(fg);
+		assert(FreeImage_PreMultiplyWithAlpha(results[k][2]));
+		results[k][3] = FreeImage_Clone(rgb);
+		assert(FreeImage_Paste(results[k][3], rgb, 0, 0, 100));
+	}
+	FreeImage_SetMaxParallelism(0);
+	for(int i = 0; i < 4; i++) {
+		assert(sameBits(results[0][i], results[1][i]));
+		FreeImage_Unload(results[0][i]);
+		FreeImage_Unload(results[1][i]);
+	}
+	FreeImage_Unload(fg);
+}
+
+/**
+Rotate and flip an image serially, then in parallel, and compare the results
+*/
+static void
+checkParallelRotations(FIBITMAP *dib) {
+	FIBITMAP *results[2][4];
+	for(int k = 0; k < 2; k++) {
+		FreeImage_SetMaxParallelism(k ? 0 : 1);
+		results[k][0] = FreeImage_Rotate(dib, 90);
+		results[k][1] = FreeImage_Rotate(dib, 30);
+		results[k][2] = FreeImage_RotateEx(dib, 30, 0, 0, FreeImage_GetWidth(dib) / 2, FreeImage_GetHeight(dib) / 2, TRUE);
+		results[k][3] = FreeImage_Clone(dib);
+		assert(FreeImage_FlipHorizontal(results[k][3]));
+	}
+	FreeImage_SetMaxParallelism(0);
+	for(int i = 0; i < 4; i++) {
+		assert(sameBits(results[0][i], results[1][i]));
+		FreeImage_Unload(results[0][i]);
+		FreeImage_Unload(results[1][i]);
+	}
+}
+
+/**
+Test executor, runs the tasks only when asked to
+*/
+typedef struct tagTestExecutor {
+	FI_TaskProc procs[256];
+	void *tasks[256];
+	int count;
+} TestExecutor;
+
+static void DLL_CALLCONV
+deferTask(FI_TaskProc proc, void *task, void *user_data) {
+	TestExecutor *executor = (TestExecutor*)user_data;
+	if(executor->count < 256) {
+		executor->procs[executor->count] = proc;
+		executor->tasks[executor->count] = task;
+		executor->count++;
+	} else {
+		proc(task);
+	}
+}
+
+static void
+runDeferredTasks(TestExecutor *executor) {
+	for(int i = 0; i < executor->count; i++) {
+		executor->procs[i](executor->tasks[i]);
+	}
+	executor->count = 0;
+}
+
+// ----------------------------------------------------------
+
+void testThreads(unsigned width, unsigned height) {
+	printf("testThreads ...\n");
+
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(zone);
+	FIBITMAP *rgba = FreeImage_ConvertTo32Bits(zone);
+	FIBITMAP *grey = FreeImage_ConvertToType(zone, FIT_FLOAT);
+
+	// settings
+	FreeImage_SetThreadCount(4);
+	assert(FreeImage_GetThreadCount() == 4);
+	FreeImage_SetMaxParallelism(2);
+	assert(FreeImage_GetMaxParallelism() == 2);
+	FreeImage_SetMaxParallelism(0);
+
+	// the worker pool gives the results of a serial run
+	checkParallelResults(zone);
+	checkParallelResults(rgb);
+	checkParallelResults(rgba);
+	checkParallelResults(grey);
+	checkParallelCompositing(rgba, rgb);
+	checkParallelRotations(zone);
+	checkParallelRotations(rgb);
+	checkParallelRotations(rgba);
+
+	FreeImage_SetMaxParallelism(1);
+	FIBITMAP *byte = FreeImage_ConvertToStandardType(grey, TRUE);
+	FreeImage_SetMaxParallelism(0);
+	FIBITMAP *p_byte = FreeImage_ConvertToStandardType(grey, TRUE);
+	assert(sameBits(byte, p_byte));
+	FreeImage_Unload(p_byte);
+
+	// an executor which has not run its tasks yet does not block the library
+	TestExecutor executor;
+	executor.count = 0;
+	FreeImage_SetExecutor(deferTask, 4, &executor);
+	assert(FreeImage_GetThreadCount() == 4);
+	p_byte = FreeImage_ConvertToStandardType(grey, TRUE);
+	assert(executor.count > 0);
+	assert(sameBits(byte, p_byte));
+	FreeImage_Unload(p_byte);
+	checkParallelResults(rgb);
+	runDeferredTasks(&executor);
+	FreeImage_SetExecutor(NULL, 0, NULL);
+
+	// back to the default settings
+	FreeImage_SetThreadCount(0);
+	checkParallelResults(rgb);
+
+	FreeImage_Unload(byte);
+	FreeImage_Unload(grey);
+	FreeImage_Unload(rgba);
+	FreeImage_Unload(rgb);
+	FreeImage_Unload(zone);
+}
+
+// ----------------------------------------------------------
+
+static void DLL_CALLCONV
+countCallback(FIASYNCJOB *job, void *user_data) {
+	int *count = (int*)user_data;
+	(*count)++;
+}
+
+/**
+Change the worker pool from a job callback, run by one of the workers
+*/
+static void DLL_CALLCONV
+reconfigureCallback(FIASYNCJOB *job, void *user_data) {
+	std::atomic<int> *count = (std::atomic<int>*)user_data;
+	FreeImage_SetThreadCount(3 + (*count % 2));
+	(*count)++;
+}
+
+/**
+Rescale an image from a job callback, run by one of the workers : 
+the parts of the loop go to the queue of that worker, the idle workers steal them
+*/
+typedef struct tagTestRescale {
+	FIBITMAP *src;
+	FIBITMAP *result;
+	std::atomic<bool> done;
+} TestRescale;
+
+static void DLL_CALLCONV
+rescaleCallback(FIASYNCJOB *job, void *user_data) {
+	TestRescale *rescale = (TestRescale*)user_data;
+	rescale->result = FreeImage_Rescale(rescale->src, 2 * FreeImage_GetWidth(rescale->src), 2 * FreeImage_GetHeight(rescale->src), FILTER_CATMULLROM);
+	rescale->done = true;
+}
+
+void testAsync(unsigned width, unsigned height) {
+	printf("testAsync ...\n");
+
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+
+	// save and load back through memory streams
+	int callbacks = 0;
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	FIASYNCJOB *job = FreeImage_SaveToMemoryAsync(FIF_PNG, zone, hmem, 0, countCallback, &callbacks);
+	assert(job != NULL);
+	assert(FreeImage_WaitAsync(job) == FIJS_DONE);
+	assert(FreeImage_GetAsyncBitmap(job) == NULL);
+	FreeImage_CloseAsync(job);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	job = FreeImage_LoadFromMemoryAsync(FIF_UNKNOWN, hmem, 0, countCallback, &callbacks);
+	assert(FreeImage_WaitAsync(job) == FIJS_DONE);
+	FIBITMAP *dib = FreeImage_GetAsyncBitmap(job);
+	assert(sameBits(zone, dib));
+	assert(FreeImage_GetAsyncBitmap(job) == NULL);
+	FreeImage_CloseAsync(job);
+	FreeImage_Unload(dib);
+
+	// save and load back a file, the bitmap not taken is unloaded on close
+	job = FreeImage_SaveAsync(FIF_TIFF, zone, "async.tif");
+	assert(FreeImage_WaitAsync(job) == FIJS_DONE);
+	FreeImage_CloseAsync(job);
+	job = FreeImage_LoadAsync(FIF_UNKNOWN, "async.tif");
+	assert(FreeImage_WaitAsync(job) == FIJS_DONE);
+	FreeImage_CloseAsync(job);
+	job = FreeImage_LoadAsync(FIF_UNKNOWN, "async.tif");
+	FreeImage_CloseAsync(job);
+
+	// a failed load
+	job = FreeImage_LoadAsync(FIF_UNKNOWN, "missing.tif", 0, countCallback, &callbacks);
+	assert(FreeImage_WaitAsync(job) == FIJS_FAILED);
+	assert(FreeImage_GetAsyncBitmap(job) == NULL);
+	FreeImage_CloseAsync(job);
+
+	// a job not started yet can be cancelled, a job which ended cannot
+	TestExecutor executor;
+	executor.count = 0;
+	FreeImage_SetExecutor(deferTask, 2, &executor);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	job = FreeImage_LoadFromMemoryAsync(FIF_PNG, hmem, 0, countCallback, &callbacks);
+	assert(FreeImage_GetAsyncStatus(job) == FIJS_PENDING);
+	assert(FreeImage_CancelAsync(job));
+	assert(FreeImage_WaitAsync(job) == FIJS_CANCELLED);
+	FIASYNCJOB *pending = FreeImage_SaveAsync(FIF_TIFF, zone, "async.tif", 0, countCallback, &callbacks);
+	FreeImage_CloseAsync(pending);
+	runDeferredTasks(&executor);
+	FreeImage_SetExecutor(NULL, 0, NULL);
+	assert(FreeImage_GetAsyncStatus(job) == FIJS_CANCELLED);
+	assert(FreeImage_GetAsyncBitmap(job) == NULL);
+	assert(!FreeImage_CancelAsync(job));
+	FreeImage_CloseAsync(job);
+
+	// callbacks run once per job, cancelled jobs included
+	assert(callbacks == 5);
+
+	// a callback can retire the pool running it
+	std::atomic<int> reconfigured(0);
+	for(int i = 0; i < 4; i++) {
+		FreeImage_SetThreadCount(2);
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		job = FreeImage_LoadFromMemoryAsync(FIF_PNG, hmem, 0, reconfigureCallback, &reconfigured);
+		assert(FreeImage_WaitAsync(job) == FIJS_DONE);
+		FreeImage_CloseAsync(job);
+		// the callback runs once the job has ended
+		while(reconfigured <= i) {
+			std::this_thread::yield();
+		}
+	}
+
+	// parallel loops started by workers give the results of a serial run
+	FreeImage_SetMaxParallelism(1);
+	FIBITMAP *serial = FreeImage_Rescale(zone, 2 * width, 2 * height, FILTER_CATMULLROM);
+	FreeImage_SetMaxParallelism(0);
+	FreeImage_SetThreadCount(4);
+	TestRescale rescales[4];
+	FIMEMORY *hrescaled[4];
+	for(int i = 0; i < 4; i++) {
+		rescales[i].src = zone;
+		rescales[i].result = NULL;
+		rescales[i].done = false;
+		hrescaled[i] = FreeImage_OpenMemory();
+		job = FreeImage_SaveToMemoryAsync(FIF_BMP, zone, hrescaled[i], 0, rescaleCallback, &rescales[i]);
+		assert(job != NULL);
+		FreeImage_CloseAsync(job);
+	}
+	for(int i = 0; i < 4; i++) {
+		while(!rescales[i].done) {
+			std::this_thread::yield();
+		}
+		assert(sameBits(serial, rescales[i].result));
+		FreeImage_Unload(rescales[i].result);
+		FreeImage_CloseMemory(hrescaled[i]);
+	}
+	FreeImage_Unload(serial);
+	FreeImage_SetThreadCount(0);
+
+	// callbacks retiring the pool while other jobs are still queued on it
+	reconfigured = 0;
+	FreeImage_SetThreadCount(2);
+	FIMEMORY *hqueued[8];
+	FIASYNCJOB *queued[8];
+	for(int i = 0; i < 8; i++) {
+		hqueued[i] = FreeImage_OpenMemory();
+		queued[i] = FreeImage_SaveToMemoryAsync(FIF_BMP, zone, hqueued[i], 0, reconfigureCallback, &reconfigured);
+	}
+	for(int i = 0; i < 8; i++) {
+		assert(FreeImage_WaitAsync(queued[i]) == FIJS_DONE);
+		FreeImage_CloseAsync(queued[i]);
+	}
+	while(reconfigured < 8) {
+		std::this_thread::yield();
+	}
+	for(int i = 0; i < 8; i++) {
+		FreeImage_CloseMemory(hqueued[i]);
+	}
+	FreeImage_SetThreadCount(0);
+
+	// concurrent saves of a bitmap share its serialized Exif profiles 
+	// (the streams are not compared byte for byte : concurrent encodes of the vendored JXR encoder differ)
+	FIBITMAP *exif = FreeImage_Load(FIF_JXR, "exif.jxr");
+	assert(exif != NULL);
+	const unsigned exif_count = FreeImage_GetMetadataCount(FIMD_EXIF_EXIF, exif);
+	assert(exif_count > 0);
+	FreeImage_SetThreadCount(4);
+	for(int pass = 0; pass < 4; pass++) {
+		FIMEMORY *hsaved[4];
+		FIASYNCJOB *jobs[4];
+		for(int i = 0; i < 4; i++) {
+			hsaved[i] = FreeImage_OpenMemory();
+			jobs[i] = FreeImage_SaveToMemoryAsync(FIF_JXR, exif, hsaved[i]);
+		}
+		for(int i = 0; i < 4; i++) {
+			assert(FreeImage_WaitAsync(jobs[i]) == FIJS_DONE);
+			FreeImage_CloseAsync(jobs[i]);
+
+			FreeImage_SeekMemory(hsaved[i], 0, SEEK_SET);
+			FIBITMAP *check = FreeImage_LoadFromMemory(FIF_JXR, hsaved[i], 0);
+			assert(check != NULL);
+			assert(FreeImage_GetMetadataCount(FIMD_EXIF_EXIF, check) == exif_count);
+			FreeImage_Unload(check);
+			FreeImage_CloseMemory(hsaved[i]);
+		}
+	}
+	FreeImage_SetThreadCount(0);
+	FreeImage_Unload(exif);
+
+	FreeImage_CloseMemory(hmem);
+	FreeImage_Unload(zone);
+}
+
+// ----------------------------------------------------------
+
+/**
+Progress handler checking the reported fractions, and cancelling
+the operation at its stop_at-th report when stop_at is not 0
+*/
+typedef struct tagTestProgress {
+	int calls;
+	int stop_at;
+	double last;
+	BOOL ordered;
+} TestProgress;
+
+static BOOL DLL_CALLCONV
+followProgress(double progress, void *user_data) {
+	TestProgress *test = (TestProgress*)user_data;
+	test->calls++;
+	// steps are mapped in floating point, allow for rounding errors
+	if((progress < test->last - 1e-9) || (progress > 1)) {
+		test->ordered = FALSE;
+	}
+	test->last = progress;
+	return (test->stop_at && (test->calls >= test->stop_at)) ? FALSE : TRUE;
+}
+
+static void
+resetProgress(TestProgress *test, int stop_at) {
+	test->calls = 0;
+	test->stop_at = stop_at;
+	test->last = 0;
+	test->ordered = TRUE;
+}
+
+/**
+Load an image followed by a progress handler, then cancel the load
+*/
+static void
+checkLoadProgress(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, int save_flags, int load_flags) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(fif, dib, hmem, save_flags));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *ref = FreeImage_LoadFromMemory(fif, hmem, load_flags);
+	assert(ref != NULL);
+
+	TestProgress progress;
+	resetProgress(&progress, 0);
+	FreeImage_SetProgressHandler(followProgress, &progress);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *chk = FreeImage_LoadFromMemory(fif, hmem, load_flags);
+	assert((progress.calls > 1) && progress.ordered);
+	assert(sameBits(ref, chk));
+	FreeImage_Unload(chk);
+
+	// cancelled loads free the partial bitmap and fail
+	resetProgress(&progress, 2);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	assert(FreeImage_LoadFromMemory(fif, hmem, load_flags) == NULL);
+	assert(progress.calls == 2);
+	FreeImage_SetProgressHandler(NULL);
+
+	FreeImage_Unload(ref);
+	FreeImage_CloseMemory(hmem);
+}
+
+/** Last message output by the library */
+static char s_last_message[256];
+
+static void DLL_CALLCONV
+keepMessage(FREE_IMAGE_FORMAT fif, const char *message) {
+	strncpy(s_last_message, message, sizeof(s_last_message) - 1);
+	s_last_message[sizeof(s_last_message) - 1] = 0;
+}
+
+/** Job cancelled by the reads of its IO */
+static FIASYNCJOB *s_cancelled_job = NULL;
+
+static unsigned DLL_CALLCONV
+cancelOnRead(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	if(s_cancelled_job) {
+		assert(FreeImage_CancelAsync(s_cancelled_job));
+	}
+	return FreeImage_ReadMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static unsigned DLL_CALLCONV
+writeMemory(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return FreeImage_WriteMemory(buffer, size, count, (FIMEMORY*)handle);
+}
+
+static int DLL_CALLCONV
+seekMemory(fi_handle handle, long offset, int origin) {
+	return FreeImage_SeekMemory((FIMEMORY*)handle, offset, origin) ? 0 : -1;
+}
+
+static long DLL_CALLCONV
+tellMemory(fi_handle handle) {
+	return FreeImage_TellMemory((FIMEMORY*)handle);
+}
+
+void testProgress(unsigned width, unsigned height) {
+	printf("testProgress ...\n");
+
+	FIBITMAP *zone = createZonePlateImage(width, height, 128);
+	assert(zone != NULL);
+	FIBITMAP *rgb = FreeImage_ConvertTo24Bits(zone);
+	FIBITMAP *rgbf = FreeImage_ConvertToRGBF(rgb);
+	// no black pixel, the tone mapping works on the log of the luminance
+	for(unsigned y = 0; y < height; y++) {
+		FIRGBF *pixel = (FIRGBF*)FreeImage_GetScanLine(rgbf, y);
+		for(unsigned x = 0; x < width; x++) {
+			pixel[x].red += 0.01F;
+			pixel[x].green += 0.01F;
+			pixel[x].blue += 0.01F;
+		}
+	}
+
+	// rescaling reports its progress in order and gives the same result
+	FIBITMAP *ref = FreeImage_Rescale(rgb, 1000, 700, FILTER_CATMULLROM);
+	TestProgress progress;
+	resetProgress(&progress, 0);
+	FreeImage_SetProgressHandler(followProgress, &progress);
+	FIBITMAP *dst = FreeImage_Rescale(rgb, 1000, 700, FILTER_CATMULLROM);
+	assert((progress.calls > 1) && progress.ordered);
+	assert(sameBits(ref, dst));
+	FreeImage_Unload(dst);
+	FreeImage_Unload(ref);
+
+	// a cancelled rescaling fails, whatever the number of threads
+	resetProgress(&progress, 2);
+	assert(FreeImage_Rescale(rgb, 1000, 700, FILTER_CATMULLROM) == NULL);
+	FreeImage_SetMaxParallelism(1);
+	resetProgress(&progress, 2);
+	assert(FreeImage_Rescale(rgb, 1000, 700, FILTER_CATMULLROM) == NULL);
+	assert(progress.calls == 2);
+	FreeImage_SetMaxParallelism(0);
+
+	// tone mapping
+	resetProgress(&progress, 0);
+	dst = FreeImage_TmoFattal02(rgbf, 0.5, 0.85);
+	assert((dst != NULL) && (progress.calls > 1) && progress.ordered);
+	FreeImage_Unload(dst);
+	resetProgress(&progress, progress.calls / 2);
+	assert(FreeImage_TmoFattal02(rgbf, 0.5, 0.85) == NULL);
+
+	// a cancelled type conversion is not reported as an unsupported one
+	FIBITMAP *flt = FreeImage_ConvertToType(zone, FIT_FLOAT);
+	assert(flt != NULL);
+	FreeImage_SetOutputMessage(keepMessage);
+	resetProgress(&progress, 1);
+	assert(FreeImage_ConvertToStandardType(flt, TRUE) == NULL);
+	assert(strstr(s_last_message, "cancelled") != NULL);
+	FreeImage_SetProgressHandler(NULL);
+	assert(FreeImage_ConvertToType(rgbf, FIT_INT16) == NULL);
+	assert(strstr(s_last_message, "No such conversion") != NULL);
+	FreeImage_SetOutputMessage(FreeImageErrorHandler);
+	FreeImage_Unload(flt);
+
+	// loads
+	checkLoadProgress(FIF_TIFF, rgb, TIFF_DEFAULT, 0);
+	checkLoadProgress(FIF_PSD, rgb, PSD_RLE, 0);
+	checkLoadProgress(FIF_PSD, rgb, PSD_NONE, 0);
+	checkLoadProgress(FIF_EXR, rgbf, EXR_DEFAULT, 0);
+
+	// asynchronous jobs report their progress, a running job can be cancelled
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	assert(FreeImage_SaveToMemory(FIF_TIFF, rgb, hmem, TIFF_DEFAULT));
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIASYNCJOB *job = FreeImage_LoadFromMemoryAsync(FIF_TIFF, hmem);
+	assert(FreeImage_WaitAsync(job) == FIJS_DONE);
+	assert(FreeImage_GetAsyncProgress(job) == 1);
+	FreeImage_CloseAsync(job);
+
+	FreeImageIO io;
+	io.read_proc = cancelOnRead;
+	io.write_proc = writeMemory;
+	io.seek_proc = seekMemory;
+	io.tell_proc = tellMemory;
+	TestExecutor executor;
+	executor.count = 0;
+	FreeImage_SetExecutor(deferTask, 2, &executor);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	job = FreeImage_LoadFromHandleAsync(FIF_TIFF, &io, (fi_handle)hmem);
+	s_cancelled_job = job;
+	runDeferredTasks(&executor);
+	FreeImage_SetExecutor(NULL, 0, NULL);
+	s_cancelled_job = NULL;
+	assert(FreeImage_WaitAsync(job) == FIJS_CANCELLED);
+	assert(FreeImage_GetAsyncBitmap(job) == NULL);
+	assert(FreeImage_GetAsyncProgress(job) < 1);
+	FreeImage_CloseAsync(job);
+	FreeImage_CloseMemory(hmem);
+
+	FreeImage_Unload(rgbf);
+	FreeImage_Unload(rgb);
+	FreeImage_Unload(zone);
+}
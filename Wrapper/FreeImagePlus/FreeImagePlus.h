@@ -617,6 +617,34 @@ public:
 	*/
 	BOOL setPixelColor(unsigned x, unsigned y, RGBQUAD *value);
 
+	/** 
+	Copy a rectangle of pixels into a caller buffer, converting to the requested layout (fast access). 
+	@param left Left position of the rectangle
+	@param top Top position of the rectangle
+	@param width Width of the rectangle
+	@param height Height of the rectangle
+	@param buffer Destination buffer, rows stored top to bottom
+	@param pitch Size in bytes of a buffer row (of a buffer plane row for planar layouts)
+	@param layout Pixel layout of the buffer
+	@return Returns TRUE if successful, FALSE otherwise. 
+	@see FreeImage_ReadRect
+	*/
+	BOOL readRect(int left, int top, int width, int height, void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout) const;
+
+	/** 
+	Copy a caller buffer into a rectangle of pixels, converting from the buffer layout (fast access). 
+	@param left Left position of the rectangle
+	@param top Top position of the rectangle
+	@param width Width of the rectangle
+	@param height Height of the rectangle
+	@param buffer Source buffer, rows stored top to bottom
+	@param pitch Size in bytes of a buffer row (of a buffer plane row for planar layouts)
+	@param layout Pixel layout of the buffer
+	@return Returns TRUE if successful, FALSE otherwise. 
+	@see FreeImage_WriteRect
+	*/
+	BOOL writeRect(int left, int top, int width, int height, const void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout);
+
 	//@}
 
 	/**	@name Conversion routines
@@ -0,0 +1,402 @@
+// ==========================================================
+// FreeImagePlus 3 - typed image views
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGEPLUSVIEW_H
+#define FREEIMAGEPLUSVIEW_H
+
+#include "FreeImagePlus.h"
+
+#include <cstddef>
+#include <iterator>
+
+/**
+Header-only typed access to the pixels of a FIBITMAP.
+
+A fi::ImageView<PixelT> is a non-owning (bits, width, height, pitch) window over an image
+whose pixel type is known at compile time. Algorithms such as fi::for_each_pixel or fi::transform
+are instantiated for a given pixel type, so that user kernels are inlined in a plain pointer loop
+the compiler can vectorize, instead of going through a runtime switch on the image type.
+
+Rows follow the FreeImage convention : row 0 is the bottom scanline, as returned by FreeImage_GetScanLine.
+Sub-views use the same (left, top, right, bottom) coordinates as FreeImage_Copy and FreeImage_CreateView.
+
+Example :
+@code
+fipImage image(FIT_RGBF, 512, 512, 96);
+fi::ImageView<FIRGBF> view(image);
+fi::for_each_pixel(view.subView(0, 0, 256, 256), ScaleRGBF(0.5F));
+@endcode
+*/
+namespace fi {
+
+// ----------------------------------------------------------
+//   Pixel traits
+// ----------------------------------------------------------
+
+/**
+Compile-time description of a pixel type : the FREE_IMAGE_TYPE it maps to and its bitdepth.
+Only the specializations below are defined, so that an ImageView of an unsupported type does not compile.
+*/
+template <class PixelT> struct PixelTraits;
+
+#define FIP_PIXEL_TRAITS(PixelT, image_type, bpp)						\
+	template <> struct PixelTraits<PixelT> {							\
+		static const FREE_IMAGE_TYPE type = image_type;				\
+		static const unsigned bitsPerPixel = bpp;						\
+		static bool accepts(FREE_IMAGE_TYPE t, unsigned b) {			\
+			return (t == type) && (b == bitsPerPixel);					\
+		}																\
+	}
+
+FIP_PIXEL_TRAITS(BYTE, FIT_BITMAP, 8);
+FIP_PIXEL_TRAITS(RGBTRIPLE, FIT_BITMAP, 24);
+FIP_PIXEL_TRAITS(RGBQUAD, FIT_BITMAP, 32);
+FIP_PIXEL_TRAITS(WORD, FIT_UINT16, 16);
+FIP_PIXEL_TRAITS(short, FIT_INT16, 16);
+FIP_PIXEL_TRAITS(DWORD, FIT_UINT32, 32);
+FIP_PIXEL_TRAITS(LONG, FIT_INT32, 32);
+FIP_PIXEL_TRAITS(float, FIT_FLOAT, 32);
+FIP_PIXEL_TRAITS(double, FIT_DOUBLE, 64);
+FIP_PIXEL_TRAITS(FICOMPLEX, FIT_COMPLEX, 128);
+FIP_PIXEL_TRAITS(FIRGBF, FIT_RGBF, 96);
+FIP_PIXEL_TRAITS(FIRGBAF, FIT_RGBAF, 128);
+
+#undef FIP_PIXEL_TRAITS
+
+/// FIRGB16 is used both by FIT_RGB16 and by FIT_RGB16F (half bits)
+template <> struct PixelTraits<FIRGB16> {
+	static const FREE_IMAGE_TYPE type = FIT_RGB16;
+	static const unsigned bitsPerPixel = 48;
+	static bool accepts(FREE_IMAGE_TYPE t, unsigned b) {
+		return ((t == FIT_RGB16) || (t == FIT_RGB16F)) && (b == bitsPerPixel);
+	}
+};
+
+/// FIRGBA16 is used both by FIT_RGBA16 and by FIT_RGBA16F (half bits)
+template <> struct PixelTraits<FIRGBA16> {
+	static const FREE_IMAGE_TYPE type = FIT_RGBA16;
+	static const unsigned bitsPerPixel = 64;
+	static bool accepts(FREE_IMAGE_TYPE t, unsigned b) {
+		return ((t == FIT_RGBA16) || (t == FIT_RGBA16F)) && (b == bitsPerPixel);
+	}
+};
+
+/// Read-only views share the traits of their mutable pixel type
+template <class PixelT> struct PixelTraits<const PixelT> : public PixelTraits<PixelT> {
+};
+
+// ----------------------------------------------------------
+//   Strided row iterator
+// ----------------------------------------------------------
+
+/// Byte type used for pitch arithmetic : char or const char, depending on the constness of PixelT
+template <class PixelT> struct ByteOf { typedef char type; };
+template <class PixelT> struct ByteOf<const PixelT> { typedef const char type; };
+
+/**
+Random access iterator over the rows of a view.
+Dereferencing the iterator gives a pointer to the first pixel of the row.
+*/
+template <class PixelT>
+class RowIterator {
+public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef PixelT* value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef PixelT* const* pointer;
+	typedef PixelT* reference;
+
+	RowIterator() : _row(NULL), _pitch(0) {}
+	RowIterator(PixelT *row, std::ptrdiff_t pitch) : _row(row), _pitch(pitch) {}
+
+	PixelT* operator*() const { return _row; }
+	PixelT* operator[](std::ptrdiff_t n) const { return advance(_row, n); }
+
+	RowIterator& operator++() { _row = advance(_row, 1); return *this; }
+	RowIterator operator++(int) { RowIterator tmp(*this); ++(*this); return tmp; }
+	RowIterator& operator--() { _row = advance(_row, -1); return *this; }
+	RowIterator operator--(int) { RowIterator tmp(*this); --(*this); return tmp; }
+	RowIterator& operator+=(std::ptrdiff_t n) { _row = advance(_row, n); return *this; }
+	RowIterator& operator-=(std::ptrdiff_t n) { _row = advance(_row, -n); return *this; }
+	RowIterator operator+(std::ptrdiff_t n) const { return RowIterator(advance(_row, n), _pitch); }
+	RowIterator operator-(std::ptrdiff_t n) const { return RowIterator(advance(_row, -n), _pitch); }
+
+	std::ptrdiff_t operator-(const RowIterator& other) const {
+		return _pitch ? ((const char*)_row - (const char*)other._row) / _pitch : 0;
+	}
+
+	bool operator==(const RowIterator& other) const { return _row == other._row; }
+	bool operator!=(const RowIterator& other) const { return _row != other._row; }
+	bool operator<(const RowIterator& other) const { return (*this - other) < 0; }
+	bool operator>(const RowIterator& other) const { return other < *this; }
+	bool operator<=(const RowIterator& other) const { return !(other < *this); }
+	bool operator>=(const RowIterator& other) const { return !(*this < other); }
+
+private:
+	PixelT* advance(PixelT *row, std::ptrdiff_t n) const {
+		typedef typename ByteOf<PixelT>::type byte_t;
+		return (PixelT*)((byte_t*)row + n * _pitch);
+	}
+
+	PixelT *_row;
+	std::ptrdiff_t _pitch;
+};
+
+// ----------------------------------------------------------
+//   ImageView
+// ----------------------------------------------------------
+
+/**
+Non-owning typed view over the pixels of an image.
+The view does not manage the lifetime of the underlying FIBITMAP, which must outlive the view.
+*/
+template <class PixelT>
+class ImageView {
+public:
+	typedef PixelT pixel_type;
+	typedef RowIterator<PixelT> iterator;
+
+	/// Create an empty view
+	ImageView() : _bits(NULL), _width(0), _height(0), _pitch(0) {}
+
+	/**
+	Create a view over a FIBITMAP.
+	If the image type or bitdepth does not match PixelT, or if the image has no pixels, the view is empty.
+	*/
+	ImageView(FIBITMAP *dib) : _bits(NULL), _width(0), _height(0), _pitch(0) {
+		attach(dib);
+	}
+
+	/// Create a view over a fipImage (same rules as above)
+	ImageView(fipImage& image) : _bits(NULL), _width(0), _height(0), _pitch(0) {
+		attach((FIBITMAP*)image);
+	}
+
+	/**
+	Create a view over a user buffer
+	@param bits Pointer to the first pixel of row 0
+	@param width View width in pixels
+	@param height View height in pixels
+	@param pitch Distance in bytes between two consecutive rows
+	*/
+	ImageView(PixelT *bits, unsigned width, unsigned height, unsigned pitch)
+		: _bits(bits), _width(width), _height(height), _pitch(pitch) {}
+
+	/// Allow implicit conversion from a mutable view to a read-only view
+	template <class OtherT>
+	ImageView(const ImageView<OtherT>& other)
+		: _bits(other.bits()), _width(other.getWidth()), _height(other.getHeight()), _pitch(other.getPitch()) {}
+
+	/// Returns TRUE if the view references pixels
+	BOOL isValid() const { return (_bits != NULL) ? TRUE : FALSE; }
+
+	unsigned getWidth() const { return _width; }
+	unsigned getHeight() const { return _height; }
+	unsigned getPitch() const { return _pitch; }
+	PixelT* bits() const { return _bits; }
+
+	/// Returns a pointer to row y (row 0 is the bottom scanline)
+	PixelT* row(unsigned y) const {
+		typedef typename ByteOf<PixelT>::type byte_t;
+		return (PixelT*)((byte_t*)_bits + (std::size_t)y * _pitch);
+	}
+
+	/// Returns the pixel at (x, y), without range check
+	PixelT& operator()(unsigned x, unsigned y) const { return row(y)[x]; }
+
+	/// Iterator on the first row
+	iterator begin() const { return iterator(_bits, _pitch); }
+	/// Iterator past the last row
+	iterator end() const { return iterator(row(_height), _pitch); }
+
+	/**
+	Returns a view on the rectangle (left, top, right, bottom), using the coordinates of FreeImage_CreateView.
+	The rectangle is clipped to the view; an empty view is returned if nothing is left.
+	*/
+	ImageView subView(unsigned left, unsigned top, unsigned right, unsigned bottom) const {
+		if(right > _width) right = _width;
+		if(bottom > _height) bottom = _height;
+		if((left >= right) || (top >= bottom)) {
+			return ImageView();
+		}
+		// rows are bottom-up : the first row of the sub-view is (height - bottom)
+		return ImageView(row(_height - bottom) + left, right - left, bottom - top, _pitch);
+	}
+
+private:
+	void attach(FIBITMAP *dib) {
+		if(dib && FreeImage_HasPixels(dib) && PixelTraits<PixelT>::accepts(FreeImage_GetImageType(dib), FreeImage_GetBPP(dib))) {
+			_bits = (PixelT*)FreeImage_GetBits(dib);
+			_width = FreeImage_GetWidth(dib);
+			_height = FreeImage_GetHeight(dib);
+			_pitch = FreeImage_GetPitch(dib);
+		}
+	}
+
+	PixelT *_bits;
+	unsigned _width;
+	unsigned _height;
+	unsigned _pitch;
+};
+
+// ----------------------------------------------------------
+//   Algorithms
+// ----------------------------------------------------------
+
+/**
+Apply f(pixel) to every pixel of a view
+@param view Input view (use a ImageView<const T> for read-only kernels)
+@param f Functor or lambda taking a PixelT&
+@return Returns the functor, so that accumulating functors can return their result
+*/
+template <class PixelT, class Function>
+Function for_each_pixel(const ImageView<PixelT>& view, Function f) {
+	const unsigned width = view.getWidth();
+	for(typename ImageView<PixelT>::iterator it = view.begin(); it != view.end(); ++it) {
+		PixelT *pixel = *it;
+		for(unsigned x = 0; x < width; x++) {
+			f(pixel[x]);
+		}
+	}
+	return f;
+}
+
+/**
+Apply f(pixel, x, y) to every pixel of a view, x and y being the pixel coordinates inside the view
+*/
+template <class PixelT, class Function>
+Function for_each_pixel_xy(const ImageView<PixelT>& view, Function f) {
+	const unsigned width = view.getWidth();
+	const unsigned height = view.getHeight();
+	for(unsigned y = 0; y < height; y++) {
+		PixelT *pixel = view.row(y);
+		for(unsigned x = 0; x < width; x++) {
+			f(pixel[x], x, y);
+		}
+	}
+	return f;
+}
+
+/**
+Store f(src pixel) into the corresponding dst pixel
+@param src Source view
+@param dst Destination view, with the same size as src (it may be the same view as src)
+@param f Functor or lambda taking a source pixel and returning a destination pixel
+@return Returns FALSE if the views have different sizes, TRUE otherwise
+*/
+template <class SrcT, class DstT, class Function>
+BOOL transform(const ImageView<SrcT>& src, const ImageView<DstT>& dst, Function f) {
+	if((src.getWidth() != dst.getWidth()) || (src.getHeight() != dst.getHeight())) {
+		return FALSE;
+	}
+	const unsigned width = src.getWidth();
+	const unsigned height = src.getHeight();
+	for(unsigned y = 0; y < height; y++) {
+		const SrcT *src_pixel = src.row(y);
+		DstT *dst_pixel = dst.row(y);
+		for(unsigned x = 0; x < width; x++) {
+			dst_pixel[x] = f(src_pixel[x]);
+		}
+	}
+	return TRUE;
+}
+
+/**
+Set every pixel of a view to value
+*/
+template <class PixelT>
+void fill(const ImageView<PixelT>& view, const PixelT& value) {
+	const unsigned width = view.getWidth();
+	for(typename ImageView<PixelT>::iterator it = view.begin(); it != view.end(); ++it) {
+		PixelT *pixel = *it;
+		for(unsigned x = 0; x < width; x++) {
+			pixel[x] = value;
+		}
+	}
+}
+
+/**
+Runtime to compile-time dispatch : call visitor(ImageView<T>) with the pixel type T matching the image.
+The visitor must provide a template operator() accepting any ImageView<T> (a generic lambda can be used with C++14).
+It is taken by forwarding reference, so that both named visitors and temporaries (such as lambdas) can be passed.
+This is the only place where the image type is switched on; the visitor body is compiled once per pixel type.
+@return Returns FALSE if the image has no pixels or if its type has no matching pixel type (1-, 4- and 16-bit bitmaps)
+*/
+template <class Visitor>
+BOOL visit(FIBITMAP *dib, Visitor&& visitor) {
+	if(!dib || !FreeImage_HasPixels(dib)) {
+		return FALSE;
+	}
+	switch(FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+			switch(FreeImage_GetBPP(dib)) {
+				case 8:
+					visitor(ImageView<BYTE>(dib));
+					return TRUE;
+				case 24:
+					visitor(ImageView<RGBTRIPLE>(dib));
+					return TRUE;
+				case 32:
+					visitor(ImageView<RGBQUAD>(dib));
+					return TRUE;
+				default:
+					return FALSE;
+			}
+		case FIT_UINT16:
+			visitor(ImageView<WORD>(dib));
+			return TRUE;
+		case FIT_INT16:
+			visitor(ImageView<short>(dib));
+			return TRUE;
+		case FIT_UINT32:
+			visitor(ImageView<DWORD>(dib));
+			return TRUE;
+		case FIT_INT32:
+			visitor(ImageView<LONG>(dib));
+			return TRUE;
+		case FIT_FLOAT:
+			visitor(ImageView<float>(dib));
+			return TRUE;
+		case FIT_DOUBLE:
+			visitor(ImageView<double>(dib));
+			return TRUE;
+		case FIT_COMPLEX:
+			visitor(ImageView<FICOMPLEX>(dib));
+			return TRUE;
+		case FIT_RGB16:
+		case FIT_RGB16F:
+			visitor(ImageView<FIRGB16>(dib));
+			return TRUE;
+		case FIT_RGBA16:
+		case FIT_RGBA16F:
+			visitor(ImageView<FIRGBA16>(dib));
+			return TRUE;
+		case FIT_RGBF:
+			visitor(ImageView<FIRGBF>(dib));
+			return TRUE;
+		case FIT_RGBAF:
+			visitor(ImageView<FIRGBAF>(dib));
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+} // namespace fi
+
+#endif // FREEIMAGEPLUSVIEW_H
@@ -293,6 +293,15 @@ BOOL fipImage::setPixelColor(unsigned x, unsigned y, RGBQUAD *value) {
 	return FreeImage_SetPixelColor(_dib, x, y, value);
 }
 
+BOOL fipImage::readRect(int left, int top, int width, int height, void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout) const {
+	return FreeImage_ReadRect(_dib, left, top, width, height, buffer, pitch, layout);
+}
+
+BOOL fipImage::writeRect(int left, int top, int width, int height, const void *buffer, unsigned pitch, FREE_IMAGE_PIXEL_LAYOUT layout) {
+	_bHasChanged = TRUE;
+	return FreeImage_WriteRect(_dib, left, top, width, height, buffer, pitch, layout);
+}
+
 ///////////////////////////////////////////////////////////////////
 // File type identification
 
@@ -66,6 +66,9 @@ int main(int argc, char *argv[]) {
 	// test multipage stream IO
 	testStreamMultiPage(lpszMultiPage);
 
+	// test typed image views
+	testImageView();
+
 #if defined(FREEIMAGE_LIB) || !defined(WIN32)
 	FreeImage_DeInitialise();
 #endif
@@ -76,5 +76,15 @@ BOOL testStreamMultiPageOpenSave(const char *input, const char *output, int inpu
 /// Test the above functions
 void testStreamMultiPage(const char *lpszPathName);
 
+// --------------------------------------------------------------------------
+// Typed image view test scripts
+
+/// test fi::ImageView, sub-views, row iterators and fi::for_each_pixel on a RGBF image
+BOOL testImageViewRGBF();
+/// test fi::transform and fi::visit
+BOOL testImageViewTransform();
+/// Test the above functions
+void testImageView();
+
 
 #endif // TEST_FREEIMAGEPLUS_API_H
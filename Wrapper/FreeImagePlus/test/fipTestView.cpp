@@ -0,0 +1,138 @@
+// ==========================================================
+// FreeImagePlus Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "fipTest.h"
+#include "../FreeImagePlusView.h"
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+// Typed image view test scripts
+
+/// Scale a RGBF pixel
+struct ScaleRGBF {
+	float factor;
+	ScaleRGBF(float f) : factor(f) {}
+	void operator()(FIRGBF& pixel) const {
+		pixel.red *= factor;
+		pixel.green *= factor;
+		pixel.blue *= factor;
+	}
+};
+
+/// Sum the pixels of a FIT_FLOAT image, ignore other image types
+struct SumVisitor {
+	double sum;
+	SumVisitor() : sum(0) {}
+	void operator()(const fi::ImageView<float>& view) {
+		for(unsigned y = 0; y < view.getHeight(); y++) {
+			for(unsigned x = 0; x < view.getWidth(); x++) {
+				sum += view(x, y);
+			}
+		}
+	}
+	template <class PixelT> void operator()(const fi::ImageView<PixelT>&) {
+	}
+};
+
+/// Count the pixels visited by a view
+struct CountPixels {
+	unsigned count;
+	CountPixels() : count(0) {}
+	void operator()(const float&) { count++; }
+};
+
+BOOL testImageViewRGBF() {
+	fipImage image(FIT_RGBF, 64, 32, 96);
+	fi::ImageView<FIRGBF> view(image);
+	if(!view.isValid()) return FALSE;
+
+	// wrong pixel type gives an empty view
+	fi::ImageView<FIRGBAF> wrong(image);
+	if(wrong.isValid()) return FALSE;
+
+	FIRGBF one = { 1, 1, 1 };
+	fi::fill(view, one);
+
+	// scale the upper left quarter (FreeImage_CreateView coordinates)
+	fi::ImageView<FIRGBF> quarter = view.subView(0, 0, 32, 16);
+	if((quarter.getWidth() != 32) || (quarter.getHeight() != 16)) return FALSE;
+	fi::for_each_pixel(quarter, ScaleRGBF(0.5F));
+
+	// row iterators are strided by the image pitch
+	if((view.end() - view.begin()) != 32) return FALSE;
+	if(*(view.begin() + 1) != (FIRGBF*)image.getScanLine(1)) return FALSE;
+
+	// check against the bottom-up scanlines
+	for(unsigned y = 0; y < 32; y++) {
+		const FIRGBF *bits = (FIRGBF*)image.getScanLine(y);
+		for(unsigned x = 0; x < 64; x++) {
+			const float expected = ((x < 32) && (y >= 16)) ? 0.5F : 1.0F;
+			if(bits[x].red != expected) return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+BOOL testImageViewTransform() {
+	fipImage src(FIT_RGBF, 16, 16, 96);
+	fipImage dst(FIT_FLOAT, 16, 16, 32);
+
+	fi::ImageView<FIRGBF> src_view(src);
+	FIRGBF color = { 0.25F, 0.5F, 0.25F };
+	fi::fill(src_view, color);
+
+	// RGBF => FLOAT luminance
+	struct Luma {
+		float operator()(const FIRGBF& pixel) const {
+			return 0.25F * pixel.red + 0.5F * pixel.green + 0.25F * pixel.blue;
+		}
+	};
+	fi::ImageView<const FIRGBF> in(src_view);
+	if(!fi::transform(in, fi::ImageView<float>(dst), Luma())) return FALSE;
+
+	// size mismatch
+	fipImage small(FIT_FLOAT, 8, 8, 32);
+	if(fi::transform(in, fi::ImageView<float>(small), Luma())) return FALSE;
+
+	// runtime dispatch
+	SumVisitor visitor;
+	if(!fi::visit(dst, visitor)) return FALSE;
+	if(visitor.sum != 16 * 16 * 0.375) return FALSE;
+
+	// runtime dispatch to a temporary
+	unsigned rows = 0;
+	if(!fi::visit(dst, [&rows](const auto& view) { rows += view.getHeight(); })) return FALSE;
+	if(rows != 16) return FALSE;
+
+	CountPixels counter = fi::for_each_pixel(fi::ImageView<const float>(dst).subView(4, 4, 12, 12), CountPixels());
+	if(counter.count != 64) return FALSE;
+
+	return TRUE;
+}
+
+void testImageView() {
+	cout << "testImageView ...\n";
+
+	BOOL bResult = testImageViewRGBF();
+	assert(bResult);
+	bResult = testImageViewTransform();
+	assert(bResult);
+}
+